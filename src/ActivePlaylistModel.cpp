@@ -16,32 +16,303 @@
  * You should have received a copy of the GNU General Public License
  * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
  */
-#include "DataStore.hpp"
 #include "ActivePlaylistModel.hpp"
-#include <QSqlRecord>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QStringList>
+#include <QSet>
 #include <QDateTime>
+#include <QFont>
+#include <QtAlgorithms>
 
 
 namespace UDJ{
 
 
-ActivePlaylistModel::ActivePlaylistModel(
-  const QString& query, DataStore *dataStore, QObject *parent)
-  :MusicModel(query, dataStore, parent)
-{}
+ActivePlaylistModel::ActivePlaylistModel(DataStore *dataStore, QObject *parent)
+  :QAbstractTableModel(parent),
+  dataStore(dataStore),
+  idColumn(-1),
+  upVoteColumn(-1),
+  downVoteColumn(-1),
+  durationColumn(-1),
+  adderColumn(-1),
+  timeAddedColumn(-1)
+{
+  refresh();
+}
+
+int ActivePlaylistModel::rowCount(const QModelIndex& parent) const{
+  return parent.isValid() ? 0 : rows.size();
+}
+
+int ActivePlaylistModel::columnCount(const QModelIndex& parent) const{
+  return parent.isValid() ? 0 : columns.count();
+}
 
 QVariant ActivePlaylistModel::data(const QModelIndex& item, int role) const{
-  int timeAddedIndex = record().indexOf(DataStore::getTimeAddedColName());
-  QVariant actualData = MusicModel::data(item, role);
-  if(item.column() == timeAddedIndex && role == Qt::DisplayRole){
-    QDateTime timeAdded = QDateTime::fromString(actualData.toString(),Qt::ISODate);
-    timeAdded.setTimeSpec(Qt::UTC);
-    return timeAdded.toLocalTime().toString("h:mm ap");
-  }
-  else{
+  if(!item.isValid() || item.row() >= rows.size()){
+    return QVariant();
+  }
+  if(role == Qt::TextAlignmentRole){
+    return QVariant(Qt::AlignLeft | Qt::AlignVCenter);
+  }
+  if(role == Qt::FontRole){
+    //Songs the server hasn't confirmed yet are set apart.
+    library_song_id_t id = rows.at(item.row()).value(idColumn).value<library_song_id_t>();
+    if(dataStore->isPendingPlaylistAdd(id)){
+      QFont pendingFont;
+      pendingFont.setItalic(true);
+      return pendingFont;
+    }
+    return QVariant();
+  }
+  if(role != Qt::DisplayRole && role != Qt::EditRole){
+    return QVariant();
+  }
+
+  QVariant actualData = rows.at(item.row()).value(item.column());
+  if(role != Qt::DisplayRole){
     return actualData;
   }
+  if(item.column() == durationColumn){
+    return durationDisplays.getDisplay(actualData.toInt());
+  }
+  if(item.column() == timeAddedColumn){
+    return getTimeAddedDisplay(actualData.toString());
+  }
+  return actualData;
+}
+
+QString ActivePlaylistModel::getTimeAddedDisplay(const QString& timeAdded) const{
+  QHash<QString, QString>::const_iterator cached = timeAddedDisplays.constFind(timeAdded);
+  if(cached != timeAddedDisplays.constEnd()){
+    return cached.value();
+  }
+  QDateTime time = QDateTime::fromString(timeAdded, Qt::ISODate);
+  time.setTimeSpec(Qt::UTC);
+  QString display = time.toLocalTime().toString("h:mm ap");
+  if(timeAddedDisplays.size() >= getMaxCachedDisplays()){
+    timeAddedDisplays.clear();
+  }
+  timeAddedDisplays.insert(timeAdded, display);
+  return display;
+}
+
+QVariant ActivePlaylistModel::headerData(
+  int section, Qt::Orientation orientation, int role) const
+{
+  if(orientation == Qt::Horizontal && role == Qt::DisplayRole &&
+    section >= 0 && section < columns.count())
+  {
+    if(section == downVoteColumn){
+      return tr("Down Votes");
+    }
+    else if(section == upVoteColumn){
+      return tr("Up Votes");
+    }
+    else if(section == adderColumn){
+      return tr("Adder");
+    }
+    else if(section == timeAddedColumn){
+      return tr("Time Added");
+    }
+    return columns.fieldName(section);
+  }
+  return QAbstractTableModel::headerData(section, orientation, role);
+}
+
+void ActivePlaylistModel::refresh(){
+  QSqlQuery dataQuery(dataStore->getDatabaseConnection());
+  EXEC_SQL(
+    "Error loading the active playlist",
+    dataQuery.exec(getDataQuery() + ";"),
+    dataQuery)
+
+  beginResetModel();
+  durationDisplays.clear();
+  timeAddedDisplays.clear();
+  columns = dataQuery.record();
+  idColumn = columns.indexOf(DataStore::getActivePlaylistLibIdColName());
+  upVoteColumn = columns.indexOf(DataStore::getUpVoteColName());
+  downVoteColumn = columns.indexOf(DataStore::getDownVoteColName());
+  durationColumn = columns.indexOf(DataStore::getLibDurationColName());
+  adderColumn = columns.indexOf(DataStore::getAdderUsernameColName());
+  timeAddedColumn = columns.indexOf(DataStore::getTimeAddedColName());
+  rows.clear();
+  while(dataQuery.next()){
+    rows.append(dataQuery.record());
+  }
+  reindexRows(0);
+  endResetModel();
+}
 
+void ActivePlaylistModel::applyChange(const DataStore::playlist_change_t& change){
+  if(!change.removed.isEmpty()){
+    QList<int> rowsToRemove;
+    Q_FOREACH(library_song_id_t id, change.removed){
+      QHash<library_song_id_t, int>::const_iterator existing = idToRow.constFind(id);
+      if(existing != idToRow.constEnd()){
+        rowsToRemove.append(existing.value());
+      }
+    }
+    if(!rowsToRemove.isEmpty()){
+      qSort(rowsToRemove);
+      removeSongRows(rowsToRemove);
+    }
+  }
+
+  if(change.entries.isEmpty()){
+    return;
+  }
+
+  QList<library_song_id_t> newIds;
+  Q_FOREACH(library_song_id_t id, change.inserted){
+    if(!idToRow.contains(id)){
+      newIds.append(id);
+    }
+  }
+  arrangeRows(change.entries, fetchSongs(newIds));
+}
+
+void ActivePlaylistModel::updateSongs(const QSet<library_song_id_t>& libIds){
+  Q_FOREACH(library_song_id_t id, libIds){
+    QHash<library_song_id_t, int>::const_iterator existing = idToRow.constFind(id);
+    if(existing != idToRow.constEnd()){
+      int row = existing.value();
+      emit dataChanged(index(row, 0), index(row, columns.count()-1));
+    }
+  }
+}
+
+void ActivePlaylistModel::arrangeRows(
+  const QVector<playlist_entry_t>& entries,
+  const QHash<library_song_id_t, QSqlRecord>& newSongs)
+{
+  //Rows above position are already where they belong. Each entry is either moved up to
+  //position, inserted at it, or skipped if it isn't something we display.
+  int position = 0;
+  for(int i=0; i<entries.size(); ++i){
+    const playlist_entry_t& entry = entries.at(i);
+    QHash<library_song_id_t, int>::const_iterator existing = idToRow.constFind(entry.libId);
+    if(existing != idToRow.constEnd()){
+      int row = existing.value();
+      if(row < position){
+        continue;
+      }
+      if(row > position){
+        beginMoveRows(QModelIndex(), row, row, QModelIndex(), position);
+        QSqlRecord moved = rows.at(row);
+        rows.remove(row);
+        rows.insert(position, moved);
+        reindexRows(position, row);
+        endMoveRows();
+      }
+      QSqlRecord& song = rows[position];
+      if(song.value(upVoteColumn).toInt() != entry.upvotes ||
+        song.value(downVoteColumn).toInt() != entry.downvotes ||
+        song.value(adderColumn).toString() != entry.adderUsername)
+      {
+        song.setValue(upVoteColumn, entry.upvotes);
+        song.setValue(downVoteColumn, entry.downvotes);
+        song.setValue(adderColumn, entry.adderUsername);
+        emit dataChanged(index(position, 0), index(position, columns.count()-1));
+      }
+      ++position;
+    }
+    else if(newSongs.contains(entry.libId)){
+      //Insert runs of new songs all at once.
+      int runEnd = i;
+      while(runEnd+1 < entries.size() &&
+        newSongs.contains(entries.at(runEnd+1).libId) &&
+        !idToRow.contains(entries.at(runEnd+1).libId))
+      {
+        ++runEnd;
+      }
+      QVector<QSqlRecord> run;
+      QSet<library_song_id_t> inRun;
+      for(int j=i; j<=runEnd; ++j){
+        library_song_id_t id = entries.at(j).libId;
+        if(!inRun.contains(id)){
+          inRun.insert(id);
+          run.append(newSongs.value(id));
+        }
+      }
+      beginInsertRows(QModelIndex(), position, position + run.size() - 1);
+      rows.insert(position, run.size(), QSqlRecord());
+      for(int j=0; j<run.size(); ++j){
+        rows[position+j] = run.at(j);
+      }
+      reindexRows(position);
+      endInsertRows();
+      position += run.size();
+      i = runEnd;
+    }
+  }
+
+  //Anything left over is no longer on the playlist.
+  if(position < rows.size()){
+    QList<int> leftOver;
+    for(int row = position; row < rows.size(); ++row){
+      leftOver.append(row);
+    }
+    removeSongRows(leftOver);
+  }
+}
+
+QHash<library_song_id_t, QSqlRecord> ActivePlaylistModel::fetchSongs(
+  const QList<library_song_id_t>& ids)
+{
+  QHash<library_song_id_t, QSqlRecord> songs;
+  QSqlQuery songQuery(dataStore->getDatabaseConnection());
+  for(int i=0; i<ids.size(); i+=getMaxIdsPerQuery()){
+    QStringList idList;
+    for(int j=i; j<ids.size() && j<i+getMaxIdsPerQuery(); ++j){
+      idList.append(QString::number(ids[j]));
+    }
+    EXEC_SQL(
+      "Error querying for songs added to the active playlist",
+      songQuery.exec(getDataQuery() + " WHERE " +
+        DataStore::getActivePlaylistLibIdColName() + " IN (" + idList.join(",") + ");"),
+      songQuery)
+    while(songQuery.next()){
+      QSqlRecord song = songQuery.record();
+      songs.insert(song.value(idColumn).value<library_song_id_t>(), song);
+    }
+  }
+  return songs;
+}
+
+void ActivePlaylistModel::removeSongRows(const QList<int>& rowsToRemove){
+  //Remove contiguous runs of rows starting from the bottom so that the rows we have
+  //yet to remove don't shift underneath us.
+  int runEnd = rowsToRemove.size() - 1;
+  while(runEnd >= 0){
+    int runStart = runEnd;
+    while(runStart > 0 && rowsToRemove[runStart-1] == rowsToRemove[runStart]-1){
+      --runStart;
+    }
+    int firstRow = rowsToRemove[runStart];
+    int lastRow = rowsToRemove[runEnd];
+    beginRemoveRows(QModelIndex(), firstRow, lastRow);
+    for(int row = firstRow; row <= lastRow; ++row){
+      idToRow.remove(rows.at(row).value(idColumn).value<library_song_id_t>());
+    }
+    rows.remove(firstRow, lastRow - firstRow + 1);
+    endRemoveRows();
+    runEnd = runStart - 1;
+  }
+  reindexRows(rowsToRemove.first());
+}
+
+void ActivePlaylistModel::reindexRows(int fromRow, int toRow){
+  if(fromRow == 0 && toRow == -1){
+    idToRow.clear();
+  }
+  int lastRow = toRow == -1 ? rows.size() - 1 : toRow;
+  for(int row = fromRow; row <= lastRow; ++row){
+    idToRow[rows.at(row).value(idColumn).value<library_song_id_t>()] = row;
+  }
 }
 
 
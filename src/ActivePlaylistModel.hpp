@@ -18,16 +18,29 @@
  */
 #ifndef ACTIVE_PLAYLIST_MODEL_HPP
 #define ACTIVE_PLAYLIST_MODEL_HPP
-#include "MusicModel.hpp"
+#include "ConfigDefs.hpp"
+#include "DataStore.hpp"
+#include "DurationDisplayCache.hpp"
+#include <QAbstractTableModel>
+#include <QSqlRecord>
+#include <QVector>
+#include <QHash>
+#include <QSet>
 
 namespace UDJ{
 
-class DataStore;
 
 /**
  * \brief A class serving as a model for the Active Playlist.
+ *
+ * The model keeps the playlist in memory and applies each change the DataStore reports
+ * to it row by row. Songs that move are moved, songs whose votes change are updated in
+ * place, and only songs new to the playlist are ever looked up in the database, so views
+ * keep their selection and scroll position while the playlist changes underneath them.
+ *
+ * Songs added locally that the server hasn't confirmed yet are shown in italics.
  */
-class ActivePlaylistModel : public MusicModel{
+class ActivePlaylistModel : public QAbstractTableModel{
 Q_OBJECT
 public:
 
@@ -37,25 +50,214 @@ public:
   /**
    * \brief Constructs an ActivePlaylistModel
    *
-   * @param query The query used to back the model.
    * @param dataStore The DataStore backing this instance of UDJ.
    * @param parent The parent QObject.
    */
-  ActivePlaylistModel(const QString& query, DataStore *dataStore, QObject *parent);
+  ActivePlaylistModel(DataStore *dataStore, QObject *parent);
 
   //@}
 
+  /** @name Overridden from QAbstractTableModel */
+  //@{
+
+  /** \brief . */
+  virtual int rowCount(const QModelIndex& parent=QModelIndex()) const;
+
+  /** \brief . */
+  virtual int columnCount(const QModelIndex& parent=QModelIndex()) const;
 
-  /** @name Overridden from MusicModel */
+  /** \brief . */
+  virtual QVariant data(const QModelIndex& item, int role) const;
+
+  /** \brief . */
+  virtual QVariant headerData(
+    int section, Qt::Orientation orientation, int role=Qt::DisplayRole) const;
+
+  //@}
+
+  /** @name Getters */
   //@{
 
   /**
-   * \brief .
+   * \brief Gets a record describing the columns of the model.
+   *
+   * \return A record describing the columns of the model.
+   */
+  inline QSqlRecord record() const{
+    return columns;
+  }
+
+  /**
+   * \brief Gets the record at the given row.
+   *
+   * \param row The row whose record is desired.
+   * \return The record at the given row.
    */
-  virtual QVariant data(const QModelIndex& item, int role) const;
+  inline QSqlRecord record(int row) const{
+    return rows.at(row);
+  }
 
   //@}
 
+public slots:
+  /** @name Public Slots */
+  //@{
+
+  /**
+   * \brief Reloads the entire playlist.
+   */
+  void refresh();
+
+  /**
+   * \brief Applies a change made to the active playlist to the model.
+   *
+   * \param change The change that was made.
+   */
+  void applyChange(const DataStore::playlist_change_t& change);
+
+  /**
+   * \brief Redisplays the given songs, for instance because they're no longer pending.
+   *
+   * \param libIds The songs to redisplay.
+   */
+  void updateSongs(const QSet<library_song_id_t>& libIds);
+
+  //@}
+
+private:
+
+  /** @name Private Memebers */
+  //@{
+
+  /** \brief DataStore backing the client */
+  DataStore *dataStore;
+
+  /** \brief Record describing the columns in the model. */
+  QSqlRecord columns;
+
+  /** \brief The songs on the playlist, in the order they'll be played. */
+  QVector<QSqlRecord> rows;
+
+  /** \brief Maps the library id of each song to the row it's in. */
+  QHash<library_song_id_t, int> idToRow;
+
+  /** \brief Index of the library id column. */
+  int idColumn;
+
+  /** \brief Index of the up vote column. */
+  int upVoteColumn;
+
+  /** \brief Index of the down vote column. */
+  int downVoteColumn;
+
+  /** \brief Index of the duration column. */
+  int durationColumn;
+
+  /** \brief Index of the adder username column. */
+  int adderColumn;
+
+  /** \brief Index of the time added column. */
+  int timeAddedColumn;
+
+  /** \brief Durations formatted for display. */
+  mutable DurationDisplayCache durationDisplays;
+
+  /**
+   * \brief Times added formatted for display in local time, by the time as stored.
+   */
+  mutable QHash<QString, QString> timeAddedDisplays;
+
+  //@}
+
+  /** @name Private Functions */
+  //@{
+
+  /**
+   * \brief Rebuilds the id to row mapping for the given rows.
+   *
+   * \param fromRow The first row whose mapping should be rebuilt.
+   * \param toRow The last row whose mapping should be rebuilt, or -1 for the last row in
+   * the model.
+   */
+  void reindexRows(int fromRow, int toRow=-1);
+
+  /**
+   * \brief Gets a time added formatted for display, converting it only the first time.
+   *
+   * \param timeAdded The time added as stored, in UTC.
+   * \return The time added in local time.
+   */
+  QString getTimeAddedDisplay(const QString& timeAdded) const;
+
+  /**
+   * \brief Removes the given rows from the model.
+   *
+   * \param rowsToRemove The rows to remove, sorted in ascending order.
+   */
+  void removeSongRows(const QList<int>& rowsToRemove);
+
+  /**
+   * \brief Looks up the given songs on the playlist.
+   *
+   * \param ids The library ids of the songs.
+   * \return The record of each song that should be displayed, by library id.
+   */
+  QHash<library_song_id_t, QSqlRecord> fetchSongs(const QList<library_song_id_t>& ids);
+
+  /**
+   * \brief Puts the rows in the same order as the given playlist, inserting new songs
+   * where they belong.
+   *
+   * \param entries The playlist in priority order.
+   * \param newSongs Records for the songs that aren't in the model yet, by library id.
+   */
+  void arrangeRows(
+    const QVector<playlist_entry_t>& entries,
+    const QHash<library_song_id_t, QSqlRecord>& newSongs);
+
+  /**
+   * \brief Gets the query that should be used to obtain the data to display, without a
+   * terminating semicolon so that it may be further restricted.
+   *
+   * @return The query that should be used to obtain the data to display.
+   */
+  static const QString& getDataQuery(){
+    static const QString dataQuery = 
+      "SELECT " +
+      DataStore::getActivePlaylistLibIdColName() + ", " +
+      DataStore::getLibSongColName() + ", " +
+      DataStore::getLibArtistColName() + ", " +
+      DataStore::getLibAlbumColName() + ", " +
+      DataStore::getUpVoteColName() + ", " +
+      DataStore::getDownVoteColName() + ", " +
+      DataStore::getLibDurationColName() + ", " +
+      DataStore::getAdderUsernameColName() + ", " +
+      DataStore::getTimeAddedColName() + 
+      " FROM " + DataStore::getActivePlaylistViewName();
+    return dataQuery;
+  }
+
+  /**
+   * \brief Gets the maximum number of ids that will be put in a single query.
+   *
+   * @return The maximum number of ids that will be put in a single query.
+   */
+  static const int& getMaxIdsPerQuery(){
+    static const int maxIdsPerQuery = 500;
+    return maxIdsPerQuery;
+  }
+
+  /**
+   * \brief Gets the most formatted times added that are kept at once.
+   *
+   * @return The most formatted times added that are kept at once.
+   */
+  static const int& getMaxCachedDisplays(){
+    static const int maxCachedDisplays = 4096;
+    return maxCachedDisplays;
+  }
+
+  //@}
 
 };
 
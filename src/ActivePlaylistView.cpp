@@ -35,7 +35,7 @@ ActivePlaylistView::ActivePlaylistView(DataStore* dataStore, QWidget* parent):
   setContextMenuPolicy(Qt::CustomContextMenu);
   setFocusPolicy(Qt::TabFocus);
   setEditTriggers(QAbstractItemView::NoEditTriggers);
-  model = new ActivePlaylistModel(getDataQuery(), dataStore, this);
+  model = new ActivePlaylistModel(dataStore, this);
   horizontalHeader()->setStretchLastSection(true);
   createActions();
   setModel(model);
@@ -44,9 +44,14 @@ ActivePlaylistView::ActivePlaylistView(DataStore* dataStore, QWidget* parent):
   configureHeaders();
   connect(
     dataStore,
-    SIGNAL(activePlaylistModified()),
+    SIGNAL(activePlaylistChanged(const DataStore::playlist_change_t&)),
     model,
-    SLOT(refresh()));
+    SLOT(applyChange(const DataStore::playlist_change_t&)));
+  connect(
+    dataStore,
+    SIGNAL(pendingPlaylistAddsConfirmed(const QSet<library_song_id_t>&)),
+    model,
+    SLOT(updateSongs(const QSet<library_song_id_t>&)));
   connect(
     this,
     SIGNAL(activated(const QModelIndex&)),
@@ -54,29 +59,12 @@ ActivePlaylistView::ActivePlaylistView(DataStore* dataStore, QWidget* parent):
     SLOT(setCurrentSong(const QModelIndex&)));
   connect(this, SIGNAL(customContextMenuRequested(const QPoint&)),
     this, SLOT(handleContextMenuRequest(const QPoint&)));
-  connect(
-    selectionModel(),
-    SIGNAL(selectionChanged(const QItemSelection&, const QItemSelection&)),
-    this,
-    SLOT(handleSelectionChange(const QItemSelection&, const QItemSelection&)));
 }
 
 void ActivePlaylistView::configureHeaders(){
   QSqlRecord record = model->record();
   int idIndex = record.indexOf(DataStore::getActivePlaylistLibIdColName());
-  int downVoteIndex = record.indexOf(DataStore::getDownVoteColName());
-  int upVoteIndex = record.indexOf(DataStore::getUpVoteColName());
-  int adderNameIndex = record.indexOf(DataStore::getAdderUsernameColName());
-  int timeAddedIndex = record.indexOf(DataStore::getTimeAddedColName());
   setColumnHidden(idIndex, true);
-  model->setHeaderData(
-    downVoteIndex, Qt::Horizontal, tr("Down Votes"), Qt::DisplayRole);
-  model->setHeaderData(
-    upVoteIndex, Qt::Horizontal, tr("Up Votes"), Qt::DisplayRole);
-  model->setHeaderData(
-    adderNameIndex, Qt::Horizontal, tr("Adder"), Qt::DisplayRole);
-  model->setHeaderData(
-    timeAddedIndex, Qt::Horizontal, tr("Time Added"), Qt::DisplayRole);
 }
 
 void ActivePlaylistView::setCurrentSong(const QModelIndex& index){
@@ -116,26 +104,6 @@ void ActivePlaylistView::removeSongs(){
   selectionModel()->clearSelection();
 }
 
-void ActivePlaylistView::handleSelectionChange(
-  const QItemSelection& selected,
-  const QItemSelection& /*deselected*/)
-{
-  if(selected.indexes().size() == 0){
-    connect(
-      dataStore,
-      SIGNAL(activePlaylistModified()),
-      model, 
-      SLOT(refresh()));
-  }
-  else{
-    disconnect(
-      dataStore,
-      SIGNAL(activePlaylistModified()),
-      model, 
-      SLOT(refresh()));
-  }
-}
-
 void ActivePlaylistView::focusOutEvent(QFocusEvent *event){
   if(event->reason() != Qt::PopupFocusReason){
     selectionModel()->clearSelection();
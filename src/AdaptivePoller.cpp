@@ -0,0 +1,114 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "AdaptivePoller.hpp"
+#include <QTimer>
+
+
+namespace UDJ{
+
+
+AdaptivePoller::AdaptivePoller(int minInterval, int maxInterval, QObject *parent):
+  QObject(parent),
+  minInterval(minInterval),
+  maxInterval(qMax(minInterval, maxInterval)),
+  interval(minInterval),
+  isStarted(false),
+  isSuspended(false),
+  isAwaitingResult(false)
+{
+  timer = new QTimer(this);
+  timer->setSingleShot(true);
+  connect(timer, SIGNAL(timeout()), this, SLOT(onTimeout()));
+}
+
+void AdaptivePoller::setMaxInterval(int newMaxInterval){
+  maxInterval = qMax(minInterval, newMaxInterval);
+  if(interval > maxInterval){
+    interval = maxInterval;
+  }
+  if(timer->isActive() && timer->interval() > maxInterval){
+    arm(maxInterval);
+  }
+}
+
+void AdaptivePoller::setSuspended(bool suspended){
+  if(suspended == isSuspended){
+    return;
+  }
+  isSuspended = suspended;
+  if(isSuspended){
+    timer->stop();
+  }
+  else{
+    interval = minInterval;
+    arm(0);
+  }
+}
+
+void AdaptivePoller::start(){
+  isStarted = true;
+  interval = minInterval;
+  arm(0);
+}
+
+void AdaptivePoller::stop(){
+  isStarted = false;
+  timer->stop();
+}
+
+void AdaptivePoller::recordChanged(){
+  isAwaitingResult = false;
+  interval = minInterval;
+  arm(interval);
+}
+
+void AdaptivePoller::recordUnchanged(){
+  isAwaitingResult = false;
+  interval = qMin(interval*getBackoffFactor()/10, maxInterval);
+  arm(interval);
+}
+
+void AdaptivePoller::recordFailed(){
+  recordUnchanged();
+}
+
+void AdaptivePoller::boost(){
+  interval = minInterval;
+  //Leave an outstanding poll alone, its result will arm the timer with the new interval.
+  if(!isAwaitingResult){
+    arm(interval);
+  }
+}
+
+void AdaptivePoller::onTimeout(){
+  isAwaitingResult = true;
+  //Make sure polling continues even if this poll's result never gets recorded.
+  arm(maxInterval);
+  emit poll();
+}
+
+void AdaptivePoller::arm(int delay){
+  if(!isStarted || isSuspended){
+    return;
+  }
+  timer->start(delay);
+}
+
+
+} //end namespace UDJ
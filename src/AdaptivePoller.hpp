@@ -0,0 +1,200 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ADAPTIVE_POLLER_HPP
+#define ADAPTIVE_POLLER_HPP
+#include <QObject>
+
+class QTimer;
+
+namespace UDJ{
+
+
+/**
+ * \brief Decides when a resource on the server should be polled next.
+ *
+ * The interval between polls shrinks back to the minimum whenever a poll finds that the
+ * resource changed and grows geometrically while it doesn't, up to a ceiling the owner
+ * can adjust (e.g. when nobody is looking at the resource). The next poll is only
+ * scheduled once the result of the previous one has been reported, so a slow server
+ * never sees overlapping polls. In case a result is never reported, the poller polls
+ * again once the ceiling has passed anyway.
+ */
+class AdaptivePoller : public QObject{
+Q_OBJECT
+public:
+
+  /** @name Constructors */
+  //@{
+
+  /**
+   * \brief Constructs an AdaptivePoller which isn't polling yet.
+   *
+   * \param minInterval The shortest interval between polls in milliseconds.
+   * \param maxInterval The longest interval between polls in milliseconds.
+   * \param parent The parent object.
+   */
+  AdaptivePoller(int minInterval, int maxInterval, QObject *parent=0);
+
+  //@}
+
+  /** @name Modifiers */
+  //@{
+
+  /**
+   * \brief Sets the longest interval between polls.
+   *
+   * \param maxInterval The longest interval between polls in milliseconds.
+   */
+  void setMaxInterval(int maxInterval);
+
+  /**
+   * \brief Stops or resumes polling without forgetting whether the poller was started.
+   *
+   * Resuming polls right away since the resource has likely changed while suspended.
+   *
+   * \param suspended Whether or not polling should be suspended.
+   */
+  void setSuspended(bool suspended);
+
+  //@}
+
+  /** @name Accessors */
+  //@{
+
+  /**
+   * \brief Gets the interval that will be used before the next poll.
+   *
+   * \return The interval that will be used before the next poll in milliseconds.
+   */
+  inline int getInterval() const{
+    return interval;
+  }
+
+  //@}
+
+public slots:
+
+  /** @name Public Slots */
+  //@{
+
+  /** \brief Starts polling, beginning with a poll right away. */
+  void start();
+
+  /** \brief Stops polling. */
+  void stop();
+
+  /**
+   * \brief Records that the last poll found the resource had changed.
+   */
+  void recordChanged();
+
+  /**
+   * \brief Records that the last poll found the resource hadn't changed.
+   */
+  void recordUnchanged();
+
+  /**
+   * \brief Records that the last poll failed. The poller backs off just as if the
+   * resource hadn't changed.
+   */
+  void recordFailed();
+
+  /**
+   * \brief Drops back to the minimum interval because the resource was just changed
+   * locally and the server is likely to have more changes soon.
+   */
+  void boost();
+
+  //@}
+
+signals:
+
+  /** @name Signals */
+  //@{
+
+  /** \brief Emitted when the resource should be polled. */
+  void poll();
+
+  //@}
+
+private slots:
+
+  /** @name Private Slots */
+  //@{
+
+  /** \brief Polls the resource and arms the fallback timer. */
+  void onTimeout();
+
+  //@}
+
+private:
+
+  /** @name Private Members */
+  //@{
+
+  /** \brief Timer used to trigger the next poll. */
+  QTimer *timer;
+
+  /** \brief Shortest interval between polls. */
+  int minInterval;
+
+  /** \brief Longest interval between polls. */
+  int maxInterval;
+
+  /** \brief Interval that will be used before the next poll. */
+  int interval;
+
+  /** \brief Whether or not start has been called without a matching stop. */
+  bool isStarted;
+
+  /** \brief Whether or not polling is currently suspended. */
+  bool isSuspended;
+
+  /** \brief Whether or not a poll is waiting for its result to be recorded. */
+  bool isAwaitingResult;
+
+  //@}
+
+  /** @name Private Functions */
+  //@{
+
+  /**
+   * \brief Arms the timer for the next poll if the poller should be polling.
+   *
+   * \param delay How long to wait before polling in milliseconds.
+   */
+  void arm(int delay);
+
+  /**
+   * \brief Gets the factor the interval grows by when a poll finds nothing new.
+   *
+   * @return The factor the interval grows by, in tenths.
+   */
+  static const int& getBackoffFactor(){
+    static const int backoffFactor = 15;
+    return backoffFactor;
+  }
+
+  //@}
+
+};
+
+
+} //end namespace UDJ
+#endif //ADAPTIVE_POLLER_HPP
@@ -0,0 +1,89 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "CircuitBreaker.hpp"
+#include "Utils.hpp"
+
+
+namespace UDJ{
+
+
+CircuitBreaker::CircuitBreaker():
+  isTripped(false),
+  probeInFlight(false),
+  consecutiveFailures(0),
+  timesOpened(0),
+  openUntil(0)
+{}
+
+CircuitBreaker::State CircuitBreaker::getState(qint64 now) const{
+  if(!isTripped){
+    return CLOSED;
+  }
+  return now < openUntil ? OPEN : HALF_OPEN;
+}
+
+bool CircuitBreaker::wouldAllowRequest(qint64 now) const{
+  State state = getState(now);
+  return state == CLOSED || (state == HALF_OPEN && !probeInFlight);
+}
+
+bool CircuitBreaker::allowRequest(qint64 now){
+  switch(getState(now)){
+    case CLOSED:
+      return true;
+    case HALF_OPEN:
+      if(!probeInFlight){
+        probeInFlight = true;
+        return true;
+      }
+      return false;
+    case OPEN:
+    default:
+      return false;
+  }
+}
+
+void CircuitBreaker::recordSuccess(){
+  isTripped = false;
+  probeInFlight = false;
+  consecutiveFailures = 0;
+  timesOpened = 0;
+}
+
+void CircuitBreaker::cancelProbe(){
+  probeInFlight = false;
+}
+
+void CircuitBreaker::recordFailure(qint64 now){
+  probeInFlight = false;
+  ++consecutiveFailures;
+  if(!isTripped && consecutiveFailures < getFailureThreshold()){
+    return;
+  }
+  isTripped = true;
+  qint64 openTime = getBaseOpenTime() << qMin(timesOpened, 10);
+  openTime = qMin(openTime, getMaxOpenTime());
+  //Spread the open time by +/-25% so players don't all probe the server at once.
+  openTime = openTime*3/4 + Utils::getRandomUpTo(openTime/2);
+  openUntil = now + openTime;
+  ++timesOpened;
+}
+
+
+} //end namespace UDJ
@@ -0,0 +1,184 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CIRCUIT_BREAKER_HPP
+#define CIRCUIT_BREAKER_HPP
+#include <QtGlobal>
+
+namespace UDJ{
+
+
+/**
+ * \brief Tracks the health of a single server endpoint.
+ *
+ * After enough consecutive transient failures the breaker opens and no requests should
+ * be sent to the endpoint. Once the open period is over the breaker lets a single probe
+ * request through. If the probe succeeds the breaker closes, otherwise it opens again for
+ * longer. Open periods are jittered so that every player doesn't come back at once after
+ * a server outage.
+ *
+ * All times are in milliseconds on a monotonic clock supplied by the caller.
+ */
+class CircuitBreaker{
+public:
+
+  /** @name Public Types */
+  //@{
+
+  /** \brief The states a breaker can be in. */
+  enum State{
+    CLOSED,
+    OPEN,
+    HALF_OPEN
+  };
+
+  //@}
+
+  /** @name Constructors */
+  //@{
+
+  /** \brief Constructs a closed CircuitBreaker. */
+  CircuitBreaker();
+
+  //@}
+
+  /** @name Modifiers */
+  //@{
+
+  /**
+   * \brief Determines whether or not a request may be sent right now. If the breaker
+   * is half open this claims the single probe request.
+   *
+   * \param now The current time.
+   * \return True if a request may be sent, false otherwise.
+   */
+  bool allowRequest(qint64 now);
+
+  /**
+   * \brief Records that the endpoint answered a request.
+   */
+  void recordSuccess();
+
+  /**
+   * \brief Records that a request to the endpoint failed transiently.
+   *
+   * \param now The current time.
+   */
+  void recordFailure(qint64 now);
+
+  /**
+   * \brief Records that the probe request was abandoned before the endpoint answered,
+   * so that another one may be sent.
+   */
+  void cancelProbe();
+
+  //@}
+
+  /** @name Accessors */
+  //@{
+
+  /**
+   * \brief Gets the state of the breaker at the given time.
+   *
+   * \param now The current time.
+   * \return The state of the breaker.
+   */
+  State getState(qint64 now) const;
+
+  /**
+   * \brief Determines whether or not allowRequest would let a request through, without
+   * claiming the probe.
+   *
+   * \param now The current time.
+   * \return True if a request would be let through, false otherwise.
+   */
+  bool wouldAllowRequest(qint64 now) const;
+
+  /**
+   * \brief Gets the time at which an open breaker will let a probe through.
+   *
+   * \return The time at which an open breaker will let a probe through.
+   */
+  inline qint64 getOpenUntil() const{
+    return openUntil;
+  }
+
+  //@}
+
+private:
+
+  /** @name Private Members */
+  //@{
+
+  /** \brief Whether or not the breaker has been tripped. */
+  bool isTripped;
+
+  /** \brief Whether or not a probe request is currently outstanding. */
+  bool probeInFlight;
+
+  /** \brief Number of transient failures in a row. */
+  int consecutiveFailures;
+
+  /** \brief Number of times in a row the breaker has been opened. */
+  int timesOpened;
+
+  /** \brief Time until which the breaker is open. */
+  qint64 openUntil;
+
+  //@}
+
+  /** @name Private Functions */
+  //@{
+
+  /**
+   * \brief Gets the number of consecutive failures that will open the breaker.
+   *
+   * @return The number of consecutive failures that will open the breaker.
+   */
+  static const int& getFailureThreshold(){
+    static const int failureThreshold = 5;
+    return failureThreshold;
+  }
+
+  /**
+   * \brief Gets how long the breaker stays open the first time it opens.
+   *
+   * @return How long the breaker stays open the first time it opens.
+   */
+  static const qint64& getBaseOpenTime(){
+    static const qint64 baseOpenTime = 5000;
+    return baseOpenTime;
+  }
+
+  /**
+   * \brief Gets the longest time the breaker will stay open.
+   *
+   * @return The longest time the breaker will stay open.
+   */
+  static const qint64& getMaxOpenTime(){
+    static const qint64 maxOpenTime = 120000;
+    return maxOpenTime;
+  }
+
+  //@}
+
+};
+
+
+} //end namespace UDJ
+#endif //CIRCUIT_BREAKER_HPP
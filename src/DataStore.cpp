@@ -18,20 +18,23 @@
  */
 #include "DataStore.hpp"
 #include "UDJServerConnection.hpp"
+#include "RequestCoalescer.hpp"
+#include "AdaptivePoller.hpp"
+#include "TrafficReplayer.hpp"
+#include "NetworkMetrics.hpp"
 #include "Utils.hpp"
 #include "Logger.hpp"
 
 #include <QDir>
 #include <QDesktopServices>
-#include <QDir>
 #include <QSqlQuery>
 #include <QVariant>
 #include <QSqlRecord>
 #include <QThread>
-#include <QTimer>
 #include <QDateTime>
 #include <QProgressDialog>
 #include <QSqlError>
+#include <QHash>
 
 #include <tag.h>
 #include <tstring.h>
@@ -50,23 +53,35 @@ DataStore::DataStore(
   :QObject(parent),
   username(username),
   password(password),
-  isReauthing(false),
   changingPlayerState(false),
   clearingCurrentSong(false),
-  currentSongId(-1)
+  isParticipantsShown(false),
+  isPlayerMinimized(false),
+  isPushConnected(false),
+  currentSongId(-1),
+  isOffline(false),
+  reconcileJournalEnd(-1),
+  reconcileCurrentSong(-1)
 {
   serverConnection = new UDJServerConnection(this);
   serverConnection->setTicket(ticket);
   serverConnection->setUserId(userId);
   QSettings settings(QSettings::UserScope, getSettingsOrg(), getSettingsApp());
+  if(settings.contains(getTicketLifetimeSettingName())){
+    serverConnection->setTicketLifetimeEstimate(
+      settings.value(getTicketLifetimeSettingName()).toLongLong());
+  }
+  serverConnection->setCredentials(username, password);
   if(settings.contains(getPlayerIdSettingName())){
     serverConnection->setPlayerId(settings.value(getPlayerIdSettingName()).value<player_id_t>());
   }
-  activePlaylistRefreshTimer = new QTimer(this);
-  activePlaylistRefreshTimer->setInterval(5000);
-  participantRefreshTimer = new QTimer(this);
-  participantRefreshTimer->setInterval(5000);
+  activePlaylistPoller = new AdaptivePoller(
+    getMinPlaylistPollInterval(), getMaxPlaylistPollInterval(), this);
+  participantPoller = new AdaptivePoller(
+    getMinParticipantPollInterval(), getMaxParticipantPollInterval(), this);
+  updatePollingPolicy();
   setupDB();
+  setupCoalescer();
 
   connect(serverConnection,
       SIGNAL(playerStateSet(const QString&)),
@@ -117,9 +132,9 @@ DataStore::DataStore(
 
   connect(
     serverConnection,
-    SIGNAL(newActivePlaylist(const QVariantMap&)),
+    SIGNAL(newActivePlaylist(const playlist_snapshot_t&)),
     this,
-    SLOT(setActivePlaylist(const QVariantMap&)));
+    SLOT(setActivePlaylist(const playlist_snapshot_t&)));
 
   connect(
     serverConnection,
@@ -127,23 +142,72 @@ DataStore::DataStore(
     this,
     SLOT(onGetActivePlaylistFail(const QString&, int, const QList<QNetworkReply::RawHeaderPair>&)));
 
-  connect(activePlaylistRefreshTimer,
-    SIGNAL(timeout()),
+  connect(
+    serverConnection,
+    SIGNAL(newActivePlaylist(const playlist_snapshot_t&)),
+    activePlaylistPoller,
+    SLOT(recordChanged()));
+
+  connect(
+    serverConnection,
+    SIGNAL(activePlaylistUnchanged()),
+    activePlaylistPoller,
+    SLOT(recordUnchanged()));
+
+  connect(
+    serverConnection,
+    SIGNAL(getActivePlaylistFail(const QString&, int, const QList<QNetworkReply::RawHeaderPair>&)),
+    activePlaylistPoller,
+    SLOT(recordFailed()));
+
+  connect(
+    activePlaylistPoller,
+    SIGNAL(poll()),
     this,
     SLOT(refreshActivePlaylist()));
 
+  connect(
+    serverConnection,
+    SIGNAL(playerEventsConnectionChanged(bool)),
+    this,
+    SLOT(onPlayerEventsConnectionChanged(bool)));
+
+  connect(
+    serverConnection,
+    SIGNAL(playerEventsGap()),
+    this,
+    SLOT(onPlayerEventsGap()));
+
+  connect(
+    serverConnection,
+    SIGNAL(playerEventsError(const QString&, int, const QList<QNetworkReply::RawHeaderPair>&)),
+    this,
+    SLOT(onPlayerEventsError(const QString&, int, const QList<QNetworkReply::RawHeaderPair>&)));
+
   connect(
     serverConnection,
     SIGNAL(currentSongSet()),
     this,
-    SLOT(refreshActivePlaylist()));
+    SLOT(onCurrentSongSet()));
+
+  connect(
+    serverConnection,
+    SIGNAL(serverReachabilityChanged(bool)),
+    this,
+    SLOT(onServerReachabilityChanged(bool)));
 
   connect(
-    participantRefreshTimer,
-    SIGNAL(timeout()),
+    participantPoller,
+    SIGNAL(poll()),
     this,
     SLOT(refreshParticipantList()));
 
+  connect(
+    serverConnection,
+    SIGNAL(getParticipantsError(const QString&, int, const QList<QNetworkReply::RawHeaderPair>&)),
+    participantPoller,
+    SLOT(recordFailed()));
+
   connect(
     serverConnection,
     SIGNAL(libModError(const QString&, int, const QList<QNetworkReply::RawHeaderPair>&)),
@@ -168,6 +232,12 @@ DataStore::DataStore(
     this,
     SLOT(onActivePlaylistModFailed(const QString&, int, const QList<QNetworkReply::RawHeaderPair>&)));
 
+  connect(
+    serverConnection,
+    SIGNAL(activePlaylistModRejected(const QSet<library_song_id_t>&, const QSet<library_song_id_t>&, const QString&)),
+    this,
+    SLOT(onActivePlaylistModRejected(const QSet<library_song_id_t>&, const QSet<library_song_id_t>&, const QString&)));
+
   connect(
     serverConnection,
     SIGNAL(setVolumeFailed(const QString&, int, const QList<QNetworkReply::RawHeaderPair>&)),
@@ -177,9 +247,9 @@ DataStore::DataStore(
 
   connect(
     serverConnection,
-    SIGNAL(authenticated(const QByteArray&, const user_id_t&)),
+    SIGNAL(ticketLifetimeObserved(qint64)),
     this,
-    SLOT(onReauth(const QByteArray&, const user_id_t&)));
+    SLOT(onTicketLifetimeObserved(qint64)));
 
   connect(
     serverConnection,
@@ -206,6 +276,30 @@ DataStore::DataStore(
     this,
     SLOT(onNewParticipantList(const QVariantList&)));
 
+  connect(
+    serverConnection,
+    SIGNAL(libraryFingerprintReceived(const QVariantMap&)),
+    this,
+    SLOT(onLibraryFingerprintReceived(const QVariantMap&)));
+
+  connect(
+    serverConnection,
+    SIGNAL(getLibraryFingerprintFailed(const QString&, int, const QList<QNetworkReply::RawHeaderPair>&)),
+    this,
+    SLOT(onGetLibraryFingerprintFail(const QString&, int, const QList<QNetworkReply::RawHeaderPair>&)));
+
+  connect(
+    serverConnection,
+    SIGNAL(libraryBucketSongsReceived(const QVariantList&)),
+    this,
+    SLOT(onLibraryBucketSongsReceived(const QVariantList&)));
+
+  connect(
+    serverConnection,
+    SIGNAL(getLibraryBucketSongsFailed(const QString&, int, const QList<QNetworkReply::RawHeaderPair>&)),
+    this,
+    SLOT(onGetLibraryFingerprintFail(const QString&, int, const QList<QNetworkReply::RawHeaderPair>&)));
+
 }
 
 void DataStore::setupDB(){
@@ -229,6 +323,12 @@ void DataStore::setupDB(){
 
   QSqlQuery setupQuery(database);
 
+  //Has to happen before the library searcher opens its connection.
+  EXEC_SQL(
+    "Error turning on write ahead logging.",
+    setupQuery.exec(getEnableWriteAheadLogQuery()),
+    setupQuery)
+
   EXEC_SQL(
     "Error creating library table",
     setupQuery.exec(getCreateLibraryQuery()),
@@ -244,21 +344,471 @@ void DataStore::setupDB(){
     setupQuery.exec(getCreateActivePlaylistViewQuery()),
     setupQuery)
 
+  EXEC_SQL(
+    "Error creating library fingerprint table.",
+    setupQuery.exec(getCreateLibFingerprintQuery()),
+    setupQuery)
+
+  EXEC_SQL(
+    "Error creating library fingerprint index.",
+    setupQuery.exec(getCreateLibFingerprintIndexQuery()),
+    setupQuery)
+
+  Q_FOREACH(const QString& createLibSortIndexQuery, getCreateLibSortIndexQueries()){
+    EXEC_SQL(
+      "Error creating library sort index.",
+      setupQuery.exec(createLibSortIndexQuery),
+      setupQuery)
+  }
+
+  EXEC_SQL(
+    "Error creating offline journal table.",
+    setupQuery.exec(getCreateOfflineJournalQuery()),
+    setupQuery)
+
+  loadLibraryFingerprint();
+}
+
+void DataStore::loadLibraryFingerprint(){
+  QSqlQuery countQuery(database);
+  EXEC_SQL(
+    "Error counting library fingerprint entries",
+    countQuery.exec("SELECT COUNT(*) FROM " + getLibFingerprintTableName() + ";"),
+    countQuery)
+  if(countQuery.next() && countQuery.value(0).toInt() == 0){
+    //The fingerprint has never been built (i.e. this library was synced by an older
+    //version of UDJ). Seed it with every song the server should already have.
+    Logger::instance()->log("Building library fingerprint for the first time");
+    bool isTransacting = database.transaction();
+    QSqlQuery syncedSongs(database);
+    EXEC_SQL(
+      "Error querying for synced songs",
+      syncedSongs.exec(
+        "SELECT * FROM " + getLibraryTableName() + " WHERE " +
+        getLibIsDeletedColName() + "=0 AND " +
+        getLibSyncStatusColName() + "=" + QString::number(getLibIsSyncedStatus()) + ";"),
+      syncedSongs)
+    QSqlQuery insertQuery(database);
+    insertQuery.prepare(
+      "INSERT OR REPLACE INTO " + getLibFingerprintTableName() + "(" +
+      getLibFingerprintIdColName() + "," +
+      getLibFingerprintBucketColName() + "," +
+      getLibFingerprintHashColName() + ") VALUES (?, ?, ?);");
+    while(syncedSongs.next()){
+      library_song_id_t id =
+        syncedSongs.record().value(getLibIdColName()).value<library_song_id_t>();
+      quint32 songHash =
+        LibraryFingerprint::computeSongHash(getSongSyncMap(syncedSongs.record()));
+      insertQuery.bindValue(0, QVariant::fromValue<library_song_id_t>(id));
+      insertQuery.bindValue(1, LibraryFingerprint::getBucket(id));
+      insertQuery.bindValue(2, (qlonglong)songHash);
+      EXEC_SQL(
+        "Error inserting library fingerprint entry",
+        insertQuery.exec(),
+        insertQuery)
+    }
+    if(isTransacting){
+      database.commit();
+    }
+  }
+
+  QSqlQuery bucketQuery(database);
+  EXEC_SQL(
+    "Error loading library fingerprint",
+    bucketQuery.exec(
+      "SELECT " + getLibFingerprintBucketColName() + ", SUM(" +
+      getLibFingerprintHashColName() + "), COUNT(*) FROM " +
+      getLibFingerprintTableName() + " GROUP BY " + getLibFingerprintBucketColName() + ";"),
+    bucketQuery)
+  while(bucketQuery.next()){
+    libraryFingerprint.setBucket(
+      bucketQuery.value(0).toInt(),
+      bucketQuery.value(1).toULongLong(),
+      bucketQuery.value(2).toInt());
+  }
+}
+
+void DataStore::setupCoalescer(){
+  QSettings settings(QSettings::UserScope, getSettingsOrg(), getSettingsApp());
+  coalescer = new RequestCoalescer(this);
+  coalescer->setWindow(VOLUME_REQUEST,
+    settings.value(getCoalesceWindowSettingName("volume"), 300).toInt());
+  coalescer->setWindow(PLAYER_STATE_REQUEST,
+    settings.value(getCoalesceWindowSettingName("state"), 150).toInt());
+  coalescer->setWindow(CURRENT_SONG_REQUEST,
+    settings.value(getCoalesceWindowSettingName("currentSong"), 250).toInt());
+  coalescer->setWindow(PLAYLIST_MOD_REQUEST,
+    settings.value(getCoalesceWindowSettingName("playlistMod"), 200).toInt());
+
+  connect(
+    coalescer,
+    SIGNAL(valueReady(int, const QVariant&)),
+    this,
+    SLOT(onCoalescedValueReady(int, const QVariant&)));
+
+  connect(
+    coalescer,
+    SIGNAL(setOperationReady(int, const QSet<library_song_id_t>&, const QSet<library_song_id_t>&)),
+    this,
+    SLOT(onCoalescedPlaylistModReady(int, const QSet<library_song_id_t>&, const QSet<library_song_id_t>&)));
+}
+
+void DataStore::onCoalescedValueReady(int request, const QVariant& value){
+  switch(request){
+    case VOLUME_REQUEST:
+      serverConnection->setVolume(value.toInt());
+      break;
+    case PLAYER_STATE_REQUEST:
+      serverConnection->setPlayerState(value.toString());
+      break;
+    case CURRENT_SONG_REQUEST:
+      if(isOffline){
+        journalChange(JOURNAL_CURRENT_SONG, value.value<library_song_id_t>());
+      }
+      else{
+        serverConnection->setCurrentSong(value.value<library_song_id_t>());
+      }
+      break;
+  }
+  activePlaylistPoller->boost();
+}
+
+void DataStore::onCoalescedPlaylistModReady(
+  int /*request*/,
+  const QSet<library_song_id_t>& toAdd,
+  const QSet<library_song_id_t>& toRemove)
+{
+  if(isOffline){
+    journalPlaylistMod(toAdd, toRemove);
+    playlistIdsToAdd.subtract(toAdd);
+    playlistIdsToRemove.subtract(toRemove);
+    return;
+  }
+  serverConnection->modActivePlaylist(toAdd, toRemove);
+  activePlaylistPoller->boost();
+}
+
+bool DataStore::replayTraffic(const QString& fileName, double speed){
+  TrafficReplayer *replayer = new TrafficReplayer(serverConnection, this);
+  if(!replayer->load(fileName)){
+    delete replayer;
+    return false;
+  }
+  activePlaylistPoller->stop();
+  participantPoller->stop();
+  serverConnection->stopPlayerEvents();
+  serverConnection->setReplaying(true);
+  NetworkMetrics::instance()->reset();
+  connect(
+    replayer,
+    SIGNAL(finished(int, qint64)),
+    this,
+    SLOT(onTrafficReplayFinished(int, qint64)));
+  replayer->start(speed);
+  return true;
+}
+
+void DataStore::onTrafficReplayFinished(int numReplayed, qint64 elapsed){
+  Logger::instance()->log("Replayed " + QString::number(numReplayed) + " replies in " +
+    QString::number(elapsed) + "ms");
+  Logger::instance()->log(QString::fromUtf8(NetworkMetrics::instance()->toJSON()));
+  sender()->deleteLater();
+}
+
+void DataStore::onServerReachabilityChanged(bool reachable){
+  if(reachable != isOffline){
+    return;
+  }
+  isOffline = !reachable;
+  Logger::instance()->log(isOffline ?
+    "Server unreachable, going offline" :
+    "Server reachable again, going back online");
+  emit offlineModeChanged(isOffline);
+  if(!isOffline){
+    replayOfflineJournal();
+  }
+}
+
+void DataStore::journalChange(JournalAction action, library_song_id_t libId){
+  QSqlQuery journalQuery(
+    "INSERT INTO " + getOfflineJournalTableName() + "(" +
+    getOfflineJournalActionColName() + ", " +
+    getOfflineJournalLibIdColName() + ") VALUES ( :action , :libid );",
+    database);
+  journalQuery.bindValue(":action", (int)action);
+  journalQuery.bindValue(":libid", QVariant::fromValue(libId));
+  EXEC_SQL(
+    "Error journaling offline change",
+    journalQuery.exec(),
+    journalQuery)
+}
+
+void DataStore::journalPlaylistMod(
+  const QSet<library_song_id_t>& toAdd,
+  const QSet<library_song_id_t>& toRemove)
+{
+  bool isTransacting = database.transaction();
+  Q_FOREACH(library_song_id_t libId, toAdd){
+    journalChange(JOURNAL_PLAYLIST_ADD, libId);
+  }
+  Q_FOREACH(library_song_id_t libId, toRemove){
+    journalChange(JOURNAL_PLAYLIST_REMOVE, libId);
+  }
+  if(isTransacting){
+    database.commit();
+  }
+  //Usually already applied when the modification was made, in which case this changes
+  //nothing.
+  applyLocalPlaylistMod(toAdd, toRemove);
+}
+
+void DataStore::applyLocalPlaylistMod(
+  const QSet<library_song_id_t>& toAdd,
+  const QSet<library_song_id_t>& toRemove)
+{
+  bool isTransacting = database.transaction();
+  QSqlQuery addQuery(
+    "INSERT INTO " + getActivePlaylistTableName() + "(" +
+    getActivePlaylistLibIdColName() + "," +
+    getDownVoteColName() + "," +
+    getUpVoteColName() + "," +
+    getPriorityColName() + "," +
+    getAdderUsernameColName() + "," +
+    getAdderIdColName() + ") " +
+    "SELECT :libid, 0, 0, (SELECT IFNULL(MAX(" + getPriorityColName() + "), -1) + 1 FROM " +
+    getActivePlaylistTableName() + "), :username, :adder " +
+    "WHERE NOT EXISTS (SELECT 1 FROM " + getActivePlaylistTableName() + " WHERE " +
+    getActivePlaylistLibIdColName() + " = :existing);",
+    database);
+  playlist_change_t change;
+  Q_FOREACH(library_song_id_t libId, toAdd){
+    addQuery.bindValue(":libid", QVariant::fromValue(libId));
+    addQuery.bindValue(":username", username);
+    addQuery.bindValue(":adder", serverConnection->getUserId());
+    addQuery.bindValue(":existing", QVariant::fromValue(libId));
+    EXEC_SQL(
+      "Error adding song to local playlist",
+      addQuery.exec(),
+      addQuery)
+    if(addQuery.numRowsAffected() > 0){
+      change.inserted.append(libId);
+    }
+  }
+  Q_FOREACH(library_song_id_t libId, toRemove){
+    if(deleteSongFromPlaylist(libId)){
+      change.removed.append(libId);
+    }
+  }
+  if(isTransacting){
+    database.commit();
+  }
+  if(change.inserted.isEmpty() && change.removed.isEmpty()){
+    return;
+  }
+  if(!change.inserted.isEmpty()){
+    serverConnection->forgetActivePlaylistVersion();
+    change.entries = readActivePlaylistEntries();
+  }
+  emit activePlaylistChanged(change);
+  emit activePlaylistModified();
+}
+
+QVector<playlist_entry_t> DataStore::withPendingPlaylistMods(
+  const QVector<playlist_entry_t>& entries) const
+{
+  if(playlistIdsToAdd.isEmpty() && playlistIdsToRemove.isEmpty()){
+    return entries;
+  }
+  QVector<playlist_entry_t> overlaid;
+  overlaid.reserve(entries.size() + playlistIdsToAdd.size());
+  QSet<library_song_id_t> onServer;
+  Q_FOREACH(const playlist_entry_t& entry, entries){
+    onServer.insert(entry.libId);
+    if(!playlistIdsToRemove.contains(entry.libId)){
+      overlaid.append(entry);
+    }
+  }
+  QString now = QDateTime::currentDateTime().toUTC().toString(Qt::ISODate);
+  Q_FOREACH(library_song_id_t libId, playlistIdsToAdd){
+    if(!onServer.contains(libId)){
+      playlist_entry_t pending = {
+        libId, 0, 0, now, username, serverConnection->getUserId() };
+      overlaid.append(pending);
+    }
+  }
+  return overlaid;
+}
+
+void DataStore::replayOfflineJournal(){
+  //Only one reconciliation at a time, anything journaled meanwhile goes in the next one.
+  if(reconcileJournalEnd != -1){
+    return;
+  }
+  QSqlQuery journalQuery(
+    "SELECT " + getOfflineJournalIdColName() + ", " +
+    getOfflineJournalActionColName() + ", " +
+    getOfflineJournalLibIdColName() + " FROM " +
+    getOfflineJournalTableName() + " ORDER BY " + getOfflineJournalIdColName() + ";",
+    database);
+  EXEC_SQL(
+    "Error reading offline journal",
+    journalQuery.exec(),
+    journalQuery)
+
+  qlonglong lastId = -1;
+  int numEntries = 0;
+  library_song_id_t current = -1;
+  QSet<library_song_id_t> toAdd;
+  QSet<library_song_id_t> toRemove;
+  while(journalQuery.next()){
+    lastId = journalQuery.value(0).toLongLong();
+    ++numEntries;
+    library_song_id_t libId = journalQuery.value(2).value<library_song_id_t>();
+    switch(journalQuery.value(1).toInt()){
+      case JOURNAL_PLAYLIST_ADD:
+        toRemove.remove(libId);
+        toAdd.insert(libId);
+        break;
+      case JOURNAL_PLAYLIST_REMOVE:
+        toAdd.remove(libId);
+        toRemove.insert(libId);
+        break;
+      case JOURNAL_CURRENT_SONG:
+        //Only the latest current song matters, the ones before it have been played and
+        //just need to come off the playlist.
+        if(current != -1 && current != libId && !toAdd.remove(current)){
+          toRemove.insert(current);
+        }
+        toRemove.remove(libId);
+        current = libId;
+        break;
+    }
+  }
+  if(lastId == -1){
+    return;
+  }
+
+  Logger::instance()->log("Reconciling " + QString::number(numEntries) +
+    " offline changes as " + QString::number(toAdd.size()) + " additions and " +
+    QString::number(toRemove.size()) + " removals");
+  reconcileJournalEnd = lastId;
+  reconcileToAdd = toAdd;
+  reconcileToRemove = toRemove;
+  reconcileCurrentSong = current;
+  if(toAdd.isEmpty() && toRemove.isEmpty()){
+    finishReconcile();
+  }
+  else{
+    serverConnection->modActivePlaylist(toAdd, toRemove);
+  }
+}
+
+void DataStore::finishReconcile(){
+  QSqlQuery deleteQuery(
+    "DELETE FROM " + getOfflineJournalTableName() + " WHERE " +
+    getOfflineJournalIdColName() + " <= " + QString::number(reconcileJournalEnd) + ";",
+    database);
+  EXEC_SQL(
+    "Error clearing offline journal",
+    deleteQuery.exec(),
+    deleteQuery)
+  reconcileJournalEnd = -1;
+  reconcileToAdd.clear();
+  reconcileToRemove.clear();
+  //The current song is sent once the server's playlist has caught up, unless we've
+  //already moved on to another one, which will have been sent on its own.
+  if(reconcileCurrentSong != -1 && reconcileCurrentSong == currentSongId){
+    coalescer->submitValue(CURRENT_SONG_REQUEST, QVariant::fromValue(reconcileCurrentSong));
+  }
+  else{
+    reconcileCurrentSong = -1;
+  }
+}
+
+bool DataStore::pickFallbackSong(QSqlQuery& query){
+  query.prepare(
+    "SELECT " + getLibFileColName() + ", " +
+    getLibSongColName() + ", " +
+    getLibArtistColName() + ", " +
+    getLibDurationColName() + ", " +
+    getLibIdColName() + " FROM " +
+    getLibraryTableName() + " WHERE " +
+    getLibIsDeletedColName() + "=0 AND " +
+    getLibIdColName() + " != :current " +
+    "ORDER BY RANDOM() LIMIT 1;");
+  query.bindValue(":current", QVariant::fromValue(currentSongId));
+  EXEC_SQL(
+    "Picking fallback song failed",
+    query.exec(),
+    query)
+  return query.next();
 }
 
 void DataStore::startPlaylistAutoRefresh(){
   Logger::instance()->log("Starting playlist auto refresh");
-  activePlaylistRefreshTimer->start();
+  activePlaylistPoller->start();
+  serverConnection->startPlayerEvents();
+  //Anything left over from running offline last time.
+  replayOfflineJournal();
 }
 
 void DataStore::startParticipantsAutoRefresh(){
   Logger::instance()->log("Starting particpants auto refresh");
-  participantRefreshTimer->start();
+  participantPoller->start();
+}
+
+void DataStore::setParticipantsShown(bool shown){
+  isParticipantsShown = shown;
+  updatePollingPolicy();
+  //Pushed changes only tell us what changed since we started listening.
+  if(shown && isPushConnected && lastParticipants.isEmpty()){
+    refreshParticipantList();
+  }
+}
+
+void DataStore::setPlayerMinimized(bool minimized){
+  isPlayerMinimized = minimized;
+  updatePollingPolicy();
+}
+
+void DataStore::updatePollingPolicy(){
+  bool isPlaying = getPlayerState() == getPlayingState();
+  int playlistCeiling = getMaxPlaylistPollInterval();
+  if(!isPlaying && isPlayerMinimized){
+    playlistCeiling = getDormantPlaylistPollInterval();
+  }
+  else if(!isPlaying || isPlayerMinimized){
+    playlistCeiling = getIdlePlaylistPollInterval();
+  }
+  activePlaylistPoller->setMaxInterval(playlistCeiling);
+  //Polling is only a fallback for when the server isn't pushing changes.
+  activePlaylistPoller->setSuspended(isPushConnected);
+  participantPoller->setSuspended(
+    isPushConnected || !isParticipantsShown || isPlayerMinimized);
+}
+
+void DataStore::onPlayerEventsConnectionChanged(bool connected){
+  isPushConnected = connected;
+  updatePollingPolicy();
+}
+
+void DataStore::onPlayerEventsGap(){
+  refreshActivePlaylist();
+  refreshParticipantList();
+}
+
+void DataStore::onPlayerEventsError(
+  const QString& errMessage,
+  int errorCode,
+  const QList<QNetworkReply::RawHeaderPair>& /*headers*/)
+{
+  Logger::instance()->log("Player events error: " + QString::number(errorCode) + " " + errMessage);
 }
 
 void DataStore::clearCurrentSong(){
   currentSongId = -1;
   clearingCurrentSong = true;
+  coalescer->cancel(CURRENT_SONG_REQUEST);
   serverConnection->clearCurrentSong();
 }
 
@@ -268,19 +818,11 @@ void DataStore::onCurrentSongCleared(){
 
 void DataStore::onCurrentSongClearError(
   const QString& errMessage,
-  int errorCode,
-  const QList<QNetworkReply::RawHeaderPair>& headers)
+  int /*errorCode*/,
+  const QList<QNetworkReply::RawHeaderPair>& /*headers*/)
 {
-  if(isTicketAuthError(errorCode, headers)){
-    Logger::instance()->log("Got the ticket-hash challenge");
-    reauthActions.insert(CLEAR_CURRENT_SONG);
-    initReauth();
-  }
-  else{
-    clearingCurrentSong = false;
-    emit clearCurrentSongError(errMessage);
-  }
-
+  clearingCurrentSong = false;
+  emit clearCurrentSongError(errMessage);
 }
 
 
@@ -294,30 +836,18 @@ void DataStore::onPlayerStateSet(const QString& state){
 void DataStore::onPlayerStateSetError(
     const QString& state,
     const QString& errMessage,
-    int errorCode,
-    const QList<QNetworkReply::RawHeaderPair>& headers)
+    int /*errorCode*/,
+    const QList<QNetworkReply::RawHeaderPair>& /*headers*/)
 {
-  if(isTicketAuthError(errorCode, headers)){
-    Logger::instance()->log("Got the ticket-hash challenge");
-    if(state != getInactiveState()){
-      reauthActions.insert(SET_PLAYER_STATE);
-    }
-    else{
-      reauthActions.insert(SET_PLAYER_INACTIVE);
-    }
-    initReauth();
+  changingPlayerState = false;
+  if(state == getPlayingState()){
+    emit playPlayerError(errMessage);
   }
-  else{
-    changingPlayerState = false;
-    if(state == getPlayingState()){
-      emit playPlayerError(errMessage);
-    }
-    else if(state == getPausedState()){
-      emit pausePlayerError(errMessage);
-    }
-    else if(state == getInactiveState()){
-      emit playerSetInactiveError(errMessage);
-    }
+  else if(state == getPausedState()){
+    emit pausePlayerError(errMessage);
+  }
+  else if(state == getInactiveState()){
+    emit playerSetInactiveError(errMessage);
   }
 }
 
@@ -331,17 +861,10 @@ void DataStore::removePlayerPassword(){
 
 void DataStore::onPlayerPasswordRemoveError(
   const QString& errMessage,
-  int errorCode,
-  const QList<QNetworkReply::RawHeaderPair>& headers)
+  int /*errorCode*/,
+  const QList<QNetworkReply::RawHeaderPair>& /*headers*/)
 {
-  if(isTicketAuthError(errorCode, headers)){
-    Logger::instance()->log("Got the ticket-hash challenge");
-    reauthActions.insert(REMOVE_PLAYER_PASSWORD);
-    initReauth();
-  }
-  else{
-    emit playerPasswordRemoveError(errMessage);
-  }
+  emit playerPasswordRemoveError(errMessage);
 }
 
 
@@ -353,20 +876,12 @@ void DataStore::setPlayerPassword(const QString& newPassword){
 }
 
 void DataStore::onPlayerPasswordSetError(
-  const QString& attemptedPassword,
+  const QString& /*attemptedPassword*/,
   const QString& errMessage,
-  int errorCode,
-  const QList<QNetworkReply::RawHeaderPair>& headers)
+  int /*errorCode*/,
+  const QList<QNetworkReply::RawHeaderPair>& /*headers*/)
 {
-  if(isTicketAuthError(errorCode, headers)){
-    Logger::instance()->log("Got the ticket-hash challenge");
-    reauthActions.insert(SET_PLAYER_PASSWORD);
-    reauthPlayerPassword = attemptedPassword;
-    initReauth();
-  }
-  else{
-    emit playerPasswordSetError(errMessage);
-  }
+  emit playerPasswordSetError(errMessage);
 }
 
 void DataStore::setPlayerLocation(
@@ -388,18 +903,11 @@ void DataStore::setPlayerLocation(
 
 void DataStore::onPlayerLocationSetError(
   const QString& errMessage,
-  int errorCode,
-  const QList<QNetworkReply::RawHeaderPair>& headers)
+  int /*errorCode*/,
+  const QList<QNetworkReply::RawHeaderPair>& /*headers*/)
 {
-  if(isTicketAuthError(errorCode, headers)){
-    Logger::instance()->log("Got the ticket-hash challenge");
-    reauthActions.insert(SET_PLAYER_LOCATION);
-    initReauth();
-  }
-  else{
-    //TODO handle location not found error
-    emit playerLocationSetError(errMessage);
-  }
+  //TODO handle location not found error
+  emit playerLocationSetError(errMessage);
 }
 
 void DataStore::pausePlayer(){
@@ -414,10 +922,15 @@ void DataStore::setPlayerState(const QString& newState){
   QSettings settings(QSettings::UserScope, getSettingsOrg(), getSettingsApp());
   settings.setValue(getPlayerStateSettingName(), newState);
   changingPlayerState = true;
-  serverConnection->setPlayerState(newState);
+  coalescer->submitValue(PLAYER_STATE_REQUEST, newState);
+  updatePollingPolicy();
 }
 
 void DataStore::setPlayerInactive(){
+  //Make sure anything the user did right before quitting still makes it to the server.
+  coalescer->cancel(PLAYER_STATE_REQUEST);
+  coalescer->flushAll();
+  serverConnection->stopPlayerEvents();
   serverConnection->setPlayerState(getInactiveState());
 }
 
@@ -577,14 +1090,16 @@ void DataStore::addSongToActivePlaylist(library_song_id_t libraryId){
 
 void DataStore::addSongsToActivePlaylist(const QSet<library_song_id_t>& libIds){
   playlistIdsToAdd.unite(libIds);
-  QSet<library_song_id_t> emptySet;
-  serverConnection->modActivePlaylist(libIds, emptySet);
+  playlistIdsToRemove.subtract(libIds);
+  coalescer->submitSetAdditions(PLAYLIST_MOD_REQUEST, libIds);
+  applyLocalPlaylistMod(libIds, QSet<library_song_id_t>());
 }
 
 void DataStore::removeSongsFromActivePlaylist(const QSet<library_song_id_t>& libIds){
   playlistIdsToRemove.unite(libIds);
-  QSet<library_song_id_t> emptySet;
-  serverConnection->modActivePlaylist(emptySet, libIds);
+  playlistIdsToAdd.subtract(libIds);
+  coalescer->submitSetRemovals(PLAYLIST_MOD_REQUEST, libIds);
+  applyLocalPlaylistMod(QSet<library_song_id_t>(), libIds);
 }
 
 QSqlDatabase DataStore::getDatabaseConnection(){
@@ -622,17 +1137,30 @@ DataStore::song_info_t DataStore::takeNextSongToPlay(){
     nextSongQuery.exec(),
     nextSongQuery)
   nextSongQuery.next();
+  bool isFallback = false;
   if(!nextSongQuery.isValid()){
-    song_info_t toReturn = {Phonon::MediaSource(""), "", "", "" };
-    return toReturn;
+    //Nobody can add songs while we're offline, so keep the music going from the library.
+    isFallback = isOffline && pickFallbackSong(nextSongQuery);
+    if(!isFallback){
+      song_info_t toReturn = {Phonon::MediaSource(""), "", "", "" };
+      return toReturn;
+    }
   }
   currentSongId =
     nextSongQuery.value(4).value<library_song_id_t>();
 
-  deleteSongFromPlaylist(currentSongId);
+  if(isFallback){
+    Logger::instance()->log("Playlist empty while offline, playing fallback song");
+    journalChange(JOURNAL_PLAYLIST_ADD, currentSongId);
+  }
+  else if(deleteSongFromPlaylist(currentSongId)){
+    playlist_change_t change;
+    change.removed.append(currentSongId);
+    emit activePlaylistChanged(change);
+  }
 
   Logger::instance()->log("Setting current song with id: " + QString::number(currentSongId));
-  serverConnection->setCurrentSong(currentSongId);
+  coalescer->submitValue(CURRENT_SONG_REQUEST, QVariant::fromValue(currentSongId));
 
   QString filePath = nextSongQuery.value(0).toString();
   QTime qtime(0, nextSongQuery.value(3).toInt()/60, nextSongQuery.value(3).toInt()%60);
@@ -647,16 +1175,45 @@ DataStore::song_info_t DataStore::takeNextSongToPlay(){
 
 }
 
-void DataStore::deleteSongFromPlaylist(library_song_id_t toDelete){
-  QSqlQuery deleteSongQuery(
-    "DELETE FROM " + getActivePlaylistTableName() +
-    " WHERE " + 
-    getActivePlaylistLibIdColName() + " = " + QString::number(toDelete) + ";", 
-    database);
+bool DataStore::deleteSongFromPlaylist(library_song_id_t toDelete){
+  QSqlQuery deleteSongQuery(database);
   EXEC_SQL(
     "Deleting song from playlist failed",
-    deleteSongQuery.exec(),
+    deleteSongQuery.exec(
+      "DELETE FROM " + getActivePlaylistTableName() +
+      " WHERE " + 
+      getActivePlaylistLibIdColName() + " = " + QString::number(toDelete) + ";"),
     deleteSongQuery)
+  serverConnection->forgetActivePlaylistVersion();
+  return deleteSongQuery.numRowsAffected() > 0;
+}
+
+QVector<playlist_entry_t> DataStore::readActivePlaylistEntries(){
+  QVector<playlist_entry_t> entries;
+  QSqlQuery entriesQuery(database);
+  EXEC_SQL(
+    "Error reading the active playlist",
+    entriesQuery.exec(
+      "SELECT " + getActivePlaylistLibIdColName() + ", " +
+      getUpVoteColName() + ", " +
+      getDownVoteColName() + ", " +
+      getTimeAddedColName() + ", " +
+      getAdderUsernameColName() + ", " +
+      getAdderIdColName() + " FROM " +
+      getActivePlaylistTableName() + " ORDER BY " + getPriorityColName() + " ASC;"),
+    entriesQuery)
+  while(entriesQuery.next()){
+    playlist_entry_t entry = {
+      entriesQuery.value(0).value<library_song_id_t>(),
+      entriesQuery.value(1).toInt(),
+      entriesQuery.value(2).toInt(),
+      entriesQuery.value(3).toString(),
+      entriesQuery.value(4).toString(),
+      entriesQuery.value(5).value<user_id_t>()
+    };
+    entries.append(entry);
+  }
+  return entries;
 }
 
 void DataStore::setCurrentSong(const library_song_id_t& songToPlay){
@@ -677,7 +1234,7 @@ void DataStore::setCurrentSong(const library_song_id_t& songToPlay){
     Logger::instance()->log("Got file, for manual song set");
     QString filePath = getSongQuery.value(0).toString();
     currentSongId = songToPlay;
-    serverConnection->setCurrentSong(songToPlay);
+    coalescer->submitValue(CURRENT_SONG_REQUEST, QVariant::fromValue(songToPlay));
     Logger::instance()->log("Retrieved Artist " + getSongQuery.value(2).toString());
     QTime qtime(0, getSongQuery.value(3).toInt()/60, getSongQuery.value(3).toInt()%60);
     song_info_t toEmit = {
@@ -726,20 +1283,15 @@ void DataStore::createNewPlayer(
 
 void DataStore::setVolume(qreal newVolume){
   QSettings settings(QSettings::UserScope, getSettingsOrg(), getSettingsApp());
-  Logger::instance()->log("Current volume " + QString::number(settings.value(getPlayerVolumeSettingName()).toReal()));
-  Logger::instance()->log("New volume " + QString::number(newVolume));
-  if((int)(settings.value(getPlayerVolumeSettingName()).toReal()*10) != (int)(newVolume*10)){
-    Logger::instance()->log("Volume was different than current volume, now setting");
+  qreal currentVolume = settings.value(getPlayerVolumeSettingName()).toReal();
+  if((int)(currentVolume*10) != (int)(newVolume*10)){
+    Logger::instance()->log("Volume changed from " + QString::number(currentVolume) +
+      " to " + QString::number(newVolume));
     settings.setValue(getPlayerVolumeSettingName(), newVolume);
-    serverConnection->setVolume((int)(newVolume * 10));
+    coalescer->submitValue(VOLUME_REQUEST, (int)(newVolume * 10));
   }
 }
 
-
-
-
-
-
 void DataStore::syncLibrary(){
   QSqlQuery needAddSongs(database);
   Logger::instance()->log("batching up sync");
@@ -754,24 +1306,7 @@ void DataStore::syncLibrary(){
   QVariantList songsToAdd;
   QSqlRecord currentRecord;
   while(needAddSongs.next()){
-    currentRecord = needAddSongs.record();
-    QVariantMap songToAdd;
-    songToAdd["id"] = currentRecord.value(getLibIdColName()).toString();
-    QString title = currentRecord.value(getLibSongColName()).toString();
-    title.truncate(199);
-    songToAdd["title"] = title;
-    QString artist = currentRecord.value(getLibArtistColName()).toString();
-    artist.truncate(199);
-    songToAdd["artist"] = artist;
-    QString album = currentRecord.value(getLibAlbumColName()).toString();
-    album.truncate(199);
-    songToAdd["album"] = album; 
-    songToAdd["duration"] = currentRecord.value(getLibDurationColName());
-    songToAdd["track"] = currentRecord.value(getLibTrackColName()).toInt();
-    QString genre = currentRecord.value(getLibGenreColName()).toString();
-    genre.truncate(49);
-    songToAdd["genre"] = genre;
-    songsToAdd.append(songToAdd);
+    songsToAdd.append(getSongSyncMap(needAddSongs.record()));
   }
 
   QSqlQuery needDeleteSongs(database);
@@ -796,6 +1331,211 @@ void DataStore::syncLibrary(){
   }
 }
 
+QVariantMap DataStore::getSongSyncMap(const QSqlRecord& record){
+  QVariantMap songToAdd;
+  songToAdd["id"] = record.value(getLibIdColName()).toString();
+  QString title = record.value(getLibSongColName()).toString();
+  title.truncate(199);
+  songToAdd["title"] = title;
+  QString artist = record.value(getLibArtistColName()).toString();
+  artist.truncate(199);
+  songToAdd["artist"] = artist;
+  QString album = record.value(getLibAlbumColName()).toString();
+  album.truncate(199);
+  songToAdd["album"] = album; 
+  songToAdd["duration"] = record.value(getLibDurationColName());
+  songToAdd["track"] = record.value(getLibTrackColName()).toInt();
+  QString genre = record.value(getLibGenreColName()).toString();
+  genre.truncate(49);
+  songToAdd["genre"] = genre;
+  return songToAdd;
+}
+
+void DataStore::reconcileLibrary(){
+  Logger::instance()->log("Requesting library fingerprint, local root is " +
+    libraryFingerprint.getRootDigest());
+  serverConnection->getLibraryFingerprint();
+}
+
+void DataStore::onLibraryFingerprintReceived(const QVariantMap& remoteFingerprint){
+  QList<int> differingBuckets = libraryFingerprint.getDifferingBuckets(remoteFingerprint);
+  Logger::instance()->log("Library fingerprint differs in " +
+    QString::number(differingBuckets.size()) + " buckets");
+  if(differingBuckets.isEmpty()){
+    emit libraryReconciled(0);
+    return;
+  }
+  //A differing bucket only tells us one of its songs is off, so we find out which.
+  reconcilingBuckets = differingBuckets;
+  serverConnection->getLibraryBucketSongs(differingBuckets);
+}
+
+void DataStore::onLibraryBucketSongsReceived(const QVariantList& remoteSongs){
+  QHash<library_song_id_t, quint32> remoteHashes;
+  Q_FOREACH(const QVariant& remoteSong, remoteSongs){
+    QVariantMap remoteSongMap = remoteSong.toMap();
+    remoteHashes.insert(
+      remoteSongMap["id"].value<library_song_id_t>(),
+      (quint32)remoteSongMap["hash"].toLongLong());
+  }
+
+  bool isTransacting = database.transaction();
+  QSqlQuery bucketSongsQuery(database);
+  bucketSongsQuery.prepare("SELECT * FROM " + getLibraryTableName() + " " +
+    "WHERE (" + getLibIdColName() + " % " +
+      QString::number(LibraryFingerprint::getNumBuckets()) + ")= ?");
+  QSqlQuery resyncQuery(database);
+  resyncQuery.prepare("UPDATE " + getLibraryTableName() + " "
+    "SET " + getLibSyncStatusColName() + "= ? WHERE " + getLibIdColName() + "= ?");
+  QSqlQuery clearBucketQuery(database);
+  clearBucketQuery.prepare("DELETE FROM " + getLibFingerprintTableName() + " " +
+    "WHERE " + getLibFingerprintBucketColName() + "= ?");
+  QSqlQuery insertQuery(database);
+  insertQuery.prepare(
+    "INSERT OR REPLACE INTO " + getLibFingerprintTableName() + "(" +
+    getLibFingerprintIdColName() + "," +
+    getLibFingerprintBucketColName() + "," +
+    getLibFingerprintHashColName() + ") VALUES (?, ?, ?);");
+
+  QSet<library_song_id_t> resyncedSongs;
+  Q_FOREACH(int bucket, reconcilingBuckets){
+    clearBucketQuery.bindValue(0, bucket);
+    EXEC_SQL(
+      "Error clearing fingerprint bucket",
+      clearBucketQuery.exec(),
+      clearBucketQuery)
+    libraryFingerprint.clearBucket(bucket);
+
+    bucketSongsQuery.bindValue(0, bucket);
+    EXEC_SQL(
+      "Error querying for fingerprint bucket songs",
+      bucketSongsQuery.exec(),
+      bucketSongsQuery)
+    while(bucketSongsQuery.next()){
+      QSqlRecord songRecord = bucketSongsQuery.record();
+      library_song_id_t id = songRecord.value(getLibIdColName()).value<library_song_id_t>();
+      lib_sync_status_t syncStatus =
+        songRecord.value(getLibSyncStatusColName()).value<lib_sync_status_t>();
+      bool serverHasSong = remoteHashes.contains(id);
+      quint32 remoteHash = remoteHashes.take(id);
+      lib_sync_status_t newSyncStatus = syncStatus;
+
+      if(songRecord.value(getLibIsDeletedColName()).toInt() == 0){
+        quint32 songHash = LibraryFingerprint::computeSongHash(getSongSyncMap(songRecord));
+        if(serverHasSong && remoteHash == songHash){
+          insertQuery.bindValue(0, QVariant::fromValue<library_song_id_t>(id));
+          insertQuery.bindValue(1, bucket);
+          insertQuery.bindValue(2, (qlonglong)songHash);
+          EXEC_SQL(
+            "Error inserting library fingerprint entry",
+            insertQuery.exec(),
+            insertQuery)
+          libraryFingerprint.addSong(id, songHash);
+          if(syncStatus == getLibNeedsAddSyncStatus()){
+            newSyncStatus = getLibIsSyncedStatus();
+          }
+        }
+        else if(syncStatus != getLibNeedsBanSyncStatus()){
+          newSyncStatus = getLibNeedsAddSyncStatus();
+        }
+      }
+      else if(syncStatus != getLibNeedsBanSyncStatus()){
+        newSyncStatus = serverHasSong ? getLibNeedsDeleteSyncStatus() : getLibIsSyncedStatus();
+      }
+
+      if(newSyncStatus != syncStatus){
+        resyncQuery.bindValue(0, newSyncStatus);
+        resyncQuery.bindValue(1, QVariant::fromValue<library_song_id_t>(id));
+        EXEC_SQL(
+          "Error marking song for resync",
+          resyncQuery.exec(),
+          resyncQuery)
+        resyncedSongs.insert(id);
+      }
+    }
+  }
+  if(isTransacting){
+    database.commit();
+  }
+  reconcilingBuckets.clear();
+
+  if(!remoteHashes.isEmpty()){
+    Logger::instance()->log("Server has " + QString::number(remoteHashes.size()) +
+      " songs that aren't in the local library");
+  }
+  Logger::instance()->log("Reconciling marked " + QString::number(resyncedSongs.size()) +
+    " songs for resync");
+  if(!resyncedSongs.isEmpty()){
+    emit libSongsModified(resyncedSongs);
+  }
+  emit libraryReconciled(resyncedSongs.size());
+}
+
+void DataStore::onGetLibraryFingerprintFail(
+  const QString& errMessage,
+  int errorCode,
+  const QList<QNetworkReply::RawHeaderPair>& /*headers*/)
+{
+  Logger::instance()->log("Library fingerprint error: " + QString::number(errorCode) + " " + errMessage);
+  emit libraryReconcileError(errMessage);
+}
+
+void DataStore::updateLibraryFingerprint(const QSet<library_song_id_t>& syncedSongs){
+  QSqlQuery songQuery(database);
+  songQuery.prepare("SELECT * FROM " + getLibraryTableName() + " WHERE " +
+    getLibIdColName() + "= ?");
+  QSqlQuery oldHashQuery(database);
+  oldHashQuery.prepare("SELECT " + getLibFingerprintHashColName() + " FROM " +
+    getLibFingerprintTableName() + " WHERE " + getLibFingerprintIdColName() + "= ?");
+  QSqlQuery insertQuery(database);
+  insertQuery.prepare(
+    "INSERT OR REPLACE INTO " + getLibFingerprintTableName() + "(" +
+    getLibFingerprintIdColName() + "," +
+    getLibFingerprintBucketColName() + "," +
+    getLibFingerprintHashColName() + ") VALUES (?, ?, ?);");
+  QSqlQuery removeQuery(database);
+  removeQuery.prepare("DELETE FROM " + getLibFingerprintTableName() + " WHERE " +
+    getLibFingerprintIdColName() + "= ?");
+
+  Q_FOREACH(library_song_id_t id, syncedSongs){
+    songQuery.bindValue(0, QVariant::fromValue<library_song_id_t>(id));
+    EXEC_SQL(
+      "Error querying for synced song",
+      songQuery.exec(),
+      songQuery)
+    if(!songQuery.next()){
+      continue;
+    }
+    QSqlRecord songRecord = songQuery.record();
+
+    oldHashQuery.bindValue(0, QVariant::fromValue<library_song_id_t>(id));
+    EXEC_SQL(
+      "Error querying for old song hash",
+      oldHashQuery.exec(),
+      oldHashQuery)
+    if(oldHashQuery.next()){
+      libraryFingerprint.removeSong(id, (quint32)oldHashQuery.value(0).toLongLong());
+      removeQuery.bindValue(0, QVariant::fromValue<library_song_id_t>(id));
+      EXEC_SQL(
+        "Error removing library fingerprint entry",
+        removeQuery.exec(),
+        removeQuery)
+    }
+
+    if(songRecord.value(getLibIsDeletedColName()).toInt() == 0){
+      quint32 songHash = LibraryFingerprint::computeSongHash(getSongSyncMap(songRecord));
+      insertQuery.bindValue(0, QVariant::fromValue<library_song_id_t>(id));
+      insertQuery.bindValue(1, LibraryFingerprint::getBucket(id));
+      insertQuery.bindValue(2, (qlonglong)songHash);
+      EXEC_SQL(
+        "Error inserting library fingerprint entry",
+        insertQuery.exec(),
+        insertQuery)
+      libraryFingerprint.addSong(id, songHash);
+    }
+  }
+}
+
 void DataStore::setLibSongSynced(library_song_id_t song){
   QSet<library_song_id_t> songSet;
   songSet.insert(song);
@@ -823,13 +1563,14 @@ void DataStore::setLibSongsSyncStatus(
       "Error setting song sync status",
       syncQuery.exec(),
       syncQuery)
-    QSet<library_song_id_t> modId;
-    modId.insert(id);
-    emit libSongsModified(modId);
+  }
+  if(syncStatus == getLibIsSyncedStatus()){
+    updateLibraryFingerprint(songs);
   }
   if(isTransacting){
     database.commit();
   }
+  emit libSongsModified(songs);
 
   if(hasUnsyncedSongs()){
     Logger::instance()->log("more stuff to sync");
@@ -863,66 +1604,152 @@ int DataStore::getTotalUnsynced() const{
 }
 
 
-void DataStore::clearActivePlaylist(){
-  QSqlQuery deleteActivePlayilstQuery(database);
+DataStore::playlist_change_t DataStore::applyActivePlaylist(
+  const QVector<playlist_entry_t>& entries)
+{
+  playlist_change_t change;
+  QHash<library_song_id_t, playlist_row_t> currentRows;
+  QSqlQuery currentQuery(database);
   EXEC_SQL(
-    "Error clearing active playlist table.",
-    deleteActivePlayilstQuery.exec(getClearActivePlaylistQuery()),
-    deleteActivePlayilstQuery)
-}
+    "Error reading the current active playlist",
+    currentQuery.exec(
+      "SELECT " + getActivePlaylistLibIdColName() + ", " +
+      getPriorityColName() + ", " +
+      getUpVoteColName() + ", " +
+      getDownVoteColName() + ", " +
+      getAdderIdColName() + ", " +
+      getAdderUsernameColName() + " FROM " +
+      getActivePlaylistTableName() + ";"),
+    currentQuery)
+  while(currentQuery.next()){
+    playlist_row_t row = {
+      currentQuery.value(1).toInt(),
+      currentQuery.value(2).toInt(),
+      currentQuery.value(3).toInt(),
+      currentQuery.value(4).value<user_id_t>(),
+      currentQuery.value(5).toString()
+    };
+    currentRows.insert(currentQuery.value(0).value<library_song_id_t>(), row);
+  }
 
-void DataStore::addSong2ActivePlaylistFromQVariant(
-  const QVariantMap &songToAdd, int priority)
-{
-  QSqlQuery addQuery(
-    "INSERT INTO "+getActivePlaylistTableName()+ 
-    "("+
-    getActivePlaylistLibIdColName() + ","+
-    getDownVoteColName() + ","+
+  QSqlQuery insertQuery(database);
+  insertQuery.prepare(
+    "INSERT INTO " + getActivePlaylistTableName() +
+    "(" +
+    getActivePlaylistLibIdColName() + "," +
+    getDownVoteColName() + "," +
     getUpVoteColName() + "," +
     getPriorityColName() + "," +
-    getTimeAddedColName() +"," +
-    getAdderUsernameColName() +"," +
+    getTimeAddedColName() + "," +
+    getAdderUsernameColName() + "," +
     getAdderIdColName() + ")" +
-    " VALUES ( :libid , :down , :up, :pri , :time , :username, :adder );",
-    database);
-
-  addQuery.bindValue(":libid", songToAdd["song"].toMap()["id"]);
-  addQuery.bindValue(":down", songToAdd["downvoters"].toList().size());
-  addQuery.bindValue(":up", songToAdd["upvoters"].toList().size());
-  addQuery.bindValue(":pri", priority);
-  addQuery.bindValue(":time", songToAdd["time_added"]);
-  addQuery.bindValue(":username", songToAdd["adder"].toMap()["username"]);
-  addQuery.bindValue(":adder", songToAdd["adder"].toMap()["id"]);
+    " VALUES ( :libid , :down , :up, :pri , :time , :username, :adder );");
+  QSqlQuery updateQuery(database);
+  updateQuery.prepare(
+    "UPDATE " + getActivePlaylistTableName() + " SET " +
+    getDownVoteColName() + " = :down, " +
+    getUpVoteColName() + " = :up, " +
+    getPriorityColName() + " = :pri, " +
+    getAdderUsernameColName() + " = :username, " +
+    getAdderIdColName() + " = :adder WHERE " +
+    getActivePlaylistLibIdColName() + " = :libid;");
+  QSqlQuery removeQuery(database);
+  removeQuery.prepare(
+    "DELETE FROM " + getActivePlaylistTableName() + " WHERE " +
+    getActivePlaylistLibIdColName() + " = :libid;");
 
-  long insertId;
-  EXEC_INSERT(
-    "Failed to add song library" << songToAdd["song"].toString().toStdString(),
-    addQuery,
-    insertId,
-    long)
+  bool isTransacting = database.transaction();
+  QSet<library_song_id_t> seen;
+  for(int priority=0; priority<entries.size(); ++priority){
+    const playlist_entry_t& entry = entries.at(priority);
+    if(seen.contains(entry.libId)){
+      Logger::instance()->log("Ignoring duplicate playlist entry " +
+        QString::number(entry.libId));
+      continue;
+    }
+    seen.insert(entry.libId);
+    QHash<library_song_id_t, playlist_row_t>::const_iterator current =
+      currentRows.constFind(entry.libId);
+    if(current == currentRows.constEnd()){
+      insertQuery.bindValue(":libid", QVariant::fromValue(entry.libId));
+      insertQuery.bindValue(":down", entry.downvotes);
+      insertQuery.bindValue(":up", entry.upvotes);
+      insertQuery.bindValue(":pri", priority);
+      insertQuery.bindValue(":time", entry.timeAdded);
+      insertQuery.bindValue(":username", entry.adderUsername);
+      insertQuery.bindValue(":adder", QVariant::fromValue(entry.adderId));
+      EXEC_SQL(
+        "Failed to add song to the active playlist",
+        insertQuery.exec(),
+        insertQuery)
+      change.inserted.append(entry.libId);
+      continue;
+    }
+    bool isMoved = current->priority != priority;
+    bool isUpdated = current->upvotes != entry.upvotes ||
+      current->downvotes != entry.downvotes ||
+      current->adderId != entry.adderId ||
+      current->adderUsername != entry.adderUsername;
+    if(isMoved || isUpdated){
+      updateQuery.bindValue(":down", entry.downvotes);
+      updateQuery.bindValue(":up", entry.upvotes);
+      updateQuery.bindValue(":pri", priority);
+      updateQuery.bindValue(":username", entry.adderUsername);
+      updateQuery.bindValue(":adder", QVariant::fromValue(entry.adderId));
+      updateQuery.bindValue(":libid", QVariant::fromValue(entry.libId));
+      EXEC_SQL(
+        "Failed to update song on the active playlist",
+        updateQuery.exec(),
+        updateQuery)
+      if(isMoved){
+        change.moved.append(entry.libId);
+      }
+      if(isUpdated){
+        change.updated.append(entry.libId);
+      }
+    }
+  }
+  QHash<library_song_id_t, playlist_row_t>::const_iterator it = currentRows.constBegin();
+  for(; it != currentRows.constEnd(); ++it){
+    if(!seen.contains(it.key())){
+      removeQuery.bindValue(":libid", QVariant::fromValue(it.key()));
+      EXEC_SQL(
+        "Failed to remove song from the active playlist",
+        removeQuery.exec(),
+        removeQuery)
+      change.removed.append(it.key());
+    }
+  }
+  if(isTransacting){
+    database.commit();
+  }
+  return change;
 }
 
-void DataStore::setActivePlaylist(const QVariantMap& newPlaylist){
+void DataStore::setActivePlaylist(const playlist_snapshot_t& newPlaylist){
 
-  int retrievedVolume = newPlaylist["volume"].toInt();
-  if(retrievedVolume != (int)(getPlayerVolume()*10)){
+  int retrievedVolume = newPlaylist.volume;
+  if(!coalescer->hasPending(VOLUME_REQUEST) &&
+    retrievedVolume != (int)(getPlayerVolume()*10))
+  {
     QSettings settings(QSettings::UserScope, getSettingsOrg(), getSettingsApp());
     settings.setValue(getPlayerVolumeSettingName(), retrievedVolume/10.0);
     emit volumeChanged(retrievedVolume/10.0);
   }
 
-  QString retrievedState = newPlaylist["state"].toString();
+  const QString& retrievedState = newPlaylist.state;
   if(!changingPlayerState && retrievedState != getPlayerState()){
     QSettings settings(QSettings::UserScope, getSettingsOrg(), getSettingsApp());
     settings.setValue(getPlayerStateSettingName(), retrievedState);
     emit playerStateChanged(retrievedState);
+    updatePollingPolicy();
   }
 
 
-  library_song_id_t retrievedCurrentId =
-    newPlaylist["current_song"].toMap()["song"].toMap()["id"].value<library_song_id_t>();
-  if(retrievedCurrentId != currentSongId && !clearingCurrentSong){
+  library_song_id_t retrievedCurrentId = newPlaylist.currentSongId;
+  if(retrievedCurrentId != currentSongId && !clearingCurrentSong &&
+    !coalescer->hasPending(CURRENT_SONG_REQUEST) && reconcileCurrentSong == -1)
+  {
     QSqlQuery getSongQuery(
       "SELECT " + getLibFileColName() + ", " +
       getLibSongColName() + ", " +
@@ -950,26 +1777,27 @@ void DataStore::setActivePlaylist(const QVariantMap& newPlaylist){
       emit manualSongChange(toEmit);
     }
   }
-  clearActivePlaylist();
-  QVariantList newSongs = newPlaylist["active_playlist"].toList();
-  for(int i=0; i<newSongs.size(); ++i){
-    addSong2ActivePlaylistFromQVariant(newSongs[i].toMap(), i); 
+  //Only what differs from what we already have is written, so a poll that brings a
+  //single new vote costs a single update.
+  QVector<playlist_entry_t> entries = withPendingPlaylistMods(newPlaylist.entries);
+  playlist_change_t change = applyActivePlaylist(entries);
+  if(!change.inserted.isEmpty() || !change.removed.isEmpty() ||
+    !change.moved.isEmpty() || !change.updated.isEmpty())
+  {
+    if(!change.inserted.isEmpty() || !change.moved.isEmpty() || !change.updated.isEmpty()){
+      change.entries = entries;
+    }
+    emit activePlaylistChanged(change);
+    emit activePlaylistModified();
   }
-  emit activePlaylistModified();
-  
 }
 
 void DataStore::onGetActivePlaylistFail(
   const QString& errMessage,
   int errorCode,
-  const QList<QNetworkReply::RawHeaderPair>& headers)
+  const QList<QNetworkReply::RawHeaderPair>& /*headers*/)
 {
   Logger::instance()->log("Playlist error: " + QString::number(errorCode) + " " + errMessage);
-  if(isTicketAuthError(errorCode, headers)){
-    Logger::instance()->log("Got the ticket-hash challenge");
-    reauthActions.insert(GET_ACTIVE_PLAYLIST);
-    initReauth();
-  }
   //TODO handle other possible errors?
 }
 
@@ -977,23 +1805,53 @@ void DataStore::onActivePlaylistModified(
   const QSet<library_song_id_t>& added,
   const QSet<library_song_id_t>& removed)
 {
+  QSet<library_song_id_t> confirmed = added;
+  confirmed.intersect(playlistIdsToAdd);
   playlistIdsToAdd.subtract(added);
   playlistIdsToRemove.subtract(removed);
+  if(!confirmed.isEmpty()){
+    emit pendingPlaylistAddsConfirmed(confirmed);
+  }
+  if(reconcileJournalEnd != -1 && added == reconcileToAdd && removed == reconcileToRemove){
+    finishReconcile();
+  }
   refreshActivePlaylist();
 }
 
 void DataStore::onActivePlaylistModFailed(
   const QString& /*errMessage*/,
   int errorCode,
-  const QList<QNetworkReply::RawHeaderPair>& headers)
+  const QList<QNetworkReply::RawHeaderPair>& /*headers*/)
 {
   Logger::instance()->log("Active playlist mod failed with code " + QString::number(errorCode));
-  if(isTicketAuthError(errorCode, headers)){
-    Logger::instance()->log("Got the ticket-hash challenge");
-    reauthActions.insert(MOD_PLAYLIST);
-    initReauth();
+  //Never reached the server or the server had trouble on its end. Keep the journal around for the next reconciliation and
+  //journal anything else that didn't make it.
+  reconcileJournalEnd = -1;
+  if(!playlistIdsToAdd.isEmpty() || !playlistIdsToRemove.isEmpty()){
+    journalPlaylistMod(playlistIdsToAdd, playlistIdsToRemove);
+    playlistIdsToAdd.clear();
+    playlistIdsToRemove.clear();
   }
-  //TODO do stuff on failure
+}
+
+void DataStore::onActivePlaylistModRejected(
+  const QSet<library_song_id_t>& added,
+  const QSet<library_song_id_t>& removed,
+  const QString& errMessage)
+{
+  Logger::instance()->log("Server refused playlist mod, rolling it back: " + errMessage);
+  //Sending the same thing again won't go any better, so it's dropped from the journal.
+  if(reconcileJournalEnd != -1){
+    finishReconcile();
+  }
+  //Stop holding the refused changes over the server's playlist. The next playlist from
+  //the server then puts back whatever was removed and takes out whatever was added.
+  playlistIdsToAdd.subtract(added);
+  playlistIdsToRemove.subtract(removed);
+  serverConnection->forgetActivePlaylistVersion();
+  refreshActivePlaylist();
+  activePlaylistPoller->boost();
+  emit activePlaylistModError(errMessage);
 }
 
 void DataStore::refreshActivePlaylist(){
@@ -1015,116 +1873,54 @@ void DataStore::onPlayerCreate(const player_id_t& issuedId){
 void DataStore::onPlayerCreationFailed(const QString& errMessage, int /*errorCode*/,
     const QList<QNetworkReply::RawHeaderPair>& /*headers*/)
 {
-  //TODO do other stuff as well. like do reauth
+  //TODO do other stuff as well.
   emit playerCreationFailed(errMessage);
 }
 
 void DataStore::onLibModError(
-    const QString& errMessage, int errorCode, const QList<QNetworkReply::RawHeaderPair>& headers)
+    const QString& errMessage, int errorCode, const QList<QNetworkReply::RawHeaderPair>& /*headers*/)
 {
   Logger::instance()->log("Got bad libmod " + QString::number(errorCode));
-  if(isTicketAuthError(errorCode, headers)){
-    Logger::instance()->log("Got the ticket-hash challenge");
-    reauthActions.insert(SYNC_LIB);
-    initReauth();
-  }
-  else{
-    Logger::instance()->log("Bad lib mod message " + errMessage);
-    emit libModError(errMessage);
-  }
+  Logger::instance()->log("Bad lib mod message " + errMessage);
+  emit libModError(errMessage);
 }
 
 void DataStore::onSetCurrentSongFailed(
-  const QString& errMessage, int errorCode, const QList<QNetworkReply::RawHeaderPair>& headers)
+  const QString& errMessage, int errorCode, const QList<QNetworkReply::RawHeaderPair>& /*headers*/)
 {
   Logger::instance()->log("Setting current song failed: " + QString::number(errorCode) + " " + errMessage);
-  if(isTicketAuthError(errorCode, headers)){
-    Logger::instance()->log("Got the ticket-hash challenge");
-    reauthActions.insert(SET_CURRENT_SONG);
-    initReauth();
+  reconcileCurrentSong = -1;
+  if(errorCode == 0 && currentSongId != -1){
+    journalChange(JOURNAL_CURRENT_SONG, currentSongId);
   }
 }
 
+void DataStore::onCurrentSongSet(){
+  reconcileCurrentSong = -1;
+  refreshActivePlaylist();
+}
+
 void DataStore::onSetVolumeFailed(
-  const QString& errMessage, int errorCode, const QList<QNetworkReply::RawHeaderPair>& headers)
+  const QString& errMessage, int errorCode, const QList<QNetworkReply::RawHeaderPair>& /*headers*/)
 {
   Logger::instance()->log("Setting volume failed " + 
     QString::number(errorCode) + " " + errMessage);
-  if(isTicketAuthError(errorCode, headers)){
-    Logger::instance()->log("Got the ticket-hash challenge");
-    reauthActions.insert(SET_CURRENT_VOLUME);
-    initReauth();
-  }
-  else{
-    emit setVolumeError(errMessage);
-  }
+  emit setVolumeError(errMessage);
 }
 
 void DataStore::onNewParticipantList(const QVariantList& newParticipants){
-  emit newParticipantList(newParticipants);
-}
-
-
-
-
-
-void DataStore::onReauth(const QByteArray& ticketHash, const user_id_t& userId){
-  Logger::instance()->log("in on reauth");
-  isReauthing=false;
-  serverConnection->setTicket(ticketHash);
-  serverConnection->setUserId(userId);
-
-  Q_FOREACH(ReauthAction r, reauthActions){
-    doReauthAction(r);
+  if(newParticipants == lastParticipants){
+    participantPoller->recordUnchanged();
+    return;
   }
-
-  reauthActions.clear();
+  lastParticipants = newParticipants;
+  participantPoller->recordChanged();
+  emit newParticipantList(newParticipants);
 }
 
-void DataStore::doReauthAction(const ReauthAction& action){
+void DataStore::onTicketLifetimeObserved(qint64 lifetime){
   QSettings settings(QSettings::UserScope, getSettingsOrg(), getSettingsApp());
-  switch(action){
-    case SYNC_LIB:
-      syncLibrary();
-      break;
-    case GET_ACTIVE_PLAYLIST:
-      refreshActivePlaylist();
-      break;
-    case SET_CURRENT_SONG:
-      if(currentSongId != -1){
-        serverConnection->setCurrentSong(currentSongId);
-      }
-      break;
-    case MOD_PLAYLIST:
-      serverConnection->modActivePlaylist(playlistIdsToAdd, playlistIdsToRemove);
-      break;
-    case SET_CURRENT_VOLUME:
-      serverConnection->setVolume((int)(getPlayerVolume() * 10));
-      break;
-    case SET_PLAYER_STATE:
-      serverConnection->setPlayerState(getPlayerState());
-      break;
-    case SET_PLAYER_INACTIVE:
-      serverConnection->setPlayerState(getInactiveState());
-      break;
-    case SET_PLAYER_LOCATION:
-      serverConnection->setPlayerLocation(
-        settings.value(getAddressSettingName()).toString(),
-        settings.value(getCitySettingName()).toString(),
-        settings.value(getStateSettingName()).toString(),
-        settings.value(getZipCodeSettingName()).toString());
-      break;
-    case SET_PLAYER_PASSWORD:
-      serverConnection->setPlayerPassword(reauthPlayerPassword);
-      reauthPlayerPassword="";
-      break;
-    case REMOVE_PLAYER_PASSWORD:
-      serverConnection->removePlayerPassword();
-      break;
-    case CLEAR_CURRENT_SONG:
-      serverConnection->clearCurrentSong();
-      break;
-  }
+  settings.setValue(getTicketLifetimeSettingName(), lifetime);
 }
 
 void DataStore::onAuthFail(const QString& /*errMessage*/){
@@ -1133,28 +1929,6 @@ void DataStore::onAuthFail(const QString& /*errMessage*/){
   emit hardAuthFailure();
 }
 
-void DataStore::initReauth(){
-  if(!isReauthing){
-    isReauthing=true;
-    serverConnection->authenticate(getUsername(), getPassword());
-  }
-}
-
-QByteArray DataStore::getHeaderValue(
-    const QByteArray& headerName,
-    const QList<QNetworkReply::RawHeaderPair>& headers)
-{
-  //Yes yes, I know this is an O(n) search. But it's fine. 
-  //This list of headers shouldn't be that long.
-  Q_FOREACH(const QNetworkReply::RawHeaderPair& pair, headers){
-    if(headerName == pair.first){
-      return pair.second;
-    }
-  }
-  return "";
-}
-
-
 bool DataStore::getDontShowPlaybackErrorSetting(){
   QSettings settings(QSettings::UserScope, getSettingsOrg(), getSettingsApp());
   return settings.value(getDontShowPlaybackErrorSettingName(), false ).toBool();
@@ -1179,8 +1953,6 @@ QString DataStore::getSavedUsername(){
   return encryptedUsername == "" ? "" : crypt.decryptToString(encryptedUsername);
 }
 
-
-
 void DataStore::savePassword(const QString& password)
 {
   QSettings settings(QSettings::UserScope, getSettingsOrg(), getSettingsApp());
@@ -1214,5 +1986,4 @@ void DataStore::clearSavedPassword(){
 }
 
 
-
 } //end namespace
@@ -22,15 +22,20 @@
 #include <phonon/mediaobject.h>
 #include <phonon/mediasource.h>
 #include <QSettings>
+#include <QStringList>
 #include "ConfigDefs.hpp"
+#include "LibraryFingerprint.hpp"
+#include "PlaylistSnapshot.hpp"
 #include <QNetworkReply>
 #include <QThread>
 
-class QTimer;
 class QProgressDialog;
+class QSqlRecord;
 
 namespace UDJ{
 
+class RequestCoalescer;
+class AdaptivePoller;
 class UDJServerConnection;
 
 /** 
@@ -43,23 +48,6 @@ public:
   /** @name Public Typedefs and Enums */
   //@{
 
-  /**
-   * \brief Actions that can be preformed once the client has reauthenticated.
-   */
-  enum ReauthAction{
-    SYNC_LIB,
-    GET_ACTIVE_PLAYLIST,
-    SET_CURRENT_SONG,
-    MOD_PLAYLIST,
-    SET_CURRENT_VOLUME,
-    SET_PLAYER_STATE,
-    SET_PLAYER_INACTIVE,
-    SET_PLAYER_LOCATION,
-    SET_PLAYER_PASSWORD,
-    REMOVE_PLAYER_PASSWORD,
-    CLEAR_CURRENT_SONG
-  };
-
   /**
    * \brief A minimal set of info describing a song in the database.
    */
@@ -70,6 +58,25 @@ public:
     QString duration;
   } song_info_t;
 
+  /**
+   * \brief What changed on the active playlist table, by library id.
+   */
+  typedef struct {
+    /** \brief Songs that weren't on the playlist before. */
+    QList<library_song_id_t> inserted;
+    /** \brief Songs that are no longer on the playlist. */
+    QList<library_song_id_t> removed;
+    /** \brief Songs that stayed on the playlist but changed position. */
+    QList<library_song_id_t> moved;
+    /** \brief Songs that stayed on the playlist but whose votes or adder changed. */
+    QList<library_song_id_t> updated;
+    /**
+     * \brief The whole playlist after the change, in priority order. Only filled in when
+     * songs were inserted, moved or updated.
+     */
+    QVector<playlist_entry_t> entries;
+  } playlist_change_t;
+
   //@}
 
 
@@ -110,12 +117,47 @@ public:
     return currentSongId;
   }
 
+  /**
+   * \brief Gets whether or not the server is currently unreachable, in which case
+   * changes are kept locally until it can be reached again.
+   *
+   * @return True if the player is offline, false otherwise.
+   */
+  inline bool isOfflineMode() const{
+    return isOffline;
+  }
+
+  /**
+   * \brief Gets whether or not a song was added to the active playlist locally but the
+   * server hasn't confirmed it yet.
+   *
+   * @param libId The library id of the song in question.
+   * @return True if adding the song is still pending, false otherwise.
+   */
+  inline bool isPendingPlaylistAdd(library_song_id_t libId) const{
+    return playlistIdsToAdd.contains(libId);
+  }
+
   //@}
 
 
   /** @name Modifiers */
   //@{
 
+  /**
+   * \brief Replays the server traffic in a capture through the data store in place of
+   * talking to the server.
+   *
+   * Polling stops and nothing more is sent to the server for the rest of the session.
+   * The replayed replies change the local database just as the captured session did.
+   *
+   * \param fileName The capture to replay.
+   * \param speed How much faster than the original session to replay, anything not above
+   * 0 meaning as fast as possible.
+   * \return True if the replay started, false if the capture couldn't be loaded.
+   */
+  bool replayTraffic(const QString& fileName, double speed);
+
   /**
    * \brief Adds a list of songs to the music library.
    *
@@ -778,6 +820,16 @@ public:
     return playerIdSetting;
   }
 
+  /**
+   * \brief Gets the name of the setting holding how long tickets are expected to last.
+   *
+   * @return The name of the ticket lifetime setting.
+   */
+  static const QString& getTicketLifetimeSettingName(){
+    static const QString ticketLifetimeSettingName = "ticketLifetime";
+    return ticketLifetimeSettingName;
+  }
+
   /**
    * \brief Gets the name of the player state setting.
    *
@@ -788,6 +840,16 @@ public:
     return playerStateSettingName;
   }
 
+  /**
+   * \brief Gets the name of the setting overriding the coalescing window of a request.
+   *
+   * @param requestName The name of the request.
+   * @return The name of the setting overriding the coalescing window of a request.
+   */
+  static QString getCoalesceWindowSettingName(const QString& requestName){
+    return "coalesceWindows/" + requestName;
+  }
+
   /**
    * \brief Name of the setting used to store whether or not the player has a password.
    *
@@ -914,6 +976,12 @@ public slots:
    */
   void syncLibrary();
 
+  /**
+   * \brief Compares the library fingerprint with the one on the server and marks any
+   * songs that differ from the server's copy as needing to be synced again.
+   */
+  void reconcileLibrary();
+
   /**
    * \brief Pauses player.
    */
@@ -932,6 +1000,22 @@ public slots:
   /** \brief Refresh the participants list. */
   void refreshParticipantList();
 
+  /**
+   * \brief Tells the data store whether or not the participants list is being shown, so
+   * it can stop polling for participants nobody is looking at.
+   *
+   * @param shown Whether or not the participants list is being shown.
+   */
+  void setParticipantsShown(bool shown);
+
+  /**
+   * \brief Tells the data store whether or not the player's window is minimized, so it
+   * can poll the server less often.
+   *
+   * @param minimized Whether or not the player's window is minimized.
+   */
+  void setPlayerMinimized(bool minimized);
+
   /**
    * \brief Adds the given song to the active playlist.
    *
@@ -1077,6 +1161,11 @@ signals:
 
   /**
    * \brief Emitted when the library table is modified.
+   *
+   * Songs modified together (e.g. a batch of songs that were just synced) are reported
+   * in a single emission.
+   *
+   * @param modifiedSongs The songs that were modified.
    */
   void libSongsModified(const QSet<library_song_id_t>& modifiedSongs);
 
@@ -1092,6 +1181,21 @@ signals:
    */
   void allSynced();
 
+  /**
+   * \brief Emitted when the library has been compared with the server's copy.
+   *
+   * \param numSongsResynced The number of songs that differed from the server's copy and
+   * were marked as needing to be synced again. Zero means the libraries already matched.
+   */
+  void libraryReconciled(int numSongsResynced);
+
+  /**
+   * \brief Emitted when there was an error comparing the library with the server's copy.
+   *
+   * \param errMessage A message describing the error.
+   */
+  void libraryReconcileError(const QString& errMessage);
+
   /**
    * \brief Emitted when a player is created.
    */
@@ -1109,6 +1213,14 @@ signals:
    */
   void activePlaylistModified();
 
+  /**
+   * \brief Emitted whenever rows of the active playlist table change, whether because a
+   * new version came from the server or because of something done locally.
+   *
+   * @param change Exactly what changed.
+   */
+  void activePlaylistChanged(const DataStore::playlist_change_t& change);
+
   /**
    * \brief Emitted when the participant list retrieved from server.
    */
@@ -1149,9 +1261,69 @@ signals:
    */
   void clearCurrentSongError(const QString& errMessage);
 
+  /**
+   * \brief Emitted when the player goes offline because the server can't be reached, or
+   * comes back online.
+   *
+   * @param offline Whether or not the player is now offline.
+   */
+  void offlineModeChanged(bool offline);
+
+  /**
+   * \brief Emitted when the server confirms songs that were added to the active playlist
+   * locally, so they're no longer pending.
+   *
+   * @param libIds The songs that are no longer pending.
+   */
+  void pendingPlaylistAddsConfirmed(const QSet<library_song_id_t>& libIds);
+
+  /**
+   * \brief Emitted when the server refused a modification of the active playlist, which
+   * has been undone locally.
+   *
+   * @param errMessage A message describing the error.
+   */
+  void activePlaylistModError(const QString& errMessage);
+
 //@}
 
 private:
+  /** @name Private Types */
+  //@{
+
+  /**
+   * \brief Requests whose bursts are collapsed by the RequestCoalescer.
+   */
+  enum CoalescedRequest{
+    VOLUME_REQUEST,
+    PLAYER_STATE_REQUEST,
+    CURRENT_SONG_REQUEST,
+    PLAYLIST_MOD_REQUEST
+  };
+
+  /**
+   * \brief Kinds of changes recorded in the offline journal.
+   */
+  enum JournalAction{
+    JOURNAL_CURRENT_SONG,
+    JOURNAL_PLAYLIST_ADD,
+    JOURNAL_PLAYLIST_REMOVE
+  };
+
+  /**
+   * \brief The parts of a row of the active playlist table a new version of the playlist
+   * is compared against.
+   */
+  typedef struct {
+    int priority;
+    int upvotes;
+    int downvotes;
+    user_id_t adderId;
+    QString adderUsername;
+  } playlist_row_t;
+
+  //@}
+
 
   /** @name Private Members */
   //@{
@@ -1162,11 +1334,23 @@ private:
   /** \brief Actual database connection */
   QSqlDatabase database;
 
-  /** \brief Timer used to refresh the active playlist. */
-  QTimer *activePlaylistRefreshTimer;
+  /** \brief Decides when the active playlist should be refreshed. */
+  AdaptivePoller *activePlaylistPoller;
+
+  /** \brief Decides when the list of participants should be refreshed. */
+  AdaptivePoller *participantPoller;
+
+  /** \brief Whether or not the list of participants is being shown to the user. */
+  bool isParticipantsShown;
+
+  /** \brief Whether or not the player's window is minimized. */
+  bool isPlayerMinimized;
 
-  /** \brief Timer used to refresh the list of participants. */
-  QTimer *participantRefreshTimer;
+  /** \brief Whether or not the server is pushing changes to us. */
+  bool isPushConnected;
+
+  /** \brief The last list of participants retrieved from the server. */
+  QVariantList lastParticipants;
 
   /** \brief Current username being used by the client */
   QString username;
@@ -1174,18 +1358,6 @@ private:
   /** \brief Current password being used by the client */
   QString password;
 
-  /** \brief A set of actions to be performed once the client has succesfully reauthenticated. */
-  QSet<ReauthAction> reauthActions;
-
-  /** 
-   * \brief If there is an auth error during the setting of a player password, this is the password that
-   * should be set on the player after the reauth is complete.
-   */
-  QString reauthPlayerPassword;
-
-  /** \brief Whether or not the client is currently reauthenticating. */
-  bool isReauthing;
-
   /**
    * \brief Whether or not the client is currently setting the player's playback state.
    *
@@ -1211,6 +1383,36 @@ private:
   /** \brief The set of songs that still need to be removed from the active playlist. */
   QSet<library_song_id_t> playlistIdsToRemove;
 
+  /** \brief Fingerprint of all the songs that have been synced with the server. */
+  LibraryFingerprint libraryFingerprint;
+
+  /** \brief Fingerprint buckets that differed and whose songs are being compared. */
+  QList<int> reconcilingBuckets;
+
+  /** \brief Collapses bursts of control and playlist requests. */
+  RequestCoalescer *coalescer;
+
+  /** \brief Whether or not the server is currently unreachable. */
+  bool isOffline;
+
+  /**
+   * \brief The id of the last journal entry included in the reconciliation in progress,
+   * or -1 if the journal isn't being reconciled.
+   */
+  qlonglong reconcileJournalEnd;
+
+  /** \brief Songs the reconciliation in progress is adding to the active playlist. */
+  QSet<library_song_id_t> reconcileToAdd;
+
+  /** \brief Songs the reconciliation in progress is removing from the active playlist. */
+  QSet<library_song_id_t> reconcileToRemove;
+
+  /**
+   * \brief The current song the reconciliation in progress will tell the server about,
+   * or -1 if there is none.
+   */
+  library_song_id_t reconcileCurrentSong;
+
   //@}
 
   /** @name Private Functions */
@@ -1219,6 +1421,99 @@ private:
   /** \brief Does initial database setup */
   void setupDB();
 
+  /** \brief Configures the windows used when coalescing requests. */
+  void setupCoalescer();
+
+  /**
+   * \brief Adjusts how often the playlist and participants are polled based on whether
+   * the player is playing and what the user can see.
+   */
+  void updatePollingPolicy();
+
+  /**
+   * \brief Gets the shortest interval between active playlist polls.
+   *
+   * @return The shortest interval between active playlist polls in milliseconds.
+   */
+  static const int& getMinPlaylistPollInterval(){
+    static const int minPlaylistPollInterval = 2000;
+    return minPlaylistPollInterval;
+  }
+
+  /**
+   * \brief Gets the longest interval between active playlist polls while the player is
+   * playing and the user can see it.
+   *
+   * @return The longest interval between active playlist polls in milliseconds.
+   */
+  static const int& getMaxPlaylistPollInterval(){
+    static const int maxPlaylistPollInterval = 20000;
+    return maxPlaylistPollInterval;
+  }
+
+  /**
+   * \brief Gets the longest interval between active playlist polls while the player is
+   * either paused or minimized.
+   *
+   * @return The longest interval between idle active playlist polls in milliseconds.
+   */
+  static const int& getIdlePlaylistPollInterval(){
+    static const int idlePlaylistPollInterval = 60000;
+    return idlePlaylistPollInterval;
+  }
+
+  /**
+   * \brief Gets the longest interval between active playlist polls while the player is
+   * both paused and minimized.
+   *
+   * @return The longest interval between dormant active playlist polls in milliseconds.
+   */
+  static const int& getDormantPlaylistPollInterval(){
+    static const int dormantPlaylistPollInterval = 300000;
+    return dormantPlaylistPollInterval;
+  }
+
+  /**
+   * \brief Gets the shortest interval between participant list polls.
+   *
+   * @return The shortest interval between participant list polls in milliseconds.
+   */
+  static const int& getMinParticipantPollInterval(){
+    static const int minParticipantPollInterval = 5000;
+    return minParticipantPollInterval;
+  }
+
+  /**
+   * \brief Gets the longest interval between participant list polls.
+   *
+   * @return The longest interval between participant list polls in milliseconds.
+   */
+  static const int& getMaxParticipantPollInterval(){
+    static const int maxParticipantPollInterval = 60000;
+    return maxParticipantPollInterval;
+  }
+
+  /**
+   * \brief Loads the library fingerprint from the database, building it from the
+   * library table if it has never been built before.
+   */
+  void loadLibraryFingerprint();
+
+  /**
+   * \brief Updates the library fingerprint for songs that were just synced with the server.
+   *
+   * \param syncedSongs The songs that were just synced with the server.
+   */
+  void updateLibraryFingerprint(const QSet<library_song_id_t>& syncedSongs);
+
+  /**
+   * \brief Builds the map describing a library song exactly as it is sent to the server.
+   *
+   * \param record A record from the library table.
+   * \return A map describing the library song as it is sent to the server.
+   */
+  static QVariantMap getSongSyncMap(const QSqlRecord& record);
+
   /**
    * \brief Set player state.
    *
@@ -1230,25 +1525,25 @@ private:
    * \brief Deletes a single song from the active playlist.
    *
    * \param toDelete The library id of the song to delete from the playlist.
+   * \return True if the song was on the playlist, false otherwise.
    */
-  void deleteSongFromPlaylist(library_song_id_t toDelete);
+  bool deleteSongFromPlaylist(library_song_id_t toDelete);
 
   /**
-   * \brief Deletes all the entries in the active playlist table.
-   */
-  void clearActivePlaylist();
-
-  /**
-   * \brief Initiates reauthentication if it hasn't already been initiated.
+   * \brief Reads the active playlist table.
+   *
+   * \return The entries on the active playlist, in priority order.
    */
-  void initReauth();
+  QVector<playlist_entry_t> readActivePlaylistEntries();
 
   /**
-   * \brief Performs the specified ReauthAction.
+   * \brief Brings the active playlist table in line with the given entries, touching
+   * only the rows that differ, all in a single transaction.
    *
-   * @param action The ReauthAction to preform.
+   * @param entries The entries that should be on the playlist, in priority order.
+   * @return What changed.
    */
-  void doReauthAction(const ReauthAction& action);
+  playlist_change_t applyActivePlaylist(const QVector<playlist_entry_t>& entries);
 
   /**
    * \brief Adds a single song to the music library.
@@ -1258,31 +1553,72 @@ private:
    */
   void addSongToLibrary(const Phonon::MediaSource& song, QSqlQuery& addQuery);
 
-  
   /**
-   * \brief Gets the value of a header.
+   * \brief Records a change in the offline journal so it can be sent to the server
+   * once it's reachable again.
    *
-   * @param headerName The name of the desired header.
-   * @param headers The given headers.
-   * @return The value of the header. If the header is not located in the given headers a blank
-   * string is returned.
+   * \param action The kind of change.
+   * \param libId The library id of the song the change is about.
    */
-  static QByteArray getHeaderValue(
-    const QByteArray& headerName, const QList<QNetworkReply::RawHeaderPair>& headers);
+  void journalChange(JournalAction action, library_song_id_t libId);
 
   /**
-   * \brief Determines whether or not an error is a ticket auth error.
-   * 
-   * \param errorCode The given error code from the server.
-   * \param headers The given headers from the server.
-   * \return True if the error is a ticket auth error, false otherwise.
+   * \brief Records a modification of the active playlist in the offline journal and
+   * applies it to the local copy of the playlist, since the server won't be telling us
+   * about it.
+   *
+   * \param toAdd The songs to add to the active playlist.
+   * \param toRemove The songs to remove from the active playlist.
    */
-  static inline bool isTicketAuthError(
-      int errorCode,
-      const QList<QNetworkReply::RawHeaderPair>& headers)
-  {
-    return errorCode==401 && getHeaderValue("WWW-Authenticate", headers) == "ticket-hash";
-  }
+  void journalPlaylistMod(
+    const QSet<library_song_id_t>& toAdd,
+    const QSet<library_song_id_t>& toRemove);
+
+  /**
+   * \brief Applies a modification of the active playlist to the local copy of the
+   * playlist right away, without waiting for the server. Added songs go to the end of
+   * the playlist, just like the server would put them.
+   *
+   * \param toAdd The songs to add to the active playlist.
+   * \param toRemove The songs to remove from the active playlist.
+   */
+  void applyLocalPlaylistMod(
+    const QSet<library_song_id_t>& toAdd,
+    const QSet<library_song_id_t>& toRemove);
+
+  /**
+   * \brief Lays the modifications that are still pending over a playlist from the server,
+   * so songs added or removed locally don't flicker back while the server catches up.
+   *
+   * \param entries The playlist from the server, in priority order.
+   * \return The playlist as it should look locally, in priority order.
+   */
+  QVector<playlist_entry_t> withPendingPlaylistMods(
+    const QVector<playlist_entry_t>& entries) const;
+
+  /**
+   * \brief Sends everything recorded in the offline journal to the server using as few
+   * requests as possible: at most one playlist modification followed by at most one
+   * current song change.
+   */
+  void replayOfflineJournal();
+
+  /**
+   * \brief Removes the entries that were just reconciled with the server from the
+   * offline journal.
+   */
+  void finishReconcile();
+
+  /**
+   * \brief Picks a song from the library to play when the active playlist runs dry
+   * while offline.
+   *
+   * \param query Query to run. On success it is positioned on a record with the file,
+   * song, artist, duration and library id of the picked song, in that order.
+   * \return True if a song was picked, false if the library has nothing to offer.
+   */
+  bool pickFallbackSong(QSqlQuery& query);
+
 
   //@}
 
@@ -1343,6 +1679,162 @@ private:
     return createLibQuery;
   }
 
+  /**
+   * \brief Gets the name of the table storing the hash of each synced library song.
+   *
+   * @return The name of the library fingerprint table.
+   */
+  static const QString& getLibFingerprintTableName(){
+    static const QString libFingerprintTableName = "library_fingerprint";
+    return libFingerprintTableName;
+  }
+
+  /**
+   * \brief Gets the name of the library id column in the library fingerprint table.
+   *
+   * @return The name of the library id column in the library fingerprint table.
+   */
+  static const QString& getLibFingerprintIdColName(){
+    static const QString libFingerprintIdColName = "lib_id";
+    return libFingerprintIdColName;
+  }
+
+  /**
+   * \brief Gets the name of the bucket column in the library fingerprint table.
+   *
+   * @return The name of the bucket column in the library fingerprint table.
+   */
+  static const QString& getLibFingerprintBucketColName(){
+    static const QString libFingerprintBucketColName = "bucket";
+    return libFingerprintBucketColName;
+  }
+
+  /**
+   * \brief Gets the name of the hash column in the library fingerprint table.
+   *
+   * @return The name of the hash column in the library fingerprint table.
+   */
+  static const QString& getLibFingerprintHashColName(){
+    static const QString libFingerprintHashColName = "song_hash";
+    return libFingerprintHashColName;
+  }
+
+  /**
+   * \brief Gets the query used to create the library fingerprint table.
+   *
+   * @return The query used to create the library fingerprint table.
+   */
+  static const QString& getCreateLibFingerprintQuery(){
+    static const QString createLibFingerprintQuery =
+      "CREATE TABLE IF NOT EXISTS " +
+      getLibFingerprintTableName() + "(" +
+      getLibFingerprintIdColName() + " INTEGER PRIMARY KEY, " +
+      getLibFingerprintBucketColName() + " INTEGER NOT NULL, " +
+      getLibFingerprintHashColName() + " INTEGER NOT NULL);";
+    return createLibFingerprintQuery;
+  }
+
+  /**
+   * \brief Gets the query used to switch the database to write ahead logging, which lets
+   * the library searcher read on its own connection without holding up writes on ours.
+   *
+   * @return The query used to switch the database to write ahead logging.
+   */
+  static const QString& getEnableWriteAheadLogQuery(){
+    static const QString enableWriteAheadLogQuery = "PRAGMA journal_mode=WAL;";
+    return enableWriteAheadLogQuery;
+  }
+
+  /**
+   * \brief Gets the query used to index the library fingerprint table by bucket.
+   *
+   * @return The query used to index the library fingerprint table by bucket.
+   */
+  static const QString& getCreateLibFingerprintIndexQuery(){
+    static const QString createLibFingerprintIndexQuery =
+      "CREATE INDEX IF NOT EXISTS " + getLibFingerprintTableName() + "_bucket_idx ON " +
+      getLibFingerprintTableName() + "(" + getLibFingerprintBucketColName() + ");";
+    return createLibFingerprintIndexQuery;
+  }
+
+  /**
+   * \brief Gets the queries used to index the library by each column it can be sorted
+   * by, with the id breaking ties, so any page of the sorted library can be found
+   * directly.
+   *
+   * @return The queries used to index the library for sorting.
+   */
+  static const QStringList& getCreateLibSortIndexQueries(){
+    static QStringList createLibSortIndexQueries;
+    if(createLibSortIndexQueries.isEmpty()){
+      QStringList sortColumns;
+      sortColumns << getLibSongColName() << getLibArtistColName() <<
+        getLibAlbumColName() << getLibDurationColName() << getLibFileColName();
+      Q_FOREACH(const QString& column, sortColumns){
+        createLibSortIndexQueries.append(
+          "CREATE INDEX IF NOT EXISTS " + getLibraryTableName() + "_" + column +
+          "_sort_idx ON " + getLibraryTableName() + "(" + column + ", " +
+          getLibIdColName() + ");");
+      }
+    }
+    return createLibSortIndexQueries;
+  }
+
+  /**
+   * \brief Gets the name of the table journaling changes made while offline.
+   *
+   * @return The name of the offline journal table.
+   */
+  static const QString& getOfflineJournalTableName(){
+    static const QString offlineJournalTableName = "offline_journal";
+    return offlineJournalTableName;
+  }
+
+  /**
+   * \brief Gets the name of the id column in the offline journal table.
+   *
+   * @return The name of the id column in the offline journal table.
+   */
+  static const QString& getOfflineJournalIdColName(){
+    static const QString offlineJournalIdColName = "id";
+    return offlineJournalIdColName;
+  }
+
+  /**
+   * \brief Gets the name of the action column in the offline journal table.
+   *
+   * @return The name of the action column in the offline journal table.
+   */
+  static const QString& getOfflineJournalActionColName(){
+    static const QString offlineJournalActionColName = "action";
+    return offlineJournalActionColName;
+  }
+
+  /**
+   * \brief Gets the name of the library id column in the offline journal table.
+   *
+   * @return The name of the library id column in the offline journal table.
+   */
+  static const QString& getOfflineJournalLibIdColName(){
+    static const QString offlineJournalLibIdColName = "lib_id";
+    return offlineJournalLibIdColName;
+  }
+
+  /**
+   * \brief Gets the query used to create the offline journal table.
+   *
+   * @return The query used to create the offline journal table.
+   */
+  static const QString& getCreateOfflineJournalQuery(){
+    static const QString createOfflineJournalQuery =
+      "CREATE TABLE IF NOT EXISTS " +
+      getOfflineJournalTableName() + "(" +
+      getOfflineJournalIdColName() + " INTEGER PRIMARY KEY AUTOINCREMENT, " +
+      getOfflineJournalActionColName() + " INTEGER NOT NULL, " +
+      getOfflineJournalLibIdColName() + " INTEGER NOT NULL);";
+    return createOfflineJournalQuery;
+  }
+
   /**
    * \brief Gets the query used to create the active playlist table.
    *
@@ -1396,19 +1888,6 @@ private:
     return createActivePlaylistViewQuery;
   }
 
-  /**
-   * \brief Gets the query used to delete all entries in the active playlist
-   * table.
-   *
-   * @return The query used to delete all entries in the active playlist
-   * table.
-   */
-  static const QString& getClearActivePlaylistQuery(){
-    static const QString clearActivePlaylistQuery = 
-      "DELETE FROM " + getActivePlaylistTableName() + ";";
-    return clearActivePlaylistQuery;
-  }
-
   /**
    * \brief Name of the setting used to store the username being used by the client.
    *
@@ -1447,6 +1926,26 @@ private:
 //@{
 private slots:
 
+  /**
+   * \brief Sends a coalesced value request to the server.
+   *
+   * \param request The CoalescedRequest the value is for.
+   * \param value The latest value for the request.
+   */
+  void onCoalescedValueReady(int request, const QVariant& value);
+
+  /**
+   * \brief Sends a coalesced playlist modification to the server.
+   *
+   * \param request The CoalescedRequest the modification is for.
+   * \param toAdd Songs to add to the active playlist.
+   * \param toRemove Songs to remove from the active playlist.
+   */
+  void onCoalescedPlaylistModReady(
+    int request,
+    const QSet<library_song_id_t>& toAdd,
+    const QSet<library_song_id_t>& toRemove);
+
   /**
    * \brief Performs appropriate tasks when the player's state has been succesfully changed on the
    * server.
@@ -1552,21 +2051,12 @@ private slots:
     const lib_sync_status_t syncStatus);
 
 
-  /**
-   * \brief Adds the given song to the active playlist in the database.
-   *
-   * @param songToAdd A QVariantMap representing the song that should be added to the active
-   * playlist in the database.
-   * @param priority The priority of the song to be added.
-   */
-  void addSong2ActivePlaylistFromQVariant(const QVariantMap &songToAdd, int priority);
-
   /**
    * \brief Sets the active playlist to the given playlist.
    *
    * @param newPlaylist The new playlist to be set in the database.
    */
-  void setActivePlaylist(const QVariantMap& playlist);
+  void setActivePlaylist(const playlist_snapshot_t& newPlaylist);
 
   /**
    * \brief Takes appropriate action when retreiving the active playlist fails.
@@ -1580,6 +2070,60 @@ private slots:
     int errorCode,
     const QList<QNetworkReply::RawHeaderPair>& headers);
 
+  /**
+   * \brief Stops or resumes polling depending on whether the server is pushing changes.
+   *
+   * @param connected Whether or not the server is pushing changes.
+   */
+  void onPlayerEventsConnectionChanged(bool connected);
+
+  /**
+   * \brief Retrieves the playlist and participants in full after pushed changes were
+   * missed.
+   */
+  void onPlayerEventsGap();
+
+  /**
+   * \brief Takes appropriate action when listening for pushed changes fails.
+   *
+   * @param errMessage A message describing the error.
+   * @param errorCode The http status code that describes the error.
+   * @param headers The headers from the http response that indicated a failure.
+   */
+  void onPlayerEventsError(
+    const QString& errMessage,
+    int errorCode,
+    const QList<QNetworkReply::RawHeaderPair>& headers);
+
+
+  /**
+   * \brief Compares the server's library fingerprint with our own and asks the server
+   * for the songs in any buckets that differ.
+   *
+   * \param remoteFingerprint The fingerprint retrieved from the server.
+   */
+  void onLibraryFingerprintReceived(const QVariantMap& remoteFingerprint);
+
+  /**
+   * \brief Compares the songs in the differing buckets one by one with the server's and
+   * marks only the ones that actually differ as needing to be synced. The differing
+   * buckets of the fingerprint are rebuilt from the songs that match.
+   *
+   * \param remoteSongs The id and hash of every song the server has in the buckets.
+   */
+  void onLibraryBucketSongsReceived(const QVariantList& remoteSongs);
+
+  /**
+   * \brief Takes appropriate action when retreiving the library fingerprint fails.
+   *
+   * @param errMessage A message describing the error.
+   * @param errorCode The http status code that describes the error.
+   * @param headers The headers from the http response that indicated a failure.
+   */
+  void onGetLibraryFingerprintFail(
+    const QString& errMessage,
+    int errorCode,
+    const QList<QNetworkReply::RawHeaderPair>& headers);
 
   /**
    * \brief Takes the appropriate action when a player is succesfully created.
@@ -1623,12 +2167,34 @@ private slots:
     const QList<QNetworkReply::RawHeaderPair>& headers);
 
   /**
-   * \brief Takes appropriate action when the client succesfully reauthenticates.
+   * \brief Remembers how long tickets have been observed to last so the next run can
+   * refresh them in time as well.
+   *
+   * \param lifetime How long tickets are now expected to last in milliseconds.
+   */
+  void onTicketLifetimeObserved(qint64 lifetime);
+
+  /**
+   * \brief Goes offline when the server can't be reached and reconciles the changes
+   * made while offline once it can be reached again.
    *
-   * \param ticketHash The ticket hash that was recieved from the server.
-   * \param userId The userId that was recieved from the server.
+   * \param reachable Whether or not the server is now reachable.
    */
-  void onReauth(const QByteArray& ticketHash, const user_id_t& userId);
+  void onServerReachabilityChanged(bool reachable);
+
+  /**
+   * \brief Reports how a replay of captured traffic went.
+   *
+   * \param numReplayed The number of replies that were replayed.
+   * \param elapsed How long the replay took in milliseconds.
+   */
+  void onTrafficReplayFinished(int numReplayed, qint64 elapsed);
+
+  /**
+   * \brief Takes appropriate action when the current song is succesfully set on the
+   * server.
+   */
+  void onCurrentSongSet();
 
   /**
    * \brief Takes appropriate action when reauthentication fails.
@@ -1648,7 +2214,8 @@ private slots:
     const QSet<library_song_id_t>& removed);
 
   /**
-   * \brief Takes appropriate action when modifiying the active playlist on the server fails.
+   * \brief Journals a modification of the active playlist that didn't make it to the
+   * server, or that the server failed on, so it's sent again on reconnect.
    *
    * @param errMessage A message describing the error.
    * @param errorCode The http status code that describes the error.
@@ -1659,6 +2226,18 @@ private slots:
     int errorCode,
     const QList<QNetworkReply::RawHeaderPair>& headers);
 
+  /**
+   * \brief Undoes a modification of the active playlist the server refused.
+   *
+   * @param added The songs that were supposed to be added to the active playlist.
+   * @param removed The songs that were supposed to be removed from the active playlist.
+   * @param errMessage A message describing the error.
+   */
+  void onActivePlaylistModRejected(
+    const QSet<library_song_id_t>& added,
+    const QSet<library_song_id_t>& removed,
+    const QString& errMessage);
+
   /**
    * \brief Takes appropriate action when setting the volume fails.
    *
@@ -0,0 +1,157 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "DiagnosticsView.hpp"
+#include "NetworkMetrics.hpp"
+#include "NetworkAccess.hpp"
+#include "Logger.hpp"
+#include <QTableWidget>
+#include <QHeaderView>
+#include <QLabel>
+#include <QPushButton>
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QFileDialog>
+#include <QMessageBox>
+#include <QFile>
+#include <QTimer>
+
+namespace UDJ{
+
+DiagnosticsView::DiagnosticsView(QWidget *parent):
+  QWidget(parent)
+{
+  setWindowTitle(tr("Network Diagnostics"));
+  setAttribute(Qt::WA_DeleteOnClose);
+
+  metricsTable = new QTableWidget(this);
+  metricsTable->setColumnCount(13);
+  metricsTable->setHorizontalHeaderLabels(QStringList()
+    << tr("Endpoint") << tr("Requests") << tr("Retries") << tr("Status Codes")
+    << tr("Sent") << tr("Received") << tr("Queued p95")
+    << tr("Latency p50") << tr("Latency p95") << tr("Latency p99")
+    << tr("Processing p50") << tr("Processing p95") << tr("Parsing p95"));
+  metricsTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+  metricsTable->setSelectionBehavior(QAbstractItemView::SelectRows);
+  metricsTable->verticalHeader()->hide();
+
+  connectionLabel = new QLabel(this);
+
+  QPushButton *exportButton = new QPushButton(tr("Export JSON..."), this);
+  QPushButton *resetButton = new QPushButton(tr("Reset"), this);
+  QHBoxLayout *buttonLayout = new QHBoxLayout();
+  buttonLayout->addWidget(connectionLabel);
+  buttonLayout->addStretch();
+  buttonLayout->addWidget(resetButton);
+  buttonLayout->addWidget(exportButton);
+
+  QVBoxLayout *mainLayout = new QVBoxLayout();
+  mainLayout->addWidget(metricsTable);
+  mainLayout->addLayout(buttonLayout);
+  setLayout(mainLayout);
+  resize(900, 300);
+
+  refreshTimer = new QTimer(this);
+  refreshTimer->setSingleShot(true);
+  connect(refreshTimer, SIGNAL(timeout()), this, SLOT(refresh()));
+  connect(exportButton, SIGNAL(clicked()), this, SLOT(exportJSON()));
+  connect(resetButton, SIGNAL(clicked()), this, SLOT(resetMetrics()));
+  connect(
+    NetworkMetrics::instance(),
+    SIGNAL(metricsChanged()),
+    this,
+    SLOT(scheduleRefresh()));
+  refresh();
+}
+
+void DiagnosticsView::scheduleRefresh(){
+  if(!refreshTimer->isActive()){
+    refreshTimer->start(getRefreshInterval());
+  }
+}
+
+void DiagnosticsView::refresh(){
+  NetworkMetrics *networkMetrics = NetworkMetrics::instance();
+  QStringList endpoints = networkMetrics->getEndpoints();
+  metricsTable->setRowCount(endpoints.size());
+  for(int row=0; row<endpoints.size(); ++row){
+    const QString& endpoint = endpoints[row];
+    NetworkMetrics::endpoint_metrics_t endpointMetrics = networkMetrics->getMetrics(endpoint);
+    QStringList statuses;
+    QMap<int, qint64>::const_iterator it = endpointMetrics.statusCounts.constBegin();
+    for(; it != endpointMetrics.statusCounts.constEnd(); ++it){
+      QString status = it.key() == 0 ? tr("none") : QString::number(it.key());
+      statuses << status + ": " + QString::number(it.value());
+    }
+    QStringList cells;
+    cells << endpoint
+      << QString::number(endpointMetrics.requests)
+      << QString::number(endpointMetrics.retries)
+      << statuses.join(", ")
+      << QString::number(endpointMetrics.bytesSent)
+      << QString::number(endpointMetrics.bytesReceived)
+      << formatTiming(networkMetrics->getPercentile(endpoint, NetworkMetrics::QUEUE_TIMING, 95))
+      << formatTiming(networkMetrics->getPercentile(endpoint, NetworkMetrics::LATENCY_TIMING, 50))
+      << formatTiming(networkMetrics->getPercentile(endpoint, NetworkMetrics::LATENCY_TIMING, 95))
+      << formatTiming(networkMetrics->getPercentile(endpoint, NetworkMetrics::LATENCY_TIMING, 99))
+      << formatTiming(networkMetrics->getPercentile(endpoint, NetworkMetrics::PROCESSING_TIMING, 50))
+      << formatTiming(networkMetrics->getPercentile(endpoint, NetworkMetrics::PROCESSING_TIMING, 95))
+      << formatTiming(networkMetrics->getPercentile(endpoint, NetworkMetrics::PARSING_TIMING, 95));
+    for(int column=0; column<cells.size(); ++column){
+      metricsTable->setItem(row, column, new QTableWidgetItem(cells[column]));
+    }
+  }
+  metricsTable->resizeColumnsToContents();
+  qint64 connectionSetup = NetworkAccess::instance()->getConnectionSetupTime();
+  connectionLabel->setText(tr("Connection setup: ") +
+    formatTiming(connectionSetup < 0 ? connectionSetup : connectionSetup*1000));
+}
+
+void DiagnosticsView::exportJSON(){
+  QString fileName = QFileDialog::getSaveFileName(this, tr("Export Network Diagnostics"),
+    "udj-network-diagnostics.json", tr("JSON (*.json)"));
+  if(fileName.isEmpty()){
+    return;
+  }
+  QFile exportFile(fileName);
+  if(!exportFile.open(QIODevice::WriteOnly) ||
+    exportFile.write(NetworkMetrics::instance()->toJSON()) == -1)
+  {
+    Logger::instance()->log("Exporting network diagnostics failed: " + exportFile.errorString());
+    QMessageBox::critical(this, tr("Export Failed"),
+      tr("We couldn't save the diagnostics to that file."));
+  }
+}
+
+void DiagnosticsView::resetMetrics(){
+  NetworkMetrics::instance()->reset();
+}
+
+QString DiagnosticsView::formatTiming(qint64 microseconds){
+  if(microseconds < 0){
+    return "-";
+  }
+  //Fractions only matter for the short timings, parsing mostly.
+  if(microseconds < 10000){
+    return QString::number(microseconds/1000.0, 'f', 2) + " ms";
+  }
+  return QString::number(microseconds/1000) + " ms";
+}
+
+
+} //end namespace UDJ
@@ -0,0 +1,108 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DIAGNOSTICS_VIEW_HPP
+#define DIAGNOSTICS_VIEW_HPP
+#include <QWidget>
+
+class QTableWidget;
+class QLabel;
+class QTimer;
+
+namespace UDJ{
+
+
+/**
+ * \brief Shows how the traffic to the server has been performing, endpoint by endpoint,
+ * and lets the numbers be exported as JSON.
+ */
+class DiagnosticsView : public QWidget{
+Q_OBJECT
+public:
+  /** @name Constructor(s) */
+  //@{
+
+  /**
+   * \brief Constructs a DiagnosticsView.
+   *
+   * \param parent The parent widget.
+   */
+  DiagnosticsView(QWidget *parent=0);
+
+  //@}
+
+private slots:
+  /** @name Private Slots */
+  //@{
+
+  /** \brief Refreshes the table, at most a couple of times a second. */
+  void scheduleRefresh();
+
+  /** \brief Fills the table with the latest metrics. */
+  void refresh();
+
+  /** \brief Asks the user where to save the metrics and saves them there as JSON. */
+  void exportJSON();
+
+  /** \brief Forgets all the metrics recorded so far. */
+  void resetMetrics();
+
+  //@}
+
+private:
+  /** @name Private Members */
+  //@{
+
+  /** \brief Table showing a row of metrics for each endpoint. */
+  QTableWidget *metricsTable;
+
+  /** \brief Label showing how long setting up the connection to the server took. */
+  QLabel *connectionLabel;
+
+  /** \brief Timer used to limit how often the table is refreshed. */
+  QTimer *refreshTimer;
+
+  //@}
+
+  /** @name Private Functions */
+  //@{
+
+  /**
+   * \brief Formats a timing for display.
+   *
+   * \param microseconds The timing in microseconds, or -1 if there is none.
+   * \return The formatted timing.
+   */
+  static QString formatTiming(qint64 microseconds);
+
+  /**
+   * \brief Gets the interval between refreshes of the table.
+   *
+   * @return The interval between refreshes of the table in milliseconds.
+   */
+  static const int& getRefreshInterval(){
+    static const int refreshInterval = 500;
+    return refreshInterval;
+  }
+
+  //@}
+};
+
+
+} //end namespace UDJ
+#endif //DIAGNOSTICS_VIEW_HPP
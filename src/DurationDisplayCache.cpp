@@ -0,0 +1,46 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "DurationDisplayCache.hpp"
+
+namespace UDJ{
+
+
+QString DurationDisplayCache::getDisplay(int duration){
+  QHash<int, QString>::const_iterator cached = displays.constFind(duration);
+  if(cached != displays.constEnd()){
+    return cached.value();
+  }
+  QString display = format(duration);
+  if(displays.size() >= getMaxCachedDisplays()){
+    displays.clear();
+  }
+  displays.insert(duration, display);
+  return display;
+}
+
+QString DurationDisplayCache::format(int duration){
+  int seconds = duration % 60;
+  int minutes = duration / 60;
+  QString secondsString = seconds < 10 ? "0" + QString::number(seconds) :
+    QString::number(seconds);
+  return QString::number(minutes) + ":" + secondsString;
+}
+
+
+} //end namespace UDJ
@@ -0,0 +1,102 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef DURATION_DISPLAY_CACHE_HPP
+#define DURATION_DISPLAY_CACHE_HPP
+#include <QHash>
+#include <QString>
+
+namespace UDJ{
+
+
+/**
+ * \brief Formats song durations for display, formatting each duration only the first
+ * time it's asked for so painting a cell doesn't have to format anything.
+ *
+ * Only a bounded number of durations are remembered; once that many have been formatted
+ * the cache starts over.
+ */
+class DurationDisplayCache{
+public:
+
+  /** @name Accessors */
+  //@{
+
+  /**
+   * \brief Gets a duration formatted for display.
+   *
+   * \param duration The duration in seconds.
+   * \return The duration as m:ss.
+   */
+  QString getDisplay(int duration);
+
+  //@}
+
+  /** @name Modifiers */
+  //@{
+
+  /** \brief Forgets every duration formatted so far. */
+  inline void clear(){
+    displays.clear();
+  }
+
+  //@}
+
+  /** @name Static Functions */
+  //@{
+
+  /**
+   * \brief Formats a duration for display.
+   *
+   * \param duration The duration in seconds.
+   * \return The duration as m:ss.
+   */
+  static QString format(int duration);
+
+  //@}
+
+private:
+
+  /** @name Private Members */
+  //@{
+
+  /** \brief Durations formatted for display, by duration. */
+  QHash<int, QString> displays;
+
+  //@}
+
+  /** @name Private Functions */
+  //@{
+
+  /**
+   * \brief Gets the most formatted durations that are kept at once.
+   *
+   * @return The most formatted durations that are kept at once.
+   */
+  static const int& getMaxCachedDisplays(){
+    static const int maxCachedDisplays = 4096;
+    return maxCachedDisplays;
+  }
+
+  //@}
+
+};
+
+
+} //end namespace UDJ
+#endif //DURATION_DISPLAY_CACHE_HPP
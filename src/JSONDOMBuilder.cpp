@@ -0,0 +1,99 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "JSONDOMBuilder.hpp"
+
+namespace UDJ{
+
+
+JSONDOMBuilder::JSONDOMBuilder(){}
+
+void JSONDOMBuilder::reset(){
+  frames.clear();
+  result = QVariant();
+}
+
+void JSONDOMBuilder::startObject(){
+  frame_t frame;
+  frame.isObject = true;
+  frames.append(frame);
+}
+
+void JSONDOMBuilder::endObject(){
+  QVariant object(frames.last().object);
+  frames.removeLast();
+  addValue(object);
+}
+
+void JSONDOMBuilder::startArray(){
+  frame_t frame;
+  frame.isObject = false;
+  frames.append(frame);
+}
+
+void JSONDOMBuilder::endArray(){
+  QVariant array(frames.last().array);
+  frames.removeLast();
+  addValue(array);
+}
+
+void JSONDOMBuilder::key(const QString& name){
+  frames.last().key = name;
+}
+
+void JSONDOMBuilder::stringValue(const QString& value){
+  addValue(value);
+}
+
+void JSONDOMBuilder::numberValue(const QByteArray& number){
+  //Same types QtJson::Json::parse would have produced.
+  if(number.contains('.') || number.contains('e') || number.contains('E')){
+    addValue(number.toDouble());
+  }
+  else if(number.startsWith('-')){
+    addValue(number.toLongLong());
+  }
+  else{
+    addValue(number.toULongLong());
+  }
+}
+
+void JSONDOMBuilder::boolValue(bool value){
+  addValue(value);
+}
+
+void JSONDOMBuilder::nullValue(){
+  addValue(QVariant());
+}
+
+void JSONDOMBuilder::addValue(const QVariant& value){
+  if(frames.isEmpty()){
+    result = value;
+    return;
+  }
+  frame_t& frame = frames.last();
+  if(frame.isObject){
+    frame.object.insert(frame.key, value);
+  }
+  else{
+    frame.array.append(value);
+  }
+}
+
+
+} //end namespace UDJ
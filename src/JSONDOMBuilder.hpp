@@ -0,0 +1,130 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef JSON_DOM_BUILDER_HPP
+#define JSON_DOM_BUILDER_HPP
+#include "JSONStreamParser.hpp"
+#include <QVariantMap>
+#include <QVariantList>
+#include <QList>
+
+namespace UDJ{
+
+
+/**
+ * \brief Builds the parsed document as nested QVariantMaps and QVariantLists, exactly like
+ * QtJson::Json::parse does, for code that wants the whole document at once.
+ *
+ * Every container is built in place and handed to its parent only once it's complete,
+ * so nothing is copied on the way.
+ */
+class JSONDOMBuilder : public JSONStreamParser::Handler{
+public:
+
+  /** @name Constructors */
+  //@{
+
+  /** \brief Constructs a JSONDOMBuilder. */
+  JSONDOMBuilder();
+
+  //@}
+
+  /** @name Accessors */
+  //@{
+
+  /**
+   * \brief Gets the document that was built.
+   *
+   * \return The document, or an invalid QVariant if none has been completed.
+   */
+  inline const QVariant& getResult() const{
+    return result;
+  }
+
+  //@}
+
+  /** @name Modifiers */
+  //@{
+
+  /** \brief Forgets everything built so far. */
+  void reset();
+
+  //@}
+
+  /** @name Overridden from JSONStreamParser::Handler */
+  //@{
+
+  virtual void startObject();
+  virtual void endObject();
+  virtual void startArray();
+  virtual void endArray();
+  virtual void key(const QString& name);
+  virtual void stringValue(const QString& value);
+  virtual void numberValue(const QByteArray& number);
+  virtual void boolValue(bool value);
+  virtual void nullValue();
+
+  //@}
+
+private:
+
+  /** @name Private Types */
+  //@{
+
+  /**
+   * \brief A container that's still being built.
+   */
+  typedef struct {
+    bool isObject;
+    QVariantMap object;
+    QVariantList array;
+    /** \brief Name of the member whose value comes next. */
+    QString key;
+  } frame_t;
+
+  //@}
+
+  /** @name Private Members */
+  //@{
+
+  /** \brief Containers still being built, innermost last. */
+  QList<frame_t> frames;
+
+  /** \brief The completed document. */
+  QVariant result;
+
+  //@}
+
+  /** @name Private Functions */
+  //@{
+
+  /**
+   * \brief Adds a complete value to the innermost container, or makes it the result if
+   * there is none.
+   *
+   * \param value The value.
+   */
+  void addValue(const QVariant& value);
+
+  //@}
+
+};
+
+
+} //end namespace UDJ
+#endif //JSON_DOM_BUILDER_HPP
@@ -18,9 +18,11 @@
  */
 #include <QNetworkReply>
 #include "JSONHelper.hpp"
+#include "JSONReplyReader.hpp"
+#include "PlaylistDecoder.hpp"
+#include "Logger.hpp"
 #include "qt-json/json.h"
 #include <QSet>
-#include <iostream>
 
 namespace UDJ{
 
@@ -43,36 +45,30 @@ QByteArray JSONHelper::getJSONForLibDelete(const QVariantList& songsToDelete, bo
 }
 
 QSet<library_song_id_t> JSONHelper::getLibIds(const QByteArray& payload){
-  QString responseString = QString::fromUtf8(payload);
   bool success;
-  QVariantList songs = 
-    QtJson::Json::parse(responseString, success).toList();
+  QVariantList songs = parse(payload, success).toList();
   if(!success){
-    std::cerr << "Error parsing json from a response to an add library entry" <<
-     "request" << std::endl <<
-      responseString.toStdString() << std::endl;
+    Logger::instance()->log("Error parsing json from a response to an add library entry "
+      "request: " + QString::fromUtf8(payload));
   }
 
   QSet<library_song_id_t> toReturn;
-  Q_FOREACH(QVariant song, songs){
+  Q_FOREACH(const QVariant& song, songs){
     toReturn.insert(song.toMap()["id"].value<library_song_id_t>());
   }
   return toReturn;
 }
 
 QSet<library_song_id_t> JSONHelper::convertLibIdArray(const QByteArray& payload){
-  QString responseString = QString::fromUtf8(payload);
   bool success;
-  QVariantList ids = 
-    QtJson::Json::parse(responseString, success).toList();
+  QVariantList ids = parse(payload, success).toList();
   if(!success){
-    std::cerr << "Error parsing json from a response to an delete library entry" <<
-     "request" << std::endl <<
-      responseString.toStdString() << std::endl;
+    Logger::instance()->log("Error parsing json from a response to an delete library entry "
+      "request: " + QString::fromUtf8(payload));
   }
 
   QSet<library_song_id_t> toReturn;
-  Q_FOREACH(QVariant id, ids){
+  Q_FOREACH(const QVariant& id, ids){
     toReturn.insert(id.value<library_song_id_t>());
   }
   return toReturn;
@@ -139,48 +135,76 @@ const QByteArray JSONHelper::getCreatePlayerJSON(
 
 
 player_id_t JSONHelper::getPlayerId(QNetworkReply *reply){
-  QByteArray responseData = reply->readAll();
-  QString responseString = QString::fromUtf8(responseData);
   bool success;
-  QVariantMap playerCreated = 
-    QtJson::Json::parse(responseString, success).toMap();
+  QVariantMap playerCreated = parseReply(reply, success).toMap();
   if(!success){
-    std::cerr << "Error parsing json from a response to an player creation" <<
-     "request" << std::endl <<
-      responseString.toStdString() << std::endl;
+    Logger::instance()->log("Error parsing json from a response to an player creation request");
   }
 
   return playerCreated["id"].value<player_id_t>();
 }
 
-QVariantMap JSONHelper::getActivePlaylistFromJSON(QNetworkReply *reply){
-  QByteArray responseData = reply->readAll();
-  QString responseString = QString::fromUtf8(responseData);
+bool JSONHelper::getActivePlaylistFromJSON(QNetworkReply *reply, playlist_snapshot_t& snapshot){
+  JSONReplyReader *reader = JSONReplyReader::findReader(reply);
+  if(reader == NULL){
+    reader = new JSONReplyReader(reply, false, new PlaylistDecoder());
+  }
+  if(!reader->finish()){
+    Logger::instance()->log("Error parsing json from a response to an acitve Playlist request" +
+      (reader->getError().isEmpty() ? QString() : ": " + reader->getError()));
+    return false;
+  }
+  PlaylistDecoder *decoder = dynamic_cast<PlaylistDecoder*>(reader->getHandler());
+  if(decoder != NULL){
+    decoder->takeSnapshot(snapshot);
+  }
+  else{
+    PlaylistDecoder::decodeVariant(reader->getResult(), snapshot);
+  }
+  return true;
+}
+
+QVariantMap JSONHelper::getLibraryFingerprintFromJSON(QNetworkReply *reply){
   bool success;
-  QVariantMap activePlaylist = 
-    QtJson::Json::parse(responseString, success).toMap();
+  QVariantMap fingerprint = parseReply(reply, success).toMap();
   if(!success){
-    std::cerr << "Error parsing json from a response to an acitve Playlist request" <<
-     "request" << std::endl <<
-      responseString.toStdString() << std::endl;
+    Logger::instance()->log(
+      "Error parsing json from a response to a library fingerprint request");
   }
-  return activePlaylist;
+  return fingerprint;
+}
+
+QVariantList JSONHelper::getLibraryBucketSongsFromJSON(
+  QNetworkReply *reply,
+  bool& success)
+{
+  QVariantList songs = parseReply(reply, success).toList();
+  if(!success){
+    Logger::instance()->log(
+      "Error parsing json from a response to a library bucket songs request");
+  }
+  return songs;
 }
 
 QVariantList JSONHelper::getParticipantListFromJSON(QNetworkReply *reply){
-  QByteArray responseData = reply->readAll();
-  QString responseString = QString::fromUtf8(responseData);
   bool success;
-  QVariantList participantsList = 
-    QtJson::Json::parse(responseString, success).toList();
+  QVariantList participantsList = parseReply(reply, success).toList();
   if(!success){
-    std::cerr << "Error parsing json from a response to an get Participants List request" <<
-     std::endl <<
-      responseString.toStdString() << std::endl;
+    Logger::instance()->log(
+      "Error parsing json from a response to an get Participants List request");
   }
   return participantsList;
 }
 
+QVariantMap JSONHelper::getPlayerEventsFromJSON(QNetworkReply *reply){
+  bool success;
+  QVariantMap events = parseReply(reply, success).toMap();
+  if(!success){
+    Logger::instance()->log("Error parsing json from a response to a player events request");
+  }
+  return events;
+}
+
 QByteArray JSONHelper::getJSONLibIds(const QSet<library_song_id_t>& libIds){
   bool success;
   QVariantList idList;
@@ -192,9 +216,9 @@ QByteArray JSONHelper::getJSONLibIds(const QSet<library_song_id_t>& libIds){
 
 QSet<library_song_id_t> JSONHelper::extractSongLibIds(const QByteArray& idsString){
   bool success;
-  QVariantList libIds = QtJson::Json::parse(idsString, success).toList();
+  QVariantList libIds = parse(idsString, success).toList();
   QSet<library_song_id_t> toReturn;
-  Q_FOREACH(QVariant libId, libIds){
+  Q_FOREACH(const QVariant& libId, libIds){
     toReturn.insert(libId.value<library_song_id_t>());
   }
   return toReturn;
@@ -202,11 +226,27 @@ QSet<library_song_id_t> JSONHelper::extractSongLibIds(const QByteArray& idsStrin
 
 
 const QVariantMap JSONHelper::getAuthReplyFromJSON(QNetworkReply *reply, bool &success){
-  QByteArray responseData = reply->readAll();
-  QString responseString = QString::fromUtf8(responseData);
-  QVariantMap authReply =
-    QtJson::Json::parse(responseString, success).toMap();
-  return authReply;
+  return parseReply(reply, success).toMap();
+}
+
+QVariant JSONHelper::parse(const QByteArray& json, bool &success){
+  JSONDOMBuilder builder;
+  JSONStreamParser parser(&builder);
+  parser.feed(json);
+  success = parser.finish();
+  if(!success){
+    Logger::instance()->log("Malformed JSON: " + parser.getError());
+  }
+  return builder.getResult();
+}
+
+QVariant JSONHelper::parseReply(QNetworkReply *reply, bool &success){
+  JSONReplyReader *reader = JSONReplyReader::forReply(reply);
+  success = reader->finish();
+  if(!reader->getError().isEmpty()){
+    Logger::instance()->log("Malformed JSON in reply: " + reader->getError());
+  }
+  return reader->getResult();
 }
 
 } //end namespace UDJ
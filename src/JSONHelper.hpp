@@ -19,6 +19,7 @@
 #ifndef JSON_HELPER_HPP
 #define JSON_HELPER_HPP
 #include "ConfigDefs.hpp"
+#include "PlaylistSnapshot.hpp"
 #include <vector>
 #include <QVariantList>
 
@@ -182,10 +183,34 @@ public:
   /**
    * \brief Gets the active playlist from the JSON given in the server reply.
    *
+   * If the reply was being decoded by a PlaylistDecoder as it arrived, the snapshot it
+   * built is handed over as is.
+   *
+   * \param reply The reply from the server.
+   * \param snapshot Set to the playlist given in the server reply.
+   * \return True if the reply could be parsed, false otherwise, in which case the
+   * snapshot is left alone.
+   */
+  static bool getActivePlaylistFromJSON(QNetworkReply *reply, playlist_snapshot_t& snapshot);
+
+  /**
+   * \brief Gets the library fingerprint from the JSON given in the server reply.
+   *
    * \param reply The reply from the server.
-   * \return A QVariantMap representing the playlist given in the server reply.
+   * \return A QVariantMap containing the root digest and the list of bucket digests.
    */
-  static QVariantMap getActivePlaylistFromJSON(QNetworkReply *reply);
+  static QVariantMap getLibraryFingerprintFromJSON(QNetworkReply *reply);
+
+  /**
+   * \brief Gets the songs the server has in some library fingerprint buckets from the
+   * JSON given in the server reply.
+   *
+   * \param reply The reply from the server.
+   * \param success Set to whether or not the reply could be parsed. A reply that
+   * couldn't be parsed mustn't be mistaken for the server having none of the songs.
+   * \return A QVariantList of maps, each with the "id" and "hash" of a song.
+   */
+  static QVariantList getLibraryBucketSongsFromJSON(QNetworkReply *reply, bool& success);
 
   /**
    * \brief Gets the list of participants from the JSON given in the server reply.
@@ -195,6 +220,14 @@ public:
    */
   static QVariantList getParticipantListFromJSON(QNetworkReply *reply);
 
+  /**
+   * \brief Gets a batch of pushed player events from the JSON given in the server reply.
+   *
+   * \param reply The reply from the server.
+   * \return A QVariantMap containing the list of events and the id of the last event.
+   */
+  static QVariantMap getPlayerEventsFromJSON(QNetworkReply *reply);
+
   /**
    * \brief Gets the auth data from a server authentication reply.
    *
@@ -207,6 +240,32 @@ public:
 
   //@}
 
+private:
+
+  /** @name Private Functions */
+  //@{
+
+  /**
+   * \brief Parses a complete JSON document.
+   *
+   * \param json The document.
+   * \param success Set to whether or not the document was well formed.
+   * \return The parsed document.
+   */
+  static QVariant parse(const QByteArray& json, bool &success);
+
+  /**
+   * \brief Gets the JSON document in the body of a reply. If the reply was being parsed as
+   * it arrived only what's left of the body still needs parsing.
+   *
+   * \param reply The reply, which must have finished.
+   * \param success Set to whether or not the body was a well formed document.
+   * \return The parsed document.
+   */
+  static QVariant parseReply(QNetworkReply *reply, bool &success);
+
+  //@}
+
 };
 
 
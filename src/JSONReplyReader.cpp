@@ -0,0 +1,117 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "JSONReplyReader.hpp"
+#include <QNetworkReply>
+#include <QElapsedTimer>
+
+namespace UDJ{
+
+
+JSONReplyReader::JSONReplyReader(
+  QNetworkReply *reply,
+  bool retainsBody,
+  JSONStreamParser::Handler *handler):
+  QObject(reply),
+  reply(reply),
+  handler(handler != NULL ? handler : &builder),
+  parser(this->handler),
+  digest(QCryptographicHash::Sha1),
+  retainsBody(retainsBody),
+  bytesRead(0),
+  parseTime(0),
+  hasCheckedStatus(false),
+  isReading(true),
+  isFinished(false),
+  succeeded(false)
+{
+  readBuffer.resize(getReadChunkSize());
+  connect(reply, SIGNAL(readyRead()), this, SLOT(readAvailable()));
+}
+
+JSONReplyReader::~JSONReplyReader(){
+  if(handler != &builder){
+    delete handler;
+  }
+}
+
+JSONReplyReader* JSONReplyReader::findReader(QNetworkReply *reply){
+  return reply->findChild<JSONReplyReader*>();
+}
+
+JSONReplyReader* JSONReplyReader::forReply(QNetworkReply *reply){
+  JSONReplyReader *reader = findReader(reply);
+  if(reader == NULL){
+    reader = new JSONReplyReader(reply);
+  }
+  return reader;
+}
+
+bool JSONReplyReader::finish(){
+  if(!isFinished){
+    readAvailable();
+    isFinished = true;
+    QElapsedTimer parseTimer;
+    parseTimer.start();
+    succeeded = isReading && parser.finish();
+    parseTime += getElapsedMicroseconds(parseTimer);
+  }
+  return succeeded;
+}
+
+void JSONReplyReader::readAvailable(){
+  if(!isReading || isFinished){
+    return;
+  }
+  if(!hasCheckedStatus){
+    hasCheckedStatus = true;
+    int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if(status < 200 || status >= 300){
+      isReading = false;
+      disconnect(reply, SIGNAL(readyRead()), this, SLOT(readAvailable()));
+      return;
+    }
+  }
+  qint64 chunkSize;
+  while((chunkSize = reply->read(readBuffer.data(), readBuffer.size())) > 0){
+    bytesRead += chunkSize;
+    digest.addData(readBuffer.constData(), chunkSize);
+    if(retainsBody){
+      retainedBody.append(readBuffer.constData(), chunkSize);
+    }
+    //Keep reading after a parse error so the digest still covers the whole body.
+    if(!parser.hasFailed()){
+      QElapsedTimer parseTimer;
+      parseTimer.start();
+      parser.feed(readBuffer.constData(), chunkSize);
+      parseTime += getElapsedMicroseconds(parseTimer);
+    }
+  }
+}
+
+qint64 JSONReplyReader::getElapsedMicroseconds(const QElapsedTimer& timer){
+  //A single chunk usually parses in well under a millisecond.
+#if QT_VERSION >= 0x040800
+  return timer.nsecsElapsed()/1000;
+#else
+  return timer.elapsed()*1000;
+#endif
+}
+
+
+} //end namespace UDJ
@@ -0,0 +1,264 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef JSON_REPLY_READER_HPP
+#define JSON_REPLY_READER_HPP
+#include "JSONStreamParser.hpp"
+#include "JSONDOMBuilder.hpp"
+#include <QObject>
+#include <QCryptographicHash>
+
+class QNetworkReply;
+class QElapsedTimer;
+
+namespace UDJ{
+
+
+/**
+ * \brief Parses the JSON body of a reply while it's still arriving.
+ *
+ * The reader attaches itself to a reply as a child and feeds every chunk to a
+ * JSONStreamParser the moment it's received, so by the time the reply finishes its
+ * document is already built. It also keeps a digest of the body so unchanged bodies can
+ * be recognized without holding on to them.
+ *
+ * Only successful (2xx) replies are read. Anything else is left untouched for its
+ * handler to read as usual.
+ */
+class JSONReplyReader : public QObject{
+Q_OBJECT
+public:
+
+  /** @name Constructors */
+  //@{
+
+  /**
+   * \brief Constructs a JSONReplyReader and attaches it to a reply.
+   *
+   * \param reply The reply to read.
+   * \param retainsBody Whether or not to keep a copy of the raw body.
+   * \param handler The handler the body is parsed into, which the reader takes ownership
+   * of. If NULL the body is built into a QVariant document available from getResult.
+   */
+  JSONReplyReader(
+    QNetworkReply *reply,
+    bool retainsBody=false,
+    JSONStreamParser::Handler *handler=NULL);
+
+  //@}
+
+  /** @name Destructor */
+  //@{
+
+  /** \brief Deconstructs a JSONReplyReader. */
+  ~JSONReplyReader();
+
+  //@}
+
+  /** @name Static Functions */
+  //@{
+
+  /**
+   * \brief Finds the reader attached to a reply.
+   *
+   * \param reply The reply in question.
+   * \return The reader attached to the reply, or NULL if there is none.
+   */
+  static JSONReplyReader* findReader(QNetworkReply *reply);
+
+  /**
+   * \brief Finds the reader attached to a reply, attaching one if there is none yet.
+   *
+   * \param reply The reply in question.
+   * \return The reader attached to the reply.
+   */
+  static JSONReplyReader* forReply(QNetworkReply *reply);
+
+  //@}
+
+  /** @name Modifiers */
+  //@{
+
+  /**
+   * \brief Reads whatever is left of the body and completes the document.
+   *
+   * Only call this once the reply has finished. Calling it again does nothing more.
+   *
+   * \return True if the body was a complete, well formed document, false otherwise.
+   */
+  bool finish();
+
+  //@}
+
+  /** @name Accessors */
+  //@{
+
+  /**
+   * \brief Gets the parsed document.
+   *
+   * \return The parsed document, or an invalid QVariant if there is none or the body
+   * was parsed into a handler of its own.
+   */
+  inline const QVariant& getResult() const{
+    return builder.getResult();
+  }
+
+  /**
+   * \brief Gets the handler the body is parsed into.
+   *
+   * \return The handler the body is parsed into.
+   */
+  inline JSONStreamParser::Handler* getHandler() const{
+    return handler;
+  }
+
+  /**
+   * \brief Gets what was wrong with the body, if anything.
+   *
+   * \return A description of the problem, empty if there is none.
+   */
+  inline const QString& getError() const{
+    return parser.getError();
+  }
+
+  /**
+   * \brief Gets the SHA1 digest of the body read so far.
+   *
+   * \return The SHA1 digest of the body read so far.
+   */
+  inline QByteArray getDigest() const{
+    return digest.result();
+  }
+
+  /**
+   * \brief Gets how much of the body has been read.
+   *
+   * \return How much of the body has been read in bytes.
+   */
+  inline qint64 getBytesRead() const{
+    return bytesRead;
+  }
+
+  /**
+   * \brief Gets how long has been spent parsing the body, not counting the time spent
+   * waiting for it to arrive.
+   *
+   * \return How long has been spent parsing the body in microseconds.
+   */
+  inline qint64 getParseTime() const{
+    return parseTime;
+  }
+
+  /**
+   * \brief Gets the raw body read so far.
+   *
+   * \return The raw body read so far, empty unless the reader retains the body.
+   */
+  inline const QByteArray& getRetainedBody() const{
+    return retainedBody;
+  }
+
+  //@}
+
+private slots:
+
+  /** @name Private Slots */
+  //@{
+
+  /** \brief Reads and parses everything that has arrived. */
+  void readAvailable();
+
+  //@}
+
+private:
+
+  /** @name Private Members */
+  //@{
+
+  /** \brief The reply being read. */
+  QNetworkReply *reply;
+
+  /** \brief Builds the document when no other handler was given. */
+  JSONDOMBuilder builder;
+
+  /** \brief The handler the body is parsed into. */
+  JSONStreamParser::Handler *handler;
+
+  /** \brief Parses the body as it arrives. */
+  JSONStreamParser parser;
+
+  /** \brief Digest of the body read so far. */
+  QCryptographicHash digest;
+
+  /** \brief Whether or not to keep a copy of the raw body. */
+  bool retainsBody;
+
+  /** \brief The raw body, if it's being retained. */
+  QByteArray retainedBody;
+
+  /** \brief Buffer chunks of the body are read into. */
+  QByteArray readBuffer;
+
+  /** \brief How much of the body has been read in bytes. */
+  qint64 bytesRead;
+
+  /** \brief How long has been spent parsing the body in microseconds. */
+  qint64 parseTime;
+
+  /** \brief Whether or not the status of the reply has been checked. */
+  bool hasCheckedStatus;
+
+  /** \brief Whether or not the body is being read, false for unsuccessful replies. */
+  bool isReading;
+
+  /** \brief Whether or not the document has been completed. */
+  bool isFinished;
+
+  /** \brief Whether or not the body was a complete, well formed document. */
+  bool succeeded;
+
+  //@}
+
+  /** @name Private Functions */
+  //@{
+
+  /**
+   * \brief Gets the size of the chunks the body is read in.
+   *
+   * @return The size of the chunks the body is read in, in bytes.
+   */
+  static const int& getReadChunkSize(){
+    static const int readChunkSize = 16384;
+    return readChunkSize;
+  }
+
+  /**
+   * \brief Gets the time elapsed on a timer as precisely as this Qt can.
+   *
+   * @param timer The timer.
+   * @return The time elapsed on the timer in microseconds.
+   */
+  static qint64 getElapsedMicroseconds(const QElapsedTimer& timer);
+
+  //@}
+
+};
+
+
+} //end namespace UDJ
+#endif //JSON_REPLY_READER_HPP
@@ -0,0 +1,627 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "JSONStreamParser.hpp"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define UDJ_JSON_USE_SSE2 1
+#endif
+
+namespace UDJ{
+
+
+/** \brief Whether or not runs of bytes are scanned a block at a time where possible. */
+static bool vectorScanEnabled = true;
+
+#ifdef UDJ_JSON_USE_SSE2
+/**
+ * \brief Gets the index of the lowest set bit of a non-zero mask.
+ */
+static inline int lowestSetBit(int mask){
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward(&index, mask);
+  return (int)index;
+#else
+  return __builtin_ctz(mask);
+#endif
+}
+#endif
+
+/**
+ * \brief Finds the first byte that ends a plain run of string bytes: a quote, a
+ * backslash or a control character.
+ *
+ * \return The first such byte, or end if there is none.
+ */
+static inline const char* findStringSpecial(const char *p, const char *end){
+#ifdef UDJ_JSON_USE_SSE2
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  const __m128i lastControl = _mm_set1_epi8(0x1F);
+  while(vectorScanEnabled && end - p >= 16){
+    __m128i block = _mm_loadu_si128((const __m128i*)p);
+    __m128i special = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(block, quote), _mm_cmpeq_epi8(block, backslash)),
+      _mm_cmpeq_epi8(_mm_min_epu8(block, lastControl), block));
+    int mask = _mm_movemask_epi8(special);
+    if(mask != 0){
+      return p + lowestSetBit(mask);
+    }
+    p += 16;
+  }
+#endif
+  while(p < end && *p != '"' && *p != '\\' && (unsigned char)*p >= 0x20){
+    ++p;
+  }
+  return p;
+}
+
+static inline bool isWhitespace(char c){
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+/**
+ * \brief Finds the first byte that isn't whitespace.
+ *
+ * \return The first such byte, or end if there is none.
+ */
+static inline const char* skipWhitespace(const char *p, const char *end){
+#ifdef UDJ_JSON_USE_SSE2
+  //Compact documents rarely have more than a byte of whitespace in a row, so only
+  //pretty printed ones with their long indents are worth a block at a time.
+  if(vectorScanEnabled && end - p >= 16 && isWhitespace(p[1])){
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i carriageReturn = _mm_set1_epi8('\r');
+    const __m128i tab = _mm_set1_epi8('\t');
+    while(end - p >= 16){
+      __m128i block = _mm_loadu_si128((const __m128i*)p);
+      __m128i whitespace = _mm_or_si128(
+        _mm_or_si128(_mm_cmpeq_epi8(block, space), _mm_cmpeq_epi8(block, newline)),
+        _mm_or_si128(_mm_cmpeq_epi8(block, carriageReturn), _mm_cmpeq_epi8(block, tab)));
+      int mask = _mm_movemask_epi8(whitespace) ^ 0xFFFF;
+      if(mask != 0){
+        return p + lowestSetBit(mask);
+      }
+      p += 16;
+    }
+  }
+#endif
+  while(p < end && isWhitespace(*p)){
+    ++p;
+  }
+  return p;
+}
+
+/**
+ * \brief Checks that bytes are well formed UTF-8: no stray continuation bytes, no
+ * truncated, overlong or surrogate sequences and nothing past U+10FFFF.
+ */
+static bool isValidUtf8(const char *data, int size){
+  const unsigned char *p = (const unsigned char*)data;
+  const unsigned char *end = p + size;
+  while(p < end){
+#ifdef UDJ_JSON_USE_SSE2
+    //Most text is ASCII, which is skipped a block at a time.
+    while(vectorScanEnabled && end - p >= 16 &&
+      _mm_movemask_epi8(_mm_loadu_si128((const __m128i*)p)) == 0)
+    {
+      p += 16;
+    }
+    if(p == end){
+      break;
+    }
+#endif
+    unsigned char lead = *p;
+    if(lead < 0x80){
+      ++p;
+      continue;
+    }
+    int length;
+    unsigned char secondMin = 0x80;
+    unsigned char secondMax = 0xBF;
+    if(lead >= 0xC2 && lead <= 0xDF){
+      length = 2;
+    }
+    else if(lead >= 0xE0 && lead <= 0xEF){
+      length = 3;
+      if(lead == 0xE0){
+        secondMin = 0xA0;
+      }
+      else if(lead == 0xED){
+        secondMax = 0x9F;
+      }
+    }
+    else if(lead >= 0xF0 && lead <= 0xF4){
+      length = 4;
+      if(lead == 0xF0){
+        secondMin = 0x90;
+      }
+      else if(lead == 0xF4){
+        secondMax = 0x8F;
+      }
+    }
+    else{
+      return false;
+    }
+    if(end - p < length || p[1] < secondMin || p[1] > secondMax){
+      return false;
+    }
+    for(int i=2; i<length; ++i){
+      if((p[i] & 0xC0) != 0x80){
+        return false;
+      }
+    }
+    p += length;
+  }
+  return true;
+}
+
+
+static inline bool isNumberByte(char c){
+  return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+/**
+ * \brief Checks a number against the JSON grammar, which is stricter than what
+ * isNumberByte lets through.
+ */
+static bool isValidNumber(const QByteArray& number){
+  int i = 0;
+  int size = number.size();
+  if(i < size && number.at(i) == '-'){
+    ++i;
+  }
+  if(i >= size){
+    return false;
+  }
+  if(number.at(i) == '0'){
+    ++i;
+  }
+  else if(number.at(i) >= '1' && number.at(i) <= '9'){
+    while(i < size && number.at(i) >= '0' && number.at(i) <= '9'){
+      ++i;
+    }
+  }
+  else{
+    return false;
+  }
+  if(i < size && number.at(i) == '.'){
+    int digitsStart = ++i;
+    while(i < size && number.at(i) >= '0' && number.at(i) <= '9'){
+      ++i;
+    }
+    if(i == digitsStart){
+      return false;
+    }
+  }
+  if(i < size && (number.at(i) == 'e' || number.at(i) == 'E')){
+    ++i;
+    if(i < size && (number.at(i) == '+' || number.at(i) == '-')){
+      ++i;
+    }
+    int digitsStart = i;
+    while(i < size && number.at(i) >= '0' && number.at(i) <= '9'){
+      ++i;
+    }
+    if(i == digitsStart){
+      return false;
+    }
+  }
+  return i == size;
+}
+
+static inline int hexValue(char c){
+  if(c >= '0' && c <= '9'){
+    return c - '0';
+  }
+  else if(c >= 'a' && c <= 'f'){
+    return c - 'a' + 10;
+  }
+  else if(c >= 'A' && c <= 'F'){
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+bool JSONStreamParser::hasVectorScan(){
+#ifdef UDJ_JSON_USE_SSE2
+  return true;
+#else
+  return false;
+#endif
+}
+
+void JSONStreamParser::setVectorScanEnabled(bool enabled){
+  vectorScanEnabled = enabled;
+}
+
+JSONStreamParser::JSONStreamParser(Handler *handler):
+  handler(handler)
+{
+  reset();
+}
+
+void JSONStreamParser::reset(){
+  state = EXPECT_VALUE;
+  token = NO_TOKEN;
+  tokenBytes.clear();
+  isKey = false;
+  literal = 0;
+  literalMatched = 0;
+  escapedUnit = 0;
+  escapedDigits = 0;
+  highSurrogate = 0;
+  containers.clear();
+  offset = 0;
+  error.clear();
+}
+
+bool JSONStreamParser::feed(const char *data, int size){
+  const char *p = data;
+  const char *end = data + size;
+  while(p < end && error.isEmpty()){
+    switch(token){
+      case STRING_TOKEN:
+      {
+        //Plain bytes, multibyte characters included, are copied a run at a time. They're
+        //checked to be UTF-8 once the whole string is in.
+        const char *run = p;
+        p = findStringSpecial(p, end);
+        if(p > run){
+          flushHighSurrogate();
+          tokenBytes.append(run, p - run);
+        }
+        if(p < end){
+          if(*p == '"'){
+            endString(offset + (p - data));
+          }
+          else if(*p == '\\'){
+            token = ESCAPE_TOKEN;
+          }
+          else{
+            fail("Unescaped control character in string", offset + (p - data));
+            continue;
+          }
+          ++p;
+        }
+        continue;
+      }
+      case ESCAPE_TOKEN:
+      {
+        char c = *p;
+        token = STRING_TOKEN;
+        if(c != 'u'){
+          flushHighSurrogate();
+        }
+        switch(c){
+          case '"': tokenBytes.append('"'); break;
+          case '\\': tokenBytes.append('\\'); break;
+          case '/': tokenBytes.append('/'); break;
+          case 'b': tokenBytes.append('\b'); break;
+          case 'f': tokenBytes.append('\f'); break;
+          case 'n': tokenBytes.append('\n'); break;
+          case 'r': tokenBytes.append('\r'); break;
+          case 't': tokenBytes.append('\t'); break;
+          case 'u':
+            token = UNICODE_TOKEN;
+            escapedUnit = 0;
+            escapedDigits = 0;
+            break;
+          default:
+            fail("Invalid escape sequence", offset + (p - data));
+        }
+        ++p;
+        continue;
+      }
+      case UNICODE_TOKEN:
+      {
+        int digit = hexValue(*p);
+        if(digit == -1){
+          fail("Invalid unicode escape", offset + (p - data));
+          continue;
+        }
+        escapedUnit = escapedUnit * 16 + digit;
+        if(++escapedDigits == 4){
+          appendEscapedUnit(escapedUnit);
+          token = STRING_TOKEN;
+        }
+        ++p;
+        continue;
+      }
+      case NUMBER_TOKEN:
+      {
+        const char *run = p;
+        while(p < end && isNumberByte(*p)){
+          ++p;
+        }
+        tokenBytes.append(run, p - run);
+        //The byte ending the number still has to be looked at.
+        if(p < end){
+          endNumber(offset + (p - data));
+        }
+        continue;
+      }
+      case LITERAL_TOKEN:
+      {
+        if(*p != literal[literalMatched]){
+          fail("Invalid literal", offset + (p - data));
+          continue;
+        }
+        ++p;
+        if(literal[++literalMatched] == '\0'){
+          endLiteral();
+        }
+        continue;
+      }
+      case NO_TOKEN:
+        break;
+    }
+
+    char c = *p;
+    if(isWhitespace(c)){
+      p = skipWhitespace(p, end);
+      continue;
+    }
+    qint64 position = offset + (p - data);
+    switch(state){
+      case EXPECT_VALUE:
+        startValue(c, position);
+        break;
+      case EXPECT_VALUE_OR_END:
+        if(c == ']'){
+          endContainer(c, position);
+        }
+        else{
+          startValue(c, position);
+        }
+        break;
+      case EXPECT_ARRAY_COMMA_OR_END:
+        if(c == ','){
+          state = EXPECT_VALUE;
+        }
+        else{
+          endContainer(c, position);
+        }
+        break;
+      case EXPECT_KEY_OR_END:
+      case EXPECT_KEY:
+        if(c == '"'){
+          token = STRING_TOKEN;
+          isKey = true;
+          tokenBytes.clear();
+        }
+        else if(c == '}' && state == EXPECT_KEY_OR_END){
+          endContainer(c, position);
+        }
+        else{
+          fail("Expected a member name", position);
+        }
+        break;
+      case EXPECT_COLON:
+        if(c == ':'){
+          state = EXPECT_VALUE;
+        }
+        else{
+          fail("Expected ':'", position);
+        }
+        break;
+      case EXPECT_OBJECT_COMMA_OR_END:
+        if(c == ','){
+          state = EXPECT_KEY;
+        }
+        else{
+          endContainer(c, position);
+        }
+        break;
+      case EXPECT_NOTHING:
+        fail("Unexpected data after the document", position);
+        break;
+    }
+    ++p;
+  }
+  offset += p - data;
+  return error.isEmpty();
+}
+
+bool JSONStreamParser::finish(){
+  if(token == NUMBER_TOKEN && error.isEmpty()){
+    endNumber(offset);
+  }
+  if(error.isEmpty() && (token != NO_TOKEN || state != EXPECT_NOTHING)){
+    fail("Unexpected end of document", offset);
+  }
+  return error.isEmpty();
+}
+
+void JSONStreamParser::startValue(char c, qint64 position){
+  switch(c){
+    case '{':
+      if(containers.size() >= getMaxDepth()){
+        fail("Nested too deeply", position);
+        return;
+      }
+      containers.append('{');
+      handler->startObject();
+      state = EXPECT_KEY_OR_END;
+      break;
+    case '[':
+      if(containers.size() >= getMaxDepth()){
+        fail("Nested too deeply", position);
+        return;
+      }
+      containers.append('[');
+      handler->startArray();
+      state = EXPECT_VALUE_OR_END;
+      break;
+    case '"':
+      token = STRING_TOKEN;
+      isKey = false;
+      tokenBytes.clear();
+      break;
+    case 't':
+      token = LITERAL_TOKEN;
+      literal = "true";
+      literalMatched = 1;
+      break;
+    case 'f':
+      token = LITERAL_TOKEN;
+      literal = "false";
+      literalMatched = 1;
+      break;
+    case 'n':
+      token = LITERAL_TOKEN;
+      literal = "null";
+      literalMatched = 1;
+      break;
+    default:
+      if(c == '-' || (c >= '0' && c <= '9')){
+        token = NUMBER_TOKEN;
+        tokenBytes.clear();
+        tokenBytes.append(c);
+      }
+      else{
+        fail("Expected a value", position);
+      }
+  }
+}
+
+void JSONStreamParser::endValue(){
+  if(containers.isEmpty()){
+    state = EXPECT_NOTHING;
+  }
+  else if(containers.last() == '{'){
+    state = EXPECT_OBJECT_COMMA_OR_END;
+  }
+  else{
+    state = EXPECT_ARRAY_COMMA_OR_END;
+  }
+}
+
+void JSONStreamParser::endString(qint64 position){
+  token = NO_TOKEN;
+  flushHighSurrogate();
+  if(!isValidUtf8(tokenBytes.constData(), tokenBytes.size())){
+    fail("Invalid UTF-8 in string", position);
+    return;
+  }
+  QString value = QString::fromUtf8(tokenBytes.constData(), tokenBytes.size());
+  if(isKey){
+    handler->key(value);
+    state = EXPECT_COLON;
+  }
+  else{
+    handler->stringValue(value);
+    endValue();
+  }
+}
+
+void JSONStreamParser::endNumber(qint64 position){
+  token = NO_TOKEN;
+  if(!isValidNumber(tokenBytes)){
+    fail("Invalid number", position);
+    return;
+  }
+  handler->numberValue(tokenBytes);
+  endValue();
+}
+
+void JSONStreamParser::endLiteral(){
+  token = NO_TOKEN;
+  if(literal[0] == 'n'){
+    handler->nullValue();
+  }
+  else{
+    handler->boolValue(literal[0] == 't');
+  }
+  endValue();
+}
+
+void JSONStreamParser::endContainer(char c, qint64 position){
+  if(containers.last() == '{' ? c != '}' : c != ']'){
+    fail(containers.last() == '{' ? "Expected ',' or '}'" : "Expected ',' or ']'", position);
+    return;
+  }
+  containers.pop_back();
+  if(c == '}'){
+    handler->endObject();
+  }
+  else{
+    handler->endArray();
+  }
+  endValue();
+}
+
+void JSONStreamParser::appendEscapedUnit(quint32 unit){
+  if(unit >= 0xD800 && unit < 0xDC00){
+    flushHighSurrogate();
+    highSurrogate = unit;
+    return;
+  }
+  if(unit >= 0xDC00 && unit < 0xE000){
+    if(highSurrogate == 0){
+      appendCodePoint(0xFFFD);
+    }
+    else{
+      appendCodePoint(0x10000 + ((highSurrogate - 0xD800) << 10) + (unit - 0xDC00));
+      highSurrogate = 0;
+    }
+    return;
+  }
+  flushHighSurrogate();
+  appendCodePoint(unit);
+}
+
+void JSONStreamParser::flushHighSurrogate(){
+  if(highSurrogate != 0){
+    appendCodePoint(0xFFFD);
+    highSurrogate = 0;
+  }
+}
+
+void JSONStreamParser::appendCodePoint(quint32 codePoint){
+  if(codePoint < 0x80){
+    tokenBytes.append((char)codePoint);
+  }
+  else if(codePoint < 0x800){
+    tokenBytes.append((char)(0xC0 | (codePoint >> 6)));
+    tokenBytes.append((char)(0x80 | (codePoint & 0x3F)));
+  }
+  else if(codePoint < 0x10000){
+    tokenBytes.append((char)(0xE0 | (codePoint >> 12)));
+    tokenBytes.append((char)(0x80 | ((codePoint >> 6) & 0x3F)));
+    tokenBytes.append((char)(0x80 | (codePoint & 0x3F)));
+  }
+  else{
+    tokenBytes.append((char)(0xF0 | (codePoint >> 18)));
+    tokenBytes.append((char)(0x80 | ((codePoint >> 12) & 0x3F)));
+    tokenBytes.append((char)(0x80 | ((codePoint >> 6) & 0x3F)));
+    tokenBytes.append((char)(0x80 | (codePoint & 0x3F)));
+  }
+}
+
+void JSONStreamParser::fail(const QString& message, qint64 position){
+  if(error.isEmpty()){
+    error = message + " at byte " + QString::number(position);
+  }
+}
+
+
+} //end namespace UDJ
@@ -0,0 +1,344 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef JSON_STREAM_PARSER_HPP
+#define JSON_STREAM_PARSER_HPP
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+namespace UDJ{
+
+
+/**
+ * \brief An event driven JSON parser working directly on UTF-8 bytes.
+ *
+ * The document can be fed in pieces of any size as they arrive, split anywhere (even in
+ * the middle of a string or a multibyte character). Nothing is buffered besides the
+ * token currently being read, and the handler is told about every value the moment it
+ * is complete.
+ *
+ * Since replies come from the network the parser is strict and bounded: anything that
+ * isn't valid JSON or UTF-8 is rejected, every byte is looked at a fixed number of times,
+ * and documents nested deeper than getMaxDepth() are refused so nothing recursing over
+ * the result can run out of stack.
+ *
+ * Where SSE2 is available, runs of string bytes and whitespace are scanned 16 bytes at a
+ * time. setVectorScanEnabled() falls back to a byte at a time, so both can be tested and
+ * benchmarked against each other.
+ */
+class JSONStreamParser{
+public:
+
+  /** @name Public Types */
+  //@{
+
+  /**
+   * \brief Receives the parts of a document as they are parsed.
+   */
+  class Handler{
+  public:
+    virtual ~Handler(){}
+
+    /** \brief Called when an object starts. */
+    virtual void startObject() = 0;
+
+    /** \brief Called when the innermost open object ends. */
+    virtual void endObject() = 0;
+
+    /** \brief Called when an array starts. */
+    virtual void startArray() = 0;
+
+    /** \brief Called when the innermost open array ends. */
+    virtual void endArray() = 0;
+
+    /**
+     * \brief Called with the name of the next member of the innermost open object.
+     *
+     * \param name The name of the member.
+     */
+    virtual void key(const QString& name) = 0;
+
+    /**
+     * \brief Called for each string value.
+     *
+     * \param value The unescaped string.
+     */
+    virtual void stringValue(const QString& value) = 0;
+
+    /**
+     * \brief Called for each number.
+     *
+     * \param number The number exactly as it appeared in the document.
+     */
+    virtual void numberValue(const QByteArray& number) = 0;
+
+    /**
+     * \brief Called for each true or false.
+     *
+     * \param value The value.
+     */
+    virtual void boolValue(bool value) = 0;
+
+    /** \brief Called for each null. */
+    virtual void nullValue() = 0;
+  };
+
+  //@}
+
+  /** @name Vector Scanning */
+  //@{
+
+  /**
+   * \brief Gets whether or not the parser was built to scan a block at a time.
+   *
+   * \return True if SSE2 scanning is available, false otherwise.
+   */
+  static bool hasVectorScan();
+
+  /**
+   * \brief Sets whether or not parsers scan a block at a time when they can. This affects
+   * every parser and is meant for tests and benchmarks; it is enabled by default.
+   *
+   * \param enabled Whether or not to scan a block at a time.
+   */
+  static void setVectorScanEnabled(bool enabled);
+
+  //@}
+
+  /** @name Constructors */
+  //@{
+
+  /**
+   * \brief Constructs a JSONStreamParser.
+   *
+   * \param handler The handler told about everything that's parsed.
+   */
+  JSONStreamParser(Handler *handler);
+
+  //@}
+
+  /** @name Parsing */
+  //@{
+
+  /**
+   * \brief Parses the next piece of the document.
+   *
+   * \param data The next bytes of the document.
+   * \param size The number of bytes.
+   * \return False if the document is malformed, true otherwise.
+   */
+  bool feed(const char *data, int size);
+
+  /**
+   * \brief Parses the next piece of the document.
+   *
+   * \param data The next bytes of the document.
+   * \return False if the document is malformed, true otherwise.
+   */
+  inline bool feed(const QByteArray& data){
+    return feed(data.constData(), data.size());
+  }
+
+  /**
+   * \brief Tells the parser the whole document has been fed.
+   *
+   * \return True if exactly one complete value was parsed, false otherwise.
+   */
+  bool finish();
+
+  /** \brief Gets the parser ready for a new document. */
+  void reset();
+
+  //@}
+
+  /** @name Accessors */
+  //@{
+
+  /**
+   * \brief Gets whether or not the document has turned out to be malformed.
+   *
+   * \return True if the document is malformed, false otherwise.
+   */
+  inline bool hasFailed() const{
+    return !error.isEmpty();
+  }
+
+  /**
+   * \brief Gets what was wrong with the document.
+   *
+   * \return A description of the problem and where it is, empty if there is none.
+   */
+  inline const QString& getError() const{
+    return error;
+  }
+
+  //@}
+
+private:
+
+  /** @name Private Types */
+  //@{
+
+  /** \brief What the parser expects to see next between tokens. */
+  enum State{
+    EXPECT_VALUE,
+    EXPECT_VALUE_OR_END,
+    EXPECT_ARRAY_COMMA_OR_END,
+    EXPECT_KEY_OR_END,
+    EXPECT_KEY,
+    EXPECT_COLON,
+    EXPECT_OBJECT_COMMA_OR_END,
+    EXPECT_NOTHING
+  };
+
+  /** \brief The kind of token currently being read, if any. */
+  enum Token{
+    NO_TOKEN,
+    STRING_TOKEN,
+    ESCAPE_TOKEN,
+    UNICODE_TOKEN,
+    NUMBER_TOKEN,
+    LITERAL_TOKEN
+  };
+
+  //@}
+
+  /** @name Private Members */
+  //@{
+
+  /** \brief Told about everything that's parsed. */
+  Handler *handler;
+
+  State state;
+
+  Token token;
+
+  /** \brief The bytes of the string or number currently being read. */
+  QByteArray tokenBytes;
+
+  /** \brief Whether or not the string being read is the name of a member. */
+  bool isKey;
+
+  /** \brief The literal (true, false or null) currently being read. */
+  const char *literal;
+
+  /** \brief How many bytes of the literal have been read. */
+  int literalMatched;
+
+  /** \brief The value of the \\u escape being read. */
+  quint32 escapedUnit;
+
+  /** \brief How many hex digits of the \\u escape have been read. */
+  int escapedDigits;
+
+  /** \brief A high surrogate waiting for its low surrogate, 0 if none. */
+  quint32 highSurrogate;
+
+  /** \brief The containers currently open, innermost last: '{' or '['. */
+  QVector<char> containers;
+
+  /** \brief Number of bytes fed before the current piece. */
+  qint64 offset;
+
+  /** \brief What was wrong with the document, empty if nothing. */
+  QString error;
+
+  //@}
+
+  /** @name Private Functions */
+  //@{
+
+  /**
+   * \brief Starts reading a value.
+   *
+   * \param c The first byte of the value.
+   * \param position The position of that byte in the document.
+   */
+  void startValue(char c, qint64 position);
+
+  /** \brief Moves on once a value is complete. */
+  void endValue();
+
+  /**
+   * \brief Hands a complete string to the handler.
+   *
+   * \param position The position of the closing quote in the document.
+   */
+  void endString(qint64 position);
+
+  /**
+   * \brief Hands a complete number to the handler.
+   *
+   * \param position The position just past the number in the document.
+   */
+  void endNumber(qint64 position);
+
+  /** \brief Hands a complete literal to the handler. */
+  void endLiteral();
+
+  /**
+   * \brief Closes the innermost container.
+   *
+   * \param c The byte closing it, '}' or ']'.
+   * \param position The position of that byte in the document.
+   */
+  void endContainer(char c, qint64 position);
+
+  /**
+   * \brief Appends a UTF-16 code unit from a \\u escape to the current string as UTF-8.
+   *
+   * \param unit The code unit.
+   */
+  void appendEscapedUnit(quint32 unit);
+
+  /** \brief Replaces a high surrogate that never got its low surrogate. */
+  void flushHighSurrogate();
+
+  /**
+   * \brief Appends a code point to the current string as UTF-8.
+   *
+   * \param codePoint The code point.
+   */
+  void appendCodePoint(quint32 codePoint);
+
+  /**
+   * \brief Gets how deeply containers may be nested.
+   *
+   * \return The most containers that may be open at once.
+   */
+  static const int& getMaxDepth(){
+    static const int maxDepth = 128;
+    return maxDepth;
+  }
+
+  /**
+   * \brief Records that the document is malformed.
+   *
+   * \param message What is wrong.
+   * \param position Where in the document it's wrong.
+   */
+  void fail(const QString& message, qint64 position);
+
+  //@}
+
+};
+
+
+} //end namespace UDJ
+#endif //JSON_STREAM_PARSER_HPP
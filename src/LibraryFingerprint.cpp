@@ -0,0 +1,97 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "LibraryFingerprint.hpp"
+#include <QCryptographicHash>
+
+namespace UDJ{
+
+
+LibraryFingerprint::LibraryFingerprint():
+  bucketSums(getNumBuckets(), 0),
+  bucketCounts(getNumBuckets(), 0)
+{}
+
+void LibraryFingerprint::addSong(library_song_id_t id, quint32 songHash){
+  int bucket = getBucket(id);
+  bucketSums[bucket] += songHash;
+  ++bucketCounts[bucket];
+}
+
+void LibraryFingerprint::removeSong(library_song_id_t id, quint32 songHash){
+  int bucket = getBucket(id);
+  bucketSums[bucket] -= songHash;
+  --bucketCounts[bucket];
+}
+
+void LibraryFingerprint::setBucket(int bucket, quint64 sum, int count){
+  bucketSums[bucket] = sum;
+  bucketCounts[bucket] = count;
+}
+
+void LibraryFingerprint::clearBucket(int bucket){
+  setBucket(bucket, 0, 0);
+}
+
+QString LibraryFingerprint::getBucketDigest(int bucket) const{
+  return QString::number(bucketSums[bucket]) + ":" + QString::number(bucketCounts[bucket]);
+}
+
+QString LibraryFingerprint::getRootDigest() const{
+  QStringList digests;
+  for(int i=0; i<getNumBuckets(); ++i){
+    digests.append(getBucketDigest(i));
+  }
+  return QString(QCryptographicHash::hash(
+    digests.join(",").toUtf8(), QCryptographicHash::Sha1).toHex());
+}
+
+QList<int> LibraryFingerprint::getDifferingBuckets(const QVariantMap& remoteFingerprint) const{
+  QList<int> differing;
+  if(remoteFingerprint["root"].toString() == getRootDigest()){
+    return differing;
+  }
+  QVariantList remoteBuckets = remoteFingerprint["buckets"].toList();
+  for(int i=0; i<getNumBuckets(); ++i){
+    if(i >= remoteBuckets.size() || remoteBuckets[i].toString() != getBucketDigest(i)){
+      differing.append(i);
+    }
+  }
+  return differing;
+}
+
+quint32 LibraryFingerprint::computeSongHash(const QVariantMap& syncedSong){
+  QStringList fields;
+  fields << syncedSong["id"].toString()
+    << syncedSong["title"].toString()
+    << syncedSong["artist"].toString()
+    << syncedSong["album"].toString()
+    << syncedSong["genre"].toString()
+    << syncedSong["track"].toString()
+    << syncedSong["duration"].toString();
+  QByteArray digest =
+    QCryptographicHash::hash(fields.join("|").toUtf8(), QCryptographicHash::Md5);
+  return
+    ((quint32)(uchar)digest[0] << 24) |
+    ((quint32)(uchar)digest[1] << 16) |
+    ((quint32)(uchar)digest[2] << 8) |
+    (quint32)(uchar)digest[3];
+}
+
+
+} //end namespace UDJ
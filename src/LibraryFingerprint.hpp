@@ -0,0 +1,173 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBRARY_FINGERPRINT_HPP
+#define LIBRARY_FINGERPRINT_HPP
+#include "ConfigDefs.hpp"
+#include <QVector>
+#include <QStringList>
+#include <QVariantMap>
+
+namespace UDJ{
+
+/**
+ * \brief A two level hash tree describing the songs in the library that have been
+ * synced with the server.
+ *
+ * Every synced song is hashed and assigned to a bucket based on its library id. Each
+ * bucket keeps the sum of the hashes of the songs in it along with a count of those
+ * songs. Because the sum is order independent a bucket can be updated in constant time
+ * whenever a single song is added to or removed from the server. The root digest is a
+ * hash of all the bucket digests, so comparing two roots tells us whether the libraries
+ * match and comparing buckets tells us exactly where they differ.
+ *
+ * The server computes the same structure over its copy of the library:
+ *  - song hash: first four bytes (big endian) of the MD5 of the UTF-8 string
+ *    "id|title|artist|album|genre|track|duration" using the values that were synced.
+ *  - bucket: id modulo the number of buckets.
+ *  - bucket digest: "<sum of song hashes modulo 2^64>:<song count>".
+ *  - root digest: hex SHA1 of all the bucket digests joined with ",".
+ */
+class LibraryFingerprint{
+public:
+
+  /** @name Constructors */
+  //@{
+
+  /** \brief Constructs an empty LibraryFingerprint. */
+  LibraryFingerprint();
+
+  //@}
+
+  /** @name Modifiers */
+  //@{
+
+  /**
+   * \brief Adds a song to the fingerprint.
+   *
+   * \param id The library id of the song.
+   * \param songHash The hash of the song as computed by computeSongHash.
+   */
+  void addSong(library_song_id_t id, quint32 songHash);
+
+  /**
+   * \brief Removes a song from the fingerprint.
+   *
+   * \param id The library id of the song.
+   * \param songHash The hash that was used when the song was added.
+   */
+  void removeSong(library_song_id_t id, quint32 songHash);
+
+  /**
+   * \brief Sets the raw contents of a bucket.
+   *
+   * \param bucket The bucket to set.
+   * \param sum The sum of all the song hashes in the bucket.
+   * \param count The number of songs in the bucket.
+   */
+  void setBucket(int bucket, quint64 sum, int count);
+
+  /**
+   * \brief Empties the given bucket.
+   *
+   * \param bucket The bucket to empty.
+   */
+  void clearBucket(int bucket);
+
+  //@}
+
+  /** @name Accessors */
+  //@{
+
+  /**
+   * \brief Gets the digest of a single bucket.
+   *
+   * \param bucket The bucket whose digest is desired.
+   * \return The digest of the given bucket.
+   */
+  QString getBucketDigest(int bucket) const;
+
+  /**
+   * \brief Gets the root digest of the fingerprint.
+   *
+   * \return The root digest of the fingerprint.
+   */
+  QString getRootDigest() const;
+
+  /**
+   * \brief Determines which buckets differ from the given fingerprint sent by the server.
+   *
+   * \param remoteFingerprint The fingerprint sent by the server. It should contain a "root"
+   * digest and a "buckets" list of bucket digests.
+   * \return The buckets whose digests don't match. If the roots match the list is empty.
+   */
+  QList<int> getDifferingBuckets(const QVariantMap& remoteFingerprint) const;
+
+  //@}
+
+  /** @name Static Helpers */
+  //@{
+
+  /**
+   * \brief Computes the hash of a song.
+   *
+   * \param syncedSong A map representing the song exactly as it was sent to the server.
+   * \return The hash of the song.
+   */
+  static quint32 computeSongHash(const QVariantMap& syncedSong);
+
+  /**
+   * \brief Gets the bucket to which a song belongs.
+   *
+   * \param id The library id of the song.
+   * \return The bucket to which the song belongs.
+   */
+  static inline int getBucket(library_song_id_t id){
+    return (int)(id % getNumBuckets());
+  }
+
+  /**
+   * \brief Gets the number of buckets in the fingerprint.
+   *
+   * \return The number of buckets in the fingerprint.
+   */
+  static const int& getNumBuckets(){
+    static const int numBuckets = 256;
+    return numBuckets;
+  }
+
+  //@}
+
+private:
+
+  /** @name Private Members */
+  //@{
+
+  /** \brief The sum of the song hashes in each bucket. */
+  QVector<quint64> bucketSums;
+
+  /** \brief The number of songs in each bucket. */
+  QVector<int> bucketCounts;
+
+  //@}
+
+};
+
+
+} //end namespace UDJ
+#endif //LIBRARY_FINGERPRINT_HPP
@@ -0,0 +1,409 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "LibraryModel.hpp"
+#include "Logger.hpp"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QStringList>
+#include <QThread>
+#include <QtAlgorithms>
+
+
+namespace UDJ{
+
+
+LibraryModel::LibraryModel(DataStore *dataStore, QObject *parent)
+  :QAbstractTableModel(parent),
+  dataStore(dataStore),
+  numSongs(0),
+  sortColumn(0),
+  sortOrder(Qt::AscendingOrder),
+  pageUses(0),
+  idColumn(-1),
+  durationColumn(-1),
+  latestSearchId(0),
+  searchedId(0),
+  requestedSortColumn(0),
+  requestedSortOrder(Qt::AscendingOrder)
+{
+  QSqlQuery columnQuery(dataStore->getDatabaseConnection());
+  EXEC_SQL(
+    "Error describing library songs",
+    columnQuery.exec(getDataQuery() + " LIMIT 0;"),
+    columnQuery)
+  columns = columnQuery.record();
+  idColumn = columns.indexOf(DataStore::getLibIdColName());
+  durationColumn = columns.indexOf(DataStore::getLibDurationColName());
+  sortColumn = idColumn;
+  requestedSortColumn = idColumn;
+  numSongs = countSongs();
+
+  qRegisterMetaType<LibrarySearcher::search_result_t>("LibrarySearcher::search_result_t");
+  searchThread = new QThread(this);
+  searcher = new LibrarySearcher(dataStore->getDatabaseConnection().databaseName());
+  searcher->moveToThread(searchThread);
+  connect(
+    this,
+    SIGNAL(searchRequested(int, const QString&, const QString&)),
+    searcher,
+    SLOT(search(int, const QString&, const QString&)));
+  connect(
+    searcher,
+    SIGNAL(searchFinished(const LibrarySearcher::search_result_t&)),
+    this,
+    SLOT(applySearchResult(const LibrarySearcher::search_result_t&)));
+  //The connection belongs to the search thread, so it's closed there as it finishes.
+  connect(searchThread, SIGNAL(finished()), searcher, SLOT(closeConnection()),
+    Qt::DirectConnection);
+  searchThread->start();
+}
+
+LibraryModel::~LibraryModel(){
+  searcher->supersede(-1);
+  searchThread->quit();
+  searchThread->wait();
+  delete searcher;
+}
+
+int LibraryModel::rowCount(const QModelIndex& parent) const{
+  return parent.isValid() ? 0 : numSongs;
+}
+
+int LibraryModel::columnCount(const QModelIndex& parent) const{
+  return parent.isValid() ? 0 : columns.count();
+}
+
+QVariant LibraryModel::data(const QModelIndex& item, int role) const{
+  if(!item.isValid() || item.row() >= numSongs){
+    return QVariant();
+  }
+  if(role == Qt::TextAlignmentRole){
+    return QVariant(Qt::AlignLeft | Qt::AlignVCenter);
+  }
+  if(role != Qt::DisplayRole && role != Qt::EditRole){
+    return QVariant();
+  }
+
+  const QSqlRecord *song = songAt(item.row());
+  if(song == NULL){
+    return QVariant();
+  }
+  QVariant actualData = song->value(item.column());
+  if(item.column() == durationColumn && role == Qt::DisplayRole){
+    return durationDisplays.getDisplay(actualData.toInt());
+  }
+  return actualData;
+}
+
+QVariant LibraryModel::headerData(
+  int section, Qt::Orientation orientation, int role) const
+{
+  if(orientation == Qt::Horizontal && role == Qt::DisplayRole &&
+    section >= 0 && section < columns.count())
+  {
+    return columns.fieldName(section);
+  }
+  return QAbstractTableModel::headerData(section, orientation, role);
+}
+
+void LibraryModel::sort(int column, Qt::SortOrder order){
+  if(column < 0 || column >= columns.count()){
+    column = idColumn;
+  }
+  if(column == requestedSortColumn && order == requestedSortOrder){
+    return;
+  }
+  requestedSortColumn = column;
+  requestedSortOrder = order;
+  if(requestedFilter.isEmpty() && !isSearching()){
+    //Without a filter the sort indexes get any page directly, nothing to search for.
+    beginResetModel();
+    sortColumn = column;
+    sortOrder = order;
+    clearPages();
+    endResetModel();
+  }
+  else{
+    requestSearch();
+  }
+}
+
+QSqlRecord LibraryModel::record(int row) const{
+  const QSqlRecord *song = songAt(row);
+  return song != NULL ? *song : QSqlRecord();
+}
+
+void LibraryModel::refresh(){
+  if(!requestedFilter.isEmpty() || isSearching()){
+    requestSearch();
+    return;
+  }
+  beginResetModel();
+  clearPages();
+  durationDisplays.clear();
+  numSongs = countSongs();
+  endResetModel();
+}
+
+void LibraryModel::setFilter(const QString& newFilter){
+  if(newFilter == requestedFilter){
+    return;
+  }
+  requestedFilter = newFilter;
+  requestSearch();
+}
+
+void LibraryModel::updateSongs(const QSet<library_song_id_t>& modifiedSongs){
+  if(modifiedSongs.isEmpty()){
+    return;
+  }
+  //Which songs match, and how many, is worked out again in the background. What's
+  //shown stays put until then.
+  requestSearch();
+}
+
+void LibraryModel::requestSearch(){
+  ++latestSearchId;
+  searcher->supersede(latestSearchId);
+  searchTimer.start();
+  emit searchRequested(
+    latestSearchId,
+    requestedFilter,
+    getOrderBy(requestedSortColumn, requestedSortOrder));
+}
+
+void LibraryModel::applySearchResult(const LibrarySearcher::search_result_t& result){
+  if(result.searchId != latestSearchId){
+    return;
+  }
+  bool isSameView = result.filter == filter &&
+    requestedSortColumn == sortColumn && requestedSortOrder == sortOrder;
+  if(isSameView){
+    //Just the songs changed. Where the modified songs were and now are isn't known
+    //without fetching every page they could be on, so forget what we have and let the
+    //views fetch what they show again. Rows stay put, only the number of them changes.
+    clearPages();
+    matchingIds = result.ids;
+    if(result.numSongs > numSongs){
+      beginInsertRows(QModelIndex(), numSongs, result.numSongs - 1);
+      numSongs = result.numSongs;
+      endInsertRows();
+    }
+    else if(result.numSongs < numSongs){
+      beginRemoveRows(QModelIndex(), result.numSongs, numSongs - 1);
+      numSongs = result.numSongs;
+      endRemoveRows();
+    }
+    if(numSongs > 0){
+      emit dataChanged(index(0, 0), index(numSongs - 1, columns.count() - 1));
+    }
+  }
+  else{
+    beginResetModel();
+    filter = result.filter;
+    sortColumn = requestedSortColumn;
+    sortOrder = requestedSortOrder;
+    matchingIds = result.ids;
+    numSongs = result.numSongs;
+    clearPages();
+    endResetModel();
+  }
+  searchedId = result.searchId;
+  Logger::instance()->log("Library search for \"" + result.filter + "\" matched " +
+    QString::number(result.numSongs) + " songs, " + QString::number(result.queryTime) +
+    "ms in the database and " + QString::number(searchTimer.elapsed()) +
+    "ms from request to display");
+}
+
+const QSqlRecord* LibraryModel::songAt(int row) const{
+  if(row < 0 || row >= numSongs){
+    return NULL;
+  }
+  int pageNumber = row / getPageSize();
+  QHash<int, page_t>::iterator page = pages.find(pageNumber);
+  if(page == pages.end()){
+    fetchPage(pageNumber);
+    page = pages.find(pageNumber);
+  }
+  page->lastUsed = ++pageUses;
+  int offset = row % getPageSize();
+  return offset < page->songs.size() ? &(page->songs.at(offset)) : NULL;
+}
+
+void LibraryModel::fetchPage(int pageNumber) const{
+  if(pages.size() >= getMaxCachedPages()){
+    QHash<int, page_t>::iterator leastRecent = pages.begin();
+    for(QHash<int, page_t>::iterator it = pages.begin(); it != pages.end(); ++it){
+      if(it->lastUsed < leastRecent->lastUsed){
+        leastRecent = it;
+      }
+    }
+    pages.erase(leastRecent);
+  }
+
+  page_t page;
+  page.lastUsed = ++pageUses;
+  page.songs = filter.isEmpty() ? fetchSortedPage(pageNumber) : fetchMatchingPage(pageNumber);
+  pages.insert(pageNumber, page);
+}
+
+QVector<QSqlRecord> LibraryModel::fetchSortedPage(int pageNumber) const{
+  const QString sortName = columns.fieldName(sortColumn);
+  const QString idName = DataStore::getLibIdColName();
+  bool isAfterPrevious = lastKeys.contains(pageNumber - 1);
+  bool isBeforeNext = !isAfterPrevious && firstKeys.contains(pageNumber + 1);
+  //Walking backwards from the next page flips the order, and the rows are put back
+  //the right way round once they're read.
+  bool isAscending = (sortOrder == Qt::AscendingOrder) != isBeforeNext;
+  QString direction = isAscending ? " ASC" : " DESC";
+  QString comparison = isAscending ? " > " : " < ";
+  QString boundary = isAscending ? " >= " : " <= ";
+  const sort_key_t *key = NULL;
+  if(isAfterPrevious){
+    key = &lastKeys[pageNumber - 1];
+  }
+  else if(isBeforeNext){
+    key = &firstKeys[pageNumber + 1];
+  }
+
+  QString queryString = getDataQuery();
+  if(key != NULL){
+    //Title, artist and album may be NULL, which sorts before everything else but never
+    //compares true, so those songs are bounded separately to stay in step with OFFSET.
+    QString nullCondition = sortName + " IS NULL";
+    if(key->value.isNull()){
+      queryString += isAscending ?
+        " AND ((" + nullCondition + " AND " + idName + " > :keyId) OR " +
+          sortName + " IS NOT NULL)" :
+        " AND " + nullCondition + " AND " + idName + " < :keyId";
+    }
+    else{
+      //The redundant bound lets the database seek straight to the key in the sort
+      //index rather than scanning up to it.
+      QString pastKey = sortName + boundary + ":keyValue AND (" +
+        sortName + comparison + ":pastKeyValue OR " + idName + comparison + ":keyId)";
+      queryString += isAscending ?
+        " AND " + pastKey :
+        " AND ((" + pastKey + ") OR " + nullCondition + ")";
+    }
+  }
+  queryString += " ORDER BY " + sortName + direction + ", " + idName + direction +
+    " LIMIT " + QString::number(getPageSize());
+  if(key == NULL){
+    queryString += " OFFSET " + QString::number(pageNumber * getPageSize());
+  }
+
+  QSqlQuery pageQuery(dataStore->getDatabaseConnection());
+  pageQuery.setForwardOnly(true);
+  pageQuery.prepare(queryString + ";");
+  if(key != NULL){
+    if(!key->value.isNull()){
+      pageQuery.bindValue(":keyValue", key->value);
+      pageQuery.bindValue(":pastKeyValue", key->value);
+    }
+    pageQuery.bindValue(":keyId", QVariant::fromValue(key->id));
+  }
+  EXEC_SQL(
+    "Error fetching page of library songs",
+    pageQuery.exec(),
+    pageQuery)
+  QVector<QSqlRecord> songs;
+  while(pageQuery.next()){
+    songs.append(pageQuery.record());
+  }
+  if(isBeforeNext){
+    for(int i=0, j=songs.size()-1; i<j; ++i, --j){
+      qSwap(songs[i], songs[j]);
+    }
+  }
+  if(!songs.isEmpty()){
+    firstKeys.insert(pageNumber, getSortKey(songs.first()));
+    lastKeys.insert(pageNumber, getSortKey(songs.last()));
+  }
+  return songs;
+}
+
+QVector<QSqlRecord> LibraryModel::fetchMatchingPage(int pageNumber) const{
+  int firstIndex = pageNumber * getPageSize();
+  int lastIndex = qMin(firstIndex + getPageSize(), matchingIds.size()) - 1;
+  QStringList idList;
+  QHash<library_song_id_t, int> positions;
+  for(int i = firstIndex; i <= lastIndex; ++i){
+    idList.append(QString::number(matchingIds.at(i)));
+    positions.insert(matchingIds.at(i), i - firstIndex);
+  }
+  QVector<QSqlRecord> songs;
+  if(idList.isEmpty()){
+    return songs;
+  }
+
+  //The search already put the matches in order, so this is just a primary key lookup.
+  QSqlQuery pageQuery(dataStore->getDatabaseConnection());
+  pageQuery.setForwardOnly(true);
+  EXEC_SQL(
+    "Error fetching page of matching library songs",
+    pageQuery.exec(getDataQuery() + " AND " + DataStore::getLibIdColName() +
+      " IN (" + idList.join(",") + ");"),
+    pageQuery)
+  QVector<QSqlRecord> ordered(idList.size());
+  while(pageQuery.next()){
+    QSqlRecord song = pageQuery.record();
+    ordered[positions.value(song.value(idColumn).value<library_song_id_t>())] = song;
+  }
+  //Songs that went away since the search leave a gap, which is closed up until the
+  //search is run again.
+  Q_FOREACH(const QSqlRecord& song, ordered){
+    if(!song.isEmpty()){
+      songs.append(song);
+    }
+  }
+  return songs;
+}
+
+void LibraryModel::clearPages(){
+  pages.clear();
+  firstKeys.clear();
+  lastKeys.clear();
+}
+
+int LibraryModel::countSongs() const{
+  QSqlQuery countQuery(dataStore->getDatabaseConnection());
+  EXEC_SQL(
+    "Error counting library songs",
+    countQuery.exec("SELECT COUNT(*) FROM (" + getDataQuery() + ");"),
+    countQuery)
+  return countQuery.next() ? countQuery.value(0).toInt() : 0;
+}
+
+QString LibraryModel::getOrderBy(int column, Qt::SortOrder order) const{
+  QString direction = order == Qt::AscendingOrder ? " ASC" : " DESC";
+  return "ORDER BY " + columns.fieldName(column) + direction + ", " +
+    DataStore::getLibIdColName() + direction;
+}
+
+LibraryModel::sort_key_t LibraryModel::getSortKey(const QSqlRecord& song) const{
+  sort_key_t key = {
+    song.value(sortColumn),
+    song.value(idColumn).value<library_song_id_t>()
+  };
+  return key;
+}
+
+
+} //end namespace UDJ
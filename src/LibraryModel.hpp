@@ -0,0 +1,403 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBRARY_MODEL_HPP
+#define LIBRARY_MODEL_HPP
+#include "ConfigDefs.hpp"
+#include "DataStore.hpp"
+#include "LibrarySearcher.hpp"
+#include "DurationDisplayCache.hpp"
+#include <QAbstractTableModel>
+#include <QElapsedTimer>
+#include <QSqlRecord>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+
+class QThread;
+
+namespace UDJ{
+
+
+/**
+ * \brief A model containing all the songs in the library that should be displayed.
+ *
+ * The model never holds the whole library. It knows how many songs match the current
+ * filter and fetches them from the database a page at a time as views ask for them,
+ * keeping only the most recently used pages around, so memory use doesn't depend on
+ * the size of the library. Sorting and filtering are done by the database.
+ *
+ * Pages are fetched with keyset pagination: a page next to one that has already been
+ * fetched starts right after that page's last (or right before its first) sort key,
+ * which the sort indexes find directly no matter how far down the library it is. Only
+ * a jump to a page with no fetched neighbour falls back to an offset.
+ *
+ * Filtering is done by a LibrarySearcher on a thread of its own, which hands back the
+ * ids of the matching songs in order. The model switches over to them all at once when
+ * they arrive, and pages of them are then fetched by id. A search that's superseded
+ * before it finishes is abandoned.
+ */
+class LibraryModel : public QAbstractTableModel{
+Q_OBJECT
+public:
+
+  /** @name Constructors */
+  //@{
+
+  /**
+   * \brief Constructs a LibraryModel.
+   *
+   * \param dataStore The datastore backing the client.
+   * \param parent The parent object.
+   */
+  LibraryModel(DataStore *dataStore, QObject *parent);
+
+  //@}
+
+  /** @name Destructor */
+  //@{
+
+  /** \brief Deconstructs a LibraryModel, stopping any search in progress. */
+  ~LibraryModel();
+
+  //@}
+
+  /** @name Overridden from QAbstractTableModel */
+  //@{
+
+  /** \brief . */
+  virtual int rowCount(const QModelIndex& parent=QModelIndex()) const;
+
+  /** \brief . */
+  virtual int columnCount(const QModelIndex& parent=QModelIndex()) const;
+
+  /** \brief . */
+  virtual QVariant data(const QModelIndex& item, int role) const;
+
+  /** \brief . */
+  virtual QVariant headerData(
+    int section, Qt::Orientation orientation, int role=Qt::DisplayRole) const;
+
+  /** \brief . */
+  virtual void sort(int column, Qt::SortOrder order=Qt::AscendingOrder);
+
+  //@}
+
+  /** @name Getters */
+  //@{
+
+  /**
+   * \brief Gets a record describing the columns of the model.
+   *
+   * \return A record describing the columns of the model.
+   */
+  inline QSqlRecord record() const{
+    return columns;
+  }
+
+  /**
+   * \brief Gets the record at the given row, fetching it if need be.
+   *
+   * \param row The row whose record is desired.
+   * \return The record at the given row, or an empty record if there is no such row.
+   */
+  QSqlRecord record(int row) const;
+
+  //@}
+
+public slots:
+  /** @name Public Slots */
+  //@{
+
+  /**
+   * \brief Forgets every fetched song and counts the songs again.
+   */
+  void refresh();
+
+  /**
+   * \brief Applies any changes made to the given songs to the model.
+   *
+   * \param modifiedSongs The songs that were modified.
+   */
+  void updateSongs(const QSet<library_song_id_t>& modifiedSongs);
+
+  /**
+   * \brief Only shows songs whose title, artist or album contain the given text. The
+   * songs are searched for in the background and shown once they've been found.
+   *
+   * \param filter The text to look for, case insensitively. Empty shows every song.
+   */
+  void setFilter(const QString& filter);
+
+  //@}
+
+signals:
+  /** @name Signals */
+  //@{
+
+  /**
+   * \brief Emitted to have the searcher search the library.
+   *
+   * \param searchId The id of the search.
+   * \param filter The text to look for.
+   * \param orderBy The ORDER BY clause to sort the matching songs with.
+   */
+  void searchRequested(int searchId, const QString& filter, const QString& orderBy);
+
+  //@}
+
+private slots:
+  /** @name Private Slots */
+  //@{
+
+  /**
+   * \brief Switches the model over to the songs found by a search, unless a newer
+   * search has been requested since.
+   *
+   * \param result The outcome of the search.
+   */
+  void applySearchResult(const LibrarySearcher::search_result_t& result);
+
+  //@}
+
+private:
+
+  /** @name Private Types */
+  //@{
+
+  /**
+   * \brief Where a song falls in the current sort order.
+   */
+  typedef struct {
+    /** \brief The song's value in the sort column. */
+    QVariant value;
+    /** \brief The song's id, which breaks ties. */
+    library_song_id_t id;
+  } sort_key_t;
+
+  /**
+   * \brief A page of songs that have been fetched.
+   */
+  typedef struct {
+    QVector<QSqlRecord> songs;
+    /** \brief When the page was last used, for evicting the least recently used page. */
+    qint64 lastUsed;
+  } page_t;
+
+  //@}
+
+  /** @name Private Memebers */
+  //@{
+
+  /** \brief DataStore backing the client */
+  DataStore *dataStore;
+
+  /** \brief Record describing the columns in the model. */
+  QSqlRecord columns;
+
+  /** \brief Number of songs matching the current filter. */
+  int numSongs;
+
+  /** \brief Index of the column songs are sorted by. */
+  int sortColumn;
+
+  /** \brief Order songs are sorted in. */
+  Qt::SortOrder sortOrder;
+
+  /** \brief Text songs are currently filtered by. */
+  QString filter;
+
+  /** \brief Ids of the songs matching the current filter in order, if there is one. */
+  QVector<library_song_id_t> matchingIds;
+
+  /** \brief Pages that have been fetched, by page number. */
+  mutable QHash<int, page_t> pages;
+
+  /** \brief Sort key of the first song on each page fetched so far. */
+  mutable QHash<int, sort_key_t> firstKeys;
+
+  /** \brief Sort key of the last song on each page fetched so far. */
+  mutable QHash<int, sort_key_t> lastKeys;
+
+  /** \brief Incremented every time a page is used. */
+  mutable qint64 pageUses;
+
+  /** \brief Index of the id column. */
+  int idColumn;
+
+  /** \brief Index of the duration column. */
+  int durationColumn;
+
+  /** \brief Durations formatted for display. */
+  mutable DurationDisplayCache durationDisplays;
+
+  /** \brief Thread the searcher lives on. */
+  QThread *searchThread;
+
+  /** \brief Searches the library in the background. */
+  LibrarySearcher *searcher;
+
+  /** \brief Id of the latest search requested. */
+  int latestSearchId;
+
+  /** \brief Id of the search whose songs are shown, 0 if none. */
+  int searchedId;
+
+  /** \brief Text to filter by once the latest search comes back. */
+  QString requestedFilter;
+
+  /** \brief Column to sort by once the latest search comes back. */
+  int requestedSortColumn;
+
+  /** \brief Order to sort in once the latest search comes back. */
+  Qt::SortOrder requestedSortOrder;
+
+  /** \brief Started when the latest search was requested. */
+  QElapsedTimer searchTimer;
+
+  //@}
+
+  /** @name Private Functions */
+  //@{
+
+  /**
+   * \brief Gets the song at the given row, fetching its page if need be.
+   *
+   * \param row The row.
+   * \return The song at the given row, or NULL if there is no such row.
+   */
+  const QSqlRecord* songAt(int row) const;
+
+  /**
+   * \brief Fetches a page of songs, evicting the least recently used page if too many
+   * are held.
+   *
+   * \param pageNumber The page to fetch.
+   */
+  void fetchPage(int pageNumber) const;
+
+  /**
+   * \brief Fetches a page of the whole library in sort order.
+   *
+   * \param pageNumber The page to fetch.
+   * \return The songs on the page.
+   */
+  QVector<QSqlRecord> fetchSortedPage(int pageNumber) const;
+
+  /**
+   * \brief Fetches a page of the songs matching the current filter.
+   *
+   * \param pageNumber The page to fetch.
+   * \return The songs on the page.
+   */
+  QVector<QSqlRecord> fetchMatchingPage(int pageNumber) const;
+
+  /**
+   * \brief Has the searcher search the library with the requested filter and sort order,
+   * abandoning any search still in progress.
+   */
+  void requestSearch();
+
+  /**
+   * \brief Gets whether or not a search has been requested that hasn't come back yet.
+   *
+   * \return True if a search is in progress, false otherwise.
+   */
+  inline bool isSearching() const{
+    return latestSearchId != searchedId;
+  }
+
+  /**
+   * \brief Gets the ORDER BY clause for a sort order.
+   *
+   * \param column The column to sort by.
+   * \param order The order to sort in.
+   * \return The ORDER BY clause.
+   */
+  QString getOrderBy(int column, Qt::SortOrder order) const;
+
+  /** \brief Forgets every fetched page. */
+  void clearPages();
+
+  /**
+   * \brief Counts every song in the library that may be shown.
+   *
+   * \return The number of songs that may be shown.
+   */
+  int countSongs() const;
+
+  /**
+   * \brief Gets the sort key of a song.
+   *
+   * \param song The song.
+   * \return The sort key of the song.
+   */
+  sort_key_t getSortKey(const QSqlRecord& song) const;
+
+  /**
+   * \brief Gets the query used to select songs, without a terminating semicolon so that
+   * it may be further restricted.
+   *
+   * @return The query used to select songs.
+   */
+  static const QString& getDataQuery(){
+    static const QString dataQuery =
+      "SELECT " +
+      DataStore::getLibIdColName() + ", " +
+      DataStore::getLibSongColName() + ", " +
+      DataStore::getLibArtistColName() + ", " +
+      DataStore::getLibAlbumColName() + ", " +
+      DataStore::getLibDurationColName() + ", " +
+      DataStore::getLibFileColName() + " " +
+      "FROM " + DataStore::getLibraryTableName() + " WHERE " +
+      DataStore::getLibIsDeletedColName() + "=0 AND " +
+      DataStore::getLibSyncStatusColName() + " != " +
+      QString::number(DataStore::getLibNeedsAddSyncStatus());
+    return dataQuery;
+  }
+
+  /**
+   * \brief Gets the number of songs on a page.
+   *
+   * Pages are several screens tall, so the songs just above and below what's visible
+   * come along with it and scrolling rarely has to wait on the database.
+   *
+   * @return The number of songs on a page.
+   */
+  static const int& getPageSize(){
+    static const int pageSize = 256;
+    return pageSize;
+  }
+
+  /**
+   * \brief Gets the most pages that are held at once.
+   *
+   * @return The most pages that are held at once.
+   */
+  static const int& getMaxCachedPages(){
+    static const int maxCachedPages = 16;
+    return maxCachedPages;
+  }
+
+  //@}
+
+};
+
+
+}
+#endif //LIBRARY_MODEL_HPP
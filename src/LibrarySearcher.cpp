@@ -0,0 +1,113 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "LibrarySearcher.hpp"
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QElapsedTimer>
+
+
+namespace UDJ{
+
+
+LibrarySearcher::LibrarySearcher(const QString& databaseName):
+  databaseName(databaseName),
+  latestSearchId(0)
+{}
+
+void LibrarySearcher::closeConnection(){
+  if(database.isValid()){
+    database.close();
+    database = QSqlDatabase();
+    QSqlDatabase::removeDatabase(getConnectionName());
+  }
+}
+
+void LibrarySearcher::supersede(int searchId){
+  latestSearchId.fetchAndStoreOrdered(searchId);
+}
+
+bool LibrarySearcher::isSuperseded(int searchId) const{
+  return (int)latestSearchId != searchId;
+}
+
+void LibrarySearcher::search(int searchId, const QString& filter, const QString& orderBy){
+  if(isSuperseded(searchId)){
+    return;
+  }
+  //The connection has to be opened on the thread that uses it.
+  if(!database.isValid()){
+    database = QSqlDatabase::addDatabase("QSQLITE", getConnectionName());
+    database.setDatabaseName(databaseName);
+    database.open();
+  }
+
+  QElapsedTimer queryTimer;
+  queryTimer.start();
+  search_result_t result;
+  result.searchId = searchId;
+  result.filter = filter;
+  result.orderBy = orderBy;
+  result.numSongs = 0;
+
+  QSqlQuery searchQuery(database);
+  searchQuery.setForwardOnly(true);
+  if(filter.isEmpty()){
+    EXEC_SQL(
+      "Error counting library songs",
+      searchQuery.exec("SELECT COUNT(*) " + getSongsQuery() + ";"),
+      searchQuery)
+    result.numSongs = searchQuery.next() ? searchQuery.value(0).toInt() : 0;
+  }
+  else{
+    searchQuery.prepare(
+      "SELECT " + DataStore::getLibIdColName() + " " + getSongsQuery() +
+      getFilterCondition() + " " + orderBy + ";");
+    bindFilter(searchQuery, filter);
+    EXEC_SQL(
+      "Error searching library",
+      searchQuery.exec(),
+      searchQuery)
+    //Sorting on an indexed column lets the database hand matches over as it finds them,
+    //so a superseded search stops right away instead of running to the end.
+    while(searchQuery.next()){
+      if(isSuperseded(searchId)){
+        return;
+      }
+      result.ids.append(searchQuery.value(0).value<library_song_id_t>());
+    }
+    result.numSongs = result.ids.size();
+  }
+  result.queryTime = queryTimer.elapsed();
+
+  if(!isSuperseded(searchId)){
+    emit searchFinished(result);
+  }
+}
+
+void LibrarySearcher::bindFilter(QSqlQuery& query, const QString& filter){
+  QString escaped = filter;
+  escaped.replace("\\", "\\\\").replace("%", "\\%").replace("_", "\\_");
+  QString pattern = "%" + escaped + "%";
+  query.bindValue(":songFilter", pattern);
+  query.bindValue(":artistFilter", pattern);
+  query.bindValue(":albumFilter", pattern);
+}
+
+
+} //end namespace UDJ
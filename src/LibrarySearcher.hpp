@@ -0,0 +1,209 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef LIBRARY_SEARCHER_HPP
+#define LIBRARY_SEARCHER_HPP
+#include "ConfigDefs.hpp"
+#include "DataStore.hpp"
+#include <QObject>
+#include <QSqlDatabase>
+#include <QAtomicInt>
+#include <QVector>
+
+class QSqlQuery;
+
+namespace UDJ{
+
+
+/**
+ * \brief Searches the library on a database connection of its own, meant to be moved to
+ * a thread of its own so searching never holds up the GUI.
+ *
+ * Every search has an id, and a search is abandoned as soon as a newer one has been
+ * requested, so only the latest search ever runs to completion.
+ */
+class LibrarySearcher : public QObject{
+Q_OBJECT
+public:
+
+  /** @name Public Types */
+  //@{
+
+  /**
+   * \brief The outcome of a search.
+   */
+  typedef struct {
+    /** \brief The id of the search. */
+    int searchId;
+    /** \brief The text that was searched for. */
+    QString filter;
+    /** \brief The ORDER BY clause the matching songs were sorted with. */
+    QString orderBy;
+    /** \brief The number of matching songs. */
+    int numSongs;
+    /**
+     * \brief The ids of the matching songs in sort order. Empty when the filter is
+     * empty, in which case every song matches and only the number of them is counted.
+     */
+    QVector<library_song_id_t> ids;
+    /** \brief How long the search took in the database in milliseconds. */
+    qint64 queryTime;
+  } search_result_t;
+
+  //@}
+
+  /** @name Constructors */
+  //@{
+
+  /**
+   * \brief Constructs a LibrarySearcher.
+   *
+   * \param databaseName The file name of the database to search.
+   */
+  LibrarySearcher(const QString& databaseName);
+
+  //@}
+
+  /** @name Modifiers */
+  //@{
+
+  /**
+   * \brief Marks every search older than the given one as abandoned. Safe to call from
+   * any thread.
+   *
+   * \param searchId The id of the latest search.
+   */
+  void supersede(int searchId);
+
+  //@}
+
+public slots:
+  /** @name Public Slots */
+  //@{
+
+  /**
+   * \brief Searches the library, unless a newer search has already been requested.
+   *
+   * \param searchId The id of the search.
+   * \param filter The text to look for in song titles, artists and albums, case
+   * insensitively. Empty matches every song.
+   * \param orderBy The ORDER BY clause to sort the matching songs with.
+   */
+  void search(int searchId, const QString& filter, const QString& orderBy);
+
+  /**
+   * \brief Closes the searcher's database connection. Has to be called on the thread
+   * the searcher searches on, e.g. directly from that thread's finished signal.
+   */
+  void closeConnection();
+
+  //@}
+
+signals:
+  /** @name Signals */
+  //@{
+
+  /**
+   * \brief Emitted when a search runs to completion.
+   *
+   * \param result The outcome of the search.
+   */
+  void searchFinished(const LibrarySearcher::search_result_t& result);
+
+  //@}
+
+private:
+
+  /** @name Private Members */
+  //@{
+
+  /** \brief The file name of the database to search. */
+  QString databaseName;
+
+  /** \brief The searcher's own connection to the database, opened on first use. */
+  QSqlDatabase database;
+
+  /** \brief The id of the latest search requested. */
+  QAtomicInt latestSearchId;
+
+  //@}
+
+  /** @name Private Functions */
+  //@{
+
+  /**
+   * \brief Gets whether or not a search has been abandoned for a newer one.
+   *
+   * \param searchId The id of the search.
+   * \return True if a newer search has been requested, false otherwise.
+   */
+  bool isSuperseded(int searchId) const;
+
+  /**
+   * \brief Binds the text being searched for to a query.
+   *
+   * \param query The query.
+   * \param filter The text being searched for.
+   */
+  static void bindFilter(QSqlQuery& query, const QString& filter);
+
+  /**
+   * \brief Gets the name of the searcher's database connection.
+   *
+   * @return The name of the searcher's database connection.
+   */
+  static const QString& getConnectionName(){
+    static const QString connectionName = "librarySearchConn";
+    return connectionName;
+  }
+
+  /**
+   * \brief Gets the query selecting the songs that may be shown, without a terminating
+   * semicolon so that it may be further restricted.
+   *
+   * @return The query selecting the songs that may be shown.
+   */
+  static const QString& getSongsQuery(){
+    static const QString songsQuery =
+      "FROM " + DataStore::getLibraryTableName() + " WHERE " +
+      DataStore::getLibIsDeletedColName() + "=0 AND " +
+      DataStore::getLibSyncStatusColName() + " != " +
+      QString::number(DataStore::getLibNeedsAddSyncStatus());
+    return songsQuery;
+  }
+
+  /**
+   * \brief Gets the condition restricting songs to those matching a filter.
+   *
+   * @return The condition restricting songs to those matching a filter.
+   */
+  static const QString& getFilterCondition(){
+    static const QString filterCondition = " AND (" +
+      DataStore::getLibSongColName() + " LIKE :songFilter ESCAPE '\\' OR " +
+      DataStore::getLibArtistColName() + " LIKE :artistFilter ESCAPE '\\' OR " +
+      DataStore::getLibAlbumColName() + " LIKE :albumFilter ESCAPE '\\')";
+    return filterCondition;
+  }
+
+  //@}
+
+};
+
+
+}
+#endif //LIBRARY_SEARCHER_HPP
@@ -18,13 +18,12 @@
  */
 #include "LibraryView.hpp"
 #include "Utils.hpp"
-#include "MusicModel.hpp"
+#include "LibraryModel.hpp"
 #include <QHeaderView>
 #include <QContextMenuEvent>
 #include <QMenu>
 #include <QSqlQuery>
 #include <QSqlRecord>
-#include <QSortFilterProxyModel>
 #include <QProgressDialog>
 #include <QMessageBox>
 
@@ -35,16 +34,11 @@ LibraryView::LibraryView(DataStore *dataStore, QWidget* parent):
   QTableView(parent),
   dataStore(dataStore)
 {
-  libraryModel = new MusicModel(getDataQuery(), dataStore, this);
-  proxyModel = new QSortFilterProxyModel(this);
-  proxyModel->setSourceModel(libraryModel);
-  proxyModel->setFilterKeyColumn(-1);
-  proxyModel->setFilterCaseSensitivity(Qt::CaseInsensitive);
-
+  libraryModel = new LibraryModel(dataStore, this);
 
   verticalHeader()->hide();
   horizontalHeader()->setStretchLastSection(true);
-  setModel(proxyModel);
+  setModel(libraryModel);
   setSortingEnabled(true);
   setSelectionBehavior(QAbstractItemView::SelectRows);
   setContextMenuPolicy(Qt::CustomContextMenu);
@@ -54,7 +48,7 @@ LibraryView::LibraryView(DataStore *dataStore, QWidget* parent):
     dataStore,
     SIGNAL(libSongsModified(const QSet<library_song_id_t>&)), 
     libraryModel,
-    SLOT(refresh()));
+    SLOT(updateSongs(const QSet<library_song_id_t>&)));
   connect(this, SIGNAL(customContextMenuRequested(const QPoint&)),
     this, SLOT(handleContextMenuRequest(const QPoint&)));
   connect(
@@ -62,10 +56,6 @@ LibraryView::LibraryView(DataStore *dataStore, QWidget* parent):
     SIGNAL(activated(const QModelIndex&)),
     this,
     SLOT(addSongToPlaylist(const QModelIndex&)));
-
-  while(libraryModel->canFetchMore()){
-    libraryModel->fetchMore();
-  }
 }
 
 void LibraryView::configureColumns(){
@@ -110,8 +100,7 @@ void LibraryView::deleteSongs(){
     Utils::getSelectedIds<library_song_id_t>(
       this,
       libraryModel,
-      DataStore::getLibIdColName(),
-      proxyModel);
+      DataStore::getLibIdColName());
 
   QProgressDialog *deletingProgress =
     new QProgressDialog(tr("Deleting Songs..."), tr("Cancel"), 0, selectedIds.size()*2, this);
@@ -119,6 +108,8 @@ void LibraryView::deleteSongs(){
   deletingProgress->setMinimumDuration(250);
 
   dataStore->removeSongsFromLibrary(selectedIds, deletingProgress);
+  //The rows that were selected now hold whatever songs followed the deleted ones.
+  selectionModel()->clearSelection();
   if(!deletingProgress->wasCanceled()){
     emit libNeedsSync();
   }
@@ -126,15 +117,11 @@ void LibraryView::deleteSongs(){
 }
 
 void LibraryView::filterContents(const QString& filter){
-  proxyModel->setFilterFixedString(filter);
-  while(libraryModel->canFetchMore()){
-    libraryModel->fetchMore();
-  }
+  libraryModel->setFilter(filter);
 }
 
 void LibraryView::addSongToPlaylist(const QModelIndex& index){
-  QModelIndex realIndex = proxyModel->mapToSource(index);
-  QSqlRecord selectedRecord = libraryModel->record(realIndex.row());
+  QSqlRecord selectedRecord = libraryModel->record(index.row());
   dataStore->addSongToActivePlaylist(
     selectedRecord.value(DataStore::getLibIdColName()).value<library_song_id_t>());
 }
@@ -144,8 +131,7 @@ void LibraryView::addSongsToActivePlaylist(){
     Utils::getSelectedIds<library_song_id_t>(
       this,
       libraryModel,
-      DataStore::getLibIdColName(),
-      proxyModel));
+      DataStore::getLibIdColName()));
 }
 
 
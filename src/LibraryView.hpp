@@ -24,12 +24,11 @@
 #include <QModelIndex>
 
 class QContextMenuEvent;
-class QSortFilterProxyModel;
 class QProgressDialog;
 
 namespace UDJ{
 
-class MusicModel;
+class LibraryModel;
 
 /**
  *\brief A class for viewing the current contents of the users music library.
@@ -91,10 +90,7 @@ private:
   DataStore *dataStore;
 
   /** \brief The model backing LibraryView.  */
-  MusicModel *libraryModel;
-
-  /** \brief The proxymodel backing LibraryView.  */
-  QSortFilterProxyModel *proxyModel;
+  LibraryModel *libraryModel;
 
   /** \brief Action used for deleting songs from the library. */
   QAction *deleteSongAction;
@@ -162,27 +158,6 @@ private slots:
    */
   void addSongsToActivePlaylist();
 
-  /**
-   * \brief Gets the query that should be used to obtain the data to display.
-   *
-   * @return The query that should be used to obtain the data to display.
-   */
-  static const QString& getDataQuery(){
-    static const QString dataQuery = 
-      "SELECT " +
-      DataStore::getLibIdColName() + ", " +
-      DataStore::getLibSongColName() + ", " +
-      DataStore::getLibArtistColName() + ", " +
-      DataStore::getLibAlbumColName() + ", " +
-      DataStore::getLibDurationColName() + ", " +
-      DataStore::getLibFileColName() + " " +
-      "FROM " + DataStore::getLibraryTableName() + " WHERE " +
-      DataStore::getLibIsDeletedColName() + "=0 AND " +
-      DataStore::getLibSyncStatusColName() + " != " +
-      QString::number(DataStore::getLibNeedsAddSyncStatus()) + ";";
-    return dataQuery;
-  }
-
   //@}
 };
 
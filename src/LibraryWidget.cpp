@@ -22,6 +22,7 @@
 #include <QGridLayout>
 #include <QLineEdit>
 #include <QLabel>
+#include <QTimer>
 
 namespace UDJ{
 
@@ -54,11 +55,24 @@ LibraryWidget::LibraryWidget(DataStore* dataStore, QWidget* parent):
 
   setLayout(layout);
 
+  searchDelayTimer = new QTimer(this);
+  searchDelayTimer->setSingleShot(true);
+  searchDelayTimer->setInterval(getSearchDelay());
   connect(
     searchEdit,
     SIGNAL(textChanged(const QString&)),
-    libraryView,
-    SLOT(filterContents(const QString&)));
+    searchDelayTimer,
+    SLOT(start()));
+  connect(
+    searchEdit,
+    SIGNAL(returnPressed()),
+    this,
+    SLOT(search()));
+  connect(
+    searchDelayTimer,
+    SIGNAL(timeout()),
+    this,
+    SLOT(search()));
 
   connect(
     libraryView,
@@ -67,5 +81,10 @@ LibraryWidget::LibraryWidget(DataStore* dataStore, QWidget* parent):
     SIGNAL(libNeedsSync()));
 }
 
+void LibraryWidget::search(){
+  searchDelayTimer->stop();
+  libraryView->filterContents(searchEdit->text());
+}
+
 
 } //end namespace
@@ -22,6 +22,7 @@
 #include <QWidget>
 
 class QLineEdit;
+class QTimer;
 
 namespace UDJ{
 
@@ -59,6 +60,15 @@ signals:
 
 //@}
 
+private slots:
+  /** @name Private Slots */
+  //@{
+
+  /** \brief Filters the library by whatever has been typed into the search box. */
+  void search();
+
+  //@}
+
 private:
   /** @name Private Members */
   //@{
@@ -72,6 +82,27 @@ private:
   /** \brief A line edit used to search the library. */
   QLineEdit *searchEdit;
 
+  /**
+   * \brief Restarted on every keystroke so the library is only searched once typing
+   * pauses.
+   */
+  QTimer *searchDelayTimer;
+
+  //@}
+
+  /** @name Private Functions */
+  //@{
+
+  /**
+   * \brief Gets how long typing has to pause before the library is searched.
+   *
+   * @return How long typing has to pause before the library is searched in milliseconds.
+   */
+  static const int& getSearchDelay(){
+    static const int searchDelay = 200;
+    return searchDelay;
+  }
+
   //@}
 
 };
@@ -49,6 +49,20 @@ LoginWidget::LoginWidget(QWidget *parent)
     SIGNAL(authFailed(const QString)),
     this,
     SLOT(displayLoginFailedMessage(const QString)));
+  //Get the handshakes with the server out of the way while the user is still typing.
+  connect(
+    usernameBox,
+    SIGNAL(textEdited(const QString&)),
+    serverConnection,
+    SLOT(prewarm()));
+  connect(
+    passwordBox,
+    SIGNAL(textEdited(const QString&)),
+    serverConnection,
+    SLOT(prewarm()));
+  if(DataStore::hasValidSavedPassword()){
+    serverConnection->prewarm();
+  }
 }
 
 void LoginWidget::setupUi(){
@@ -27,6 +27,8 @@
 #include "Logger.hpp"
 #include "AboutWidget.hpp"
 #include "LogViewer.hpp"
+#include "DiagnosticsView.hpp"
+#include "TrafficReplayer.hpp"
 #include "SetLocationDialog.hpp"
 #include "ParticipantsView.hpp"
 #include <QCloseEvent>
@@ -44,6 +46,7 @@
 #include <QMessageBox>
 #include <QInputDialog>
 #include <QDesktopServices>
+#include <QStatusBar>
 
 
 
@@ -81,7 +84,17 @@ MetaWindow::MetaWindow(
   else{
     setWindowState(Qt::WindowMaximized);
   }
-  if(dataStore->hasPlayerId()){
+  QString replayFile =
+    QString::fromLocal8Bit(qgetenv(TrafficReplayer::getReplayFileEnvName().constData()));
+  if(!replayFile.isEmpty()){
+    double replaySpeed = 1;
+    QByteArray speedSetting = qgetenv(TrafficReplayer::getReplaySpeedEnvName().constData());
+    if(!speedSetting.isEmpty()){
+      replaySpeed = speedSetting.toDouble();
+    }
+    dataStore->replayTraffic(replayFile, replaySpeed);
+  }
+  else if(dataStore->hasPlayerId()){
     dataStore->playPlayer();
     dataStore->startPlaylistAutoRefresh();
     dataStore->startParticipantsAutoRefresh();
@@ -141,6 +154,29 @@ MetaWindow::MetaWindow(
     SIGNAL(playerPasswordRemoveError(const QString&)),
     this,
     SLOT(onPlayerPasswordRemoveError(const QString&)));
+
+  connect(
+    dataStore,
+    SIGNAL(libraryReconciled(int)),
+    this,
+    SLOT(onLibraryReconciled(int)));
+
+  connect(
+    dataStore,
+    SIGNAL(libraryReconcileError(const QString&)),
+    this,
+    SLOT(onLibraryReconcileError(const QString&)));
+
+  connect(
+    dataStore,
+    SIGNAL(offlineModeChanged(bool)),
+    this,
+    SLOT(onOfflineModeChanged(bool)));
+  connect(
+    dataStore,
+    SIGNAL(activePlaylistModError(const QString&)),
+    this,
+    SLOT(onActivePlaylistModError(const QString&)));
 }
 
 void MetaWindow::closeEvent(QCloseEvent *event){
@@ -180,6 +216,13 @@ bool MetaWindow::eventFilter(QObject* /*obj*/, QEvent *event){
   return false;
 }
 
+void MetaWindow::changeEvent(QEvent *event){
+  if(event->type() == QEvent::WindowStateChange){
+    dataStore->setPlayerMinimized(isMinimized());
+  }
+  QMainWindow::changeEvent(event);
+}
+
 bool MetaWindow::hasItunesLibrary(){
   QString musicDir = QDesktopServices::storageLocation(QDesktopServices::MusicLocation);
   QDir iTunesDir = QDir(musicDir).filePath("iTunes");
@@ -346,8 +389,10 @@ void MetaWindow::createActions(){
   addSongAction->setShortcut(tr("Ctrl+D"));
   viewLogAction = new QAction(tr("View Lo&g"), this);
   viewLogAction->setShortcut(tr("Ctrl+G"));
+  viewDiagnosticsAction = new QAction(tr("Network &Diagnostics"), this);
   viewAboutAction = new QAction(tr("About"), this);
   rescanItunesAction = new QAction(tr("Rescan iTunes Library"), this);
+  reconcileLibraryAction = new QAction(tr("Reconcile Library With Server"), this);
   #if IS_WINDOWS_BUILD
   checkUpdateAction = new QAction(tr("Check For Updates"), this);
   connect(checkUpdateAction, SIGNAL(triggered()), updater, SLOT(CheckNow()));
@@ -356,8 +401,10 @@ void MetaWindow::createActions(){
   connect(quitAction, SIGNAL(triggered()), this, SLOT(close()));
   connect(addSongAction, SIGNAL(triggered()), this, SLOT(addSongToLibrary()));
   connect(viewLogAction, SIGNAL(triggered()), this, SLOT(displayLogView()));
+  connect(viewDiagnosticsAction, SIGNAL(triggered()), this, SLOT(displayDiagnosticsView()));
   connect(viewAboutAction, SIGNAL(triggered()), this, SLOT(displayAboutWidget()));
   connect(rescanItunesAction, SIGNAL(triggered()), this, SLOT(scanItunesLibrary()));
+  connect(reconcileLibraryAction, SIGNAL(triggered()), dataStore, SLOT(reconcileLibrary()));
 }
 
 void MetaWindow::setupMenus(){
@@ -367,6 +414,7 @@ void MetaWindow::setupMenus(){
   if(hasItunesLibrary()){
     musicMenu->addAction(rescanItunesAction);
   }
+  musicMenu->addAction(reconcileLibraryAction);
   musicMenu->addSeparator();
   musicMenu->addAction(quitAction);
 
@@ -374,6 +422,7 @@ void MetaWindow::setupMenus(){
 
   QMenu *helpMenu = menuBar()->addMenu(tr("&Help"));
   helpMenu->addAction(viewLogAction);
+  helpMenu->addAction(viewDiagnosticsAction);
   helpMenu->addAction(viewAboutAction);
   #if IS_WINDOWS_BUILD
   helpMenu->addAction(checkUpdateAction);
@@ -414,6 +463,36 @@ void MetaWindow::onPlayerPasswordRemoveError(const QString& /*errMessage*/){
       "player's password. We're super sorry. Can you try it again in a little bit?"));
 }
 
+void MetaWindow::onLibraryReconciled(int numSongsResynced){
+  if(numSongsResynced > 0){
+    syncLibrary();
+  }
+  else{
+    QMessageBox::information(this, tr("Library In Sync"),
+      tr("Your library is already in sync with the server."));
+  }
+}
+
+void MetaWindow::onLibraryReconcileError(const QString& /*errMessage*/){
+  QMessageBox::critical(this, tr("Error Reconciling Library"), tr("Oops. We couldn't compare "
+      "your library with the server. Can you try it again in a little bit?"));
+}
+
+void MetaWindow::onActivePlaylistModError(const QString& /*errMessage*/){
+  statusBar()->showMessage(tr("The server wouldn't accept your playlist change, so it's "
+    "been undone."), getStatusMessageTimeout());
+}
+
+void MetaWindow::onOfflineModeChanged(bool offline){
+  if(offline){
+    statusBar()->showMessage(tr("Can't reach the UDJ server. Your playlist changes will "
+      "be sent once it's back."));
+  }
+  else{
+    statusBar()->clearMessage();
+  }
+}
+
 void MetaWindow::setPlayerPassword(){
   bool ok;
   QString newPlayerPassword = QInputDialog::getText(this, tr("Set Player Password"),
@@ -435,14 +514,17 @@ void MetaWindow::setPlayerLocation(){
 
 void MetaWindow::displayLibrary(){
   contentStack->setCurrentWidget(libraryWidget);
+  dataStore->setParticipantsShown(false);
 }
 
 void MetaWindow::displayPlaylist(){
   contentStack->setCurrentWidget(playlistView);
+  dataStore->setParticipantsShown(false);
 }
 
 void MetaWindow::displayParticipants(){
   contentStack->setCurrentWidget(participantsView);
+  dataStore->setParticipantsShown(true);
 }
 
 void MetaWindow::syncLibrary(){
@@ -508,6 +590,11 @@ void MetaWindow::displayLogView(){
   viewer->show();
 }
 
+void MetaWindow::displayDiagnosticsView(){
+  DiagnosticsView *diagnostics = new DiagnosticsView();
+  diagnostics->show();
+}
+
 void MetaWindow::displayAboutWidget(){
   AboutWidget *about = new AboutWidget();
   about->show();
@@ -91,6 +91,11 @@ protected:
   /** \brief . */
   bool eventFilter(QObject *obj, QEvent *event);
 
+  /**
+   * \brief Lets the data store know when the window is minimized or restored.
+   */
+  virtual void changeEvent(QEvent *event);
+
   //@}
 
 private slots:
@@ -109,6 +114,9 @@ private slots:
   /** \brief Shows the logger view. */
   void displayLogView();
 
+  /** \brief Shows the network diagnostics. */
+  void displayDiagnosticsView();
+
   /** \brief Shows the about widget. */
   void displayAboutWidget();
 
@@ -202,6 +210,36 @@ private slots:
    */
   void checkForITunes();
 
+  /**
+   * \brief Performs necessary actions once the library has been reconciled with the server.
+   *
+   * \param numSongsResynced The number of songs that were marked for resync.
+   */
+  void onLibraryReconciled(int numSongsResynced);
+
+  /**
+   * \brief Performs necessary actions when there is an error reconciling the library.
+   *
+   * \param errMessage A message describing the error.
+   */
+  void onLibraryReconcileError(const QString& errMessage);
+
+  /**
+   * \brief Lets the user know whether changes are only being kept locally because the
+   * server can't be reached.
+   *
+   * \param offline Whether or not the player is offline.
+   */
+  void onOfflineModeChanged(bool offline);
+
+  /**
+   * \brief Lets the user know a playlist change they made was refused by the server and
+   * has been undone.
+   *
+   * \param errMessage A message describing the error.
+   */
+  void onActivePlaylistModError(const QString& errMessage);
+
   //@}
 
 private:
@@ -226,6 +264,9 @@ private:
   /** \brief Triggers display of the log viewer */
   QAction *viewLogAction;
 
+  /** \brief Triggers display of the network diagnostics */
+  QAction *viewDiagnosticsAction;
+
   /** \brief Triggers display of the about widget */
   QAction *viewAboutAction;
 
@@ -235,6 +276,9 @@ private:
   /** \brief Triggers rescanning of the iTunes Library. */
   QAction *rescanItunesAction;
 
+  /** \brief Triggers reconciliation of the library with the server. */
+  QAction *reconcileLibraryAction;
+
   /**
    * \brief Triggers the setting of the player password.
    */
@@ -328,6 +372,16 @@ private:
    */
   void disconnectSyncSignals();
 
+  /**
+   * \brief Gets how long transient messages stay in the status bar.
+   *
+   * \return How long transient messages stay in the status bar in milliseconds.
+   */
+  static const int& getStatusMessageTimeout(){
+    static const int statusMessageTimeout = 8000;
+    return statusMessageTimeout;
+  }
+
   //@}
 
 };
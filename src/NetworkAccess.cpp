@@ -0,0 +1,88 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "NetworkAccess.hpp"
+#include "Logger.hpp"
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+#include <QUrl>
+
+
+namespace UDJ{
+
+
+NetworkAccess* NetworkAccess::myInstance = NULL;
+
+
+NetworkAccess::NetworkAccess():
+  QObject(),
+  prewarmReply(0),
+  connectionSetupTime(-1)
+{
+  manager = new QNetworkAccessManager(this);
+}
+
+NetworkAccess* NetworkAccess::instance(){
+  if(myInstance == NULL){
+    myInstance = new NetworkAccess();
+  }
+  return myInstance;
+}
+
+void NetworkAccess::deleteNetworkAccess(){
+  if(myInstance != NULL){
+    delete myInstance;
+    myInstance = NULL;
+  }
+}
+
+bool NetworkAccess::isWarm() const{
+  return warmTimer.isValid() && warmTimer.elapsed() < getWarmLifetime();
+}
+
+void NetworkAccess::prewarm(const QUrl& url){
+  if(prewarmReply != 0 || isWarm()){
+    return;
+  }
+  //Any answer at all means the handshakes are done, so ask for as little as possible.
+  prewarmTimer.start();
+  prewarmReply = manager->head(QNetworkRequest(url));
+  connect(prewarmReply, SIGNAL(finished()), this, SLOT(onPrewarmFinished()));
+}
+
+void NetworkAccess::onPrewarmFinished(){
+  qint64 elapsed = prewarmTimer.elapsed();
+  //An HTTP status means the server answered, even if it didn't like the request.
+  bool answered = prewarmReply->error() == QNetworkReply::NoError ||
+    prewarmReply->attribute(QNetworkRequest::HttpStatusCodeAttribute).isValid();
+  if(answered){
+    connectionSetupTime = elapsed;
+    warmTimer.start();
+    Logger::instance()->log("Connection to " + prewarmReply->url().host() +
+      " prewarmed, setup took " + QString::number(elapsed) + "ms");
+  }
+  else{
+    Logger::instance()->log("Prewarming connection failed: " + prewarmReply->errorString());
+  }
+  prewarmReply->deleteLater();
+  prewarmReply = 0;
+}
+
+
+} //end namespace UDJ
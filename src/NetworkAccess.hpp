@@ -0,0 +1,178 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NETWORK_ACCESS_HPP
+#define NETWORK_ACCESS_HPP
+#include <QObject>
+#include <QElapsedTimer>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QUrl;
+
+namespace UDJ{
+
+
+/**
+ * \brief Singleton owning the network access manager shared by every server connection.
+ *
+ * Qt keeps a pool of open connections per network access manager, so sharing one
+ * manager means a connection set up while logging in (TCP and TLS handshakes included)
+ * is still there for the requests made once the player is running. The connection can
+ * also be opened ahead of time, before the first real request needs it.
+ */
+class NetworkAccess : public QObject{
+Q_OBJECT
+public:
+
+  /** @name Creation/Destruction Functions */
+  //@{
+
+  /**
+   * \brief Retrieves the instance of the network access layer.
+   *
+   * \return The instance of the network access layer.
+   */
+  static NetworkAccess* instance();
+
+  /**
+   * \brief Deletes the instance of the network access layer. This should only be called
+   * when the program is finished and nothing will talk to the server anymore.
+   */
+  static void deleteNetworkAccess();
+
+  //@}
+
+  /** @name Accessors */
+  //@{
+
+  /**
+   * \brief Gets the network access manager every request should be issued through.
+   *
+   * \return The shared network access manager.
+   */
+  inline QNetworkAccessManager* getManager() const{
+    return manager;
+  }
+
+  /**
+   * \brief Gets how long it took to set up the last prewarmed connection, i.e. the TCP
+   * and TLS handshakes plus a single round trip.
+   *
+   * \return How long setting up the connection took in milliseconds, or -1 if no
+   * connection has been prewarmed.
+   */
+  inline qint64 getConnectionSetupTime() const{
+    return connectionSetupTime;
+  }
+
+  /**
+   * \brief Gets whether or not a connection was recently opened and is likely still
+   * waiting in the pool.
+   *
+   * \return True if a connection is likely ready for use, false otherwise.
+   */
+  bool isWarm() const;
+
+  //@}
+
+  /** @name Modifiers */
+  //@{
+
+  /**
+   * \brief Opens a connection to the host of the given url so that it's ready by the
+   * time a real request is made. Does nothing if a connection is already warm or being
+   * opened.
+   *
+   * \param url A url on the host to connect to.
+   */
+  void prewarm(const QUrl& url);
+
+  //@}
+
+private slots:
+
+  /** @name Private Slots */
+  //@{
+
+  /** \brief Records how long setting up the prewarmed connection took. */
+  void onPrewarmFinished();
+
+  //@}
+
+private:
+
+  /** @name Constructor(s) */
+  //@{
+
+  /** \brief . */
+  NetworkAccess();
+
+  /** \brief . */
+  NetworkAccess(NetworkAccess const&);
+
+  /** \brief . */
+  NetworkAccess& operator=(NetworkAccess const&);
+
+  //@}
+
+  /** @name Private Members */
+  //@{
+
+  /** \brief Singleton instance of the network access layer. */
+  static NetworkAccess* myInstance;
+
+  /** \brief The shared network access manager. */
+  QNetworkAccessManager *manager;
+
+  /** \brief The reply for the prewarm request in flight, if any. */
+  QNetworkReply *prewarmReply;
+
+  /** \brief Started when the prewarm request is issued. */
+  QElapsedTimer prewarmTimer;
+
+  /** \brief Started when a prewarmed connection is ready. */
+  QElapsedTimer warmTimer;
+
+  /** \brief How long the last prewarmed connection took to set up. */
+  qint64 connectionSetupTime;
+
+  //@}
+
+  /** @name Private Functions */
+  //@{
+
+  /**
+   * \brief Gets how long a connection is assumed to stay in the pool while idle.
+   *
+   * This is on the conservative side of how long Qt keeps idle connections around.
+   *
+   * @return How long a connection is assumed to stay warm in milliseconds.
+   */
+  static const qint64& getWarmLifetime(){
+    static const qint64 warmLifetime = 60000;
+    return warmLifetime;
+  }
+
+  //@}
+
+};
+
+
+} //end namespace UDJ
+#endif //NETWORK_ACCESS_HPP
@@ -0,0 +1,195 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "NetworkMetrics.hpp"
+#include "NetworkAccess.hpp"
+#include "qt-json/json.h"
+#include <QDateTime>
+#include <QtAlgorithms>
+
+
+namespace UDJ{
+
+
+NetworkMetrics* NetworkMetrics::myInstance = NULL;
+
+
+NetworkMetrics::NetworkMetrics():
+  QObject()
+{}
+
+NetworkMetrics* NetworkMetrics::instance(){
+  if(myInstance == NULL){
+    myInstance = new NetworkMetrics();
+  }
+  return myInstance;
+}
+
+void NetworkMetrics::deleteNetworkMetrics(){
+  if(myInstance != NULL){
+    delete myInstance;
+    myInstance = NULL;
+  }
+}
+
+void NetworkMetrics::record(
+  const QString& endpoint,
+  int status,
+  int attempts,
+  qint64 bytesSent,
+  qint64 bytesReceived,
+  qint64 queueWait,
+  qint64 latency,
+  qint64 processing,
+  qint64 parsing)
+{
+  if(!metrics.contains(endpoint)){
+    endpoint_metrics_t fresh;
+    fresh.requests = 0;
+    fresh.retries = 0;
+    fresh.bytesSent = 0;
+    fresh.bytesReceived = 0;
+    for(int i=0; i<NUM_TIMINGS; ++i){
+      fresh.histograms[i].fill(0, getBucketBounds().size());
+    }
+    metrics.insert(endpoint, fresh);
+  }
+  endpoint_metrics_t& endpointMetrics = metrics[endpoint];
+  ++endpointMetrics.requests;
+  endpointMetrics.retries += qMax(attempts - 1, 0);
+  endpointMetrics.bytesSent += bytesSent*qMax(attempts, 1);
+  endpointMetrics.bytesReceived += bytesReceived;
+  ++endpointMetrics.statusCounts[status];
+  addSample(endpointMetrics.histograms[QUEUE_TIMING], queueWait*1000);
+  addSample(endpointMetrics.histograms[LATENCY_TIMING], latency*1000);
+  addSample(endpointMetrics.histograms[PROCESSING_TIMING], processing*1000);
+  addSample(endpointMetrics.histograms[PARSING_TIMING], parsing);
+  emit metricsChanged();
+}
+
+void NetworkMetrics::reset(){
+  metrics.clear();
+  emit metricsChanged();
+}
+
+qint64 NetworkMetrics::getPercentile(
+  const QString& endpoint, Timing timing, int percentile) const
+{
+  if(!metrics.contains(endpoint)){
+    return -1;
+  }
+  return getPercentile(metrics[endpoint].histograms[timing], percentile);
+}
+
+void NetworkMetrics::addSample(QVector<qint64>& histogram, qint64 value){
+  if(value < 0){
+    return;
+  }
+  const QVector<qint64>& bounds = getBucketBounds();
+  int bucket = qLowerBound(bounds.begin(), bounds.end(), value) - bounds.begin();
+  ++histogram[qMin(bucket, bounds.size() - 1)];
+}
+
+qint64 NetworkMetrics::getPercentile(const QVector<qint64>& histogram, int percentile){
+  qint64 total = 0;
+  Q_FOREACH(qint64 count, histogram){
+    total += count;
+  }
+  if(total == 0){
+    return -1;
+  }
+  //The smallest bucket holding at least the requested share of all samples.
+  qint64 wanted = qMax((total*percentile + 99)/100, (qint64)1);
+  qint64 seen = 0;
+  for(int i=0; i<histogram.size(); ++i){
+    seen += histogram[i];
+    if(seen >= wanted){
+      return getBucketBounds()[i];
+    }
+  }
+  return getBucketBounds().last();
+}
+
+const QVector<qint64>& NetworkMetrics::getBucketBounds(){
+  static QVector<qint64> bucketBounds;
+  if(bucketBounds.isEmpty()){
+    //10us up to 5 minutes, each bucket a quarter larger than the last.
+    qint64 bound = 10;
+    while(bound < Q_INT64_C(300000000)){
+      bucketBounds.append(bound);
+      bound = qMax(bound + 1, bound*5/4);
+    }
+    bucketBounds.append(bound);
+  }
+  return bucketBounds;
+}
+
+QVariantMap NetworkMetrics::toVariant() const{
+  const QVector<qint64>& bounds = getBucketBounds();
+  QVariantMap endpoints;
+  QMap<QString, endpoint_metrics_t>::const_iterator it = metrics.constBegin();
+  for(; it != metrics.constEnd(); ++it){
+    const endpoint_metrics_t& endpointMetrics = it.value();
+    QVariantMap endpoint;
+    endpoint["requests"] = endpointMetrics.requests;
+    endpoint["retries"] = endpointMetrics.retries;
+    endpoint["bytes_sent"] = endpointMetrics.bytesSent;
+    endpoint["bytes_received"] = endpointMetrics.bytesReceived;
+
+    QVariantMap statusCodes;
+    QMap<int, qint64>::const_iterator statusIt = endpointMetrics.statusCounts.constBegin();
+    for(; statusIt != endpointMetrics.statusCounts.constEnd(); ++statusIt){
+      statusCodes[QString::number(statusIt.key())] = statusIt.value();
+    }
+    endpoint["status_codes"] = statusCodes;
+
+    for(int i=0; i<NUM_TIMINGS; ++i){
+      const QVector<qint64>& histogram = endpointMetrics.histograms[i];
+      QVariantMap timing;
+      timing["p50"] = getPercentile(histogram, 50);
+      timing["p95"] = getPercentile(histogram, 95);
+      timing["p99"] = getPercentile(histogram, 99);
+      //Only the buckets that were actually hit, as [upper bound, count] pairs.
+      QVariantList buckets;
+      for(int j=0; j<histogram.size(); ++j){
+        if(histogram[j] != 0){
+          buckets.append(QVariantList() << bounds[j] << histogram[j]);
+        }
+      }
+      timing["buckets"] = buckets;
+      endpoint[getTimingNames()[i]] = timing;
+    }
+    endpoints[it.key()] = endpoint;
+  }
+
+  QVariantMap toReturn;
+  toReturn["exported_at"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+  toReturn["timing_unit"] = "us";
+  qint64 connectionSetup = NetworkAccess::instance()->getConnectionSetupTime();
+  toReturn["connection_setup"] = connectionSetup < 0 ? connectionSetup : connectionSetup*1000;
+  toReturn["endpoints"] = endpoints;
+  return toReturn;
+}
+
+QByteArray NetworkMetrics::toJSON() const{
+  bool success;
+  return QtJson::Json::serialize(toVariant(), success);
+}
+
+
+} //end namespace UDJ
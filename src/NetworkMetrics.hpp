@@ -0,0 +1,264 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef NETWORK_METRICS_HPP
+#define NETWORK_METRICS_HPP
+#include <QObject>
+#include <QMap>
+#include <QVector>
+#include <QVariantMap>
+#include <QStringList>
+
+namespace UDJ{
+
+
+/**
+ * \brief Singleton keeping track of how the traffic to the server performs, broken down
+ * by endpoint.
+ *
+ * For every endpoint it counts requests, retries, bytes sent and received and the http
+ * status codes seen. Four timings are kept as histograms: how long a request waited in
+ * the scheduler's queue, how long the network and server took to answer it, how long
+ * we took to process the answer and how much of our time went into parsing its JSON.
+ * Telling those apart tells whether slowness comes from
+ * the client, the venue's network or the server.
+ *
+ * Histogram buckets grow geometrically, so percentiles are accurate to within a quarter
+ * of their value no matter how long a request takes while the memory used stays fixed.
+ * They are kept in microseconds because parsing a small reply takes well under a
+ * millisecond.
+ */
+class NetworkMetrics : public QObject{
+Q_OBJECT
+public:
+
+  /** @name Public Types */
+  //@{
+
+  /**
+   * \brief The timings kept for each endpoint.
+   */
+  enum Timing{
+    QUEUE_TIMING=0,
+    LATENCY_TIMING,
+    PROCESSING_TIMING,
+    PARSING_TIMING,
+    NUM_TIMINGS
+  };
+
+  /**
+   * \brief Everything recorded about a single endpoint.
+   */
+  typedef struct {
+    /** \brief Number of final replies received. */
+    qint64 requests;
+    /** \brief Number of times a request was sent again after a transient failure. */
+    qint64 retries;
+    qint64 bytesSent;
+    qint64 bytesReceived;
+    /** \brief Number of replies for each http status code, 0 meaning no answer at all. */
+    QMap<int, qint64> statusCounts;
+    /** \brief Histogram of each timing, one count per bucket. */
+    QVector<qint64> histograms[NUM_TIMINGS];
+  } endpoint_metrics_t;
+
+  //@}
+
+  /** @name Creation/Destruction Functions */
+  //@{
+
+  /**
+   * \brief Retrieves the instance of the network metrics.
+   *
+   * \return The instance of the network metrics.
+   */
+  static NetworkMetrics* instance();
+
+  /**
+   * \brief Deletes the instance of the network metrics. This should only be called when
+   * the program is finished and nothing will talk to the server anymore.
+   */
+  static void deleteNetworkMetrics();
+
+  //@}
+
+  /** @name Recording */
+  //@{
+
+  /**
+   * \brief Records a final reply from the server.
+   *
+   * \param endpoint The name of the endpoint the request was for.
+   * \param status The http status code of the reply, or 0 if the server never answered.
+   * \param attempts How many times the request was sent.
+   * \param bytesSent The size of the request body.
+   * \param bytesReceived The size of the reply body.
+   * \param queueWait How long the request waited to be issued in milliseconds.
+   * \param latency How long the reply took to arrive once issued in milliseconds.
+   * \param processing How long handling the reply took in milliseconds.
+   * \param parsing How long parsing the reply body took in microseconds, whether it was
+   * parsed as it arrived or while being handled, or -1 if it had no JSON body to parse.
+   */
+  void record(
+    const QString& endpoint,
+    int status,
+    int attempts,
+    qint64 bytesSent,
+    qint64 bytesReceived,
+    qint64 queueWait,
+    qint64 latency,
+    qint64 processing,
+    qint64 parsing);
+
+  /** \brief Forgets everything recorded so far. */
+  void reset();
+
+  //@}
+
+  /** @name Accessors */
+  //@{
+
+  /**
+   * \brief Gets the names of the endpoints something has been recorded for.
+   *
+   * \return The names of the endpoints, sorted.
+   */
+  inline QStringList getEndpoints() const{
+    return metrics.keys();
+  }
+
+  /**
+   * \brief Gets everything recorded about an endpoint.
+   *
+   * \param endpoint The name of the endpoint.
+   * \return Everything recorded about the endpoint.
+   */
+  inline endpoint_metrics_t getMetrics(const QString& endpoint) const{
+    return metrics.value(endpoint);
+  }
+
+  /**
+   * \brief Estimates a percentile of one of an endpoint's timings.
+   *
+   * \param endpoint The name of the endpoint.
+   * \param timing The timing in question.
+   * \param percentile The percentile wanted, between 0 and 100.
+   * \return The estimated percentile in microseconds, or -1 if nothing was recorded.
+   */
+  qint64 getPercentile(const QString& endpoint, Timing timing, int percentile) const;
+
+  /**
+   * \brief Gets everything recorded as a map which can be serialized to JSON.
+   *
+   * \return Everything recorded.
+   */
+  QVariantMap toVariant() const;
+
+  /**
+   * \brief Gets everything recorded as JSON.
+   *
+   * \return Everything recorded, as JSON.
+   */
+  QByteArray toJSON() const;
+
+  //@}
+
+signals:
+
+  /** @name Signals */
+  //@{
+
+  /** \brief Emitted when something new has been recorded or the metrics were reset. */
+  void metricsChanged();
+
+  //@}
+
+private:
+
+  /** @name Constructor(s) */
+  //@{
+
+  /** \brief . */
+  NetworkMetrics();
+
+  /** \brief . */
+  NetworkMetrics(NetworkMetrics const&);
+
+  /** \brief . */
+  NetworkMetrics& operator=(NetworkMetrics const&);
+
+  //@}
+
+  /** @name Private Members */
+  //@{
+
+  /** \brief Singleton instance of the network metrics. */
+  static NetworkMetrics* myInstance;
+
+  /** \brief Everything recorded, by endpoint name. */
+  QMap<QString, endpoint_metrics_t> metrics;
+
+  //@}
+
+  /** @name Private Functions */
+  //@{
+
+  /**
+   * \brief Adds a sample to a histogram.
+   *
+   * \param histogram The histogram.
+   * \param value The sample in microseconds. Negative samples are ignored.
+   */
+  static void addSample(QVector<qint64>& histogram, qint64 value);
+
+  /**
+   * \brief Estimates a percentile of a histogram.
+   *
+   * \param histogram The histogram.
+   * \param percentile The percentile wanted, between 0 and 100.
+   * \return The upper bound of the bucket holding the percentile, or -1 if the histogram
+   * is empty.
+   */
+  static qint64 getPercentile(const QVector<qint64>& histogram, int percentile);
+
+  /**
+   * \brief Gets the upper bound of each histogram bucket. The last bucket holds anything
+   * larger than the bound before it.
+   *
+   * @return The upper bound of each histogram bucket in microseconds.
+   */
+  static const QVector<qint64>& getBucketBounds();
+
+  /**
+   * \brief Gets the name used for each timing when exporting.
+   *
+   * @return The name used for each timing, indexed by Timing.
+   */
+  static const QStringList& getTimingNames(){
+    static const QStringList timingNames =
+      QStringList() << "queue_wait" << "latency" << "processing" << "parsing";
+    return timingNames;
+  }
+
+  //@}
+
+};
+
+
+} //end namespace UDJ
+#endif //NETWORK_METRICS_HPP
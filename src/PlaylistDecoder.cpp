@@ -0,0 +1,255 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ * 
+ * This file is part of UDJ.
+ * 
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "PlaylistDecoder.hpp"
+#include <QVariantMap>
+#include <QVariantList>
+
+namespace UDJ{
+
+
+PlaylistDecoder::PlaylistDecoder(){
+  resetSnapshot();
+}
+
+void PlaylistDecoder::decodeVariant(
+  const QVariant& playlist,
+  playlist_snapshot_t& snapshot)
+{
+  PlaylistDecoder decoder;
+  decoder.replay(playlist);
+  decoder.takeSnapshot(snapshot);
+}
+
+void PlaylistDecoder::takeSnapshot(playlist_snapshot_t& snapshot){
+  //Everything in the snapshot is implicitly shared, so handing it over and starting a
+  //fresh one never copies the entries.
+  snapshot = this->snapshot;
+  resetSnapshot();
+  contexts.clear();
+  currentKey.clear();
+}
+
+void PlaylistDecoder::startObject(){
+  startContainer(true);
+}
+
+void PlaylistDecoder::endObject(){
+  endContainer();
+}
+
+void PlaylistDecoder::startArray(){
+  startContainer(false);
+}
+
+void PlaylistDecoder::endArray(){
+  endContainer();
+}
+
+void PlaylistDecoder::key(const QString& name){
+  currentKey = name;
+}
+
+void PlaylistDecoder::stringValue(const QString& value){
+  scalarValue(value);
+}
+
+void PlaylistDecoder::numberValue(const QByteArray& number){
+  scalarValue(QString::fromLatin1(number.constData(), number.size()));
+}
+
+void PlaylistDecoder::boolValue(bool /*value*/){
+  countVote();
+}
+
+void PlaylistDecoder::nullValue(){
+  countVote();
+}
+
+void PlaylistDecoder::startContainer(bool isObject){
+  Context context = SKIPPED_CONTEXT;
+  if(contexts.isEmpty()){
+    context = isObject ? ROOT_CONTEXT : SKIPPED_CONTEXT;
+  }
+  else if(countVote()){
+    context = SKIPPED_CONTEXT;
+  }
+  else{
+    switch(contexts.last()){
+      case ROOT_CONTEXT:
+        if(!isObject && currentKey == QLatin1String("active_playlist")){
+          context = PLAYLIST_CONTEXT;
+        }
+        else if(isObject && currentKey == QLatin1String("current_song")){
+          context = CURRENT_SONG_CONTEXT;
+        }
+        break;
+      case PLAYLIST_CONTEXT:
+        if(isObject){
+          //Filled in place so the finished entry never has to be copied into the list.
+          playlist_entry_t entry = {-1, 0, 0, QString(), QString(), -1};
+          snapshot.entries.append(entry);
+          context = ENTRY_CONTEXT;
+        }
+        break;
+      case ENTRY_CONTEXT:
+        if(isObject && currentKey == QLatin1String("song")){
+          context = SONG_CONTEXT;
+        }
+        else if(!isObject && currentKey == QLatin1String("upvoters")){
+          context = UPVOTERS_CONTEXT;
+        }
+        else if(!isObject && currentKey == QLatin1String("downvoters")){
+          context = DOWNVOTERS_CONTEXT;
+        }
+        else if(isObject && currentKey == QLatin1String("adder")){
+          context = ADDER_CONTEXT;
+        }
+        break;
+      case CURRENT_SONG_CONTEXT:
+        if(isObject && currentKey == QLatin1String("song")){
+          context = CURRENT_SONG_SONG_CONTEXT;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+  contexts.append(context);
+}
+
+void PlaylistDecoder::endContainer(){
+  contexts.pop_back();
+}
+
+void PlaylistDecoder::scalarValue(const QString& value){
+  if(contexts.isEmpty() || countVote()){
+    return;
+  }
+  switch(contexts.last()){
+    case ROOT_CONTEXT:
+      if(currentKey == QLatin1String("volume")){
+        snapshot.volume = (int)value.toDouble();
+      }
+      else if(currentKey == QLatin1String("state")){
+        snapshot.state = value;
+      }
+      break;
+    case ENTRY_CONTEXT:
+      if(currentKey == QLatin1String("time_added")){
+        snapshot.entries.last().timeAdded = value;
+      }
+      break;
+    case SONG_CONTEXT:
+      if(currentKey == QLatin1String("id")){
+        snapshot.entries.last().libId = value.toLong();
+      }
+      break;
+    case ADDER_CONTEXT:
+      if(currentKey == QLatin1String("id")){
+        snapshot.entries.last().adderId = value.toLong();
+      }
+      else if(currentKey == QLatin1String("username")){
+        snapshot.entries.last().adderUsername = intern(value);
+      }
+      break;
+    case CURRENT_SONG_SONG_CONTEXT:
+      if(currentKey == QLatin1String("id")){
+        snapshot.currentSongId = value.toLong();
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+bool PlaylistDecoder::countVote(){
+  if(contexts.isEmpty()){
+    return false;
+  }
+  if(contexts.last() == UPVOTERS_CONTEXT){
+    ++snapshot.entries.last().upvotes;
+    return true;
+  }
+  if(contexts.last() == DOWNVOTERS_CONTEXT){
+    ++snapshot.entries.last().downvotes;
+    return true;
+  }
+  return false;
+}
+
+void PlaylistDecoder::resetSnapshot(){
+  snapshot.entries = QVector<playlist_entry_t>();
+  snapshot.currentSongId = -1;
+  snapshot.volume = 0;
+  snapshot.state = QString();
+}
+
+void PlaylistDecoder::replay(const QVariant& value){
+  switch(value.type()){
+    case QVariant::Map:
+    {
+      startObject();
+      const QVariantMap object = value.toMap();
+      QVariantMap::const_iterator it = object.constBegin();
+      for(; it != object.constEnd(); ++it){
+        key(it.key());
+        replay(it.value());
+      }
+      endObject();
+      break;
+    }
+    case QVariant::List:
+    {
+      startArray();
+      Q_FOREACH(const QVariant& element, value.toList()){
+        replay(element);
+      }
+      endArray();
+      break;
+    }
+    case QVariant::String:
+      stringValue(value.toString());
+      break;
+    case QVariant::Bool:
+      boolValue(value.toBool());
+      break;
+    case QVariant::Invalid:
+      nullValue();
+      break;
+    default:
+      numberValue(value.toString().toLatin1());
+      break;
+  }
+}
+
+QString PlaylistDecoder::intern(const QString& username){
+  static QSet<QString> usernames;
+  QSet<QString>::const_iterator it = usernames.constFind(username);
+  if(it != usernames.constEnd()){
+    return *it;
+  }
+  if(usernames.size() >= getMaxInternedUsernames()){
+    usernames.clear();
+  }
+  usernames.insert(username);
+  return username;
+}
+
+
+} //end namespace UDJ
@@ -0,0 +1,187 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ * 
+ * This file is part of UDJ.
+ * 
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PLAYLIST_DECODER_HPP
+#define PLAYLIST_DECODER_HPP
+#include "JSONStreamParser.hpp"
+#include "PlaylistSnapshot.hpp"
+#include <QVariant>
+#include <QVector>
+#include <QSet>
+
+namespace UDJ{
+
+
+/**
+ * \brief Decodes an active playlist document straight into a playlist_snapshot_t.
+ *
+ * Only the members the player uses are kept, everything else is skipped as it goes by.
+ * Vote counts are tallied as the voters go by rather than kept, and adder usernames are
+ * interned so the same user adding several songs shares one string.
+ */
+class PlaylistDecoder : public JSONStreamParser::Handler{
+public:
+
+  /** @name Constructors */
+  //@{
+
+  /** \brief Constructs a PlaylistDecoder. */
+  PlaylistDecoder();
+
+  //@}
+
+  /** @name Static Functions */
+  //@{
+
+  /**
+   * \brief Decodes an active playlist document that has already been parsed into
+   * QVariants, e.g. one carried by a player event.
+   *
+   * \param playlist The parsed document.
+   * \param snapshot Set to the decoded playlist.
+   */
+  static void decodeVariant(const QVariant& playlist, playlist_snapshot_t& snapshot);
+
+  //@}
+
+  /** @name Modifiers */
+  //@{
+
+  /**
+   * \brief Hands over the decoded playlist without copying it. The decoder is left
+   * ready for a new document.
+   *
+   * \param snapshot Set to the decoded playlist.
+   */
+  void takeSnapshot(playlist_snapshot_t& snapshot);
+
+  //@}
+
+  /** @name Overridden from JSONStreamParser::Handler */
+  //@{
+
+  virtual void startObject();
+  virtual void endObject();
+  virtual void startArray();
+  virtual void endArray();
+  virtual void key(const QString& name);
+  virtual void stringValue(const QString& value);
+  virtual void numberValue(const QByteArray& number);
+  virtual void boolValue(bool value);
+  virtual void nullValue();
+
+  //@}
+
+private:
+
+  /** @name Private Types */
+  //@{
+
+  /** \brief The part of the document a container holds. */
+  enum Context{
+    ROOT_CONTEXT,
+    PLAYLIST_CONTEXT,
+    ENTRY_CONTEXT,
+    SONG_CONTEXT,
+    UPVOTERS_CONTEXT,
+    DOWNVOTERS_CONTEXT,
+    ADDER_CONTEXT,
+    CURRENT_SONG_CONTEXT,
+    CURRENT_SONG_SONG_CONTEXT,
+    SKIPPED_CONTEXT
+  };
+
+  //@}
+
+  /** @name Private Members */
+  //@{
+
+  /** \brief The playlist decoded so far. */
+  playlist_snapshot_t snapshot;
+
+  /** \brief Containers currently open, innermost last. */
+  QVector<Context> contexts;
+
+  /** \brief Name of the member of the innermost object whose value comes next. */
+  QString currentKey;
+
+  //@}
+
+  /** @name Private Functions */
+  //@{
+
+  /**
+   * \brief Opens a container.
+   *
+   * \param isObject Whether the container is an object or an array.
+   */
+  void startContainer(bool isObject);
+
+  /** \brief Closes the innermost container. */
+  void endContainer();
+
+  /**
+   * \brief Handles a string or number.
+   *
+   * \param value The value as text.
+   */
+  void scalarValue(const QString& value);
+
+  /**
+   * \brief Counts a value as a vote if it's directly inside a list of voters.
+   *
+   * \return True if the value was a vote, false otherwise.
+   */
+  bool countVote();
+
+  /** \brief Puts the snapshot back to an empty playlist. */
+  void resetSnapshot();
+
+  /**
+   * \brief Reports a parsed value as if it were being parsed.
+   *
+   * \param value The value.
+   */
+  void replay(const QVariant& value);
+
+  /**
+   * \brief Gets the one shared copy of a username.
+   *
+   * \param username The username.
+   * \return A string equal to the username shared with every other use of it.
+   */
+  static QString intern(const QString& username);
+
+  /**
+   * \brief Gets the most usernames kept for interning. Past this the pool is emptied
+   * and starts over.
+   *
+   * \return The most usernames kept for interning.
+   */
+  static const int& getMaxInternedUsernames(){
+    static const int maxInternedUsernames = 4096;
+    return maxInternedUsernames;
+  }
+
+  //@}
+
+};
+
+
+} //end namespace UDJ
+#endif //PLAYLIST_DECODER_HPP
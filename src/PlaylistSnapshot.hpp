@@ -0,0 +1,62 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ * 
+ * This file is part of UDJ.
+ * 
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ * 
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef PLAYLIST_SNAPSHOT_HPP
+#define PLAYLIST_SNAPSHOT_HPP
+#include "ConfigDefs.hpp"
+#include <QString>
+#include <QVector>
+
+namespace UDJ{
+
+
+/**
+ * \brief A single song on the active playlist, as the server reported it.
+ */
+typedef struct {
+  /** \brief Library id of the song. */
+  library_song_id_t libId;
+  /** \brief Number of users who voted the song up. */
+  int upvotes;
+  /** \brief Number of users who voted the song down. */
+  int downvotes;
+  /** \brief When the song was added, exactly as the server gave it. */
+  QString timeAdded;
+  /** \brief Username of the user who added the song. */
+  QString adderUsername;
+  /** \brief Id of the user who added the song. */
+  user_id_t adderId;
+} playlist_entry_t;
+
+/**
+ * \brief The complete state of the active playlist, as the server reported it.
+ */
+typedef struct {
+  /** \brief The songs on the playlist, in priority order. */
+  QVector<playlist_entry_t> entries;
+  /** \brief Library id of the song currently playing, -1 if there is none. */
+  library_song_id_t currentSongId;
+  /** \brief The player volume, on the server's 0 to 10 scale. */
+  int volume;
+  /** \brief The player state. */
+  QString state;
+} playlist_snapshot_t;
+
+
+} //end namespace UDJ
+#endif //PLAYLIST_SNAPSHOT_HPP
@@ -0,0 +1,89 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "ReplayReply.hpp"
+#include <QNetworkAccessManager>
+#include <QStringList>
+#include <cstring>
+
+namespace UDJ{
+
+
+ReplayReply::ReplayReply(const QVariantMap& exchange, QObject *parent):
+  QNetworkReply(parent),
+  content(exchange["response_body"].toString().toUtf8()),
+  offset(0)
+{
+  QNetworkRequest request(QUrl(exchange["url"].toString()));
+  Q_FOREACH(const QVariant& header, exchange["request_headers"].toList()){
+    QStringList pair = header.toStringList();
+    if(pair.size() == 2){
+      request.setRawHeader(pair[0].toLatin1(), pair[1].toLatin1());
+    }
+  }
+  setRequest(request);
+  setUrl(request.url());
+  setOperation((QNetworkAccessManager::Operation)exchange["operation"].toInt());
+
+  Q_FOREACH(const QVariant& header, exchange["response_headers"].toList()){
+    QStringList pair = header.toStringList();
+    if(pair.size() == 2){
+      setRawHeader(pair[0].toLatin1(), pair[1].toLatin1());
+    }
+  }
+  int status = exchange["status"].toInt();
+  if(status != 0){
+    setAttribute(QNetworkRequest::HttpStatusCodeAttribute, status);
+  }
+  QNetworkReply::NetworkError error = (QNetworkReply::NetworkError)exchange["error"].toInt();
+  if(error != QNetworkReply::NoError){
+    setError(error, exchange["error_string"].toString());
+  }
+
+  QVariantMap properties = exchange["properties"].toMap();
+  QVariantMap::const_iterator it = properties.constBegin();
+  for(; it != properties.constEnd(); ++it){
+    setProperty(it.key().toLatin1().constData(), it.value());
+  }
+
+  open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+  setFinished(true);
+}
+
+void ReplayReply::abort(){}
+
+qint64 ReplayReply::bytesAvailable() const{
+  return content.size() - offset + QIODevice::bytesAvailable();
+}
+
+bool ReplayReply::isSequential() const{
+  return true;
+}
+
+qint64 ReplayReply::readData(char *data, qint64 maxSize){
+  if(offset >= content.size()){
+    return -1;
+  }
+  qint64 toRead = qMin(maxSize, content.size() - offset);
+  memcpy(data, content.constData() + offset, toRead);
+  offset += toRead;
+  return toRead;
+}
+
+
+} //end namespace UDJ
@@ -0,0 +1,89 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef REPLAY_REPLY_HPP
+#define REPLAY_REPLY_HPP
+#include <QNetworkReply>
+#include <QVariantMap>
+
+namespace UDJ{
+
+
+/**
+ * \brief A finished reply rebuilt from an exchange recorded by TrafficCapture, so the
+ * usual reply handlers can process it as if it had just arrived from the server.
+ */
+class ReplayReply : public QNetworkReply{
+Q_OBJECT
+public:
+
+  /** @name Constructors */
+  //@{
+
+  /**
+   * \brief Constructs a ReplayReply.
+   *
+   * \param exchange The exchange as read from a capture.
+   * \param parent The parent object.
+   */
+  ReplayReply(const QVariantMap& exchange, QObject *parent=0);
+
+  //@}
+
+  /** @name Overridden from QNetworkReply */
+  //@{
+
+  /** \brief Does nothing, the reply has already finished. */
+  virtual void abort();
+
+  /** \brief . */
+  virtual qint64 bytesAvailable() const;
+
+  /** \brief . */
+  virtual bool isSequential() const;
+
+  //@}
+
+protected:
+
+  /** @name Overridden from QIODevice */
+  //@{
+
+  /** \brief . */
+  virtual qint64 readData(char *data, qint64 maxSize);
+
+  //@}
+
+private:
+
+  /** @name Private Members */
+  //@{
+
+  /** \brief The body of the reply. */
+  QByteArray content;
+
+  /** \brief How much of the body has been read. */
+  qint64 offset;
+
+  //@}
+
+};
+
+
+} //end namespace UDJ
+#endif //REPLAY_REPLY_HPP
@@ -0,0 +1,120 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "RequestCoalescer.hpp"
+#include <QTimer>
+#include <QSignalMapper>
+
+
+namespace UDJ{
+
+
+RequestCoalescer::RequestCoalescer(QObject *parent):
+  QObject(parent)
+{
+  timerMapper = new QSignalMapper(this);
+  connect(timerMapper, SIGNAL(mapped(int)), this, SLOT(flush(int)));
+}
+
+void RequestCoalescer::setWindow(int key, int windowMs){
+  windows[key] = windowMs;
+  if(timers.contains(key)){
+    timers[key]->setInterval(windowMs);
+  }
+}
+
+void RequestCoalescer::submitValue(int key, const QVariant& value){
+  pendingValues[key] = value;
+  openWindow(key);
+}
+
+void RequestCoalescer::submitSetAdditions(int key, const QSet<library_song_id_t>& toAdd){
+  pendingRemovals[key].subtract(toAdd);
+  pendingAdditions[key].unite(toAdd);
+  openWindow(key);
+}
+
+void RequestCoalescer::submitSetRemovals(int key, const QSet<library_song_id_t>& toRemove){
+  pendingAdditions[key].subtract(toRemove);
+  pendingRemovals[key].unite(toRemove);
+  openWindow(key);
+}
+
+void RequestCoalescer::cancel(int key){
+  if(timers.contains(key)){
+    timers[key]->stop();
+  }
+  pendingValues.remove(key);
+  pendingAdditions.remove(key);
+  pendingRemovals.remove(key);
+}
+
+bool RequestCoalescer::hasPending(int key) const{
+  return pendingValues.contains(key) ||
+    !pendingAdditions.value(key).isEmpty() ||
+    !pendingRemovals.value(key).isEmpty();
+}
+
+void RequestCoalescer::flush(int key){
+  if(timers.contains(key)){
+    timers[key]->stop();
+  }
+  if(pendingValues.contains(key)){
+    QVariant value = pendingValues.take(key);
+    emit valueReady(key, value);
+  }
+  if(pendingAdditions.contains(key) || pendingRemovals.contains(key)){
+    QSet<library_song_id_t> toAdd = pendingAdditions.take(key);
+    QSet<library_song_id_t> toRemove = pendingRemovals.take(key);
+    if(!toAdd.isEmpty() || !toRemove.isEmpty()){
+      emit setOperationReady(key, toAdd, toRemove);
+    }
+  }
+}
+
+void RequestCoalescer::flushAll(){
+  QSet<int> keys = pendingValues.keys().toSet();
+  keys.unite(pendingAdditions.keys().toSet());
+  keys.unite(pendingRemovals.keys().toSet());
+  Q_FOREACH(int key, keys){
+    flush(key);
+  }
+}
+
+void RequestCoalescer::openWindow(int key){
+  int window = windows.value(key, 0);
+  if(window <= 0){
+    flush(key);
+    return;
+  }
+  QTimer *timer = timers.value(key, 0);
+  if(timer == 0){
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    timer->setInterval(window);
+    connect(timer, SIGNAL(timeout()), timerMapper, SLOT(map()));
+    timerMapper->setMapping(timer, key);
+    timers[key] = timer;
+  }
+  if(!timer->isActive()){
+    timer->start();
+  }
+}
+
+
+} //end namespace UDJ
@@ -0,0 +1,210 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef REQUEST_COALESCER_HPP
+#define REQUEST_COALESCER_HPP
+#include "ConfigDefs.hpp"
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QVariant>
+
+class QTimer;
+class QSignalMapper;
+
+namespace UDJ{
+
+
+/**
+ * \brief Collapses bursts of requests into as few requests as possible.
+ *
+ * Two kinds of requests are supported, each identified by an integer key chosen by the
+ * user of the coalescer:
+ *  - Value requests, where only the latest value matters (e.g. volume). Submitting a
+ *    new value simply replaces any value that is still pending.
+ *  - Set requests, where songs are added to or removed from a set (e.g. the active
+ *    playlist). Operations are merged so that for each song only the most recent
+ *    operation is sent.
+ *
+ * The first submission for a key opens a window. When the window closes the pending
+ * value or set operation is emitted, so the final value is always delivered and is
+ * never delayed by more than the window, no matter how long a burst lasts. A window of
+ * zero disables coalescing for that key.
+ */
+class RequestCoalescer : public QObject{
+Q_OBJECT
+public:
+
+  /** @name Constructors */
+  //@{
+
+  /**
+   * \brief Constructs a RequestCoalescer.
+   *
+   * \param parent The parent object.
+   */
+  RequestCoalescer(QObject *parent=0);
+
+  //@}
+
+  /** @name Modifiers */
+  //@{
+
+  /**
+   * \brief Sets the coalescing window for a key.
+   *
+   * \param key The key whose window should be set.
+   * \param windowMs The length of the window in milliseconds.
+   */
+  void setWindow(int key, int windowMs);
+
+  /**
+   * \brief Submits a new value, replacing any value pending for the same key.
+   *
+   * \param key The key the value is for.
+   * \param value The new value.
+   */
+  void submitValue(int key, const QVariant& value);
+
+  /**
+   * \brief Submits songs that should be added to a set.
+   *
+   * \param key The key of the set.
+   * \param toAdd The songs that should be added.
+   */
+  void submitSetAdditions(int key, const QSet<library_song_id_t>& toAdd);
+
+  /**
+   * \brief Submits songs that should be removed from a set.
+   *
+   * \param key The key of the set.
+   * \param toRemove The songs that should be removed.
+   */
+  void submitSetRemovals(int key, const QSet<library_song_id_t>& toRemove);
+
+  /**
+   * \brief Drops anything pending for the given key without emitting it.
+   *
+   * \param key The key whose pending request should be dropped.
+   */
+  void cancel(int key);
+
+  //@}
+
+  /** @name Accessors */
+  //@{
+
+  /**
+   * \brief Determines whether or not there's anything pending for the given key.
+   *
+   * \param key The key in question.
+   * \return True if there is something pending for the key, false otherwise.
+   */
+  bool hasPending(int key) const;
+
+  //@}
+
+public slots:
+
+  /** @name Public Slots */
+  //@{
+
+  /**
+   * \brief Immediately emits anything pending for the given key.
+   *
+   * \param key The key to flush.
+   */
+  void flush(int key);
+
+  /**
+   * \brief Immediately emits everything that is pending.
+   */
+  void flushAll();
+
+  //@}
+
+signals:
+
+  /** @name Signals */
+  //@{
+
+  /**
+   * \brief Emitted when the window for a value request closes.
+   *
+   * \param key The key of the request.
+   * \param value The latest value submitted for the key.
+   */
+  void valueReady(int key, const QVariant& value);
+
+  /**
+   * \brief Emitted when the window for a set request closes.
+   *
+   * \param key The key of the request.
+   * \param toAdd The songs that should be added.
+   * \param toRemove The songs that should be removed.
+   */
+  void setOperationReady(
+    int key,
+    const QSet<library_song_id_t>& toAdd,
+    const QSet<library_song_id_t>& toRemove);
+
+  //@}
+
+private:
+
+  /** @name Private Members */
+  //@{
+
+  /** \brief The window for each key, in milliseconds. */
+  QHash<int, int> windows;
+
+  /** \brief The timer for each key. */
+  QHash<int, QTimer*> timers;
+
+  /** \brief Maps timer timeouts to the key of the timer. */
+  QSignalMapper *timerMapper;
+
+  /** \brief Values waiting to be emitted. */
+  QHash<int, QVariant> pendingValues;
+
+  /** \brief Set additions waiting to be emitted. */
+  QHash<int, QSet<library_song_id_t> > pendingAdditions;
+
+  /** \brief Set removals waiting to be emitted. */
+  QHash<int, QSet<library_song_id_t> > pendingRemovals;
+
+  //@}
+
+  /** @name Private Functions */
+  //@{
+
+  /**
+   * \brief Starts the window for the given key if it isn't already open, flushing
+   * right away if the key isn't being coalesced.
+   *
+   * \param key The key whose window should be opened.
+   */
+  void openWindow(int key);
+
+  //@}
+
+};
+
+
+} //end namespace UDJ
+#endif //REQUEST_COALESCER_HPP
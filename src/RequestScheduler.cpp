@@ -0,0 +1,367 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "RequestScheduler.hpp"
+#include "Logger.hpp"
+#include "Utils.hpp"
+#include <QNetworkReply>
+#include <QDateTime>
+#include <QTimer>
+
+
+namespace UDJ{
+
+
+RequestScheduler::RequestScheduler(QNetworkAccessManager *netAccessManager, QObject *parent):
+  QObject(parent),
+  netAccessManager(netAccessManager),
+  totalInFlight(0),
+  nextCorrelationId(1),
+  consecutiveTransientFailures(0),
+  isReachable(true)
+{
+  for(int i=0; i<NUM_REQUEST_CLASSES; ++i){
+    inFlight[i] = 0;
+  }
+  clock.start();
+  qsrand((uint)QDateTime::currentMSecsSinceEpoch() ^ (uint)(quintptr)this);
+  wakeTimer = new QTimer(this);
+  wakeTimer->setSingleShot(true);
+  connect(wakeTimer, SIGNAL(timeout()), this, SLOT(onWakeUp()));
+  connect(netAccessManager, SIGNAL(finished(QNetworkReply*)),
+    this, SLOT(onReplyFinished(QNetworkReply*)));
+}
+
+RequestScheduler::request_t RequestScheduler::createRequest(
+  RequestClass requestClass,
+  int endpoint,
+  QNetworkAccessManager::Operation operation,
+  const QNetworkRequest& request,
+  const QByteArray& payload)
+{
+  request_t toReturn;
+  toReturn.requestClass = requestClass;
+  toReturn.endpoint = endpoint;
+  toReturn.correlationId = 0;
+  toReturn.latency = -1;
+  toReturn.queueWait = -1;
+  toReturn.operation = operation;
+  toReturn.request = request;
+  toReturn.payload = payload;
+  toReturn.isIdempotent = operation != QNetworkAccessManager::PostOperation;
+  toReturn.attempts = 0;
+  return toReturn;
+}
+
+quint32 RequestScheduler::schedule(const request_t& request){
+  if(isDuplicateGet(request)){
+    Logger::instance()->log("Dropping duplicate request for " + request.request.url().path());
+    return 0;
+  }
+  request_t toSchedule = request;
+  toSchedule.correlationId = nextCorrelationId++;
+  requeue(toSchedule);
+  dispatch();
+  return toSchedule.correlationId;
+}
+
+void RequestScheduler::requeue(const request_t& request){
+  request_t toQueue = request;
+  toQueue.queuedTimer.start();
+  queues[toQueue.requestClass].enqueue(toQueue);
+}
+
+RequestScheduler::ErrorClass RequestScheduler::classifyReply(QNetworkReply *reply){
+  if(reply->error() == QNetworkReply::OperationCanceledError){
+    return CANCELED_ERROR_CLASS;
+  }
+  QVariant statusAttribute = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute);
+  if(!statusAttribute.isValid()){
+    return reply->error() == QNetworkReply::NoError ? NO_ERROR_CLASS : NETWORK_ERROR_CLASS;
+  }
+  int status = statusAttribute.toInt();
+  if(status == 401){
+    return AUTH_ERROR_CLASS;
+  }
+  //501 is how the server tells us we're out of date, retrying won't help.
+  if(status >= 500 && status != 501){
+    return SERVER_ERROR_CLASS;
+  }
+  if(status >= 400){
+    return CLIENT_ERROR_CLASS;
+  }
+  return NO_ERROR_CLASS;
+}
+
+void RequestScheduler::onReplyFinished(QNetworkReply *reply){
+  //The network access manager is shared, so this may well be someone else's reply.
+  if(!inFlightRequests.contains(reply)){
+    return;
+  }
+  request_t request = inFlightRequests.take(reply);
+  --inFlight[request.requestClass];
+  --totalInFlight;
+  request.latency = request.issuedTimer.elapsed();
+  QString endpoint = getEndpoint(request);
+  CircuitBreaker& breaker = breakers[endpoint];
+
+  ErrorClass errorClass = classifyReply(reply);
+  bool isTransient = errorClass == NETWORK_ERROR_CLASS || errorClass == SERVER_ERROR_CLASS;
+  if(errorClass == CANCELED_ERROR_CLASS){
+    //Whoever aborted it has already decided what to do next, so it isn't retried. It
+    //tells us nothing about the endpoint either, but if it was the probe another one
+    //has to be let through.
+    breaker.cancelProbe();
+    releaseHeldRequests(endpoint);
+    emit replyFinished(reply, request);
+    armWakeTimer();
+    dispatch();
+    return;
+  }
+  updateReachability(isTransient);
+  if(!isTransient){
+    bool wasTripped = breaker.getState(clock.elapsed()) != CircuitBreaker::CLOSED;
+    breaker.recordSuccess();
+    if(wasTripped){
+      Logger::instance()->log("Circuit closed for " + endpoint);
+    }
+    releaseHeldRequests(endpoint);
+    emit replyFinished(reply, request);
+  }
+  else{
+    breaker.recordFailure(clock.elapsed());
+    if(breaker.getState(clock.elapsed()) == CircuitBreaker::OPEN){
+      Logger::instance()->log("Circuit open for " + endpoint + " for " +
+        QString::number(breaker.getOpenUntil() - clock.elapsed()) + "ms");
+    }
+    if(request.isIdempotent && request.attempts < getMaxAttempts()){
+      Logger::instance()->log("Transient failure for " + endpoint + " (" +
+        reply->errorString() + "), will retry");
+      scheduleRetry(request);
+      reply->deleteLater();
+    }
+    else{
+      emit replyFinished(reply, request);
+    }
+  }
+  armWakeTimer();
+  dispatch();
+}
+
+void RequestScheduler::updateReachability(bool isTransientFailure){
+  if(!isTransientFailure){
+    consecutiveTransientFailures = 0;
+    if(!isReachable){
+      isReachable = true;
+      Logger::instance()->log("Server is reachable again");
+      emit reachabilityChanged(true);
+    }
+    return;
+  }
+  ++consecutiveTransientFailures;
+  if(isReachable && consecutiveTransientFailures >= getUnreachableThreshold()){
+    isReachable = false;
+    Logger::instance()->log("Server appears to be unreachable");
+    emit reachabilityChanged(false);
+  }
+}
+
+void RequestScheduler::scheduleRetry(const request_t& request){
+  //Capped exponential backoff with "equal jitter": wait at least half the backoff and
+  //a random amount up to the full backoff.
+  qint64 backoff = getBaseBackoff() << qMin(request.attempts - 1, 16);
+  backoff = qMin(backoff, getMaxBackoff());
+  qint64 delay = backoff/2 + Utils::getRandomUpTo(backoff/2);
+  retries.insert(clock.elapsed() + delay, request);
+}
+
+void RequestScheduler::onWakeUp(){
+  qint64 now = clock.elapsed();
+  while(!retries.isEmpty() && retries.begin().key() <= now){
+    requeue(retries.take(retries.begin().key()));
+  }
+  Q_FOREACH(const QString& endpoint, heldRequests.keys()){
+    if(breakers[endpoint].wouldAllowRequest(now)){
+      releaseHeldRequests(endpoint);
+    }
+  }
+  armWakeTimer();
+  dispatch();
+}
+
+void RequestScheduler::releaseHeldRequests(const QString& endpoint){
+  QList<request_t> held = heldRequests.take(endpoint);
+  Q_FOREACH(const request_t& request, held){
+    requeue(request);
+  }
+}
+
+void RequestScheduler::armWakeTimer(){
+  qint64 wakeAt = -1;
+  if(!retries.isEmpty()){
+    wakeAt = retries.begin().key();
+  }
+  qint64 now = clock.elapsed();
+  QHash<QString, QList<request_t> >::const_iterator it = heldRequests.constBegin();
+  for(; it != heldRequests.constEnd(); ++it){
+    //Requests held behind a probe that's still out are released once it finishes, so
+    //only breakers that are still open have anything to wake up for.
+    const CircuitBreaker& breaker = breakers[it.key()];
+    if(breaker.getState(now) != CircuitBreaker::OPEN){
+      continue;
+    }
+    qint64 openUntil = breaker.getOpenUntil();
+    if(wakeAt == -1 || openUntil < wakeAt){
+      wakeAt = openUntil;
+    }
+  }
+  if(wakeAt == -1){
+    wakeTimer->stop();
+    return;
+  }
+  wakeTimer->start((int)qMax((qint64)0, wakeAt - now));
+}
+
+void RequestScheduler::dispatch(){
+  int nextClass = pickNextClass();
+  bool heldAny = false;
+  while(nextClass != NUM_REQUEST_CLASSES){
+    request_t toIssue = queues[nextClass].dequeue();
+    QString endpoint = getEndpoint(toIssue);
+    if(!breakers[endpoint].allowRequest(clock.elapsed())){
+      heldRequests[endpoint].append(toIssue);
+      heldAny = true;
+    }
+    else{
+      qint64 waited = toIssue.queuedTimer.elapsed();
+      if(waited > getAgingInterval()){
+        Logger::instance()->log("Request of class " + QString::number(nextClass) +
+          " waited " + QString::number(waited) + "ms to be issued");
+      }
+      issue(toIssue);
+    }
+    nextClass = pickNextClass();
+  }
+  if(heldAny){
+    armWakeTimer();
+  }
+}
+
+int RequestScheduler::pickNextClass() const{
+  //Long polls have slots of their own, everything else shares the rest.
+  bool sharedSlotFree =
+    totalInFlight - inFlight[LONG_POLL_REQUEST] < getMaxInFlight() - getLongPollSlots();
+  int bestClass = NUM_REQUEST_CLASSES;
+  qint64 bestPriority = 0;
+  for(int i=0; i<NUM_REQUEST_CLASSES; ++i){
+    if(queues[i].isEmpty() || inFlight[i] >= getClassCap(i) ||
+      (i != LONG_POLL_REQUEST && !sharedSlotFree))
+    {
+      continue;
+    }
+    //The longer the request at the head of the queue has waited, the more
+    //important it becomes.
+    qint64 effectivePriority = i - (queues[i].head().queuedTimer.elapsed() / getAgingInterval());
+    if(bestClass == NUM_REQUEST_CLASSES || effectivePriority < bestPriority){
+      bestClass = i;
+      bestPriority = effectivePriority;
+    }
+  }
+  return bestClass;
+}
+
+void RequestScheduler::issue(const request_t& request){
+  QNetworkReply *reply = 0;
+  switch(request.operation){
+    case QNetworkAccessManager::GetOperation:
+      reply = netAccessManager->get(request.request);
+      break;
+    case QNetworkAccessManager::PostOperation:
+      reply = netAccessManager->post(request.request, request.payload);
+      break;
+    case QNetworkAccessManager::PutOperation:
+      reply = netAccessManager->put(request.request, request.payload);
+      break;
+    case QNetworkAccessManager::DeleteOperation:
+      reply = netAccessManager->deleteResource(request.request);
+      break;
+    default:
+      Logger::instance()->log("Tried to issue request with unsupported operation");
+      return;
+  }
+  ++inFlight[request.requestClass];
+  ++totalInFlight;
+  request_t issued = request;
+  ++issued.attempts;
+  issued.queueWait = request.queuedTimer.elapsed();
+  issued.issuedTimer.start();
+  inFlightRequests.insert(reply, issued);
+  QHash<QByteArray, QVariant>::const_iterator it = request.properties.constBegin();
+  for(; it != request.properties.constEnd(); ++it){
+    reply->setProperty(it.key().constData(), it.value());
+  }
+  emit requestIssued(reply, issued);
+}
+
+bool RequestScheduler::isDuplicateGet(const request_t& request) const{
+  if(request.operation != QNetworkAccessManager::GetOperation){
+    return false;
+  }
+  QUrl url = request.request.url();
+  for(int i=0; i<NUM_REQUEST_CLASSES; ++i){
+    Q_FOREACH(const request_t& queued, queues[i]){
+      if(queued.operation == QNetworkAccessManager::GetOperation &&
+        queued.request.url() == url)
+      {
+        return true;
+      }
+    }
+  }
+  Q_FOREACH(const request_t& held, heldRequests.value(getEndpoint(request))){
+    if(held.operation == QNetworkAccessManager::GetOperation && held.request.url() == url){
+      return true;
+    }
+  }
+  Q_FOREACH(const request_t& retry, retries){
+    if(retry.operation == QNetworkAccessManager::GetOperation && retry.request.url() == url){
+      return true;
+    }
+  }
+  return false;
+}
+
+QString RequestScheduler::getEndpoint(const request_t& request){
+  return request.request.url().path();
+}
+
+int RequestScheduler::getClassCap(int requestClass){
+  switch(requestClass){
+    case PLAYLIST_READ_REQUEST:
+      return 2;
+    case BACKGROUND_SYNC_REQUEST:
+      return 2;
+    case LONG_POLL_REQUEST:
+      return getLongPollSlots();
+    case INTERACTIVE_REQUEST:
+    default:
+      return getMaxInFlight() - getLongPollSlots();
+  }
+}
+
+
+} //end namespace UDJ
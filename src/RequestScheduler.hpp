@@ -0,0 +1,468 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef REQUEST_SCHEDULER_HPP
+#define REQUEST_SCHEDULER_HPP
+#include "CircuitBreaker.hpp"
+#include <QObject>
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QElapsedTimer>
+#include <QQueue>
+#include <QHash>
+#include <QMultiMap>
+#include <QVariant>
+
+class QNetworkReply;
+class QTimer;
+
+namespace UDJ{
+
+
+/**
+ * \brief Decides when requests to the server are actually handed to the network.
+ *
+ * Qt only opens a handful of connections to a single host at a time, so a long library
+ * sync can otherwise hold up requests the user is waiting on. Each request is given a
+ * class and every class is limited in how many requests it may have in flight at once.
+ * Background classes are capped low enough that interactive requests always have a free
+ * connection. Queued requests age while they wait so that a steady stream of interactive
+ * requests can never starve the other classes. Long polls tie up a connection for as long
+ * as the server likes, so only one is ever allowed in flight, on a slot kept for it that
+ * the other classes can't take.
+ *
+ * The scheduler also deals with transient failures. Idempotent requests that fail
+ * because of a network error or a 5xx are retried with capped exponential backoff and
+ * jitter. Each endpoint has a CircuitBreaker; while it's open requests for the endpoint
+ * are held back rather than sent, and duplicate GETs are dropped instead of piling up.
+ * Only final replies are passed on through replyFinished.
+ */
+class RequestScheduler : public QObject{
+Q_OBJECT
+public:
+
+  /** @name Public Types */
+  //@{
+
+  /**
+   * \brief The classes of requests, in order of decreasing priority.
+   */
+  enum RequestClass{
+    INTERACTIVE_REQUEST=0,
+    PLAYLIST_READ_REQUEST,
+    BACKGROUND_SYNC_REQUEST,
+    /** \brief Requests the server deliberately holds open until it has news. */
+    LONG_POLL_REQUEST,
+    NUM_REQUEST_CLASSES
+  };
+
+  /**
+   * \brief The kinds of failures a reply can represent.
+   */
+  enum ErrorClass{
+    NO_ERROR_CLASS,
+    NETWORK_ERROR_CLASS,
+    SERVER_ERROR_CLASS,
+    CLIENT_ERROR_CLASS,
+    AUTH_ERROR_CLASS,
+    /** \brief We aborted the request ourselves, so it says nothing about the server. */
+    CANCELED_ERROR_CLASS
+  };
+
+  /**
+   * \brief Everything needed to issue a request at a later time.
+   */
+  typedef struct {
+    RequestClass requestClass;
+    /** \brief Identifies the endpoint, as defined by the user of the scheduler. */
+    int endpoint;
+    /** \brief Unique id assigned when the request is first scheduled. */
+    quint32 correlationId;
+    QNetworkAccessManager::Operation operation;
+    QNetworkRequest request;
+    QByteArray payload;
+    /** \brief Properties which will be set on the reply once the request is issued. */
+    QHash<QByteArray, QVariant> properties;
+    /** \brief Whether or not sending the request more than once is harmless. */
+    bool isIdempotent;
+    /** \brief Number of times the request has been sent. */
+    int attempts;
+    QElapsedTimer queuedTimer;
+    /** \brief Started when the request is handed to the network. */
+    QElapsedTimer issuedTimer;
+    /** \brief Time between issuing the request and receiving its reply in milliseconds. */
+    qint64 latency;
+    /** \brief Time the request spent waiting to be issued in milliseconds. */
+    qint64 queueWait;
+  } request_t;
+
+  //@}
+
+  /** @name Constructors */
+  //@{
+
+  /**
+   * \brief Constructs a RequestScheduler.
+   *
+   * \param netAccessManager The network access manager which will issue the requests.
+   * It may be shared with others, replies to requests this scheduler didn't issue are
+   * ignored.
+   * \param parent The parent object.
+   */
+  RequestScheduler(QNetworkAccessManager *netAccessManager, QObject *parent=0);
+
+  //@}
+
+  /** @name Scheduling */
+  //@{
+
+  /**
+   * \brief Creates a request which can be given to the scheduler.
+   *
+   * Requests are considered idempotent unless they're POSTs. Callers should override
+   * this for POSTs that simply set a value and for PUTs that create something.
+   *
+   * \param requestClass The class of the request.
+   * \param endpoint Identifies the endpoint the request is for.
+   * \param operation The HTTP operation to perform.
+   * \param request The network request.
+   * \param payload The body of the request, if any.
+   * \return The created request.
+   */
+  static request_t createRequest(
+    RequestClass requestClass,
+    int endpoint,
+    QNetworkAccessManager::Operation operation,
+    const QNetworkRequest& request,
+    const QByteArray& payload=QByteArray());
+
+  /**
+   * \brief Queues the given request, issuing it right away if its class has room.
+   *
+   * \param request The request to schedule.
+   * \return The correlation id assigned to the request, or 0 if it was dropped as a
+   * duplicate.
+   */
+  quint32 schedule(const request_t& request);
+
+  /**
+   * \brief Gets the number of requests of the given class waiting to be issued.
+   *
+   * \param requestClass The class in question.
+   * \return The number of requests of the given class waiting to be issued.
+   */
+  inline int getNumQueued(RequestClass requestClass) const{
+    return queues[requestClass].size();
+  }
+
+  /**
+   * \brief Gets the number of requests of the given class currently in flight.
+   *
+   * \param requestClass The class in question.
+   * \return The number of requests of the given class currently in flight.
+   */
+  inline int getNumInFlight(RequestClass requestClass) const{
+    return inFlight[requestClass];
+  }
+
+  /**
+   * \brief Determines what kind of failure, if any, a reply represents.
+   *
+   * \param reply The reply in question.
+   * \return The kind of failure the reply represents.
+   */
+  static ErrorClass classifyReply(QNetworkReply *reply);
+
+  /**
+   * \brief Gets whether or not the server currently appears to be reachable.
+   *
+   * \return True if the server appears to be reachable, false otherwise.
+   */
+  inline bool isServerReachable() const{
+    return isReachable;
+  }
+
+  //@}
+
+signals:
+
+  /** @name Signals */
+  //@{
+
+  /**
+   * \brief Emitted right after a request is issued, before any of its reply has arrived.
+   * Listeners may connect to the reply here to see its body as it comes in.
+   *
+   * \param reply The reply that was just created.
+   * \param request The request the reply is for.
+   */
+  void requestIssued(QNetworkReply *reply, const RequestScheduler::request_t& request);
+
+  /**
+   * \brief Emitted when a reply is final, i.e. it succeeded or won't be retried.
+   *
+   * \param reply The reply.
+   * \param request The request the reply is for.
+   */
+  void replyFinished(QNetworkReply *reply, const RequestScheduler::request_t& request);
+
+  /**
+   * \brief Emitted when the server stops or starts being reachable. The server is
+   * considered unreachable after several transient failures in a row and reachable
+   * again as soon as it gives any answer that isn't a transient failure.
+   *
+   * \param reachable Whether or not the server is now reachable.
+   */
+  void reachabilityChanged(bool reachable);
+
+  //@}
+
+private slots:
+
+  /** @name Private Slots */
+  //@{
+
+  /**
+   * \brief Frees up the slot used by the given reply, retrying it if appropriate, and
+   * issues any waiting requests.
+   *
+   * \param reply The reply that finished.
+   */
+  void onReplyFinished(QNetworkReply *reply);
+
+  /**
+   * \brief Requeues any retries that are due and any requests held back by circuit
+   * breakers that are now willing to let requests through.
+   */
+  void onWakeUp();
+
+  //@}
+
+private:
+
+  /** @name Private Members */
+  //@{
+
+  /** \brief Manager used to actually issue requests. */
+  QNetworkAccessManager *netAccessManager;
+
+  /** \brief Requests waiting to be issued, one queue per class. */
+  QQueue<request_t> queues[NUM_REQUEST_CLASSES];
+
+  /** \brief Number of requests in flight for each class. */
+  int inFlight[NUM_REQUEST_CLASSES];
+
+  /** \brief Total number of requests in flight. */
+  int totalInFlight;
+
+  /** \brief The requests behind each reply that is in flight. */
+  QHash<QNetworkReply*, request_t> inFlightRequests;
+
+  /** \brief Requests waiting to be retried, keyed by when they should be retried. */
+  QMultiMap<qint64, request_t> retries;
+
+  /**
+   * \brief Requests held back because their endpoint's circuit breaker is open or is
+   * waiting to hear back from its probe.
+   */
+  QHash<QString, QList<request_t> > heldRequests;
+
+  /** \brief The circuit breaker for each endpoint. */
+  QHash<QString, CircuitBreaker> breakers;
+
+  /** \brief Monotonic clock used for retries and circuit breakers. */
+  QElapsedTimer clock;
+
+  /** \brief Timer used to wake up when a retry is due or a breaker half opens. */
+  QTimer *wakeTimer;
+
+  /** \brief The correlation id that will be given to the next request. */
+  quint32 nextCorrelationId;
+
+  /** \brief Number of transient failures seen since the last answer from the server. */
+  int consecutiveTransientFailures;
+
+  /** \brief Whether or not the server currently appears to be reachable. */
+  bool isReachable;
+
+  //@}
+
+  /** @name Private Functions */
+  //@{
+
+  /**
+   * \brief Issues as many waiting requests as the concurrency caps allow.
+   */
+  void dispatch();
+
+  /**
+   * \brief Determines the class whose next request should be issued.
+   *
+   * \return The class whose next request should be issued or NUM_REQUEST_CLASSES if no
+   * request may be issued right now.
+   */
+  int pickNextClass() const;
+
+  /**
+   * \brief Hands the given request to the network access manager.
+   *
+   * \param request The request to issue.
+   */
+  void issue(const request_t& request);
+
+  /**
+   * \brief Puts a request back in its class queue.
+   *
+   * \param request The request to requeue.
+   */
+  void requeue(const request_t& request);
+
+  /**
+   * \brief Puts every request held back for the given endpoint back in the queues.
+   *
+   * \param endpoint The endpoint whose requests should be released.
+   */
+  void releaseHeldRequests(const QString& endpoint);
+
+  /**
+   * \brief Updates whether or not the server is considered reachable based on the
+   * outcome of the latest reply.
+   *
+   * \param isTransientFailure Whether or not the latest reply was a transient failure.
+   */
+  void updateReachability(bool isTransientFailure);
+
+  /**
+   * \brief Arranges for a failed request to be sent again after a backoff period.
+   *
+   * \param request The request to retry.
+   */
+  void scheduleRetry(const request_t& request);
+
+  /**
+   * \brief Arms the wake timer for the next retry or breaker that needs attention.
+   */
+  void armWakeTimer();
+
+  /**
+   * \brief Determines whether or not an identical GET is already waiting to be sent.
+   *
+   * \param request The request in question.
+   * \return True if an identical GET is already waiting, false otherwise.
+   */
+  bool isDuplicateGet(const request_t& request) const;
+
+  /**
+   * \brief Gets the key used to identify the endpoint of a request.
+   *
+   * \param request The request in question.
+   * \return The key used to identify the endpoint of the request.
+   */
+  static QString getEndpoint(const request_t& request);
+
+  /**
+   * \brief Gets the maximum number of requests that may be in flight at once.
+   *
+   * This matches the number of connections Qt will open to a single host.
+   *
+   * @return The maximum number of requests that may be in flight at once.
+   */
+  static const int& getMaxInFlight(){
+    static const int maxInFlight = 6;
+    return maxInFlight;
+  }
+
+  /**
+   * \brief Gets the number of slots kept for long polls. No other class may use them,
+   * so however busy the other classes are a long poll can always be issued, and an
+   * outstanding long poll never takes a slot from anyone else.
+   *
+   * @return The number of slots kept for long polls.
+   */
+  static const int& getLongPollSlots(){
+    static const int longPollSlots = 1;
+    return longPollSlots;
+  }
+
+  /**
+   * \brief Gets the maximum number of requests of the given class that may be in flight.
+   *
+   * \param requestClass The class in question.
+   * @return The maximum number of requests of the given class that may be in flight.
+   */
+  static int getClassCap(int requestClass);
+
+  /**
+   * \brief Gets how long a request must wait before it's treated as one class more
+   * important than it actually is.
+   *
+   * @return The aging interval in milliseconds.
+   */
+  static const qint64& getAgingInterval(){
+    static const qint64 agingInterval = 1500;
+    return agingInterval;
+  }
+
+  /**
+   * \brief Gets how many transient failures in a row make the server count as
+   * unreachable.
+   *
+   * @return The number of transient failures after which the server is unreachable.
+   */
+  static const int& getUnreachableThreshold(){
+    static const int unreachableThreshold = 3;
+    return unreachableThreshold;
+  }
+
+  /**
+   * \brief Gets the most times a request will be sent before its failure is reported.
+   *
+   * @return The most times a request will be sent.
+   */
+  static const int& getMaxAttempts(){
+    static const int maxAttempts = 5;
+    return maxAttempts;
+  }
+
+  /**
+   * \brief Gets the backoff used before the first retry.
+   *
+   * @return The backoff used before the first retry in milliseconds.
+   */
+  static const qint64& getBaseBackoff(){
+    static const qint64 baseBackoff = 500;
+    return baseBackoff;
+  }
+
+  /**
+   * \brief Gets the longest backoff used between retries.
+   *
+   * @return The longest backoff used between retries in milliseconds.
+   */
+  static const qint64& getMaxBackoff(){
+    static const qint64 maxBackoff = 30000;
+    return maxBackoff;
+  }
+
+  //@}
+
+};
+
+
+} //end namespace UDJ
+#endif //REQUEST_SCHEDULER_HPP
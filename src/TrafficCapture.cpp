@@ -0,0 +1,208 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "TrafficCapture.hpp"
+#include "Logger.hpp"
+#include "qt-json/json.h"
+#include <QNetworkReply>
+#include <QStringList>
+#include <QDateTime>
+
+namespace UDJ{
+
+
+TrafficCapture::TrafficCapture(){}
+
+bool TrafficCapture::open(const QString& fileName){
+  close();
+  captureFile.setFileName(fileName);
+  if(!captureFile.open(QIODevice::WriteOnly | QIODevice::Truncate)){
+    Logger::instance()->log("Couldn't open traffic capture " + fileName + ": " +
+      captureFile.errorString());
+    return false;
+  }
+  QVariantMap header;
+  header["format"] = getFormatName();
+  header["version"] = getFormatVersion();
+  header["started"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+  captureFile.write(QtJson::Json::serialize(header) + "\n");
+  captureFile.flush();
+  captureTimer.start();
+  Logger::instance()->log("Capturing server traffic to " + fileName);
+  return true;
+}
+
+void TrafficCapture::close(){
+  if(captureFile.isOpen()){
+    captureFile.close();
+  }
+}
+
+void TrafficCapture::record(
+  const QString& endpointName,
+  const RequestScheduler::request_t& request,
+  QNetworkReply *reply,
+  const QByteArray& body)
+{
+  if(!isOpen()){
+    return;
+  }
+  QList<QPair<QByteArray, QByteArray> > requestHeaders;
+  Q_FOREACH(const QByteArray& name, request.request.rawHeaderList()){
+    requestHeaders.append(qMakePair(name, request.request.rawHeader(name)));
+  }
+  QVariantMap properties;
+  QHash<QByteArray, QVariant>::const_iterator it = request.properties.constBegin();
+  for(; it != request.properties.constEnd(); ++it){
+    QString name = QString::fromLatin1(it.key());
+    properties[name] = isSensitive(name) ? QVariant(getRedactedValue()) : it.value();
+  }
+
+  QVariantMap exchange;
+  exchange["time"] = captureTimer.elapsed();
+  exchange["endpoint"] = endpointName;
+  exchange["operation"] = (int)request.operation;
+  exchange["url"] = request.request.url().toString();
+  exchange["request_headers"] = redactHeaders(requestHeaders);
+  exchange["request_body"] = redactBody(request.payload);
+  exchange["properties"] = properties;
+  exchange["status"] = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+  exchange["error"] = (int)reply->error();
+  exchange["error_string"] = reply->errorString();
+  exchange["response_headers"] = redactHeaders(reply->rawHeaderPairs());
+  //Peeking leaves the body where it is for the reply's handler.
+  exchange["response_body"] = redactBody(body);
+  exchange["attempts"] = request.attempts;
+  exchange["queue_wait"] = request.queueWait;
+  exchange["latency"] = request.latency;
+
+  bool success = true;
+  QByteArray line = QtJson::Json::serialize(exchange, success);
+  if(!success){
+    Logger::instance()->log("Couldn't capture " + endpointName + " exchange");
+    return;
+  }
+  captureFile.write(line + "\n");
+  captureFile.flush();
+}
+
+bool TrafficCapture::readCapture(
+  const QString& fileName, QVariantList& exchanges, QString& error)
+{
+  QFile capture(fileName);
+  if(!capture.open(QIODevice::ReadOnly)){
+    error = capture.errorString();
+    return false;
+  }
+  bool success = true;
+  QVariantMap header =
+    QtJson::Json::parse(QString::fromUtf8(capture.readLine()), success).toMap();
+  if(!success || header["format"].toString() != getFormatName()){
+    error = "Not a UDJ traffic capture";
+    return false;
+  }
+  if(header["version"].toInt() > getFormatVersion()){
+    error = "Capture was written by a newer version of UDJ";
+    return false;
+  }
+
+  exchanges.clear();
+  int lineNumber = 1;
+  while(!capture.atEnd()){
+    ++lineNumber;
+    QByteArray line = capture.readLine().trimmed();
+    if(line.isEmpty()){
+      continue;
+    }
+    QVariant exchange = QtJson::Json::parse(QString::fromUtf8(line), success);
+    if(!success || exchange.type() != QVariant::Map){
+      error = "Malformed exchange on line " + QString::number(lineNumber);
+      return false;
+    }
+    exchanges.append(exchange);
+  }
+  return true;
+}
+
+QString TrafficCapture::redactBody(const QByteArray& body){
+  if(body.isEmpty()){
+    return QString();
+  }
+  QString bodyString = QString::fromUtf8(body);
+  bool isJSON = true;
+  QVariant parsed = QtJson::Json::parse(bodyString, isJSON);
+  if(isJSON && (parsed.type() == QVariant::Map || parsed.type() == QVariant::List)){
+    return QString::fromUtf8(QtJson::Json::serialize(redactJSON(parsed)));
+  }
+  if(!bodyString.contains('=')){
+    return bodyString;
+  }
+  //Form encoded
+  QStringList fields = bodyString.split('&');
+  for(int i=0; i<fields.size(); ++i){
+    QString name = fields[i].section('=', 0, 0);
+    if(isSensitive(name)){
+      fields[i] = name + "=" + getRedactedValue();
+    }
+  }
+  return fields.join("&");
+}
+
+QVariant TrafficCapture::redactJSON(const QVariant& value){
+  if(value.type() == QVariant::Map){
+    QVariantMap redacted = value.toMap();
+    QVariantMap::iterator it = redacted.begin();
+    for(; it != redacted.end(); ++it){
+      it.value() = isSensitive(it.key()) ? QVariant(getRedactedValue()) : redactJSON(it.value());
+    }
+    return redacted;
+  }
+  else if(value.type() == QVariant::List){
+    QVariantList redacted = value.toList();
+    for(int i=0; i<redacted.size(); ++i){
+      redacted[i] = redactJSON(redacted[i]);
+    }
+    return redacted;
+  }
+  return value;
+}
+
+QVariantList TrafficCapture::redactHeaders(
+  const QList<QPair<QByteArray, QByteArray> >& headers)
+{
+  QVariantList redacted;
+  for(int i=0; i<headers.size(); ++i){
+    QString name = QString::fromLatin1(headers[i].first);
+    QVariantList header;
+    header << name << (isSensitive(name) ?
+      getRedactedValue() : QString::fromLatin1(headers[i].second));
+    redacted.append(QVariant(header));
+  }
+  return redacted;
+}
+
+bool TrafficCapture::isSensitive(const QString& name){
+  QString lowerName = name.toLower();
+  return lowerName.contains("password") ||
+    lowerName.contains("ticket") ||
+    lowerName.contains("cookie") ||
+    lowerName == "authorization";
+}
+
+
+} //end namespace UDJ
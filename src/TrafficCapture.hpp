@@ -0,0 +1,210 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TRAFFIC_CAPTURE_HPP
+#define TRAFFIC_CAPTURE_HPP
+#include "RequestScheduler.hpp"
+#include <QFile>
+#include <QElapsedTimer>
+#include <QVariantList>
+
+class QNetworkReply;
+
+namespace UDJ{
+
+
+/**
+ * \brief Writes every exchange with the server to a file so a session can be replayed
+ * later.
+ *
+ * A capture is a text file with one compact JSON object per line. The first line
+ * identifies the format, every other line is one exchange: when it finished relative to
+ * the start of the capture, the endpoint, the request (method, url, headers, body and
+ * the properties handed to its reply) and the reply (status, network error, headers and
+ * body) along with how long the request was queued and in flight.
+ *
+ * Credentials never reach the file. Ticket, cookie and authorization headers, password
+ * form fields, password and ticket_hash JSON members and password properties are all
+ * replaced with a placeholder.
+ */
+class TrafficCapture{
+public:
+
+  /** @name Constructors */
+  //@{
+
+  /** \brief Constructs a TrafficCapture which isn't writing anywhere yet. */
+  TrafficCapture();
+
+  //@}
+
+  /** @name Modifiers */
+  //@{
+
+  /**
+   * \brief Starts writing exchanges to the given file, replacing anything in it.
+   *
+   * \param fileName The file to write to.
+   * \return True if the file could be opened, false otherwise.
+   */
+  bool open(const QString& fileName);
+
+  /** \brief Stops writing exchanges. */
+  void close();
+
+  /**
+   * \brief Writes an exchange to the capture.
+   *
+   * \param endpointName The name of the endpoint the request was for.
+   * \param request The request as it was sent.
+   * \param reply The reply that was received.
+   * \param body The complete body of the reply, including anything already read from it.
+   */
+  void record(
+    const QString& endpointName,
+    const RequestScheduler::request_t& request,
+    QNetworkReply *reply,
+    const QByteArray& body);
+
+  //@}
+
+  /** @name Accessors */
+  //@{
+
+  /**
+   * \brief Gets whether or not exchanges are being written.
+   *
+   * \return True if exchanges are being written, false otherwise.
+   */
+  inline bool isOpen() const{
+    return captureFile.isOpen();
+  }
+
+  //@}
+
+  /** @name Static Functions */
+  //@{
+
+  /**
+   * \brief Reads every exchange from a capture.
+   *
+   * \param fileName The capture to read.
+   * \param exchanges Set to the exchanges in the capture, in the order they finished.
+   * \param error Set to a description of the problem if reading fails.
+   * \return True if the capture was read, false otherwise.
+   */
+  static bool readCapture(const QString& fileName, QVariantList& exchanges, QString& error);
+
+  /**
+   * \brief Gets the name of the environment variable naming the file to capture to.
+   *
+   * \return The name of the environment variable naming the file to capture to.
+   */
+  static const QByteArray& getCaptureFileEnvName(){
+    static const QByteArray captureFileEnvName = "UDJ_CAPTURE_FILE";
+    return captureFileEnvName;
+  }
+
+  //@}
+
+private:
+
+  /** @name Private Members */
+  //@{
+
+  /** \brief The file exchanges are written to. */
+  QFile captureFile;
+
+  /** \brief Started when the capture was opened. */
+  QElapsedTimer captureTimer;
+
+  //@}
+
+  /** @name Private Functions */
+  //@{
+
+  /**
+   * \brief Redacts credentials from a request or reply body.
+   *
+   * \param body The body to redact.
+   * \return The body with any credentials replaced.
+   */
+  static QString redactBody(const QByteArray& body);
+
+  /**
+   * \brief Redacts credentials from parsed JSON.
+   *
+   * \param value The JSON value to redact.
+   * \return The value with any credential members replaced.
+   */
+  static QVariant redactJSON(const QVariant& value);
+
+  /**
+   * \brief Converts headers for writing, redacting any that carry credentials.
+   *
+   * \param headers The headers to convert.
+   * \return A list of [name, value] pairs.
+   */
+  static QVariantList redactHeaders(const QList<QPair<QByteArray, QByteArray> >& headers);
+
+  /**
+   * \brief Gets whether or not the given header, field or member name carries
+   * credentials.
+   *
+   * \param name The name in question.
+   * \return True if the name carries credentials, false otherwise.
+   */
+  static bool isSensitive(const QString& name);
+
+  /**
+   * \brief Gets the value credentials are replaced with.
+   *
+   * @return The value credentials are replaced with.
+   */
+  static const QString& getRedactedValue(){
+    static const QString redactedValue = "REDACTED";
+    return redactedValue;
+  }
+
+  /**
+   * \brief Gets the name identifying the capture format on the first line of a capture.
+   *
+   * @return The name identifying the capture format.
+   */
+  static const QString& getFormatName(){
+    static const QString formatName = "udj-capture";
+    return formatName;
+  }
+
+  /**
+   * \brief Gets the version of the capture format written.
+   *
+   * @return The version of the capture format written.
+   */
+  static const int& getFormatVersion(){
+    static const int formatVersion = 1;
+    return formatVersion;
+  }
+
+  //@}
+
+};
+
+
+} //end namespace UDJ
+#endif //TRAFFIC_CAPTURE_HPP
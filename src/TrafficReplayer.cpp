@@ -0,0 +1,99 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "TrafficReplayer.hpp"
+#include "TrafficCapture.hpp"
+#include "ReplayReply.hpp"
+#include "UDJServerConnection.hpp"
+#include "Logger.hpp"
+#include <QTimer>
+
+namespace UDJ{
+
+
+TrafficReplayer::TrafficReplayer(UDJServerConnection *serverConnection, QObject *parent):
+  QObject(parent),
+  serverConnection(serverConnection),
+  nextExchange(0),
+  speed(1)
+{
+  dueTimer = new QTimer(this);
+  dueTimer->setSingleShot(true);
+  connect(dueTimer, SIGNAL(timeout()), this, SLOT(replayDue()));
+}
+
+bool TrafficReplayer::load(const QString& fileName){
+  QString error;
+  if(!TrafficCapture::readCapture(fileName, exchanges, error)){
+    Logger::instance()->log("Couldn't load traffic capture " + fileName + ": " + error);
+    return false;
+  }
+  nextExchange = 0;
+  Logger::instance()->log("Loaded " + QString::number(exchanges.size()) +
+    " exchanges from " + fileName);
+  return true;
+}
+
+void TrafficReplayer::start(double speed){
+  this->speed = speed;
+  nextExchange = 0;
+  Logger::instance()->log("Replaying traffic at " +
+    (speed > 0 ? QString::number(speed) + "x" : QString("full")) + " speed");
+  replayTimer.start();
+  replayDue();
+}
+
+void TrafficReplayer::replayDue(){
+  while(nextExchange < exchanges.size() && getDueTime(nextExchange) <= replayTimer.elapsed()){
+    QVariantMap exchange = exchanges[nextExchange].toMap();
+    ++nextExchange;
+    ReplayReply *reply = new ReplayReply(exchange, this);
+    if(!serverConnection->replayReply(
+      exchange["endpoint"].toString(),
+      reply,
+      exchange["request_body"].toString().toUtf8(),
+      exchange["latency"].toLongLong()))
+    {
+      Logger::instance()->log("Skipping replay of unknown endpoint " +
+        exchange["endpoint"].toString());
+    }
+    //Let everything the reply set off settle before the next one, as it would have live.
+    if(speed <= 0){
+      break;
+    }
+  }
+
+  if(nextExchange < exchanges.size()){
+    dueTimer->start(qMax<qint64>(0, getDueTime(nextExchange) - replayTimer.elapsed()));
+  }
+  else{
+    Logger::instance()->log("Replay finished after " +
+      QString::number(replayTimer.elapsed()) + "ms");
+    emit finished(exchanges.size(), replayTimer.elapsed());
+  }
+}
+
+qint64 TrafficReplayer::getDueTime(int exchange) const{
+  if(speed <= 0){
+    return 0;
+  }
+  return (qint64)(exchanges[exchange].toMap()["time"].toLongLong() / speed);
+}
+
+
+} //end namespace UDJ
@@ -0,0 +1,181 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TRAFFIC_REPLAYER_HPP
+#define TRAFFIC_REPLAYER_HPP
+#include <QObject>
+#include <QVariantList>
+#include <QElapsedTimer>
+
+class QTimer;
+
+namespace UDJ{
+
+class UDJServerConnection;
+
+
+/**
+ * \brief Feeds the replies in a traffic capture back through a server connection, in the
+ * order and with the spacing they were originally received.
+ *
+ * Every reply goes through the same handlers a live reply would, so everything
+ * listening to the connection (the DataStore above all) does exactly the work it did
+ * during the captured session. Replaying is deterministic: the same capture always
+ * produces the same sequence of replies.
+ */
+class TrafficReplayer : public QObject{
+Q_OBJECT
+public:
+
+  /** @name Constructors */
+  //@{
+
+  /**
+   * \brief Constructs a TrafficReplayer.
+   *
+   * \param serverConnection The connection the replies should be fed through.
+   * \param parent The parent object.
+   */
+  TrafficReplayer(UDJServerConnection *serverConnection, QObject *parent=0);
+
+  //@}
+
+  /** @name Modifiers */
+  //@{
+
+  /**
+   * \brief Loads the capture to replay.
+   *
+   * \param fileName The capture to replay.
+   * \return True if the capture was loaded, false otherwise.
+   */
+  bool load(const QString& fileName);
+
+  /**
+   * \brief Starts replaying the loaded capture.
+   *
+   * \param speed How much faster than the original session to replay, 1 being the
+   * original speed. Anything not above 0 replays as fast as replies can be handled.
+   */
+  void start(double speed);
+
+  //@}
+
+  /** @name Accessors */
+  //@{
+
+  /**
+   * \brief Gets the number of exchanges in the loaded capture.
+   *
+   * \return The number of exchanges in the loaded capture.
+   */
+  inline int getNumExchanges() const{
+    return exchanges.size();
+  }
+
+  /**
+   * \brief Gets the name of the environment variable naming a capture to replay.
+   *
+   * \return The name of the environment variable naming a capture to replay.
+   */
+  static const QByteArray& getReplayFileEnvName(){
+    static const QByteArray replayFileEnvName = "UDJ_REPLAY_FILE";
+    return replayFileEnvName;
+  }
+
+  /**
+   * \brief Gets the name of the environment variable giving the replay speed.
+   *
+   * \return The name of the environment variable giving the replay speed.
+   */
+  static const QByteArray& getReplaySpeedEnvName(){
+    static const QByteArray replaySpeedEnvName = "UDJ_REPLAY_SPEED";
+    return replaySpeedEnvName;
+  }
+
+  //@}
+
+signals:
+
+  /** @name Signals */
+  //@{
+
+  /**
+   * \brief Emitted when every exchange in the capture has been replayed.
+   *
+   * \param numReplayed The number of replies fed through the connection.
+   * \param elapsed How long the replay took in milliseconds.
+   */
+  void finished(int numReplayed, qint64 elapsed);
+
+  //@}
+
+private slots:
+
+  /** @name Private Slots */
+  //@{
+
+  /** \brief Replays every exchange that's due and waits for the next one. */
+  void replayDue();
+
+  //@}
+
+private:
+
+  /** @name Private Members */
+  //@{
+
+  /** \brief The connection replies are fed through. */
+  UDJServerConnection *serverConnection;
+
+  /** \brief The exchanges in the capture, in the order they finished. */
+  QVariantList exchanges;
+
+  /** \brief The index of the next exchange to replay. */
+  int nextExchange;
+
+  /** \brief How much faster than the original session to replay. */
+  double speed;
+
+  /** \brief Started when the replay started. */
+  QElapsedTimer replayTimer;
+
+  /** \brief Timer used to wait for the next exchange. */
+  QTimer *dueTimer;
+
+  //@}
+
+  /** @name Private Functions */
+  //@{
+
+  /**
+   * \brief Gets when the given exchange should be replayed.
+   *
+   * \param exchange The index of the exchange.
+   * \return When the exchange should be replayed, in milliseconds since the start of the
+   * replay.
+   */
+  qint64 getDueTime(int exchange) const;
+
+  //@}
+
+};
+
+
+} //end namespace UDJ
+#endif //TRAFFIC_REPLAYER_HPP
@@ -17,13 +17,19 @@
  * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include <QNetworkAccessManager>
-#include <QBuffer>
 #include <QRegExp>
 #include <QStringList>
 #include "UDJServerConnection.hpp"
 #include "JSONHelper.hpp"
+#include "JSONReplyReader.hpp"
+#include "PlaylistDecoder.hpp"
+#include "RequestScheduler.hpp"
+#include "NetworkAccess.hpp"
+#include "NetworkMetrics.hpp"
 #include "Logger.hpp"
+#include "Utils.hpp"
 #include <QSet>
+#include <QTimer>
 
 
 QByteArray stripControllCharacters(const QByteArray& toStrip){
@@ -37,11 +43,45 @@ namespace UDJ{
 UDJServerConnection::UDJServerConnection(QObject *parent):QObject(parent),
   ticket_hash(""),
   user_id(-1),
-  playerId(-1)
+  playerId(-1),
+  isPlayerEventsEnabled(false),
+  playerEventsConnected(false),
+  isAwaitingPlayerEvents(false),
+  lastPlayerEventId(-1),
+  playerEventsBackoff(getPlayerEventsBaseBackoff()),
+  isReauthing(false),
+  isTicketExpired(false),
+  ticketLifetime(getDefaultTicketLifetime()),
+  isReplaying(false)
 {
-  netAccessManager = new QNetworkAccessManager(this);
-  connect(netAccessManager, SIGNAL(finished(QNetworkReply*)),
-    this, SLOT(recievedReply(QNetworkReply*)));
+  netAccessManager = NetworkAccess::instance()->getManager();
+  scheduler = new RequestScheduler(netAccessManager, this);
+  playerEventsWatchdog = new QTimer(this);
+  playerEventsWatchdog->setSingleShot(true);
+  playerEventsReconnectTimer = new QTimer(this);
+  playerEventsReconnectTimer->setSingleShot(true);
+  connect(playerEventsWatchdog, SIGNAL(timeout()), this, SLOT(onPlayerEventsStalled()));
+  connect(playerEventsReconnectTimer, SIGNAL(timeout()), this, SLOT(requestPlayerEvents()));
+  ticketRefreshTimer = new QTimer(this);
+  ticketRefreshTimer->setSingleShot(true);
+  connect(ticketRefreshTimer, SIGNAL(timeout()), this, SLOT(refreshTicket()));
+  connect(scheduler,
+    SIGNAL(replyFinished(QNetworkReply*, const RequestScheduler::request_t&)),
+    this,
+    SLOT(recievedReply(QNetworkReply*, const RequestScheduler::request_t&)));
+  connect(scheduler,
+    SIGNAL(requestIssued(QNetworkReply*, const RequestScheduler::request_t&)),
+    this,
+    SLOT(onRequestIssued(QNetworkReply*, const RequestScheduler::request_t&)));
+  connect(scheduler,
+    SIGNAL(reachabilityChanged(bool)),
+    this,
+    SIGNAL(serverReachabilityChanged(bool)));
+  QString captureFile =
+    QString::fromLocal8Bit(qgetenv(TrafficCapture::getCaptureFileEnvName().constData()));
+  if(!captureFile.isEmpty()){
+    trafficCapture.open(captureFile);
+  }
 }
 
 void UDJServerConnection::prepareJSONRequest(QNetworkRequest &request){
@@ -49,16 +89,132 @@ void UDJServerConnection::prepareJSONRequest(QNetworkRequest &request){
   request.setRawHeader(getTicketHeaderName(), ticket_hash);
 }
 
+void UDJServerConnection::setTicket(const QByteArray& ticket){
+  ticket_hash = ticket;
+  ticketTimer.start();
+  armTicketRefresh();
+}
+
+void UDJServerConnection::setCredentials(const QString& newUsername, const QString& newPassword){
+  username = newUsername;
+  password = newPassword;
+  armTicketRefresh();
+}
+
+void UDJServerConnection::setTicketLifetimeEstimate(qint64 lifetime){
+  ticketLifetime = qMax(lifetime, getMinTicketLifetime());
+  armTicketRefresh();
+}
+
+void UDJServerConnection::armTicketRefresh(){
+  if(username.isEmpty() || ticket_hash.isEmpty()){
+    ticketRefreshTimer->stop();
+    return;
+  }
+  qint64 refreshIn = ticketLifetime*9/10 - ticketTimer.elapsed();
+  ticketRefreshTimer->start((int)qMax((qint64)0, refreshIn));
+}
+
+void UDJServerConnection::refreshTicket(){
+  if(!isReauthing){
+    Logger::instance()->log("Refreshing ticket before it expires");
+    isReauthing = true;
+    authenticate(username, password);
+  }
+}
+
+bool UDJServerConnection::send(const RequestScheduler::request_t& request){
+  //There's no point sending a request with a ticket we know is dead.
+  if(isTicketExpired){
+    holdRequest(request);
+    return true;
+  }
+  return issue(request);
+}
+
+bool UDJServerConnection::issue(const RequestScheduler::request_t& request){
+  if(isReplaying){
+    Logger::instance()->log("Not sending " + QString(getReplyHandlers()[request.endpoint].name) +
+      " request while replaying captured traffic");
+    return true;
+  }
+  return scheduler->schedule(request) != 0;
+}
+
+void UDJServerConnection::parkRequest(const RequestScheduler::request_t& request){
+  if(request.endpoint == PLAYER_EVENTS_ENDPOINT){
+    //Nothing is on the wire until it's sent again, which restarts the watchdog.
+    playerEventsWatchdog->stop();
+  }
+  if(request.request.rawHeader(getTicketHeaderName()) != ticket_hash && !isTicketExpired){
+    //The request went out with a ticket that's since been replaced.
+    RequestScheduler::request_t toResend = request;
+    toResend.request.setRawHeader(getTicketHeaderName(), ticket_hash);
+    toResend.attempts = 0;
+    issue(toResend);
+    return;
+  }
+  if(!isTicketExpired){
+    qint64 age = ticketTimer.elapsed();
+    Logger::instance()->log("Ticket expired after " + QString::number(age) + "ms");
+    if(age < ticketLifetime){
+      ticketLifetime = qMax(age, getMinTicketLifetime());
+      emit ticketLifetimeObserved(ticketLifetime);
+    }
+    isTicketExpired = true;
+  }
+  holdRequest(request);
+}
+
+void UDJServerConnection::holdRequest(const RequestScheduler::request_t& request){
+  if(parkedRequests.size() >= getMaxParkedRequests()){
+    Logger::instance()->log("Too many requests waiting for a new ticket, dropping the oldest");
+    parkedRequests.removeFirst();
+  }
+  parkedRequests.append(request);
+  if(!isReauthing){
+    isReauthing = true;
+    authenticate(username, password);
+  }
+}
+
+void UDJServerConnection::abandonParkedRequests(){
+  //Whatever happens next has to start from a fresh request rather than wait on a
+  //ticket that isn't coming.
+  isTicketExpired = false;
+  parkedRequests.clear();
+}
+
+void UDJServerConnection::replayParkedRequests(){
+  QList<RequestScheduler::request_t> toReplay = parkedRequests;
+  parkedRequests.clear();
+  Logger::instance()->log("Replaying " + QString::number(toReplay.size()) + " parked requests");
+  Q_FOREACH(RequestScheduler::request_t request, toReplay){
+    request.request.setRawHeader(getTicketHeaderName(), ticket_hash);
+    request.attempts = 0;
+    issue(request);
+  }
+}
+
+bool UDJServerConnection::isTicketAuthError(QNetworkReply *reply){
+  return reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 401 &&
+    reply->rawHeader("WWW-Authenticate") == "ticket-hash";
+}
+
 void UDJServerConnection::authenticate(
   const QString& username,
   const QString& password)
 {
   QNetworkRequest authRequest(getAuthUrl());
   QString data("username="+username+"&password="+password);
-  QBuffer *dataBuffer = new QBuffer();
-  dataBuffer->setData(data.toUtf8());
-  QNetworkReply *reply = netAccessManager->post(authRequest, dataBuffer);
-  dataBuffer->setParent(reply);
+  RequestScheduler::request_t request = RequestScheduler::createRequest(
+    RequestScheduler::INTERACTIVE_REQUEST,
+    AUTH_ENDPOINT,
+    QNetworkAccessManager::PostOperation,
+    authRequest,
+    data.toUtf8());
+  request.isIdempotent = true;
+  issue(request);
   Logger::instance()->log("Doing auth request");
 }
 
@@ -78,11 +234,36 @@ void UDJServerConnection::modLibContents(const QVariantList& songsToAdd,
     addJSON.replace("%", "%25").replace("&", "%26").replace("=", "%3D").replace(";", "%3B").replace("\x02","")
     + "&to_delete=" + deleteJSON;
   Logger::instance()->log("Lib mod payload: " + QString::fromUtf8(payload));
-  QNetworkReply *reply = netAccessManager->post(modRequest, payload);
-  Logger::instance()->log("Issued request" + QString::fromUtf8(payload));
-  reply->setProperty(getSongsAddedPropertyName(), addJSON);
-  reply->setProperty(getSongsDeletedPropertyName(), deleteJSON);
-  Logger::instance()->log("Set reply properties" + QString::fromUtf8(payload));
+  RequestScheduler::request_t request = RequestScheduler::createRequest(
+    RequestScheduler::BACKGROUND_SYNC_REQUEST,
+    LIB_MOD_ENDPOINT,
+    QNetworkAccessManager::PostOperation,
+    modRequest,
+    payload);
+  request.properties[getSongsAddedPropertyName()] = addJSON;
+  request.properties[getSongsDeletedPropertyName()] = deleteJSON;
+  send(request);
+  Logger::instance()->log("Scheduled request" + QString::fromUtf8(payload));
+}
+
+void UDJServerConnection::getLibraryFingerprint(){
+  QNetworkRequest fingerprintRequest(getLibFingerprintUrl());
+  fingerprintRequest.setRawHeader(getTicketHeaderName(), ticket_hash);
+  send(RequestScheduler::createRequest(
+    RequestScheduler::BACKGROUND_SYNC_REQUEST,
+    LIB_FINGERPRINT_ENDPOINT,
+    QNetworkAccessManager::GetOperation,
+    fingerprintRequest));
+}
+
+void UDJServerConnection::getLibraryBucketSongs(const QList<int>& buckets){
+  QNetworkRequest bucketSongsRequest(getLibBucketSongsUrl(buckets));
+  bucketSongsRequest.setRawHeader(getTicketHeaderName(), ticket_hash);
+  send(RequestScheduler::createRequest(
+    RequestScheduler::BACKGROUND_SYNC_REQUEST,
+    LIB_BUCKET_SONGS_ENDPOINT,
+    QNetworkAccessManager::GetOperation,
+    bucketSongsRequest));
 }
 
 void UDJServerConnection::createPlayer(
@@ -110,13 +291,25 @@ void UDJServerConnection::createPlayer(
 void UDJServerConnection::createPlayer(const QByteArray& payload){
   QNetworkRequest createPlayerRequest(getCreatePlayerUrl());
   prepareJSONRequest(createPlayerRequest);
-  /*QNetworkReply *reply =*/ netAccessManager->put(createPlayerRequest, payload);
+  RequestScheduler::request_t request = RequestScheduler::createRequest(
+    RequestScheduler::INTERACTIVE_REQUEST,
+    CREATE_PLAYER_ENDPOINT,
+    QNetworkAccessManager::PutOperation,
+    createPlayerRequest,
+    payload);
+  //Retrying could create the player twice.
+  request.isIdempotent = false;
+  send(request);
 }
 
 void UDJServerConnection::removePlayerPassword(){
   QNetworkRequest removePasswordRequest(getPlayerPasswordUrl());
   removePasswordRequest.setRawHeader(getTicketHeaderName(), ticket_hash);
-  /*QNetworkReply *reply =*/ netAccessManager->deleteResource(removePasswordRequest);
+  send(RequestScheduler::createRequest(
+    RequestScheduler::INTERACTIVE_REQUEST,
+    REMOVE_PASSWORD_ENDPOINT,
+    QNetworkAccessManager::DeleteOperation,
+    removePasswordRequest));
 }
 
 void UDJServerConnection::setPlayerPassword(const QString& newPassword){
@@ -125,8 +318,15 @@ void UDJServerConnection::setPlayerPassword(const QString& newPassword){
   QUrl params;
   params.addQueryItem("password", newPassword);
   QByteArray payload = params.encodedQuery();
-  QNetworkReply *reply = netAccessManager->post(setPasswordRequest, payload);
-  reply->setProperty(getPlayerPasswordPropertyName(), newPassword);
+  RequestScheduler::request_t request = RequestScheduler::createRequest(
+    RequestScheduler::INTERACTIVE_REQUEST,
+    SET_PASSWORD_ENDPOINT,
+    QNetworkAccessManager::PostOperation,
+    setPasswordRequest,
+    payload);
+  request.properties[getPlayerPasswordPropertyName()] = newPassword;
+  request.isIdempotent = true;
+  send(request);
 }
 
 void UDJServerConnection::setPlayerLocation(
@@ -145,17 +345,31 @@ void UDJServerConnection::setPlayerLocation(
   params.addQueryItem("postal_code", zipcode);
   params.addQueryItem("country", "United States");
   QByteArray payload = params.encodedQuery();
-  QNetworkReply *reply = netAccessManager->post(setLocationRequest, payload);
-  reply->setProperty(getLocationAddressPropertyName(), streetAddress);
-  reply->setProperty(getLocationCityPropertyName(), city);
-  reply->setProperty(getLocationStatePropertyName(), state);
-  reply->setProperty(getLocationZipcodePropertyName(), zipcode);
+  RequestScheduler::request_t request = RequestScheduler::createRequest(
+    RequestScheduler::INTERACTIVE_REQUEST,
+    SET_LOCATION_ENDPOINT,
+    QNetworkAccessManager::PostOperation,
+    setLocationRequest,
+    payload);
+  request.properties[getLocationAddressPropertyName()] = streetAddress;
+  request.properties[getLocationCityPropertyName()] = city;
+  request.properties[getLocationStatePropertyName()] = state;
+  request.properties[getLocationZipcodePropertyName()] = zipcode;
+  request.isIdempotent = true;
+  send(request);
 }
 
 void UDJServerConnection::getActivePlaylist(){
   QNetworkRequest getActivePlaylistRequest(getActivePlaylistUrl());
   getActivePlaylistRequest.setRawHeader(getTicketHeaderName(), ticket_hash);
-  netAccessManager->get(getActivePlaylistRequest);
+  if(!activePlaylistETag.isEmpty()){
+    getActivePlaylistRequest.setRawHeader(getIfNoneMatchHeaderName(), activePlaylistETag);
+  }
+  send(RequestScheduler::createRequest(
+    RequestScheduler::PLAYLIST_READ_REQUEST,
+    GET_ACTIVE_PLAYLIST_ENDPOINT,
+    QNetworkAccessManager::GetOperation,
+    getActivePlaylistRequest));
 }
 
 void UDJServerConnection::modActivePlaylist(
@@ -171,9 +385,15 @@ void UDJServerConnection::modActivePlaylist(
   params.addQueryItem("to_add", addJSON);
   params.addQueryItem("to_remove", removeJSON);
   QByteArray payload = params.encodedQuery();
-  QNetworkReply *reply = netAccessManager->post(modRequest, payload);
-  reply->setProperty(getSongsAddedPropertyName(), addJSON);
-  reply->setProperty(getSongsRemovedPropertyName(), removeJSON);
+  RequestScheduler::request_t request = RequestScheduler::createRequest(
+    RequestScheduler::INTERACTIVE_REQUEST,
+    MOD_ACTIVE_PLAYLIST_ENDPOINT,
+    QNetworkAccessManager::PostOperation,
+    modRequest,
+    payload);
+  request.properties[getSongsAddedPropertyName()] = addJSON;
+  request.properties[getSongsRemovedPropertyName()] = removeJSON;
+  send(request);
 }
 
 void UDJServerConnection::setCurrentSong(library_song_id_t currentSong){
@@ -181,8 +401,14 @@ void UDJServerConnection::setCurrentSong(library_song_id_t currentSong){
   QString params = "lib_id="+QString::number(currentSong);
   QNetworkRequest setCurrentSongRequest(getCurrentSongUrl());
   setCurrentSongRequest.setRawHeader(getTicketHeaderName(), ticket_hash);
-  /*QNetworkReply *reply =*/
-    netAccessManager->post(setCurrentSongRequest, params.toUtf8());
+  RequestScheduler::request_t request = RequestScheduler::createRequest(
+    RequestScheduler::INTERACTIVE_REQUEST,
+    SET_CURRENT_SONG_ENDPOINT,
+    QNetworkAccessManager::PostOperation,
+    setCurrentSongRequest,
+    params.toUtf8());
+  request.isIdempotent = true;
+  send(request);
 }
 
 void UDJServerConnection::setVolume(int volume){
@@ -191,8 +417,14 @@ void UDJServerConnection::setVolume(int volume){
   params.addQueryItem("volume", QString::number(volume));
   QNetworkRequest setCurrentVolumeRequest(getVolumeUrl());
   setCurrentVolumeRequest.setRawHeader(getTicketHeaderName(), ticket_hash);
-  /*QNetworkReply *reply = */
-    netAccessManager->post(setCurrentVolumeRequest,  params.encodedQuery());
+  RequestScheduler::request_t request = RequestScheduler::createRequest(
+    RequestScheduler::INTERACTIVE_REQUEST,
+    SET_VOLUME_ENDPOINT,
+    QNetworkAccessManager::PostOperation,
+    setCurrentVolumeRequest,
+    params.encodedQuery());
+  request.isIdempotent = true;
+  send(request);
 }
 
 void UDJServerConnection::setPlayerState(const QString& newState){
@@ -201,67 +433,159 @@ void UDJServerConnection::setPlayerState(const QString& newState){
   QByteArray payload = params.toUtf8();
   QNetworkRequest setPlayerActiveRequest(getPlayerStateUrl());
   setPlayerActiveRequest.setRawHeader(getTicketHeaderName(), ticket_hash);
-  QNetworkReply *reply = netAccessManager->post(setPlayerActiveRequest, payload);
-  reply->setProperty(getStatePropertyName(), newState);
+  RequestScheduler::request_t request = RequestScheduler::createRequest(
+    RequestScheduler::INTERACTIVE_REQUEST,
+    SET_STATE_ENDPOINT,
+    QNetworkAccessManager::PostOperation,
+    setPlayerActiveRequest,
+    payload);
+  request.properties[getStatePropertyName()] = newState;
+  request.isIdempotent = true;
+  send(request);
 }
 
 void UDJServerConnection::clearCurrentSong(){
   Logger::instance()->log("Clearing current song");
   QNetworkRequest clearCurrentSongRequest(getCurrentSongUrl());
   clearCurrentSongRequest.setRawHeader(getTicketHeaderName(), ticket_hash);
-  /*QNetworkReply *reply =*/ netAccessManager->deleteResource(clearCurrentSongRequest);
+  send(RequestScheduler::createRequest(
+    RequestScheduler::INTERACTIVE_REQUEST,
+    CLEAR_CURRENT_SONG_ENDPOINT,
+    QNetworkAccessManager::DeleteOperation,
+    clearCurrentSongRequest));
 }
 
 
 void UDJServerConnection::getParticipantList(){
   QNetworkRequest getParticipantListRequest(getParticipantsUrl());
   getParticipantListRequest.setRawHeader(getTicketHeaderName(), ticket_hash);
-  /*QNetworkReply *reply =*/ netAccessManager->get(getParticipantListRequest);
+  send(RequestScheduler::createRequest(
+    RequestScheduler::PLAYLIST_READ_REQUEST,
+    GET_PARTICIPANTS_ENDPOINT,
+    QNetworkAccessManager::GetOperation,
+    getParticipantListRequest));
 }
 
-void UDJServerConnection::recievedReply(QNetworkReply *reply){
-  if(reply->request().url().path() == getAuthUrl().path()){
-    handleAuthReply(reply);
-  }
-  else if(reply->request().url().path() == getPlayerStateUrl().path()){
-    handleSetStateReply(reply);
-  }
-  else if(reply->request().url().path() == getCreatePlayerUrl().path()){
-    handleCreatePlayerReply(reply);
-  }
-  else if(isGetActivePlaylistReply(reply)){
-    handleReceivedActivePlaylist(reply);
-  }
-  else if(reply->request().url().path() == getCurrentSongUrl().path() && 
-      reply->operation() == QNetworkAccessManager::PostOperation)
-  {
-    handleReceivedCurrentSongSet(reply);
-  }
-  else if(reply->request().url().path() == getCurrentSongUrl().path() && 
-      reply->operation() == QNetworkAccessManager::DeleteOperation)
-  {
-    handleRecievedClearCurrentSong(reply);
-  }
-  else if(reply->request().url().path() == getLibModUrl().path()){
-    handleReceivedLibMod(reply);
-  }
-  else if(reply->request().url().path() == getVolumeUrl().path()){
-    handleReceivedVolumeSet(reply);
+void UDJServerConnection::prewarm(){
+  NetworkAccess::instance()->prewarm(getServerUrl());
+}
+
+void UDJServerConnection::startPlayerEvents(){
+  isPlayerEventsEnabled = true;
+  playerEventsBackoff = getPlayerEventsBaseBackoff();
+  requestPlayerEvents();
+}
+
+void UDJServerConnection::stopPlayerEvents(){
+  isPlayerEventsEnabled = false;
+  playerEventsWatchdog->stop();
+  playerEventsReconnectTimer->stop();
+  setPlayerEventsConnected(false);
+}
+
+void UDJServerConnection::requestPlayerEvents(){
+  if(!isPlayerEventsEnabled || isAwaitingPlayerEvents){
+    return;
   }
-  else if(isModActivePlaylistReply(reply)){
-    handleReceivedPlaylistMod(reply);
+  playerEventsReconnectTimer->stop();
+  QNetworkRequest eventsRequest(getPlayerEventsUrl());
+  eventsRequest.setRawHeader(getTicketHeaderName(), ticket_hash);
+  RequestScheduler::request_t request = RequestScheduler::createRequest(
+    RequestScheduler::LONG_POLL_REQUEST,
+    PLAYER_EVENTS_ENDPOINT,
+    QNetworkAccessManager::GetOperation,
+    eventsRequest);
+  //We reconnect on our own so that polling can take over as soon as the channel drops.
+  request.isIdempotent = false;
+  //The request may yet be held back, so the watchdog is only started once it's issued.
+  if(send(request)){
+    isAwaitingPlayerEvents = true;
   }
-  else if(reply->request().url().path() == getPlayerLocationUrl().path()){
-    handleLocationSetReply(reply);
+}
+
+void UDJServerConnection::onPlayerEventsStalled(){
+  Logger::instance()->log("Player events stalled");
+  //A half open connection never finishes on its own, so we give up on it and start a
+  //fresh one.
+  isAwaitingPlayerEvents = false;
+  QNetworkReply *stalledReply = playerEventsReply;
+  playerEventsReply = NULL;
+  if(stalledReply != NULL){
+    stalledReply->abort();
   }
-  else if(isPasswordSetReply(reply)){
-    handlePlayerPasswordSetReply(reply);
+  setPlayerEventsConnected(false);
+  schedulePlayerEventsReconnect();
+}
+
+void UDJServerConnection::onPlayerEventsProgress(){
+  if(sender() == playerEventsReply && isPlayerEventsEnabled){
+    playerEventsWatchdog->start();
   }
-  else if(isPasswordRemoveReply(reply)){
-    handlePlayerPasswordRemoveReply(reply);
+}
+
+void UDJServerConnection::setPlayerEventsConnected(bool connected){
+  if(connected == playerEventsConnected){
+    return;
   }
-  else if(reply->request().url().path() == getParticipantsUrl().path()){
-    handleParticipantsResponse(reply);
+  playerEventsConnected = connected;
+  Logger::instance()->log(connected ? "Player events connected" : "Player events disconnected");
+  emit playerEventsConnectionChanged(connected);
+}
+
+void UDJServerConnection::schedulePlayerEventsReconnect(int minDelay){
+  //Equal jitter, like the request scheduler, so players don't all reconnect at once.
+  int delay = playerEventsBackoff/2 + (int)Utils::getRandomUpTo(playerEventsBackoff/2);
+  playerEventsReconnectTimer->start(qMax(delay, minDelay));
+  playerEventsBackoff = qMin(playerEventsBackoff*2, getPlayerEventsMaxBackoff());
+}
+
+void UDJServerConnection::recievedReply(
+  QNetworkReply *reply,
+  const RequestScheduler::request_t& request)
+{
+  if(request.endpoint >= 0 && request.endpoint < NUM_ENDPOINTS){
+    const reply_handler_t& handler = getReplyHandlers()[request.endpoint];
+    Logger::instance()->log(QString(handler.name) + " reply #" +
+      QString::number(request.correlationId) + " took " +
+      QString::number(request.latency) + "ms");
+    //Streamed replies have already had some of their body read, the rest of it is
+    //still available.
+    JSONReplyReader *reader = JSONReplyReader::findReader(reply);
+    qint64 bytesReceived = reply->bytesAvailable();
+    if(reader != NULL){
+      bytesReceived += reader->getBytesRead();
+    }
+    if(!isReplaying){
+      QByteArray body = reply->peek(reply->bytesAvailable());
+      if(reader != NULL){
+        body.prepend(reader->getRetainedBody());
+      }
+      trafficCapture.record(handler.name, request, reply, body);
+    }
+    QElapsedTimer processingTimer;
+    processingTimer.start();
+    //With credentials on hand an expired ticket is ours to deal with. The request is
+    //held exactly as it was sent and replayed once we have a new ticket.
+    if(request.endpoint != AUTH_ENDPOINT && !username.isEmpty() && !isReplaying &&
+      isTicketAuthError(reply))
+    {
+      parkRequest(request);
+    }
+    else{
+      (this->*handler.handle)(reply);
+    }
+    //Handlers of replies that weren't streamed attach a reader of their own.
+    reader = JSONReplyReader::findReader(reply);
+    NetworkMetrics::instance()->record(
+      handler.name,
+      reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(),
+      request.attempts,
+      request.payload.size(),
+      bytesReceived,
+      request.queueWait,
+      request.latency,
+      processingTimer.elapsed(),
+      reader != NULL ? reader->getParseTime() : -1);
   }
   else{
     Logger::instance()->log("Received unknown response");
@@ -270,23 +594,114 @@ void UDJServerConnection::recievedReply(QNetworkReply *reply){
   reply->deleteLater();
 }
 
+void UDJServerConnection::onRequestIssued(
+  QNetworkReply *reply,
+  const RequestScheduler::request_t& request)
+{
+  if(request.endpoint >= 0 && request.endpoint < NUM_ENDPOINTS &&
+    getReplyHandlers()[request.endpoint].isStreamed)
+  {
+    //The playlist is decoded straight into its snapshot, everything else is built
+    //into a QVariant document.
+    JSONStreamParser::Handler *decoder = NULL;
+    if(request.endpoint == GET_ACTIVE_PLAYLIST_ENDPOINT){
+      decoder = new PlaylistDecoder();
+    }
+    new JSONReplyReader(reply, trafficCapture.isOpen(), decoder);
+  }
+  if(request.endpoint == PLAYER_EVENTS_ENDPOINT){
+    playerEventsReply = reply;
+    connect(reply, SIGNAL(readyRead()), this, SLOT(onPlayerEventsProgress()));
+    playerEventsWatchdog->start(getPlayerEventsWait()*1000 + getPlayerEventsGracePeriod());
+  }
+}
+
+bool UDJServerConnection::replayReply(
+  const QString& endpointName,
+  QNetworkReply *reply,
+  const QByteArray& payload,
+  qint64 latency)
+{
+  for(int endpoint=0; endpoint<NUM_ENDPOINTS; ++endpoint){
+    if(endpointName == getReplyHandlers()[endpoint].name){
+      RequestScheduler::request_t request = RequestScheduler::createRequest(
+        RequestScheduler::INTERACTIVE_REQUEST,
+        endpoint,
+        reply->operation(),
+        reply->request(),
+        payload);
+      request.attempts = 1;
+      request.queueWait = 0;
+      request.latency = latency;
+      recievedReply(reply, request);
+      return true;
+    }
+  }
+  reply->deleteLater();
+  return false;
+}
+
+const UDJServerConnection::reply_handler_t* UDJServerConnection::getReplyHandlers(){
+  //Indexed by Endpoint, so the order here must match the order of the enum. Streamed
+  //endpoints are the ones whose bodies can get big enough to be worth parsing as they
+  //arrive.
+  static const reply_handler_t replyHandlers[NUM_ENDPOINTS] = {
+    {"Auth", &UDJServerConnection::handleAuthReply, false},
+    {"Set state", &UDJServerConnection::handleSetStateReply, false},
+    {"Create player", &UDJServerConnection::handleCreatePlayerReply, false},
+    {"Get active playlist", &UDJServerConnection::handleReceivedActivePlaylist, true},
+    {"Mod active playlist", &UDJServerConnection::handleReceivedPlaylistMod, false},
+    {"Set current song", &UDJServerConnection::handleReceivedCurrentSongSet, false},
+    {"Clear current song", &UDJServerConnection::handleRecievedClearCurrentSong, false},
+    {"Lib mod", &UDJServerConnection::handleReceivedLibMod, false},
+    {"Lib fingerprint", &UDJServerConnection::handleReceivedLibFingerprint, true},
+    {"Lib bucket songs", &UDJServerConnection::handleReceivedLibBucketSongs, true},
+    {"Set volume", &UDJServerConnection::handleReceivedVolumeSet, false},
+    {"Set location", &UDJServerConnection::handleLocationSetReply, false},
+    {"Set password", &UDJServerConnection::handlePlayerPasswordSetReply, false},
+    {"Remove password", &UDJServerConnection::handlePlayerPasswordRemoveReply, false},
+    {"Get participants", &UDJServerConnection::handleParticipantsResponse, true},
+    {"Player events", &UDJServerConnection::handlePlayerEventsReply, true}
+  };
+  return replyHandlers;
+}
+
 void UDJServerConnection::handleAuthReply(QNetworkReply* reply){
+  bool wasReauthing = isReauthing;
+  isReauthing = false;
   bool success = true;
   QVariantMap authReplyJSON = JSONHelper::getAuthReplyFromJSON(reply, success);
   if(reply->error() == QNetworkReply::NoError && success){
     Logger::instance()->log("Got good auth reply");
-    emit authenticated(authReplyJSON["ticket_hash"].toByteArray(), authReplyJSON["user_id"].value<user_id_t>());
+    QByteArray newTicket = authReplyJSON["ticket_hash"].toByteArray();
+    user_id_t newUserId = authReplyJSON["user_id"].value<user_id_t>();
+    if(wasReauthing){
+      user_id = newUserId;
+      setTicket(newTicket);
+      isTicketExpired = false;
+      replayParkedRequests();
+    }
+    emit authenticated(newTicket, newUserId);
   }
   else if(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute) == 401){
+    abandonParkedRequests();
     emit authFailed(tr("Incorrect Username and password"));
   }
   else if(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute) == 501){
+    abandonParkedRequests();
     emit authFailed(tr("Your version of the UDJ player is out of date. Please check www.udjplayer.com for an update."));
   }
   else{
     QByteArray responseData = reply->readAll();
     QString responseString = QString::fromUtf8(responseData);
     Logger::instance()->log(responseString);
+    if(wasReauthing && !isTicketExpired){
+      //The current ticket still works, so there's no need to bother the user yet.
+      Logger::instance()->log("Refreshing ticket failed, will try again");
+      ticketRefreshTimer->start(getTicketRefreshRetryDelay());
+      return;
+    }
+    abandonParkedRequests();
     emit authFailed(
       tr("We're experiencing some techinical difficulties. "
       "We'll be back in a bit"));
@@ -308,6 +723,98 @@ void UDJServerConnection::handleRecievedClearCurrentSong(QNetworkReply *reply){
 
 }
 
+void UDJServerConnection::handlePlayerEventsReply(QNetworkReply *reply){
+  //A poll we gave up on because it stalled. We've already arranged to reconnect and
+  //anything it brings back is older than what its replacement will.
+  if(!isReplaying && reply != playerEventsReply){
+    return;
+  }
+  playerEventsReply = NULL;
+  isAwaitingPlayerEvents = false;
+  playerEventsWatchdog->stop();
+  if(!isPlayerEventsEnabled){
+    return;
+  }
+  int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+  if(status == 200 || status == 204){
+    setPlayerEventsConnected(true);
+    playerEventsBackoff = getPlayerEventsBaseBackoff();
+    if(status == 200){
+      processPlayerEvents(JSONHelper::getPlayerEventsFromJSON(reply));
+    }
+    requestPlayerEvents();
+  }
+  else if(status == 410){
+    //We've been gone long enough that the server no longer has the events we missed.
+    Logger::instance()->log("Missed player events, resyncing");
+    setPlayerEventsConnected(true);
+    lastPlayerEventId = -1;
+    emit playerEventsGap();
+    requestPlayerEvents();
+  }
+  else{
+    setPlayerEventsConnected(false);
+    if(status == 404 || status == 501){
+      Logger::instance()->log("Server doesn't push player events, polling instead");
+      playerEventsReconnectTimer->start(getPlayerEventsUnsupportedDelay());
+    }
+    else{
+      Logger::instance()->log("Player events failed: " + reply->errorString());
+      schedulePlayerEventsReconnect();
+    }
+    QByteArray response = reply->readAll();
+    emit playerEventsError(QString(response), status, reply->rawHeaderPairs());
+  }
+}
+
+void UDJServerConnection::processPlayerEvents(const QVariantMap& batch){
+  QMap<qint64, QVariantMap> ordered;
+  Q_FOREACH(const QVariant& event, batch["events"].toList()){
+    QVariantMap eventMap = event.toMap();
+    qint64 id = eventMap["id"].toLongLong();
+    if(id > lastPlayerEventId){
+      ordered.insert(id, eventMap);
+    }
+  }
+  if(!ordered.isEmpty() && lastPlayerEventId != -1 &&
+    ordered.begin().key() > lastPlayerEventId + 1)
+  {
+    Logger::instance()->log("Gap in player events, resyncing");
+    emit playerEventsGap();
+  }
+
+  //Each event carries a complete snapshot, so only the newest of each kind matters.
+  QVariantMap newestPlaylist;
+  QVariantList newestParticipants;
+  bool hasPlaylist = false;
+  bool hasParticipants = false;
+  QMap<qint64, QVariantMap>::const_iterator it = ordered.constBegin();
+  for(; it != ordered.constEnd(); ++it){
+    QString type = it.value()["type"].toString();
+    if(type == "active_playlist"){
+      newestPlaylist = it.value()["data"].toMap();
+      hasPlaylist = true;
+    }
+    else if(type == "participants"){
+      newestParticipants = it.value()["data"].toList();
+      hasParticipants = true;
+    }
+    lastPlayerEventId = it.key();
+  }
+  if(batch.contains("last_event_id")){
+    lastPlayerEventId = qMax(lastPlayerEventId, batch["last_event_id"].toLongLong());
+  }
+
+  if(hasPlaylist){
+    playlist_snapshot_t snapshot;
+    PlaylistDecoder::decodeVariant(newestPlaylist, snapshot);
+    emit newActivePlaylist(snapshot);
+  }
+  if(hasParticipants){
+    emit newParticipantList(newestParticipants);
+  }
+}
+
 void UDJServerConnection::handleParticipantsResponse(QNetworkReply *reply){
   if(isResponseType(reply, 200)){
     emit newParticipantList(JSONHelper::getParticipantListFromJSON(reply));
@@ -407,6 +914,41 @@ void UDJServerConnection::handleReceivedLibMod(QNetworkReply *reply){
   }
 }
 
+void UDJServerConnection::handleReceivedLibFingerprint(QNetworkReply *reply){
+  if(isResponseType(reply, 200)){
+    emit libraryFingerprintReceived(JSONHelper::getLibraryFingerprintFromJSON(reply));
+  }
+  else{
+    Logger::instance()->log("Getting library fingerprint failed");
+    QByteArray response = reply->readAll();
+    QString responseMsg = QString::fromUtf8(response);
+    emit getLibraryFingerprintFailed(
+      "error: " + responseMsg,
+      reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(),
+      reply->rawHeaderPairs());
+  }
+}
+
+void UDJServerConnection::handleReceivedLibBucketSongs(QNetworkReply *reply){
+  bool success = false;
+  QVariantList songs;
+  if(isResponseType(reply, 200)){
+    songs = JSONHelper::getLibraryBucketSongsFromJSON(reply, success);
+  }
+  if(success){
+    emit libraryBucketSongsReceived(songs);
+  }
+  else{
+    Logger::instance()->log("Getting library bucket songs failed");
+    QByteArray response = reply->readAll();
+    QString responseMsg = QString::fromUtf8(response);
+    emit getLibraryBucketSongsFailed(
+      "error: " + responseMsg,
+      reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(),
+      reply->rawHeaderPairs());
+  }
+}
+
 void UDJServerConnection::handleCreatePlayerReply(QNetworkReply *reply){
   if(isResponseType(reply, 201)){
     player_id_t issuedId = JSONHelper::getPlayerId(reply);
@@ -424,11 +966,34 @@ void UDJServerConnection::handleCreatePlayerReply(QNetworkReply *reply){
 }
 
 void UDJServerConnection::handleReceivedActivePlaylist(QNetworkReply *reply){
-  if(isResponseType(reply, 200)){
-    emit newActivePlaylist(JSONHelper::getActivePlaylistFromJSON(reply));
+  if(isResponseType(reply, 304)){
+    emit activePlaylistUnchanged();
+  }
+  else if(isResponseType(reply, 200)){
+    playlist_snapshot_t snapshot;
+    if(!JSONHelper::getActivePlaylistFromJSON(reply, snapshot)){
+      //The version we have is still the last one we actually got.
+      emit getActivePlaylistFail(
+        "error: malformed playlist",
+        reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(),
+        reply->rawHeaderPairs());
+      return;
+    }
+    activePlaylistETag = reply->rawHeader(getETagHeaderName());
+    //Not every server supports conditional requests, so fall back to comparing the
+    //body itself. The body was decoded as it arrived, but an unchanged playlist is
+    //never reported.
+    QByteArray digest = JSONReplyReader::findReader(reply)->getDigest();
+    if(digest == activePlaylistDigest){
+      emit activePlaylistUnchanged();
+      return;
+    }
+    activePlaylistDigest = digest;
+    emit newActivePlaylist(snapshot);
   }
   else{
     Logger::instance()->log("Getting playlist failed");
+    forgetActivePlaylistVersion();
     QByteArray response = reply->readAll();
     QString responseMsg = QString(response);
     emit getActivePlaylistFail(
@@ -449,10 +1014,22 @@ void UDJServerConnection::handleReceivedPlaylistMod(QNetworkReply *reply){
     Logger::instance()->log("Modding playlist failed");
     QByteArray response = reply->readAll();
     QString responseMsg = QString(response);
-    emit activePlaylistModFailed(
-      "error: " + responseMsg,
-      reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(),
-      reply->rawHeaderPairs());
+    RequestScheduler::ErrorClass errorClass = RequestScheduler::classifyReply(reply);
+    if(errorClass == RequestScheduler::NETWORK_ERROR_CLASS ||
+      errorClass == RequestScheduler::SERVER_ERROR_CLASS ||
+      errorClass == RequestScheduler::CANCELED_ERROR_CLASS)
+    {
+      emit activePlaylistModFailed(
+        "error: " + responseMsg,
+        reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt(),
+        reply->rawHeaderPairs());
+    }
+    else{
+      emit activePlaylistModRejected(
+        JSONHelper::extractSongLibIds(reply->property(getSongsAddedPropertyName()).toByteArray()),
+        JSONHelper::extractSongLibIds(reply->property(getSongsRemovedPropertyName()).toByteArray()),
+        "error: " + responseMsg);
+    }
   }
 }
 
@@ -485,6 +1062,21 @@ void UDJServerConnection::handleReceivedVolumeSet(QNetworkReply *reply){
   }
 }
 
+QString UDJServerConnection::getConfiguredServerUrlPath(){
+  QString configured = QString::fromUtf8(qgetenv(getServerUrlEnvName().constData()));
+  if(configured.isEmpty()){
+    configured = UDJ_SERVER_URL;
+  }
+  if(configured.isEmpty()){
+    return "https://udjplayer.com:" + getServerPortNumber() + "/udj/0_6/";
+  }
+  if(!configured.endsWith("/")){
+    configured += "/";
+  }
+  Logger::instance()->log("Using UDJ server at " + configured);
+  return configured;
+}
+
 QUrl UDJServerConnection::getActivePlaylistUrl() const{
   return QUrl(getServerUrlPath() + "players/" + QString::number(playerId) +
     "/active_playlist");
@@ -509,6 +1101,22 @@ QUrl UDJServerConnection::getLibModUrl() const{
       QString::number(playerId) + "/library");
 }
 
+QUrl UDJServerConnection::getLibFingerprintUrl() const{
+  return QUrl(getServerUrlPath()+ "players/" +
+      QString::number(playerId) + "/library/fingerprint");
+}
+
+QUrl UDJServerConnection::getLibBucketSongsUrl(const QList<int>& buckets) const{
+  QUrl bucketSongsUrl(getServerUrlPath()+ "players/" +
+      QString::number(playerId) + "/library/fingerprint/songs");
+  QStringList bucketList;
+  Q_FOREACH(int bucket, buckets){
+    bucketList.append(QString::number(bucket));
+  }
+  bucketSongsUrl.addQueryItem("buckets", bucketList.join(","));
+  return bucketSongsUrl;
+}
+
 QUrl UDJServerConnection::getVolumeUrl() const{
   return QUrl(getServerUrlPath()+ "players/" + 
       QString::number(playerId) + "/volume");
@@ -528,37 +1136,21 @@ QUrl UDJServerConnection::getParticipantsUrl() const{
   return QUrl(getServerUrlPath()+ "players/"+QString::number(playerId)+"/users");
 }
 
-
-
-bool UDJServerConnection::isResponseType(QNetworkReply *reply, int code){
-  return reply->attribute(QNetworkRequest::HttpStatusCodeAttribute) == code;
+QUrl UDJServerConnection::getPlayerEventsUrl() const{
+  QUrl eventsUrl(getServerUrlPath()+ "players/"+QString::number(playerId)+"/events");
+  eventsUrl.addQueryItem("wait", QString::number(getPlayerEventsWait()));
+  if(lastPlayerEventId != -1){
+    eventsUrl.addQueryItem("since", QString::number(lastPlayerEventId));
+  }
+  return eventsUrl;
 }
 
-bool UDJServerConnection::isGetActivePlaylistReply(const QNetworkReply *reply) const{
-  return
-    reply->request().url().path() == getActivePlaylistUrl().path()
-    && !reply->property(getSongsRemovedPropertyName()).isValid()
-    && !reply->property(getSongsAddedPropertyName()).isValid();
-}
 
-bool UDJServerConnection::isModActivePlaylistReply(const QNetworkReply *reply) const{
-  return
-    reply->request().url().path() == getActivePlaylistUrl().path()
-    && reply->property(getSongsRemovedPropertyName()).isValid()
-    && reply->property(getSongsAddedPropertyName()).isValid();
-}
 
-bool UDJServerConnection::isPasswordSetReply(const QNetworkReply *reply) const{
-  return reply->request().url().path() == getPlayerPasswordUrl().path() &&
-    reply->operation() == QNetworkAccessManager::PostOperation;
-}
-
-bool UDJServerConnection::isPasswordRemoveReply(const QNetworkReply *reply) const{
-  return reply->request().url().path() == getPlayerPasswordUrl().path() &&
-    reply->operation() == QNetworkAccessManager::DeleteOperation;
+bool UDJServerConnection::isResponseType(QNetworkReply *reply, int code){
+  return reply->attribute(QNetworkRequest::HttpStatusCodeAttribute) == code;
 }
 
 
 
-
 }//end namespace
@@ -25,10 +25,15 @@
 #include <vector>
 #include <QNetworkRequest>
 #include <QNetworkReply>
+#include <QPointer>
 #include "ConfigDefs.hpp"
+#include "RequestScheduler.hpp"
+#include "TrafficCapture.hpp"
+#include "PlaylistSnapshot.hpp"
 
 class QNetworkAccessManager;
 class QNetworkCookieJar;
+class QTimer;
 
 namespace UDJ{
 
@@ -67,11 +72,30 @@ public:
   /**
    * \brief Sets the ticket to be used when communicating with the server.
    *
+   * The ticket is assumed to have just been issued.
+   *
    * \param ticket The ticket to be used when communicating with the server.
    */
-  inline void setTicket(const QByteArray& ticket){
-    ticket_hash = ticket;
-  }
+  void setTicket(const QByteArray& ticket);
+
+  /**
+   * \brief Sets the credentials used to get a new ticket.
+   *
+   * Once credentials are set the connection refreshes its ticket shortly before it's
+   * expected to expire. Requests rejected because of an expired ticket anyway are held
+   * and sent again, exactly as they were, once a new ticket has been obtained.
+   *
+   * \param username The username to authenticate with.
+   * \param password The password to authenticate with.
+   */
+  void setCredentials(const QString& username, const QString& password);
+
+  /**
+   * \brief Sets how long tickets are expected to last.
+   *
+   * \param lifetime How long tickets are expected to last in milliseconds.
+   */
+  void setTicketLifetimeEstimate(qint64 lifetime);
 
   /**
    * \brief Sets the user id to be used when communicating with the server.
@@ -82,6 +106,15 @@ public:
     user_id = userId;
   }
 
+  /**
+   * \brief Gets the user id being used when communicating with the server.
+   *
+   * \return The user id being used when communicating with the server.
+   */
+  inline const user_id_t& getUserId() const{
+    return user_id;
+  }
+
   /**
    * \brief Sets the player id to be used when communicating with the server.
    *
@@ -89,8 +122,58 @@ public:
    */
   inline void setPlayerId(const player_id_t& newPlayerId){
     playerId = newPlayerId;
+    lastPlayerEventId = -1;
+    forgetActivePlaylistVersion();
   }
 
+  /**
+   * \brief Forgets which version of the active playlist was last received so that the
+   * next one received is always reported, even if it hasn't changed on the server.
+   *
+   * This should be called whenever the local copy of the playlist is changed without
+   * the server's involvement.
+   */
+  inline void forgetActivePlaylistVersion(){
+    activePlaylistETag.clear();
+    activePlaylistDigest.clear();
+  }
+
+  /**
+   * \brief Gets whether or not changes are currently being pushed by the server.
+   *
+   * \return True if changes are currently being pushed by the server, false otherwise.
+   */
+  inline bool isPlayerEventsConnected() const{
+    return playerEventsConnected;
+  }
+
+  /**
+   * \brief Sets whether or not the connection is replaying captured traffic.
+   *
+   * While replaying nothing is sent to the server and nothing is captured, the only
+   * replies handled are the ones given to replayReply.
+   *
+   * \param replaying Whether or not the connection is replaying captured traffic.
+   */
+  inline void setReplaying(bool replaying){
+    isReplaying = replaying;
+  }
+
+  /**
+   * \brief Handles a captured reply exactly as if it had just arrived from the server.
+   *
+   * \param endpointName The name of the endpoint the reply is from.
+   * \param reply The captured reply. The connection takes ownership of it.
+   * \param payload The body of the request the reply answered.
+   * \param latency How long the reply originally took to arrive in milliseconds.
+   * \return True if the reply was handled, false if the endpoint is unknown.
+   */
+  bool replayReply(
+    const QString& endpointName,
+    QNetworkReply *reply,
+    const QByteArray& payload,
+    qint64 latency);
+
   //@}
 
 
@@ -141,6 +224,19 @@ public slots:
    */
   void modLibContents(const QVariantList& songsToAdd, const QVariantList& songsToDelete);
 
+  /**
+   * \brief Retrieves the server's fingerprint of the player's library.
+   */
+  void getLibraryFingerprint();
+
+  /**
+   * \brief Retrieves the id and hash of every song the server has in the given buckets
+   * of the library fingerprint.
+   *
+   * @param buckets The buckets whose songs should be retrieved.
+   */
+  void getLibraryBucketSongs(const QList<int>& buckets);
+
   /**
    * \brief Creates a player on the server.
    *
@@ -211,6 +307,25 @@ public slots:
    */
   void getParticipantList();
 
+  /**
+   * \brief Opens a connection to the server ahead of time so the next request doesn't
+   * have to wait on the TCP and TLS handshakes.
+   */
+  void prewarm();
+
+  /**
+   * \brief Starts listening for playlist and participant changes pushed by the server.
+   *
+   * Changes are reported through newActivePlaylist and newParticipantList just like the
+   * results of polling.
+   */
+  void startPlayerEvents();
+
+  /**
+   * \brief Stops listening for changes pushed by the server.
+   */
+  void stopPlayerEvents();
+
   //@}
 
 signals:
@@ -374,6 +489,45 @@ signals:
     int errorCode,
     const QList<QNetworkReply::RawHeaderPair>& headers);
 
+  /**
+   * \brief Emitted when the server's fingerprint of the library is retrieved.
+   *
+   * \param fingerprint The fingerprint of the library as computed by the server.
+   */
+  void libraryFingerprintReceived(const QVariantMap& fingerprint);
+
+  /**
+   * \brief Emitted when there was an error retrieving the server's fingerprint of the library.
+   *
+   * @param errMessage A message describing the error.
+   * @param errorCode The http status code that describes the error.
+   * @param headers The headers from the http response that indicated a failure.
+   */
+  void getLibraryFingerprintFailed(
+    const QString& errMessage,
+    int errorCode,
+    const QList<QNetworkReply::RawHeaderPair>& headers);
+
+  /**
+   * \brief Emitted when the songs the server has in some fingerprint buckets are retrieved.
+   *
+   * \param songs A list of maps, each with the "id" and "hash" of a song the server has.
+   */
+  void libraryBucketSongsReceived(const QVariantList& songs);
+
+  /**
+   * \brief Emitted when there was an error retrieving the songs the server has in some
+   * fingerprint buckets.
+   *
+   * @param errMessage A message describing the error.
+   * @param errorCode The http status code that describes the error.
+   * @param headers The headers from the http response that indicated a failure.
+   */
+  void getLibraryBucketSongsFailed(
+    const QString& errMessage,
+    int errorCode,
+    const QList<QNetworkReply::RawHeaderPair>& headers);
+
   /**
    * \brief Emitted when an player is succesfully created.
    */
@@ -397,7 +551,13 @@ signals:
    *
    * @param newPlaylist The new playlist that was retreived from the server.
    */
-  void newActivePlaylist(const QVariantMap& newPlaylist);
+  void newActivePlaylist(const playlist_snapshot_t& newPlaylist);
+
+  /**
+   * \brief Emitted when the active playlist was retrieved from the server but hadn't
+   * changed since the last time it was retrieved.
+   */
+  void activePlaylistUnchanged();
 
   /**
    * \brief Emitted when there was an error getting the active playlist from the server.
@@ -430,6 +590,46 @@ signals:
     int errorCode,
     const QList<QNetworkReply::RawHeaderPair>& headers);
 
+  /**
+   * \brief Emitted when the server starts or stops pushing changes to us.
+   *
+   * @param connected Whether or not changes are now being pushed.
+   */
+  void playerEventsConnectionChanged(bool connected);
+
+  /**
+   * \brief Emitted when the server stops or starts being reachable.
+   *
+   * @param reachable Whether or not the server is now reachable.
+   */
+  void serverReachabilityChanged(bool reachable);
+
+  /**
+   * \brief Emitted when a ticket expired sooner than expected, meaning tickets will be
+   * refreshed sooner from now on.
+   *
+   * @param lifetime How long tickets are now expected to last in milliseconds.
+   */
+  void ticketLifetimeObserved(qint64 lifetime);
+
+  /**
+   * \brief Emitted when some pushed changes were missed, meaning the playlist and the
+   * participants need to be retrieved in full.
+   */
+  void playerEventsGap();
+
+  /**
+   * \brief Emitted when there was an error listening for pushed changes.
+   *
+   * @param errMessage A message describing the error.
+   * @param errorCode The http status code that describes the error.
+   * @param headers The headers from the http response that indicated a failure.
+   */
+  void playerEventsError(
+    const QString& errMessage,
+    int errorCode,
+    const QList<QNetworkReply::RawHeaderPair>& headers);
+
   /**
    * \brief Emitted when the current song that the player is playing is
    * succesfully set on the server.
@@ -459,7 +659,9 @@ signals:
     const QSet<library_song_id_t>& removed);
 
   /**
-   * \brief Emitted when there in a error modifying the playlist on the server.
+   * \brief Emitted when modifying the playlist on the server failed in a way that
+   * sending the modification again later may fix: it never reached the server or the
+   * server failed on its end.
    *
    * @param errMessage A message describing the error.
    * @param errorCode The http status code that describes the error.
@@ -470,6 +672,19 @@ signals:
     int errorCode,
     const QList<QNetworkReply::RawHeaderPair>& headers);
 
+  /**
+   * \brief Emitted instead of activePlaylistModFailed when the server answered but
+   * refused the modification, so sending it again won't help.
+   *
+   * @param added The set of songs that were supposed to be added to the playlist.
+   * @param removed The set of songs that were supposed to be removed from the playlist.
+   * @param errMessage A message describing the error.
+   */
+  void activePlaylistModRejected(
+    const QSet<library_song_id_t>& added,
+    const QSet<library_song_id_t>& removed,
+    const QString& errMessage);
+
   void volumeSetOnServer();
 
   /**
@@ -493,16 +708,87 @@ private slots:
   //@{
 
   /**
-   * \brief Handles a reply from the server.
+   * \brief Handles a reply from the server by dispatching it to the handler for the
+   * endpoint it came from.
    *
    * @param reply The reply from the server.
+   * @param request The request the reply is for.
    */
-  void recievedReply(QNetworkReply *reply);
+  void recievedReply(QNetworkReply *reply, const RequestScheduler::request_t& request);
+
+  /**
+   * \brief Starts parsing the body of a reply as it arrives if its endpoint is streamed.
+   *
+   * @param reply The reply that was just created.
+   * @param request The request the reply is for.
+   */
+  void onRequestIssued(QNetworkReply *reply, const RequestScheduler::request_t& request);
+
+  /**
+   * \brief Asks the server for any changes after the last one we saw, unless we're
+   * already waiting on such a request.
+   */
+  void requestPlayerEvents();
+
+  /**
+   * \brief Called when the server has held a request for changes far longer than it
+   * said it would, meaning the channel has most likely stalled.
+   */
+  void onPlayerEventsStalled();
+
+  /**
+   * \brief Called when part of the reply to the outstanding request for changes
+   * arrives, which shows the channel is still alive.
+   */
+  void onPlayerEventsProgress();
+
+  /**
+   * \brief Gets a new ticket before the current one expires.
+   */
+  void refreshTicket();
 
   //@}
 
 
 private:
+  /** @name Private Types */
+  //@{
+
+  /**
+   * \brief The server endpoints, used to tell which handler a reply should go to.
+   */
+  enum Endpoint{
+    AUTH_ENDPOINT=0,
+    SET_STATE_ENDPOINT,
+    CREATE_PLAYER_ENDPOINT,
+    GET_ACTIVE_PLAYLIST_ENDPOINT,
+    MOD_ACTIVE_PLAYLIST_ENDPOINT,
+    SET_CURRENT_SONG_ENDPOINT,
+    CLEAR_CURRENT_SONG_ENDPOINT,
+    LIB_MOD_ENDPOINT,
+    LIB_FINGERPRINT_ENDPOINT,
+    LIB_BUCKET_SONGS_ENDPOINT,
+    SET_VOLUME_ENDPOINT,
+    SET_LOCATION_ENDPOINT,
+    SET_PASSWORD_ENDPOINT,
+    REMOVE_PASSWORD_ENDPOINT,
+    GET_PARTICIPANTS_ENDPOINT,
+    PLAYER_EVENTS_ENDPOINT,
+    NUM_ENDPOINTS
+  };
+
+  /**
+   * \brief An entry in the reply dispatch table.
+   */
+  typedef struct {
+    const char* name;
+    void (UDJServerConnection::*handle)(QNetworkReply *reply);
+    /** \brief Whether or not the reply body is parsed while it's still arriving. */
+    bool isStreamed;
+  } reply_handler_t;
+
+  //@}
+
   /** @name Private Members */
   //@{
 
@@ -515,9 +801,75 @@ private:
   /** \brief Id of the player associated with this conneciton */
   player_id_t playerId;
 
-  /** \brief Manager for access to the network. */
+  /** \brief Manager for access to the network, shared with every other connection. */
   QNetworkAccessManager *netAccessManager;
 
+  /**
+   * \brief ETag the server gave the last active playlist it sent, if it gave one.
+   */
+  QByteArray activePlaylistETag;
+
+  /**
+   * \brief Digest of the body of the last active playlist received from the server.
+   */
+  QByteArray activePlaylistDigest;
+
+  /** \brief Whether or not we should be listening for pushed changes. */
+  bool isPlayerEventsEnabled;
+
+  /** \brief Whether or not the server is currently pushing changes to us. */
+  bool playerEventsConnected;
+
+  /** \brief Whether or not a request for changes is outstanding. */
+  bool isAwaitingPlayerEvents;
+
+  /** \brief The outstanding request for changes, once it has actually been issued. */
+  QPointer<QNetworkReply> playerEventsReply;
+
+  /** \brief Id of the last pushed change we've seen, -1 if we haven't seen any. */
+  qint64 lastPlayerEventId;
+
+  /** \brief How long to wait before reconnecting after the next failure. */
+  int playerEventsBackoff;
+
+  /** \brief Fires if the server holds a request for changes for too long. */
+  QTimer *playerEventsWatchdog;
+
+  /** \brief Used to reconnect to the server after a failure. */
+  QTimer *playerEventsReconnectTimer;
+
+  /** \brief Username used to get a new ticket. */
+  QString username;
+
+  /** \brief Password used to get a new ticket. */
+  QString password;
+
+  /** \brief Whether or not we're getting a new ticket. */
+  bool isReauthing;
+
+  /** \brief Whether or not the server has told us the current ticket has expired. */
+  bool isTicketExpired;
+
+  /** \brief Requests waiting for a new ticket so they can be sent again. */
+  QList<RequestScheduler::request_t> parkedRequests;
+
+  /** \brief Started when the current ticket was issued. */
+  QElapsedTimer ticketTimer;
+
+  /** \brief How long tickets are expected to last in milliseconds. */
+  qint64 ticketLifetime;
+
+  /** \brief Fires when the ticket should be refreshed. */
+  QTimer *ticketRefreshTimer;
+
+  /** \brief Decides when requests are actually issued to the server. */
+  RequestScheduler *scheduler;
+
+  /** \brief Records every exchange with the server when capturing is turned on. */
+  TrafficCapture trafficCapture;
+
+  /** \brief Whether or not captured traffic is being replayed rather than sent. */
+  bool isReplaying;
 
   //@}
 
@@ -531,6 +883,64 @@ private:
    */
   void handleAuthReply(QNetworkReply* reply);
 
+  /**
+   * \brief Hands a request to the scheduler, or holds on to it if the current ticket
+   * is known to have expired.
+   *
+   * @param request The request to send.
+   * @return True if the request will be sent, false if it was dropped as a duplicate.
+   */
+  bool send(const RequestScheduler::request_t& request);
+
+  /**
+   * \brief Hands a request straight to the scheduler, unless captured traffic is being
+   * replayed.
+   *
+   * @param request The request to issue.
+   * @return True if the request will be sent, false if it was dropped as a duplicate.
+   */
+  bool issue(const RequestScheduler::request_t& request);
+
+  /**
+   * \brief Holds on to a request that was rejected because of an expired ticket and
+   * starts getting a new ticket.
+   *
+   * @param request The rejected request.
+   */
+  void parkRequest(const RequestScheduler::request_t& request);
+
+  /**
+   * \brief Holds on to a request until there's a new ticket, getting one if we aren't
+   * already. Only so many requests are held, the oldest are dropped past that.
+   *
+   * @param request The request to hold.
+   */
+  void holdRequest(const RequestScheduler::request_t& request);
+
+  /**
+   * \brief Drops every held request and stops treating the current ticket as expired,
+   * used when getting a new ticket has failed.
+   */
+  void abandonParkedRequests();
+
+  /**
+   * \brief Sends every held request again with the current ticket.
+   */
+  void replayParkedRequests();
+
+  /**
+   * \brief Arms the timer used to refresh the ticket before it expires.
+   */
+  void armTicketRefresh();
+
+  /**
+   * \brief Determines whether or not a reply means the ticket used has expired.
+   *
+   * @param reply The reply in question.
+   * @return True if the reply is a ticket auth error, false otherwise.
+   */
+  static bool isTicketAuthError(QNetworkReply *reply);
+
   /**
    * \brief Handles a state set reply.
    *
@@ -545,6 +955,20 @@ private:
    */
   void handleReceivedLibMod(QNetworkReply *reply);
 
+  /**
+   * \brief Handles a library fingerprint reply.
+   *
+   * \param the response from the server.
+   */
+  void handleReceivedLibFingerprint(QNetworkReply *reply);
+
+  /**
+   * \brief Handles a reply listing the songs the server has in some fingerprint buckets.
+   *
+   * \param the response from the server.
+   */
+  void handleReceivedLibBucketSongs(QNetworkReply *reply);
+
   /**
    * \brief Handle a response from the server regarding player creation.
    *
@@ -632,6 +1056,36 @@ private:
    */
   void handleParticipantsResponse(QNetworkReply *reply);
 
+  /**
+   * \brief Handles a response from the server containing pushed changes.
+   *
+   * @param reply The response from the server.
+   */
+  void handlePlayerEventsReply(QNetworkReply *reply);
+
+  /**
+   * \brief Reports the changes in a batch of pushed events, in order, skipping any we've
+   * already seen.
+   *
+   * @param batch The batch of events received from the server.
+   */
+  void processPlayerEvents(const QVariantMap& batch);
+
+  /**
+   * \brief Records whether or not the server is pushing changes, notifying listeners if
+   * that changed.
+   *
+   * @param connected Whether or not the server is pushing changes.
+   */
+  void setPlayerEventsConnected(bool connected);
+
+  /**
+   * \brief Arranges to reconnect after a failure, backing off on repeated failures.
+   *
+   * @param minDelay The least amount of time to wait in milliseconds.
+   */
+  void schedulePlayerEventsReconnect(int minDelay=0);
+
   /**
    * \brief Prepares a network request that is going to include JSON.
    *
@@ -660,6 +1114,22 @@ private:
    */
   QUrl getLibModUrl() const;
 
+  /**
+   * \brief Gets the url that should be used for retrieving the library fingerprint.
+   *
+   * \return The url that should be used for retrieving the library fingerprint.
+   */
+  QUrl getLibFingerprintUrl() const;
+
+  /**
+   * \brief Gets the url that should be used for retrieving the songs in some buckets of
+   * the library fingerprint.
+   *
+   * \param buckets The buckets whose songs should be retrieved.
+   * \return The url that should be used for retrieving the songs in the buckets.
+   */
+  QUrl getLibBucketSongsUrl(const QList<int>& buckets) const;
+
   /**
    * \brief Get the url for interacting with the active playlist from the server.
    *
@@ -681,6 +1151,13 @@ private:
    */
   QUrl getParticipantsUrl() const;
 
+  /**
+   * \brief Get the url to be used for waiting on pushed changes.
+   *
+   * @return The url to be used for waiting on pushed changes.
+   */
+  QUrl getPlayerEventsUrl() const;
+
 
 
   /**
@@ -707,38 +1184,11 @@ private:
   QUrl getVolumeUrl() const;
 
   /**
-   * \brief Determines if the given network reply is in response to a request to 
-   * obtain the active playlist.
+   * \brief Gets the table used to dispatch replies, indexed by Endpoint.
    *
-   * \param reply The network reply in question.
-   * \return True if the reply is a response to getting the active playlist. False otherwise.
+   * \return The table used to dispatch replies.
    */
-  bool isGetActivePlaylistReply(const QNetworkReply *reply) const;
-
-  /**
-   * \brief Determines if the given network reply is in response to a request to 
-   * modify the active playlist.
-   *
-   * \param reply The network reply in question.
-   * \return True if the reply is a response to modifying the active playlist. False otherwise.
-   */
-  bool isModActivePlaylistReply(const QNetworkReply *reply) const;
-
-  /**
-   * \brief Determines if the reply is a response to a request that the player's password be set.
-   *
-   * \param reply The network reply in question.
-   * \return True if the reply is a response to setting the player's password. False otherwise.
-   */
-  bool isPasswordSetReply(const QNetworkReply* reply) const;
-
-  /**
-   * \brief Determines if the reply is a response to a request that the player's password be removed.
-   *
-   * \param reply The network reply in question.
-   * \return True if the reply is a response to removing the player's password. False otherwise.
-   */
-  bool isPasswordRemoveReply(const QNetworkReply* reply) const;
+  static const reply_handler_t* getReplyHandlers();
 
   /**
    * \brief Determines if a given reply has the same Http Status code as the one specified.
@@ -778,14 +1228,33 @@ private:
     return serverPortNumber;
   }
 
+  /**
+   * \brief Gets the name of the environment variable which, when set, overrides the url
+   * of the server. Handy for pointing the player at a local mock server.
+   *
+   * @return The name of the environment variable overriding the url of the server.
+   */
+  static const QByteArray& getServerUrlEnvName(){
+    static const QByteArray serverUrlEnvName = "UDJ_SERVER_URL";
+    return serverUrlEnvName;
+  }
+
+  /**
+   * \brief Works out which server to talk to. In order of preference that's the one
+   * given by the environment, the one the player was built for (UDJ_SERVER_URL in CMake)
+   * and finally the official UDJ server.
+   *
+   * @return The url path to the server in string form, always ending in a slash.
+   */
+  static QString getConfiguredServerUrlPath();
+
   /**
    * \brief Gets the url path to the server in string form.
    *
    * @return The url path to the server in string form.
    */
   static const QString& getServerUrlPath(){
-    static const QString SERVER_URL_PATH= 
-      "https://udjplayer.com:" + getServerPortNumber() + "/udj/0_6/";
+    static const QString SERVER_URL_PATH = getConfiguredServerUrlPath();
     return SERVER_URL_PATH;
   }
 
@@ -819,6 +1288,121 @@ private:
     return ticketHeaderName;
   }
 
+  /**
+   * \brief Gets the name of the header the server uses to tag versions of a resource.
+   *
+   * @return The name of the ETag header.
+   */
+  static const QByteArray& getETagHeaderName(){
+    static const QByteArray eTagHeaderName = "ETag";
+    return eTagHeaderName;
+  }
+
+  /**
+   * \brief Gets the name of the header used to ask for a resource only if it no longer
+   * matches a given ETag.
+   *
+   * @return The name of the If-None-Match header.
+   */
+  static const QByteArray& getIfNoneMatchHeaderName(){
+    static const QByteArray ifNoneMatchHeaderName = "If-None-Match";
+    return ifNoneMatchHeaderName;
+  }
+
+  /**
+   * \brief Gets how long we ask the server to hold a request for changes open.
+   *
+   * @return How long the server may hold a request for changes in seconds.
+   */
+  static const int& getPlayerEventsWait(){
+    static const int playerEventsWait = 25;
+    return playerEventsWait;
+  }
+
+  /**
+   * \brief Gets how much longer than it said it would the server may take to answer a
+   * request for changes before we consider the channel stalled.
+   *
+   * @return The grace period in milliseconds.
+   */
+  static const int& getPlayerEventsGracePeriod(){
+    static const int playerEventsGracePeriod = 10000;
+    return playerEventsGracePeriod;
+  }
+
+  /**
+   * \brief Gets how long to wait before reconnecting after the first failure.
+   *
+   * @return How long to wait before reconnecting in milliseconds.
+   */
+  static const int& getPlayerEventsBaseBackoff(){
+    static const int playerEventsBaseBackoff = 1000;
+    return playerEventsBaseBackoff;
+  }
+
+  /**
+   * \brief Gets the longest time to wait before reconnecting after a failure.
+   *
+   * @return The longest time to wait before reconnecting in milliseconds.
+   */
+  static const int& getPlayerEventsMaxBackoff(){
+    static const int playerEventsMaxBackoff = 60000;
+    return playerEventsMaxBackoff;
+  }
+
+  /**
+   * \brief Gets how long to wait before checking again whether a server which doesn't
+   * push changes has started to.
+   *
+   * @return How long to wait in milliseconds.
+   */
+  static const int& getPlayerEventsUnsupportedDelay(){
+    static const int playerEventsUnsupportedDelay = 300000;
+    return playerEventsUnsupportedDelay;
+  }
+
+  /**
+   * \brief Gets how long tickets are assumed to last until we've seen one expire.
+   *
+   * @return How long tickets are assumed to last in milliseconds.
+   */
+  static const qint64& getDefaultTicketLifetime(){
+    static const qint64 defaultTicketLifetime = 3600000;
+    return defaultTicketLifetime;
+  }
+
+  /**
+   * \brief Gets the shortest ticket lifetime we'll believe. Tickets can be invalidated
+   * early, e.g. when the server restarts, and that shouldn't have us reauthenticating
+   * constantly.
+   *
+   * @return The shortest ticket lifetime in milliseconds.
+   */
+  static const qint64& getMinTicketLifetime(){
+    static const qint64 minTicketLifetime = 300000;
+    return minTicketLifetime;
+  }
+
+  /**
+   * \brief Gets how long to wait before trying again when refreshing the ticket fails.
+   *
+   * @return How long to wait in milliseconds.
+   */
+  static const int& getTicketRefreshRetryDelay(){
+    static const int ticketRefreshRetryDelay = 60000;
+    return ticketRefreshRetryDelay;
+  }
+
+  /**
+   * \brief Gets the most requests that will be held waiting for a new ticket.
+   *
+   * @return The most requests that will be held.
+   */
+  static const int& getMaxParkedRequests(){
+    static const int maxParkedRequests = 64;
+    return maxParkedRequests;
+  }
+
   /**
    * \brief Get the header used for identifying the Missing Resource header.
    *
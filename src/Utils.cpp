@@ -23,6 +23,7 @@
 #include "ConfigDefs.hpp"
 #include <QDateTime>
 #include <QFile>
+#include <cstdlib>
 
 namespace UDJ{
 namespace Utils{
@@ -54,6 +55,10 @@ SimpleCrypt getCryptoObject(){
   }
 }
 
+qint64 getRandomUpTo(qint64 max){
+  return (qint64)(qrand() / ((double)RAND_MAX + 1.0) * (max + 1));
+}
+
 
 } //End namespace Utils
 
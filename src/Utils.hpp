@@ -39,9 +39,9 @@ namespace Utils{
  * \param colName The name of the id column in the model.
  * \param proxyModel A proxy model being used by the view.
  */
-template<class T> QSet<T> getSelectedIds(
+template<class T, class Model> QSet<T> getSelectedIds(
   const QTableView* view,
-  const QSqlQueryModel* model,
+  const Model* model,
   const QString& colName,
   const QSortFilterProxyModel *proxyModel=0)
 {
@@ -82,6 +82,15 @@ template<class T> QSet<T> getSelectedIds(
  */
 SimpleCrypt getCryptoObject();
 
+/**
+ * Gets a random value from qrand() scaled to the given range. qrand() % max only works
+ * while max is below RAND_MAX, which is just 32767 on some platforms.
+ *
+ * @param max The largest value that may be returned.
+ * @return A random value between 0 and max, inclusive.
+ */
+qint64 getRandomUpTo(qint64 max);
+
 } //end namespace utils
 
 
@@ -21,6 +21,8 @@
 #include "LoginDialog.hpp"
 #include "ConfigDefs.hpp"
 #include "Logger.hpp"
+#include "NetworkAccess.hpp"
+#include "NetworkMetrics.hpp"
 
 #if IS_APPLE_BUILD
 //#include "UDJApp_Mac.h"
@@ -43,9 +45,8 @@ int main(int argc, char* argv[]){
   app.setApplicationName("Udj");
   app.setApplicationVersion(UDJ_VERSION);
   app.setQuitOnLastWindowClosed(true);
-  UDJ::LoginDialog loginDialog;
-  loginDialog.show(); 
 
+  //The CAs have to be in place before the login dialog starts prewarming a connection.
   #ifdef HAS_CUSTOM_CA_CERT
   QFile servercaFile("serverca.pem");
   if(servercaFile.exists()){
@@ -61,7 +62,12 @@ int main(int argc, char* argv[]){
   }
   #endif
 
+  UDJ::LoginDialog loginDialog;
+  loginDialog.show(); 
+
   int toReturn = app.exec();
+  UDJ::NetworkMetrics::deleteNetworkMetrics();
+  UDJ::NetworkAccess::deleteNetworkAccess();
   UDJ::Logger::deleteLogger();
   return toReturn;
 }
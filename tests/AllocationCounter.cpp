@@ -0,0 +1,95 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "AllocationCounter.hpp"
+#include <stdlib.h>
+#include <new>
+
+/**
+ * Only read and written by the benchmarks' own thread, the count doesn't need to be
+ * exact if Qt happens to allocate from another one.
+ */
+static long allocationCount = 0;
+
+#ifdef __GLIBC__
+
+extern "C"{
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void *pointer, size_t size);
+
+void* malloc(size_t size) __THROW{
+  ++allocationCount;
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) __THROW{
+  ++allocationCount;
+  return __libc_calloc(count, size);
+}
+
+void* realloc(void *pointer, size_t size) __THROW{
+  ++allocationCount;
+  return __libc_realloc(pointer, size);
+}
+
+}
+
+#else
+
+void* operator new(size_t size) throw(std::bad_alloc){
+  ++allocationCount;
+  void *pointer = malloc(size == 0 ? 1 : size);
+  if(pointer == NULL){
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+void* operator new[](size_t size) throw(std::bad_alloc){
+  return operator new(size);
+}
+
+void operator delete(void *pointer) throw(){
+  free(pointer);
+}
+
+void operator delete[](void *pointer) throw(){
+  free(pointer);
+}
+
+#endif
+
+namespace UDJ{
+
+
+long AllocationCounter::getCount(){
+  return allocationCount;
+}
+
+bool AllocationCounter::isCountingEverything(){
+#ifdef __GLIBC__
+  return true;
+#else
+  return false;
+#endif
+}
+
+
+} //end namespace UDJ
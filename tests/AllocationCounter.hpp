@@ -0,0 +1,54 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef ALLOCATION_COUNTER_HPP
+#define ALLOCATION_COUNTER_HPP
+
+namespace UDJ{
+
+
+/**
+ * \brief Counts the heap allocations made by the program it's linked into.
+ *
+ * With glibc every malloc, calloc and realloc is counted, which covers both Qt's
+ * containers and operator new. Elsewhere only operator new is counted, so Qt's own
+ * container buffers go unseen.
+ */
+class AllocationCounter{
+public:
+
+  /**
+   * \brief Gets the number of allocations made so far.
+   *
+   * \return The number of allocations made so far.
+   */
+  static long getCount();
+
+  /**
+   * \brief Gets whether or not every allocation is counted, as opposed to only the ones
+   * made with operator new.
+   *
+   * \return True if every allocation is counted, false otherwise.
+   */
+  static bool isCountingEverything();
+
+};
+
+
+} //end namespace UDJ
+#endif //ALLOCATION_COUNTER_HPP
@@ -0,0 +1,60 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "JSONFixtures.hpp"
+#include <QCoreApplication>
+#include <QStringList>
+#include <QTextStream>
+#include <QDir>
+#include <QFile>
+
+using namespace UDJ;
+
+/**
+ * Writes every JSON fixture to a directory, so they can be looked at, fed to the mock
+ * server or handed to other tools.
+ */
+int main(int argc, char* argv[]){
+  QCoreApplication app(argc, argv);
+  QTextStream out(stdout);
+  QTextStream err(stderr);
+
+  QStringList args = app.arguments();
+  if(args.size() != 2 || args[1] == "--help"){
+    err << "Usage: udj-fixturegen DIRECTORY" << endl;
+    return args.size() == 2 ? 0 : 1;
+  }
+  QDir dir(args[1]);
+  if(!dir.exists() && !dir.mkpath(".")){
+    err << "Couldn't create " << dir.absolutePath() << endl;
+    return 1;
+  }
+
+  QVariantMap fixtures = JSONFixtures::getAllFixtures();
+  for(QVariantMap::const_iterator it = fixtures.constBegin(); it != fixtures.constEnd(); ++it){
+    QFile fixtureFile(dir.absoluteFilePath(it.key() + ".json"));
+    if(!fixtureFile.open(QIODevice::WriteOnly | QIODevice::Truncate)){
+      err << "Couldn't write " << fixtureFile.fileName() << endl;
+      return 1;
+    }
+    QByteArray json = JSONFixtures::toJSON(it.value());
+    fixtureFile.write(json);
+    out << fixtureFile.fileName() << " (" << json.size() << " bytes)" << endl;
+  }
+  return 0;
+}
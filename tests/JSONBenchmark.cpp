@@ -0,0 +1,282 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "JSONFixtures.hpp"
+#include "AllocationCounter.hpp"
+#include "JSONStreamParser.hpp"
+#include "JSONDOMBuilder.hpp"
+#include "PlaylistDecoder.hpp"
+#include "qt-json/json.h"
+#include <QtTest/QtTest>
+#include <QElapsedTimer>
+
+namespace UDJ{
+
+
+/**
+ * \brief Benchmarks parsing and serializing the documents the player exchanges with the
+ * server, using the generated fixtures.
+ *
+ * Besides the time QBENCHMARK reports, every case prints its throughput and how many
+ * allocations a single document takes.
+ */
+class JSONBenchmark : public QObject{
+Q_OBJECT
+public:
+
+  /** @name Public Types */
+  //@{
+
+  /**
+   * \brief A benchmarked operation. Each is handed both forms of a fixture and uses
+   * whichever one it needs.
+   */
+  typedef void (*Operation)(const QByteArray& json, const QVariant& document);
+
+  //@}
+
+private slots:
+  void initTestCase();
+  void cleanup();
+
+  void streamParser_data();
+  void streamParser();
+
+  void streamParserScalar_data();
+  void streamParserScalar();
+
+  void domBuilder_data();
+  void domBuilder();
+
+  void playlistDecoder_data();
+  void playlistDecoder();
+
+  void qtJsonParse_data();
+  void qtJsonParse();
+
+  void qtJsonSerialize_data();
+  void qtJsonSerialize();
+
+private:
+
+  /** @name Private Members */
+  //@{
+
+  /** \brief Every fixture by name. */
+  QVariantMap fixtures;
+
+  //@}
+
+  /** @name Private Functions */
+  //@{
+
+  /**
+   * \brief Adds a row for each fixture to the current benchmark.
+   *
+   * \param playlistsOnly Whether or not only the active playlists should be added.
+   */
+  void addFixtureRows(bool playlistsOnly);
+
+  /**
+   * \brief Benchmarks an operation on the current row's fixture and reports its
+   * throughput and allocations.
+   *
+   * \param operation The operation.
+   */
+  void benchmark(Operation operation);
+
+  /**
+   * \brief Gets how long each operation is run for when measuring its throughput.
+   *
+   * \return How long to run each operation in milliseconds.
+   */
+  static const int& getThroughputRunTime(){
+    static const int throughputRunTime = 200;
+    return throughputRunTime;
+  }
+
+  //@}
+
+};
+
+
+/**
+ * \brief Throws away everything that's parsed, so only the parser itself is measured.
+ */
+class NullHandler : public JSONStreamParser::Handler{
+public:
+  NullHandler():numValues(0){}
+  virtual void startObject(){}
+  virtual void endObject(){}
+  virtual void startArray(){}
+  virtual void endArray(){}
+  virtual void key(const QString& /*name*/){}
+  virtual void stringValue(const QString& /*value*/){ ++numValues; }
+  virtual void numberValue(const QByteArray& /*number*/){ ++numValues; }
+  virtual void boolValue(bool /*value*/){ ++numValues; }
+  virtual void nullValue(){ ++numValues; }
+  int numValues;
+};
+
+static void parseWithStreamParser(const QByteArray& json, const QVariant& /*document*/){
+  NullHandler handler;
+  JSONStreamParser parser(&handler);
+  parser.feed(json);
+  parser.finish();
+}
+
+static void parseWithDOMBuilder(const QByteArray& json, const QVariant& /*document*/){
+  JSONDOMBuilder builder;
+  JSONStreamParser parser(&builder);
+  parser.feed(json);
+  parser.finish();
+}
+
+static void parseWithPlaylistDecoder(const QByteArray& json, const QVariant& /*document*/){
+  PlaylistDecoder decoder;
+  JSONStreamParser parser(&decoder);
+  parser.feed(json);
+  parser.finish();
+  playlist_snapshot_t snapshot;
+  decoder.takeSnapshot(snapshot);
+}
+
+static void parseWithQtJson(const QByteArray& json, const QVariant& /*document*/){
+  bool success = true;
+  QtJson::Json::parse(QString::fromUtf8(json), success);
+}
+
+static void serializeWithQtJson(const QByteArray& /*json*/, const QVariant& document){
+  bool success = true;
+  QtJson::Json::serialize(document, success);
+}
+
+void JSONBenchmark::initTestCase(){
+  fixtures = JSONFixtures::getAllFixtures();
+  //A fixture the parser rejects would be benchmarked as a suspiciously fast failure.
+  for(QVariantMap::const_iterator it = fixtures.constBegin(); it != fixtures.constEnd(); ++it){
+    QByteArray json = JSONFixtures::toJSON(it.value());
+    JSONDOMBuilder builder;
+    JSONStreamParser parser(&builder);
+    parser.feed(json);
+    QVERIFY2(parser.finish(), qPrintable(it.key() + ": " + parser.getError()));
+    bool success = true;
+    QCOMPARE(builder.getResult(), QtJson::Json::parse(QString::fromUtf8(json), success));
+  }
+}
+
+void JSONBenchmark::cleanup(){
+  JSONStreamParser::setVectorScanEnabled(true);
+}
+
+void JSONBenchmark::addFixtureRows(bool playlistsOnly){
+  QTest::addColumn<QByteArray>("json");
+  QTest::addColumn<QVariant>("document");
+  for(QVariantMap::const_iterator it = fixtures.constBegin(); it != fixtures.constEnd(); ++it){
+    if(!playlistsOnly || it.key().startsWith("playlist_")){
+      QTest::newRow(qPrintable(it.key())) << JSONFixtures::toJSON(it.value()) << it.value();
+    }
+  }
+}
+
+void JSONBenchmark::benchmark(Operation operation){
+  QFETCH(QByteArray, json);
+  QFETCH(QVariant, document);
+
+  QBENCHMARK{
+    operation(json, document);
+  }
+
+  long allocationsBefore = AllocationCounter::getCount();
+  operation(json, document);
+  long allocations = AllocationCounter::getCount() - allocationsBefore;
+
+  int runs = 0;
+  QElapsedTimer timer;
+  timer.start();
+  do{
+    operation(json, document);
+    ++runs;
+  } while(timer.elapsed() < getThroughputRunTime());
+  double megabytesPerSecond =
+    (double)json.size()*runs / (1024.0*1024.0) / (timer.elapsed()/1000.0);
+
+  qDebug("%s(%s): %d bytes, %.1f MB/s, %ld allocations%s",
+    QTest::currentTestFunction(),
+    QTest::currentDataTag(),
+    json.size(),
+    megabytesPerSecond,
+    allocations,
+    AllocationCounter::isCountingEverything() ? "" : " (operator new only)");
+}
+
+void JSONBenchmark::streamParser_data(){
+  addFixtureRows(false);
+}
+
+void JSONBenchmark::streamParser(){
+  benchmark(&parseWithStreamParser);
+}
+
+void JSONBenchmark::streamParserScalar_data(){
+  addFixtureRows(false);
+}
+
+void JSONBenchmark::streamParserScalar(){
+  //The same parser scanning a byte at a time, to see what the SSE2 scanning buys.
+  JSONStreamParser::setVectorScanEnabled(false);
+  benchmark(&parseWithStreamParser);
+}
+
+void JSONBenchmark::domBuilder_data(){
+  addFixtureRows(false);
+}
+
+void JSONBenchmark::domBuilder(){
+  benchmark(&parseWithDOMBuilder);
+}
+
+void JSONBenchmark::playlistDecoder_data(){
+  addFixtureRows(true);
+}
+
+void JSONBenchmark::playlistDecoder(){
+  benchmark(&parseWithPlaylistDecoder);
+}
+
+void JSONBenchmark::qtJsonParse_data(){
+  addFixtureRows(false);
+}
+
+void JSONBenchmark::qtJsonParse(){
+  benchmark(&parseWithQtJson);
+}
+
+void JSONBenchmark::qtJsonSerialize_data(){
+  addFixtureRows(false);
+}
+
+void JSONBenchmark::qtJsonSerialize(){
+  benchmark(&serializeWithQtJson);
+}
+
+
+} //end namespace UDJ
+
+QTEST_APPLESS_MAIN(UDJ::JSONBenchmark)
+#include "JSONBenchmark.moc"
@@ -0,0 +1,147 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "JSONFixtures.hpp"
+#include "qt-json/json.h"
+#include <QDateTime>
+
+namespace UDJ{
+
+
+QVariantMap JSONFixtures::createActivePlaylist(int numEntries){
+  quint32 random = getSeed() + numEntries;
+  QDateTime added(QDate(2012, 6, 1), QTime(20, 0));
+  QVariantList entries;
+  for(int i=0; i<numEntries; ++i){
+    QVariantList upvoters;
+    QVariantList downvoters;
+    int numUpvoters = next(random) % 6;
+    int numDownvoters = next(random) % 3;
+    for(int j=0; j<numUpvoters; ++j){
+      upvoters.append(createUser(next(random) % 500, random));
+    }
+    for(int j=0; j<numDownvoters; ++j){
+      downvoters.append(createUser(next(random) % 500, random));
+    }
+    QVariantMap entry;
+    entry["song"] = createSong(1000 + i, random);
+    entry["upvoters"] = upvoters;
+    entry["downvoters"] = downvoters;
+    entry["time_added"] = added.addSecs(i*37).toString(Qt::ISODate);
+    entry["adder"] = createUser(next(random) % 500, random);
+    entries.append(entry);
+  }
+  QVariantMap currentSong;
+  currentSong["song"] = createSong(999, random);
+  currentSong["upvoters"] = QVariantList();
+  currentSong["downvoters"] = QVariantList();
+  currentSong["time_added"] = added.toString(Qt::ISODate);
+  currentSong["time_played"] = added.addSecs(-60).toString(Qt::ISODate);
+  currentSong["adder"] = createUser(1, random);
+
+  QVariantMap activePlaylist;
+  activePlaylist["active_playlist"] = entries;
+  activePlaylist["current_song"] = currentSong;
+  activePlaylist["volume"] = 5;
+  activePlaylist["state"] = "playing";
+  return activePlaylist;
+}
+
+QVariantList JSONFixtures::createParticipants(int numParticipants){
+  quint32 random = getSeed() + numParticipants;
+  QVariantList participants;
+  for(int i=0; i<numParticipants; ++i){
+    participants.append(createUser(2000 + i, random));
+  }
+  return participants;
+}
+
+QVariantList JSONFixtures::createLibAddSongs(int numSongs){
+  quint32 random = getSeed() + numSongs;
+  QVariantList songs;
+  for(int i=0; i<numSongs; ++i){
+    songs.append(createSong(i, random));
+  }
+  return songs;
+}
+
+QByteArray JSONFixtures::toJSON(const QVariant& document){
+  bool success = true;
+  return QtJson::Json::serialize(document, success);
+}
+
+QVariantMap JSONFixtures::getAllFixtures(){
+  QVariantMap fixtures;
+  fixtures["playlist_10"] = createActivePlaylist(10);
+  fixtures["playlist_100"] = createActivePlaylist(100);
+  fixtures["playlist_1000"] = createActivePlaylist(1000);
+  fixtures["participants_10"] = createParticipants(10);
+  fixtures["participants_100"] = createParticipants(100);
+  fixtures["participants_1000"] = createParticipants(1000);
+  fixtures["lib_add_100"] = createLibAddSongs(100);
+  return fixtures;
+}
+
+QVariantMap JSONFixtures::createSong(int id, quint32& random){
+  static const QStringList titleWords = QStringList() << "Love" << "Night" << "Fire" <<
+    "Dancing" << "Road" << "\\\"Heart\\\"" << QString::fromUtf8("Caf\xc3\xa9") <<
+    QString::fromUtf8("Stra\xc3\x9f" "e") << QString::fromUtf8("\xe5\xa4\x9c") <<
+    QString::fromUtf8("\xf0\x9f\x8e\xb5") << "Tab\tStop";
+  static const QStringList artistWords = QStringList() << "The Lemons" << "DJ Fresh" <<
+    QString::fromUtf8("Sigur R\xc3\xb3s") << QString::fromUtf8("Bj\xc3\xb6rk") <<
+    QString::fromUtf8("\xe3\x82\xb5\xe3\x82\xab\xe3\x83\x8a\xe3\x82\xaf\xe3\x82\xb7\xe3\x83\xa7\xe3\x83\xb3") <<
+    "AC/DC" << "Mot\\orhead";
+  static const QStringList genreWords = QStringList() << "Rock" << "Pop" << "Electronic" <<
+    "Hip-Hop" << "Classical" << "";
+  QString title = pick(titleWords, random) + " " + pick(titleWords, random);
+  QVariantMap song;
+  song["id"] = id;
+  song["title"] = title;
+  song["artist"] = pick(artistWords, random);
+  song["album"] = pick(titleWords, random) + " (Deluxe Edition)";
+  song["duration"] = 120 + (int)(next(random) % 300);
+  song["track"] = 1 + (int)(next(random) % 14);
+  song["genre"] = pick(genreWords, random);
+  return song;
+}
+
+QVariantMap JSONFixtures::createUser(int id, quint32& random){
+  static const QStringList firstNames = QStringList() << "Kurtis" << "Alex" <<
+    QString::fromUtf8("Zo\xc3\xab") << QString::fromUtf8("Jos\xc3\xa9") << "Sam";
+  static const QStringList lastNames = QStringList() << "Nusbaum" << "Smith" <<
+    QString::fromUtf8("M\xc3\xbcller") << "O'Brien";
+  QVariantMap user;
+  user["id"] = QString::number(id);
+  user["username"] = "user" + QString::number(id);
+  user["first_name"] = pick(firstNames, random);
+  user["last_name"] = pick(lastNames, random);
+  return user;
+}
+
+QString JSONFixtures::pick(const QStringList& words, quint32& random){
+  return words.at(next(random) % words.size());
+}
+
+quint32 JSONFixtures::next(quint32& random){
+  //Numerical Recipes' linear congruential generator.
+  random = random*1664525u + 1013904223u;
+  return random >> 8;
+}
+
+
+} //end namespace UDJ
@@ -0,0 +1,142 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef JSON_FIXTURES_HPP
+#define JSON_FIXTURES_HPP
+#include <QByteArray>
+#include <QVariantMap>
+#include <QVariantList>
+#include <QStringList>
+
+namespace UDJ{
+
+
+/**
+ * \brief Generates documents shaped like the ones the UDJ server sends and the player
+ * uploads, for benchmarking and fuzzing the JSON code.
+ *
+ * The documents are made up from a fixed seed, so the same fixture is generated on every
+ * run and every machine. Titles, artists and usernames mix in escapes and multibyte
+ * characters so the slow paths of the parser get exercised along with the fast ones.
+ */
+class JSONFixtures{
+public:
+
+  /** @name Generators */
+  //@{
+
+  /**
+   * \brief Generates an active playlist like the one the server answers a poll with.
+   *
+   * \param numEntries The number of songs on the playlist.
+   * \return The playlist.
+   */
+  static QVariantMap createActivePlaylist(int numEntries);
+
+  /**
+   * \brief Generates a participant list like the one the server answers a poll with.
+   *
+   * \param numParticipants The number of participants.
+   * \return The participants.
+   */
+  static QVariantList createParticipants(int numParticipants);
+
+  /**
+   * \brief Generates the songs of a library add, as the player uploads them.
+   *
+   * \param numSongs The number of songs.
+   * \return The songs.
+   */
+  static QVariantList createLibAddSongs(int numSongs);
+
+  /**
+   * \brief Serializes a generated document the way the player and server do.
+   *
+   * \param document The document.
+   * \return The document as JSON.
+   */
+  static QByteArray toJSON(const QVariant& document);
+
+  /**
+   * \brief Gets every fixture by name, e.g. "playlist_100". Each of the names is also a
+   * good file name once ".json" is added.
+   *
+   * \return The fixtures by name.
+   */
+  static QVariantMap getAllFixtures();
+
+  //@}
+
+private:
+
+  /** @name Private Functions */
+  //@{
+
+  /**
+   * \brief Generates a song as it appears in the library and on the playlist.
+   *
+   * \param id The library id of the song.
+   * \param random State of the random number generator.
+   * \return The song.
+   */
+  static QVariantMap createSong(int id, quint32& random);
+
+  /**
+   * \brief Generates a user.
+   *
+   * \param id The id of the user.
+   * \param random State of the random number generator.
+   * \return The user.
+   */
+  static QVariantMap createUser(int id, quint32& random);
+
+  /**
+   * \brief Picks one of a list of made up words.
+   *
+   * \param words The words to pick from.
+   * \param random State of the random number generator.
+   * \return The word.
+   */
+  static QString pick(const QStringList& words, quint32& random);
+
+  /**
+   * \brief Steps the random number generator. It's our own so the fixtures don't depend
+   * on the platform's rand().
+   *
+   * \param random State of the random number generator.
+   * \return The next random number.
+   */
+  static quint32 next(quint32& random);
+
+  /**
+   * \brief Gets the seed every fixture is generated from.
+   *
+   * \return The seed.
+   */
+  static const quint32& getSeed(){
+    static const quint32 seed = 20111114;
+    return seed;
+  }
+
+  //@}
+
+};
+
+
+} //end namespace UDJ
+#endif //JSON_FIXTURES_HPP
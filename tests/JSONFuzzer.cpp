@@ -0,0 +1,410 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "JSONFixtures.hpp"
+#include "JSONStreamParser.hpp"
+#include "JSONDOMBuilder.hpp"
+#include "PlaylistDecoder.hpp"
+#include <QCoreApplication>
+#include <QStringList>
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <QDateTime>
+#include <QFile>
+
+using namespace UDJ;
+
+/**
+ * Feeds random and mutated documents through JSONStreamParser, split into random pieces,
+ * to make sure no input can crash or hang the player. For every input:
+ *  - parsing has to finish within getMaxParseTime(),
+ *  - once feed() has failed it has to keep failing, and so does finish(),
+ *  - where the pieces are split can't change whether the document is accepted or what
+ *    it parses into,
+ *  - the playlist decoder has to accept exactly what the DOM builder accepts,
+ *  - the fixtures themselves have to be accepted.
+ * A failing input is written out so it can be looked at and replayed.
+ */
+
+static const int& getMaxParseTime(){
+  static const int maxParseTime = 2000;
+  return maxParseTime;
+}
+
+static const int& getMaxMutatedFixtureSize(){
+  static const int maxMutatedFixtureSize = 32*1024;
+  return maxMutatedFixtureSize;
+}
+
+/** Our own generator, so a seed reproduces the same run on every platform. */
+static quint32 nextRandom(quint32& random){
+  random = random*1664525u + 1013904223u;
+  return random >> 8;
+}
+
+static int randomBelow(int bound, quint32& random){
+  return bound <= 0 ? 0 : (int)(nextRandom(random) % (quint32)bound);
+}
+
+/**
+ * Pieces of JSON, good and bad, that random documents are made of and mutations insert.
+ * The UTF-8 ones cover overlong, surrogate, out of range and truncated sequences.
+ */
+static const QList<QByteArray>& getInterestingPieces(){
+  static QList<QByteArray> pieces;
+  if(pieces.isEmpty()){
+    pieces << "{" << "}" << "[" << "]" << "," << ":" << "\"" << "\\" << "\\\"" << "\\n" <<
+      "\\u" << "\\u00e9" << "\\ud83c" << "\\udfb5" << "\\ud83c\\udfb5" << "\\uzzzz" <<
+      "true" << "false" << "null" << "tru" << "nul" << "-" << "0" << "01" << "-0" <<
+      "1.5e+3" << "1." << ".5" << "1e" << "123456789012345678901234567890" <<
+      " " << "\n" << "\r\n" << "\t" << "                " << "a" << "\"key\":" <<
+      QByteArray(1, '\0') << "\x01" << "\x1f" << "\x7f" <<
+      "\xc3\xa9" << "\xe6\x97\xa5\xe6\x9c\xac" << "\xf0\x9f\x8e\xb5" <<
+      "\x80" << "\xbf" << "\xc0\xaf" << "\xc1\xbf" << "\xe0\x80\xaf" << "\xf0\x80\x80\xaf" <<
+      "\xed\xa0\x80" << "\xed\xbf\xbf" << "\xf4\x90\x80\x80" << "\xf5\x80\x80\x80" <<
+      "\xff" << "\xc3" << "\xe2\x82" << "\xf0\x9f\x8e";
+  }
+  return pieces;
+}
+
+static QByteArray randomPiece(quint32& random){
+  const QList<QByteArray>& pieces = getInterestingPieces();
+  return pieces.at(randomBelow(pieces.size(), random));
+}
+
+/** Text that's fine inside a string, once QtJson has escaped it. */
+static const QList<QByteArray>& getValidStringPieces(){
+  static QList<QByteArray> pieces;
+  if(pieces.isEmpty()){
+    pieces << "a" << "key" << " " << "\"" << "\\" << "\n" << "\t" << "\\u00e9" << "\x7f" <<
+      "\xc3\xa9" << "\xe6\x97\xa5\xe6\x9c\xac" << "\xf0\x9f\x8e\xb5" <<
+      "                ";
+  }
+  return pieces;
+}
+
+/** Builds a valid document, so acceptance is exercised along with rejection. */
+static QVariant randomValue(int depth, quint32& random){
+  int kind = randomBelow(depth > 4 ? 4 : 6, random);
+  switch(kind){
+    case 0:
+      return QVariant();
+    case 1:
+      return randomBelow(2, random) == 0;
+    case 2:
+      return randomBelow(100000, random) - 50000;
+    case 3:
+    {
+      QByteArray utf8;
+      int length = randomBelow(40, random);
+      const QList<QByteArray>& pieces = getValidStringPieces();
+      for(int i=0; i<length; ++i){
+        utf8 += pieces.at(randomBelow(pieces.size(), random));
+      }
+      return QString::fromUtf8(utf8);
+    }
+    case 4:
+    {
+      QVariantList list;
+      int length = randomBelow(8, random);
+      for(int i=0; i<length; ++i){
+        list.append(randomValue(depth + 1, random));
+      }
+      return list;
+    }
+    default:
+    {
+      QVariantMap map;
+      int length = randomBelow(8, random);
+      for(int i=0; i<length; ++i){
+        map["k" + QString::number(randomBelow(20, random))] = randomValue(depth + 1, random);
+      }
+      return map;
+    }
+  }
+}
+
+static QByteArray randomGarbage(quint32& random){
+  QByteArray document;
+  int length = randomBelow(200, random);
+  for(int i=0; i<length; ++i){
+    document += randomPiece(random);
+  }
+  return document;
+}
+
+static QByteArray deeplyNested(quint32& random){
+  int depth = JSONStreamParser::getMaxDepth() - 8 + randomBelow(16, random);
+  QByteArray document;
+  QByteArray closers;
+  for(int i=0; i<depth; ++i){
+    if(randomBelow(2, random) == 0){
+      document += "[";
+      closers.prepend(']');
+    }
+    else{
+      document += "{\"a\":";
+      closers.prepend('}');
+    }
+  }
+  return document + "1" + closers;
+}
+
+static QByteArray mutate(const QByteArray& original, quint32& random){
+  QByteArray document = original;
+  int numMutations = 1 + randomBelow(4, random);
+  for(int i=0; i<numMutations && !document.isEmpty(); ++i){
+    int position = randomBelow(document.size(), random);
+    switch(randomBelow(6, random)){
+      case 0:
+        document[position] = (char)(document.at(position) ^ (1 << randomBelow(8, random)));
+        break;
+      case 1:
+        document.replace(position, 1, randomPiece(random));
+        break;
+      case 2:
+        document.insert(position, randomPiece(random));
+        break;
+      case 3:
+        document.remove(position, 1 + randomBelow(16, random));
+        break;
+      case 4:
+        document.insert(position, document.mid(position, 1 + randomBelow(64, random)));
+        break;
+      default:
+        document.truncate(position);
+        break;
+    }
+  }
+  return document;
+}
+
+/** Mostly small pieces, with sizes around the 16 byte blocks the parser scans. */
+static QList<int> randomPieceSizes(int size, quint32& random){
+  QList<int> pieceSizes;
+  int mode = randomBelow(3, random);
+  int fed = 0;
+  while(fed < size){
+    int pieceSize;
+    if(mode == 0){
+      pieceSize = 1;
+    }
+    else if(mode == 1){
+      static const int blockEdges[] = {1, 2, 3, 7, 15, 16, 17, 31, 32, 33};
+      pieceSize = blockEdges[randomBelow(10, random)];
+    }
+    else{
+      pieceSize = 1 + randomBelow(size, random);
+    }
+    pieceSize = qMin(pieceSize, size - fed);
+    pieceSizes.append(pieceSize);
+    fed += pieceSize;
+  }
+  return pieceSizes;
+}
+
+/**
+ * Parses a document in the given pieces.
+ *
+ * \return An empty string if the parser behaved, otherwise what it did wrong.
+ */
+static QString parse(
+  const QByteArray& document,
+  const QList<int>& pieceSizes,
+  JSONStreamParser::Handler *handler,
+  bool& accepted)
+{
+  JSONStreamParser parser(handler);
+  bool hasFailed = false;
+  int fed = 0;
+  Q_FOREACH(int pieceSize, pieceSizes){
+    bool fedOk = parser.feed(document.constData() + fed, pieceSize);
+    fed += pieceSize;
+    if(hasFailed && fedOk){
+      return "feed() succeeded after failing";
+    }
+    if(fedOk == parser.hasFailed()){
+      return "feed() and hasFailed() disagree";
+    }
+    hasFailed = !fedOk;
+  }
+  accepted = parser.finish();
+  if(hasFailed && accepted){
+    return "finish() succeeded after feed() failed";
+  }
+  if(!accepted && parser.getError().isEmpty()){
+    return "Document rejected without an error";
+  }
+  return QString();
+}
+
+/**
+ * Runs every check on a single input.
+ *
+ * \return An empty string if the parser behaved, otherwise what it did wrong.
+ */
+static QString check(const QByteArray& document, bool mustAccept, quint32& random){
+  QElapsedTimer timer;
+  timer.start();
+
+  QList<int> wholeDocument;
+  if(!document.isEmpty()){
+    wholeDocument.append(document.size());
+  }
+  JSONDOMBuilder wholeBuilder;
+  bool wholeAccepted = false;
+  QString problem = parse(document, wholeDocument, &wholeBuilder, wholeAccepted);
+  if(!problem.isEmpty()){
+    return problem;
+  }
+  if(mustAccept && !wholeAccepted){
+    return "Valid document rejected";
+  }
+
+  JSONDOMBuilder piecesBuilder;
+  bool piecesAccepted = false;
+  problem = parse(
+    document, randomPieceSizes(document.size(), random), &piecesBuilder, piecesAccepted);
+  if(!problem.isEmpty()){
+    return problem;
+  }
+  if(piecesAccepted != wholeAccepted){
+    return "Splitting the document into pieces changed whether it's accepted";
+  }
+  if(wholeAccepted && piecesBuilder.getResult() != wholeBuilder.getResult()){
+    return "Splitting the document into pieces changed what it parsed into";
+  }
+
+  PlaylistDecoder decoder;
+  bool decoderAccepted = false;
+  problem = parse(document, randomPieceSizes(document.size(), random), &decoder, decoderAccepted);
+  if(!problem.isEmpty()){
+    return problem;
+  }
+  if(decoderAccepted != wholeAccepted){
+    return "The playlist decoder and the DOM builder disagree on whether it's accepted";
+  }
+  playlist_snapshot_t snapshot;
+  decoder.takeSnapshot(snapshot);
+
+  if(timer.elapsed() > getMaxParseTime()){
+    return "Parsing took " + QString::number(timer.elapsed()) + "ms";
+  }
+  return QString();
+}
+
+static void printUsage(QTextStream& out){
+  out << "Usage: udj-jsonfuzz [options]" << endl
+    << "  --iterations N  Number of inputs to try (default 10000)" << endl
+    << "  --seed N        Seed for the random inputs (default the current time)" << endl;
+}
+
+int main(int argc, char* argv[]){
+  QCoreApplication app(argc, argv);
+  QTextStream out(stdout);
+  QTextStream err(stderr);
+
+  int iterations = 10000;
+  quint32 seed = QDateTime::currentDateTime().toTime_t();
+  QStringList args = app.arguments();
+  args.removeFirst();
+  while(!args.isEmpty()){
+    QString arg = args.takeFirst();
+    if(arg == "--help"){
+      printUsage(out);
+      return 0;
+    }
+    if(args.isEmpty()){
+      err << "Unknown option or missing value: " << arg << endl;
+      printUsage(err);
+      return 1;
+    }
+    QString value = args.takeFirst();
+    bool isNumber = true;
+    if(arg == "--iterations"){
+      iterations = value.toInt(&isNumber);
+    }
+    else if(arg == "--seed"){
+      seed = value.toUInt(&isNumber);
+    }
+    else{
+      err << "Unknown option: " << arg << endl;
+      printUsage(err);
+      return 1;
+    }
+    if(!isNumber){
+      err << "Bad value for " << arg << ": " << value << endl;
+      return 1;
+    }
+  }
+
+  QList<QByteArray> fixtures;
+  QVariantMap allFixtures = JSONFixtures::getAllFixtures();
+  for(QVariantMap::const_iterator it = allFixtures.constBegin();
+    it != allFixtures.constEnd(); ++it)
+  {
+    QByteArray json = JSONFixtures::toJSON(it.value());
+    if(json.size() <= getMaxMutatedFixtureSize()){
+      fixtures.append(json);
+    }
+  }
+
+  out << "Fuzzing the JSON parser with seed " << seed << endl;
+  quint32 random = seed;
+  for(int i=0; i<iterations; ++i){
+    QByteArray document;
+    bool mustAccept = false;
+    switch(randomBelow(8, random)){
+      case 0:
+        document = randomGarbage(random);
+        break;
+      case 1:
+        document = deeplyNested(random);
+        break;
+      case 2:
+        document = JSONFixtures::toJSON(randomValue(0, random));
+        mustAccept = true;
+        break;
+      case 3:
+        document = mutate(JSONFixtures::toJSON(randomValue(0, random)), random);
+        break;
+      case 4:
+        document = fixtures.at(randomBelow(fixtures.size(), random));
+        mustAccept = true;
+        break;
+      default:
+        document = mutate(fixtures.at(randomBelow(fixtures.size(), random)), random);
+        break;
+    }
+
+    QString problem = check(document, mustAccept, random);
+    if(!problem.isEmpty()){
+      QString failureFileName =
+        "jsonfuzz-failure-" + QString::number(seed) + "-" + QString::number(i) + ".json";
+      QFile failureFile(failureFileName);
+      if(failureFile.open(QIODevice::WriteOnly | QIODevice::Truncate)){
+        failureFile.write(document);
+      }
+      err << "Input " << i << " with seed " << seed << ": " << problem << endl
+        << "Input written to " << failureFileName << endl;
+      return 1;
+    }
+  }
+  out << "Tried " << iterations << " inputs, no problems found" << endl;
+  return 0;
+}
@@ -0,0 +1,223 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "JSONFixtures.hpp"
+#include "JSONStreamParser.hpp"
+#include "JSONDOMBuilder.hpp"
+#include <QtTest/QtTest>
+
+namespace UDJ{
+
+
+/**
+ * \brief Checks that scanning a block at a time parses exactly like scanning a byte at a
+ * time.
+ *
+ * Every document is parsed both ways, whole and in pieces sized around the 16 byte
+ * blocks, and both have to agree on whether it's accepted, on the error and on what it
+ * parses into. The documents put quotes, escapes, control characters, whitespace and
+ * well and badly formed UTF-8 at every offset of the first two blocks.
+ */
+class JSONStreamParserTest : public QObject{
+Q_OBJECT
+private slots:
+  void initTestCase();
+  void cleanup();
+
+  void vectorAndScalarAgree_data();
+  void vectorAndScalarAgree();
+
+private:
+
+  /** @name Private Functions */
+  //@{
+
+  /**
+   * \brief Parses a document.
+   *
+   * \param json The document.
+   * \param pieceSize How many bytes to feed the parser at once.
+   * \param vectorScan Whether or not to scan a block at a time.
+   * \param result Set to what the document parses into.
+   * \param error Set to what was wrong with the document, if anything.
+   * \return True if the document was accepted, false otherwise.
+   */
+  static bool parse(
+    const QByteArray& json,
+    int pieceSize,
+    bool vectorScan,
+    QVariant& result,
+    QString& error);
+
+  /**
+   * \brief Adds a row to the current test.
+   *
+   * \param name The name of the row.
+   * \param json The document.
+   * \param valid Whether or not the document should be accepted.
+   */
+  static void addRow(const QByteArray& name, const QByteArray& json, bool valid);
+
+  /**
+   * \brief Gets how far into a string the interesting bytes are put, enough to cover
+   * both sides of the first two block edges.
+   *
+   * \return The largest offset used.
+   */
+  static const int& getMaxOffset(){
+    static const int maxOffset = 33;
+    return maxOffset;
+  }
+
+  //@}
+
+};
+
+
+bool JSONStreamParserTest::parse(
+  const QByteArray& json,
+  int pieceSize,
+  bool vectorScan,
+  QVariant& result,
+  QString& error)
+{
+  JSONStreamParser::setVectorScanEnabled(vectorScan);
+  JSONDOMBuilder builder;
+  JSONStreamParser parser(&builder);
+  for(int i=0; i<json.size(); i+=pieceSize){
+    parser.feed(json.constData() + i, qMin(pieceSize, json.size() - i));
+  }
+  bool accepted = parser.finish();
+  result = builder.getResult();
+  error = parser.getError();
+  return accepted;
+}
+
+void JSONStreamParserTest::addRow(const QByteArray& name, const QByteArray& json, bool valid){
+  QTest::newRow(name.constData()) << json << valid;
+}
+
+void JSONStreamParserTest::initTestCase(){
+  if(!JSONStreamParser::hasVectorScan()){
+    qDebug("Built without SSE2, both paths scan a byte at a time");
+  }
+}
+
+void JSONStreamParserTest::cleanup(){
+  JSONStreamParser::setVectorScanEnabled(true);
+}
+
+void JSONStreamParserTest::vectorAndScalarAgree_data(){
+  QTest::addColumn<QByteArray>("json");
+  QTest::addColumn<bool>("valid");
+
+  for(int offset=0; offset<=getMaxOffset(); ++offset){
+    QByteArray padding(offset, 'a');
+    QByteArray tail(16, 'b');
+    QByteArray tag = QByteArray::number(offset);
+    addRow("string end at " + tag, "\"" + padding + "\"", true);
+    addRow("escaped quote at " + tag, "\"" + padding + "\\\"" + tail + "\"", true);
+    addRow("escape at " + tag, "\"" + padding + "\\n\\u00e9" + tail + "\"", true);
+    addRow("control 0x01 at " + tag, "\"" + padding + "\x01" + tail + "\"", false);
+    addRow("control 0x1f at " + tag, "\"" + padding + "\x1f" + tail + "\"", false);
+    addRow("nul at " + tag, "\"" + padding + QByteArray(1, '\0') + tail + "\"", false);
+    addRow("delete at " + tag, "\"" + padding + "\x7f" + tail + "\"", true);
+    addRow("unterminated at " + tag, "\"" + padding, false);
+
+    QByteArray spaces(offset, ' ');
+    QByteArray indent = QByteArray("\n\t\r ").repeated(offset/4 + 1).left(offset);
+    addRow("spaces " + tag, "[" + spaces + "1" + spaces + "]", true);
+    addRow("indent " + tag, "{" + indent + "\"a\"" + indent + ":" + indent + "[" + indent +
+      "true" + indent + "," + indent + "null" + indent + "]" + indent + "}", true);
+    addRow("garbage after spaces " + tag, "[" + spaces + "x]", false);
+    addRow("vertical tab after spaces " + tag, "[" + spaces + "\v1]", false);
+    addRow("trailing spaces " + tag, "1" + spaces, true);
+  }
+
+  //Multibyte sequences, good and bad, starting at every offset so they straddle the
+  //edges of the blocks the ASCII run is skipped in.
+  QList<QPair<QByteArray, bool> > sequences;
+  sequences
+    << qMakePair(QByteArray("\xc3\xa9"), true)
+    << qMakePair(QByteArray("\xe6\x97\xa5"), true)
+    << qMakePair(QByteArray("\xef\xbf\xbd"), true)
+    << qMakePair(QByteArray("\xf0\x9f\x8e\xb5"), true)
+    << qMakePair(QByteArray("\xf4\x8f\xbf\xbf"), true)
+    << qMakePair(QByteArray("\xc0\xaf"), false)
+    << qMakePair(QByteArray("\xc1\xbf"), false)
+    << qMakePair(QByteArray("\xe0\x80\xaf"), false)
+    << qMakePair(QByteArray("\xe0\x9f\xbf"), false)
+    << qMakePair(QByteArray("\xf0\x80\x80\xaf"), false)
+    << qMakePair(QByteArray("\xf0\x8f\xbf\xbf"), false)
+    << qMakePair(QByteArray("\xed\xa0\x80"), false)
+    << qMakePair(QByteArray("\xed\xbf\xbf"), false)
+    << qMakePair(QByteArray("\xf4\x90\x80\x80"), false)
+    << qMakePair(QByteArray("\xf5\x80\x80\x80"), false)
+    << qMakePair(QByteArray("\xff"), false)
+    << qMakePair(QByteArray("\x80"), false)
+    << qMakePair(QByteArray("\xbf"), false)
+    << qMakePair(QByteArray("\xc3"), false)
+    << qMakePair(QByteArray("\xe2\x82"), false)
+    << qMakePair(QByteArray("\xf0\x9f\x8e"), false)
+    << qMakePair(QByteArray("\xc3\x28"), false);
+  for(int i=0; i<sequences.size(); ++i){
+    const QByteArray& sequence = sequences[i].first;
+    bool valid = sequences[i].second;
+    QByteArray name = sequence.toHex();
+    for(int offset=0; offset<=getMaxOffset(); ++offset){
+      QByteArray padding(offset, 'a');
+      QByteArray tag = name + " at " + QByteArray::number(offset);
+      addRow("utf8 " + tag, "\"" + padding + sequence + "aaaa\"", valid);
+      //Truncated right at the closing quote, the end of the token.
+      addRow("utf8 last " + tag, "\"" + padding + sequence + "\"", valid);
+      addRow("utf8 key " + tag, "{\"" + padding + sequence + "\":1}", valid);
+    }
+  }
+
+  QVariantMap fixtures = JSONFixtures::getAllFixtures();
+  for(QVariantMap::const_iterator it = fixtures.constBegin(); it != fixtures.constEnd(); ++it){
+    addRow("fixture " + it.key().toUtf8(), JSONFixtures::toJSON(it.value()), true);
+  }
+}
+
+void JSONStreamParserTest::vectorAndScalarAgree(){
+  QFETCH(QByteArray, json);
+  QFETCH(bool, valid);
+
+  QList<int> pieceSizes;
+  pieceSizes << qMax(json.size(), 1) << 1 << 15 << 16 << 17;
+  Q_FOREACH(int pieceSize, pieceSizes){
+    QVariant scalarResult;
+    QString scalarError;
+    bool scalarAccepted = parse(json, pieceSize, false, scalarResult, scalarError);
+    QVariant vectorResult;
+    QString vectorError;
+    bool vectorAccepted = parse(json, pieceSize, true, vectorResult, vectorError);
+
+    QCOMPARE(scalarAccepted, valid);
+    QCOMPARE(vectorAccepted, scalarAccepted);
+    QCOMPARE(vectorError, scalarError);
+    QCOMPARE(vectorResult, scalarResult);
+  }
+}
+
+
+} //end namespace UDJ
+
+QTEST_APPLESS_MAIN(UDJ::JSONStreamParserTest)
+#include "JSONStreamParserTest.moc"
@@ -0,0 +1,144 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "MockConnection.hpp"
+#include <QTcpSocket>
+
+
+namespace UDJ{
+
+
+MockConnection::MockConnection(QTcpSocket *socket, QObject *parent):
+  QObject(parent),
+  socket(socket),
+  isAwaitingResponse(false),
+  closeAfterResponse(false)
+{
+  socket->setParent(this);
+  connect(socket, SIGNAL(readyRead()), this, SLOT(onReadyRead()));
+  connect(socket, SIGNAL(disconnected()), this, SLOT(deleteLater()));
+}
+
+void MockConnection::onReadyRead(){
+  buffer += socket->readAll();
+  if(buffer.size() > getMaxRequestSize()){
+    drop();
+    return;
+  }
+  processBuffer();
+}
+
+void MockConnection::processBuffer(){
+  if(isAwaitingResponse){
+    return;
+  }
+  int headerEnd = buffer.indexOf("\r\n\r\n");
+  if(headerEnd == -1){
+    return;
+  }
+  QList<QByteArray> lines = buffer.left(headerEnd).split('\n');
+  QList<QByteArray> requestLine = lines.takeFirst().trimmed().split(' ');
+  if(requestLine.size() != 3){
+    isAwaitingResponse = true;
+    closeAfterResponse = true;
+    respond(400);
+    return;
+  }
+
+  http_request_t parsed;
+  parsed.method = requestLine[0];
+  parsed.url = QUrl::fromEncoded(requestLine[1]);
+  Q_FOREACH(const QByteArray& line, lines){
+    int colon = line.indexOf(':');
+    if(colon > 0){
+      parsed.headers.insert(line.left(colon).trimmed().toLower(), line.mid(colon + 1).trimmed());
+    }
+  }
+  int contentLength = parsed.headers.value("content-length").toInt();
+  int requestSize = headerEnd + 4 + contentLength;
+  if(buffer.size() < requestSize){
+    return;
+  }
+  parsed.body = buffer.mid(headerEnd + 4, contentLength);
+  buffer.remove(0, requestSize);
+
+  closeAfterResponse = requestLine[2] == "HTTP/1.0" ||
+    parsed.headers.value("connection").toLower() == "close";
+  request = parsed;
+  isAwaitingResponse = true;
+  requestTimer.start();
+  emit requestReceived(this);
+}
+
+void MockConnection::release(){
+  emit requestReady(this);
+}
+
+void MockConnection::respond(int status, const QByteArray& body, const header_list_t& headers){
+  if(!isAwaitingResponse){
+    return;
+  }
+  QByteArray response = "HTTP/1.1 " + QByteArray::number(status) + " " +
+    getReasonPhrase(status) + "\r\n";
+  response += "Content-Length: " + QByteArray::number(body.size()) + "\r\n";
+  if(!body.isEmpty()){
+    response += "Content-Type: text/json; charset=utf-8\r\n";
+  }
+  for(int i=0; i<headers.size(); ++i){
+    response += headers[i].first + ": " + headers[i].second + "\r\n";
+  }
+  if(closeAfterResponse){
+    response += "Connection: close\r\n";
+  }
+  response += "\r\n";
+  response += body;
+  socket->write(response);
+  isAwaitingResponse = false;
+  if(closeAfterResponse){
+    socket->disconnectFromHost();
+  }
+  else{
+    processBuffer();
+  }
+}
+
+void MockConnection::drop(){
+  isAwaitingResponse = false;
+  socket->abort();
+  deleteLater();
+}
+
+QByteArray MockConnection::getReasonPhrase(int status){
+  switch(status){
+    case 200: return "OK";
+    case 201: return "Created";
+    case 204: return "No Content";
+    case 304: return "Not Modified";
+    case 400: return "Bad Request";
+    case 401: return "Unauthorized";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 410: return "Gone";
+    case 500: return "Internal Server Error";
+    case 503: return "Service Unavailable";
+    default: return "Unknown";
+  }
+}
+
+
+} //end namespace UDJ
@@ -0,0 +1,215 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef MOCK_CONNECTION_HPP
+#define MOCK_CONNECTION_HPP
+#include <QObject>
+#include <QUrl>
+#include <QHash>
+#include <QList>
+#include <QPair>
+#include <QElapsedTimer>
+
+class QTcpSocket;
+
+namespace UDJ{
+
+
+/**
+ * \brief A single client connection to the mock server, speaking just enough HTTP/1.1
+ * for QNetworkAccessManager: keep-alive, Content-Length bodies and one request at a time.
+ *
+ * The connection reads one request, announces it and then waits until it's been
+ * answered before looking at the next one, so answers can be delayed or held open for
+ * as long as the server likes.
+ */
+class MockConnection : public QObject{
+Q_OBJECT
+public:
+
+  /** @name Public Types */
+  //@{
+
+  /** \brief Headers of a response, in the order they should be sent. */
+  typedef QList<QPair<QByteArray, QByteArray> > header_list_t;
+
+  /**
+   * \brief A request received from a client.
+   */
+  typedef struct {
+    QByteArray method;
+    /** \brief The request target, i.e. the path and query. */
+    QUrl url;
+    /** \brief The request headers, keyed by lower case name. */
+    QHash<QByteArray, QByteArray> headers;
+    QByteArray body;
+  } http_request_t;
+
+  //@}
+
+  /** @name Constructors */
+  //@{
+
+  /**
+   * \brief Constructs a MockConnection which takes ownership of the given socket.
+   *
+   * \param socket The socket connected to the client.
+   * \param parent The parent object.
+   */
+  MockConnection(QTcpSocket *socket, QObject *parent=0);
+
+  //@}
+
+  /** @name Accessors */
+  //@{
+
+  /**
+   * \brief Gets the request currently waiting to be answered.
+   *
+   * \return The request currently waiting to be answered.
+   */
+  inline const http_request_t& getRequest() const{
+    return request;
+  }
+
+  /**
+   * \brief Gets how long the current request has been waiting for an answer.
+   *
+   * \return How long the current request has been waiting in milliseconds.
+   */
+  inline qint64 getElapsed() const{
+    return requestTimer.elapsed();
+  }
+
+  //@}
+
+  /** @name Modifiers */
+  //@{
+
+  /**
+   * \brief Answers the current request.
+   *
+   * \param status The http status code.
+   * \param body The body of the response.
+   * \param headers Any headers beyond Content-Length and Content-Type.
+   */
+  void respond(int status, const QByteArray& body=QByteArray(),
+    const header_list_t& headers=header_list_t());
+
+  /** \brief Drops the connection without answering, like a flaky network would. */
+  void drop();
+
+  //@}
+
+public slots:
+
+  /** @name Public Slots */
+  //@{
+
+  /** \brief Hands the current request over for handling by emitting requestReady. */
+  void release();
+
+  //@}
+
+signals:
+
+  /** @name Signals */
+  //@{
+
+  /**
+   * \brief Emitted when a complete request has been read.
+   *
+   * \param connection This connection.
+   */
+  void requestReceived(MockConnection *connection);
+
+  /**
+   * \brief Emitted when the current request should be handled.
+   *
+   * \param connection This connection.
+   */
+  void requestReady(MockConnection *connection);
+
+  //@}
+
+private slots:
+
+  /** @name Private Slots */
+  //@{
+
+  /** \brief Reads whatever the client sent. */
+  void onReadyRead();
+
+  //@}
+
+private:
+
+  /** @name Private Members */
+  //@{
+
+  /** \brief The socket connected to the client. */
+  QTcpSocket *socket;
+
+  /** \brief Bytes received but not yet part of a handled request. */
+  QByteArray buffer;
+
+  /** \brief The request currently waiting to be answered. */
+  http_request_t request;
+
+  /** \brief Whether or not a request is waiting to be answered. */
+  bool isAwaitingResponse;
+
+  /** \brief Whether or not the client asked for the connection to be closed. */
+  bool closeAfterResponse;
+
+  /** \brief Started when the current request was read. */
+  QElapsedTimer requestTimer;
+
+  //@}
+
+  /** @name Private Functions */
+  //@{
+
+  /** \brief Reads the next request from the buffer if one is complete and none is pending. */
+  void processBuffer();
+
+  /**
+   * \brief Gets the reason phrase for a status code.
+   *
+   * \param status The status code.
+   * \return The reason phrase.
+   */
+  static QByteArray getReasonPhrase(int status);
+
+  /**
+   * \brief Gets the most a client may send before a request is complete.
+   *
+   * @return The most a client may send before a request is complete, in bytes.
+   */
+  static const int& getMaxRequestSize(){
+    static const int maxRequestSize = 32*1024*1024;
+    return maxRequestSize;
+  }
+
+  //@}
+
+};
+
+
+} //end namespace UDJ
+#endif //MOCK_CONNECTION_HPP
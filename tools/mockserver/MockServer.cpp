@@ -0,0 +1,712 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "MockServer.hpp"
+#include "qt-json/json.h"
+#include <QTcpSocket>
+#include <QHostAddress>
+#include <QTimer>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include <QTextStream>
+#include <QSet>
+
+
+namespace UDJ{
+
+
+MockServer::MockServer(const options_t& options, QObject *parent):
+  QObject(parent),
+  options(options),
+  nextPlayerId(1),
+  nextEventId(1)
+{
+  tcpServer = new QTcpServer(this);
+  connect(tcpServer, SIGNAL(newConnection()), this, SLOT(onNewConnection()));
+  clock.start();
+
+  waiterTimer = new QTimer(this);
+  connect(waiterTimer, SIGNAL(timeout()), this, SLOT(expireEventWaiters()));
+  waiterTimer->start(1000);
+
+  churnTimer = new QTimer(this);
+  connect(churnTimer, SIGNAL(timeout()), this, SLOT(churn()));
+  if(options.churnInterval > 0){
+    churnTimer->start(options.churnInterval);
+  }
+}
+
+bool MockServer::listen(quint16 port, bool listenAnywhere){
+  return tcpServer->listen(
+    listenAnywhere ? QHostAddress::Any : QHostAddress::LocalHost, port);
+}
+
+void MockServer::onNewConnection(){
+  while(tcpServer->hasPendingConnections()){
+    MockConnection *connection = new MockConnection(tcpServer->nextPendingConnection(), this);
+    connect(
+      connection,
+      SIGNAL(requestReceived(MockConnection*)),
+      this,
+      SLOT(onRequestReceived(MockConnection*)));
+    connect(
+      connection,
+      SIGNAL(requestReady(MockConnection*)),
+      this,
+      SLOT(onRequestReady(MockConnection*)));
+  }
+}
+
+void MockServer::onRequestReceived(MockConnection *connection){
+  int delay = options.latency + qrand() % (options.jitter + 1);
+  QTimer::singleShot(delay, connection, SLOT(release()));
+}
+
+void MockServer::onRequestReady(MockConnection *connection){
+  const MockConnection::http_request_t& request = connection->getRequest();
+  QString path = request.url.path();
+  QString description = QString::fromLatin1(request.method) + " " + path;
+  QTextStream out(stdout);
+
+  if(chance(options.dropRate)){
+    if(options.isVerbose){
+      out << description << " -> dropped" << endl;
+    }
+    connection->drop();
+    return;
+  }
+
+  int status;
+  if(chance(options.errorRate)){
+    connection->respond(503);
+    status = 503;
+  }
+  else{
+    while(path.contains("//")){
+      path.replace("//", "/");
+    }
+    if(path.startsWith(options.basePath)){
+      status = route(connection, path.mid(options.basePath.size()).split(
+        '/', QString::SkipEmptyParts));
+    }
+    else{
+      connection->respond(404);
+      status = 404;
+    }
+  }
+
+  if(options.isVerbose){
+    out << description << " -> ";
+    if(status == 0){
+      out << "held";
+    }
+    else{
+      out << status << " (" << connection->getElapsed() << "ms)";
+    }
+    out << endl;
+  }
+}
+
+int MockServer::route(MockConnection *connection, const QStringList& segments){
+  const QByteArray& method = connection->getRequest().method;
+  if(segments == QStringList("auth")){
+    if(method != "POST"){
+      connection->respond(405);
+      return 405;
+    }
+    return handleAuth(connection);
+  }
+
+  if(segments.size() < 2 || segments[0] != "players"){
+    connection->respond(404);
+    return 404;
+  }
+
+  ticket_t ticket;
+  if(!checkTicket(connection, ticket)){
+    return 401;
+  }
+
+  if(segments.size() == 2 && segments[1] == "player"){
+    if(method != "PUT"){
+      connection->respond(405);
+      return 405;
+    }
+    return handleCreatePlayer(connection, ticket);
+  }
+
+  bool isId = false;
+  player_id_t playerId = segments[1].toLong(&isId);
+  if(!isId || !players.contains(playerId) || segments.size() < 3){
+    connection->respond(404);
+    return 404;
+  }
+  player_t& player = players[playerId];
+  QString resource = QStringList(segments.mid(2)).join("/");
+
+  if(resource == "state" && method == "POST"){
+    return handleState(connection, playerId, player);
+  }
+  else if(resource == "volume" && method == "POST"){
+    return handleVolume(connection, playerId, player);
+  }
+  else if(resource == "location" && method == "POST"){
+    connection->respond(200);
+    return 200;
+  }
+  else if(resource == "password" && (method == "POST" || method == "DELETE")){
+    connection->respond(200);
+    return 200;
+  }
+  else if(resource == "library" && method == "POST"){
+    return handleLibMod(connection, playerId, player);
+  }
+  else if(resource == "library/fingerprint" && method == "GET"){
+    return handleLibFingerprint(connection, player);
+  }
+  else if(resource == "library/fingerprint/songs" && method == "GET"){
+    return handleLibBucketSongs(connection, player);
+  }
+  else if(resource == "active_playlist" && method == "GET"){
+    return handleGetActivePlaylist(connection, player);
+  }
+  else if(resource == "active_playlist" && method == "POST"){
+    return handleModActivePlaylist(connection, playerId, player, ticket);
+  }
+  else if(resource == "current_song" && (method == "POST" || method == "DELETE")){
+    return handleCurrentSong(connection, playerId, player);
+  }
+  else if(resource == "users" && method == "GET"){
+    connection->respond(200, toJSON(player.participants));
+    return 200;
+  }
+  else if(resource == "events" && method == "GET"){
+    return handleEvents(connection, playerId, player);
+  }
+  else if(resource == "state" || resource == "volume" || resource == "location" ||
+    resource == "password" || resource == "library" || resource == "library/fingerprint" ||
+    resource == "library/fingerprint/songs" ||
+    resource == "active_playlist" || resource == "current_song" || resource == "users" ||
+    resource == "events")
+  {
+    connection->respond(405);
+    return 405;
+  }
+  connection->respond(404);
+  return 404;
+}
+
+bool MockServer::checkTicket(MockConnection *connection, ticket_t& ticket){
+  QByteArray hash = connection->getRequest().headers.value("x-udj-ticket-hash");
+  bool isValid = tickets.contains(hash);
+  if(isValid && options.ticketLifetime > 0 &&
+    tickets[hash].issued.elapsed() > options.ticketLifetime * 1000)
+  {
+    tickets.remove(hash);
+    isValid = false;
+  }
+  if(isValid && chance(options.challengeRate)){
+    tickets.remove(hash);
+    isValid = false;
+  }
+  if(!isValid){
+    MockConnection::header_list_t headers;
+    headers.append(qMakePair(QByteArray("WWW-Authenticate"), QByteArray("ticket-hash")));
+    connection->respond(401, QByteArray(), headers);
+    return false;
+  }
+  ticket = tickets[hash];
+  return true;
+}
+
+int MockServer::handleAuth(MockConnection *connection){
+  QHash<QString, QString> form = parseForm(connection->getRequest().body);
+  QString username = form.value("username");
+  if(username.isEmpty()){
+    connection->respond(400);
+    return 400;
+  }
+  if(!options.password.isEmpty() && form.value("password") != options.password){
+    connection->respond(401);
+    return 401;
+  }
+  if(!users.contains(username)){
+    users.insert(username, users.size() + 1);
+  }
+
+  ticket_t ticket;
+  ticket.userId = users[username];
+  ticket.username = username;
+  ticket.issued.start();
+  QByteArray hash = QCryptographicHash::hash(
+    username.toUtf8() + QByteArray::number(qrand()) +
+    QByteArray::number(QDateTime::currentMSecsSinceEpoch()),
+    QCryptographicHash::Sha1).toHex();
+  tickets.insert(hash, ticket);
+
+  QVariantMap authReply;
+  authReply["ticket_hash"] = QString::fromLatin1(hash);
+  authReply["user_id"] = QString::number(ticket.userId);
+  connection->respond(200, toJSON(authReply));
+  return 200;
+}
+
+int MockServer::handleCreatePlayer(MockConnection *connection, const ticket_t& ticket){
+  bool success = true;
+  QVariantMap playerToCreate =
+    fromJSON(QString::fromUtf8(connection->getRequest().body), success).toMap();
+  if(!success || playerToCreate["name"].toString().isEmpty()){
+    connection->respond(400);
+    return 400;
+  }
+
+  player_id_t playerId = nextPlayerId++;
+  player_t& player = players[playerId];
+  player.name = playerToCreate["name"].toString();
+  player.owner = ticket.userId;
+  player.state = "inactive";
+  player.volume = 5;
+  player.playlistVersion = 1;
+  for(int i=0; i<options.numParticipants; ++i){
+    QVariantMap participant;
+    participant["id"] = 1000 + i;
+    participant["username"] = "participant" + QString::number(i);
+    participant["first_name"] = "Participant";
+    participant["last_name"] = QString::number(i);
+    player.participants.append(participant);
+  }
+
+  QVariantMap createReply;
+  createReply["id"] = QString::number(playerId);
+  connection->respond(201, toJSON(createReply));
+  return 201;
+}
+
+int MockServer::handleLibMod(MockConnection *connection, player_id_t playerId, player_t& player){
+  QHash<QString, QString> form = parseForm(connection->getRequest().body);
+  bool addSuccess = true;
+  bool deleteSuccess = true;
+  QVariantList toAdd = fromJSON(form.value("to_add", "[]"), addSuccess).toList();
+  QVariantList toDelete = fromJSON(form.value("to_delete", "[]"), deleteSuccess).toList();
+  if(!addSuccess || !deleteSuccess){
+    connection->respond(400);
+    return 400;
+  }
+
+  Q_FOREACH(const QVariant& song, toAdd){
+    QVariantMap songMap = song.toMap();
+    library_song_id_t id = songMap["id"].value<library_song_id_t>();
+    if(player.library.contains(id)){
+      player.fingerprint.removeSong(id, LibraryFingerprint::computeSongHash(player.library[id]));
+    }
+    player.library.insert(id, songMap);
+    player.fingerprint.addSong(id, LibraryFingerprint::computeSongHash(songMap));
+  }
+
+  bool playlistChanged = false;
+  Q_FOREACH(const QVariant& deleted, toDelete){
+    library_song_id_t id = deleted.value<library_song_id_t>();
+    if(!player.library.contains(id)){
+      continue;
+    }
+    player.fingerprint.removeSong(id, LibraryFingerprint::computeSongHash(player.library[id]));
+    player.library.remove(id);
+    int entry = findPlaylistEntry(player, id);
+    if(entry != -1){
+      player.playlist.removeAt(entry);
+      playlistChanged = true;
+    }
+  }
+
+  connection->respond(200);
+  if(playlistChanged){
+    ++player.playlistVersion;
+    publishEvent(playerId, "active_playlist");
+  }
+  return 200;
+}
+
+int MockServer::handleLibFingerprint(MockConnection *connection, player_t& player){
+  QVariantList buckets;
+  for(int i=0; i<LibraryFingerprint::getNumBuckets(); ++i){
+    buckets.append(player.fingerprint.getBucketDigest(i));
+  }
+  QVariantMap fingerprint;
+  fingerprint["root"] = player.fingerprint.getRootDigest();
+  fingerprint["buckets"] = buckets;
+  connection->respond(200, toJSON(fingerprint));
+  return 200;
+}
+
+int MockServer::handleLibBucketSongs(MockConnection *connection, player_t& player){
+  QSet<int> buckets;
+  QStringList requestedBuckets =
+    connection->getRequest().url.queryItemValue("buckets").split(",", QString::SkipEmptyParts);
+  Q_FOREACH(const QString& bucket, requestedBuckets){
+    buckets.insert(bucket.toInt());
+  }
+  QVariantList songs;
+  QMap<library_song_id_t, QVariantMap>::const_iterator it;
+  for(it = player.library.constBegin(); it != player.library.constEnd(); ++it){
+    if(buckets.contains(LibraryFingerprint::getBucket(it.key()))){
+      QVariantMap song;
+      song["id"] = (qlonglong)it.key();
+      song["hash"] = (qlonglong)LibraryFingerprint::computeSongHash(it.value());
+      songs.append(song);
+    }
+  }
+  connection->respond(200, toJSON(songs));
+  return 200;
+}
+
+int MockServer::handleGetActivePlaylist(MockConnection *connection, player_t& player){
+  MockConnection::header_list_t headers;
+  if(options.supportsETags){
+    QByteArray etag = "\"v" + QByteArray::number(player.playlistVersion) + "\"";
+    headers.append(qMakePair(QByteArray("ETag"), etag));
+    if(connection->getRequest().headers.value("if-none-match") == etag){
+      connection->respond(304, QByteArray(), headers);
+      return 304;
+    }
+  }
+  connection->respond(200, toJSON(getActivePlaylist(player)), headers);
+  return 200;
+}
+
+int MockServer::handleModActivePlaylist(
+  MockConnection *connection, player_id_t playerId, player_t& player, const ticket_t& ticket)
+{
+  QHash<QString, QString> form = parseForm(connection->getRequest().body);
+  bool addSuccess = true;
+  bool removeSuccess = true;
+  QVariantList toAdd = fromJSON(form.value("to_add", "[]"), addSuccess).toList();
+  QVariantList toRemove = fromJSON(form.value("to_remove", "[]"), removeSuccess).toList();
+  if(!addSuccess || !removeSuccess){
+    connection->respond(400);
+    return 400;
+  }
+  Q_FOREACH(const QVariant& added, toAdd){
+    if(!player.library.contains(added.value<library_song_id_t>())){
+      connection->respond(404);
+      return 404;
+    }
+  }
+
+  library_song_id_t currentId =
+    player.currentSong["song"].toMap()["id"].value<library_song_id_t>();
+  Q_FOREACH(const QVariant& added, toAdd){
+    library_song_id_t id = added.value<library_song_id_t>();
+    if(findPlaylistEntry(player, id) == -1 && (player.currentSong.isEmpty() || id != currentId)){
+      player.playlist.append(
+        createPlaylistEntry(player.library[id], ticket.userId, ticket.username));
+    }
+  }
+  Q_FOREACH(const QVariant& removed, toRemove){
+    int entry = findPlaylistEntry(player, removed.value<library_song_id_t>());
+    if(entry != -1){
+      player.playlist.removeAt(entry);
+    }
+  }
+
+  connection->respond(200);
+  ++player.playlistVersion;
+  publishEvent(playerId, "active_playlist");
+  return 200;
+}
+
+int MockServer::handleCurrentSong(
+  MockConnection *connection, player_id_t playerId, player_t& player)
+{
+  if(connection->getRequest().method == "DELETE"){
+    player.currentSong.clear();
+  }
+  else{
+    QHash<QString, QString> form = parseForm(connection->getRequest().body);
+    bool isId = false;
+    library_song_id_t id = form.value("lib_id").toLong(&isId);
+    if(!isId){
+      connection->respond(400);
+      return 400;
+    }
+    int entry = findPlaylistEntry(player, id);
+    if(entry == -1){
+      connection->respond(404);
+      return 404;
+    }
+    player.currentSong = player.playlist.takeAt(entry).toMap();
+  }
+
+  connection->respond(200);
+  ++player.playlistVersion;
+  publishEvent(playerId, "active_playlist");
+  return 200;
+}
+
+int MockServer::handleVolume(MockConnection *connection, player_id_t playerId, player_t& player){
+  QHash<QString, QString> form = parseForm(connection->getRequest().body);
+  bool isNumber = false;
+  int volume = form.value("volume").toInt(&isNumber);
+  if(!isNumber || volume < 0 || volume > 10){
+    connection->respond(400);
+    return 400;
+  }
+  player.volume = volume;
+  connection->respond(200);
+  ++player.playlistVersion;
+  publishEvent(playerId, "active_playlist");
+  return 200;
+}
+
+int MockServer::handleState(MockConnection *connection, player_id_t playerId, player_t& player){
+  QHash<QString, QString> form = parseForm(connection->getRequest().body);
+  QString state = form.value("state");
+  if(state != "playing" && state != "paused" && state != "inactive"){
+    connection->respond(400);
+    return 400;
+  }
+  player.state = state;
+  connection->respond(200);
+  ++player.playlistVersion;
+  publishEvent(playerId, "active_playlist");
+  return 200;
+}
+
+int MockServer::handleEvents(MockConnection *connection, player_id_t playerId, player_t& player){
+  if(!options.supportsEvents){
+    connection->respond(404);
+    return 404;
+  }
+  const QUrl& url = connection->getRequest().url;
+  int wait = qBound(0, url.queryItemValue("wait").toInt(), getMaxEventsWait());
+  qint64 since = url.hasQueryItem("since") ? url.queryItemValue("since").toLongLong() : -1;
+
+  int status = answerEvents(connection, player, since);
+  if(status != 0){
+    return status;
+  }
+  if(wait == 0){
+    connection->respond(204);
+    return 204;
+  }
+
+  event_waiter_t waiter;
+  waiter.connection = connection;
+  waiter.playerId = playerId;
+  waiter.since = since;
+  waiter.deadline = clock.elapsed() + wait * 1000;
+  eventWaiters.append(waiter);
+  return 0;
+}
+
+void MockServer::publishEvent(player_id_t playerId, const QString& type){
+  player_t& player = players[playerId];
+  QVariantMap event;
+  event["id"] = nextEventId++;
+  event["type"] = type;
+  if(type == "participants"){
+    event["data"] = player.participants;
+  }
+  else{
+    event["data"] = getActivePlaylist(player);
+  }
+  player.events.append(event);
+  while(player.events.size() > getMaxEvents()){
+    player.events.removeFirst();
+  }
+
+  QList<event_waiter_t>::iterator it = eventWaiters.begin();
+  while(it != eventWaiters.end()){
+    if(it->connection.isNull()){
+      it = eventWaiters.erase(it);
+    }
+    else if(it->playerId == playerId && answerEvents(it->connection, player, it->since) != 0){
+      it = eventWaiters.erase(it);
+    }
+    else{
+      ++it;
+    }
+  }
+}
+
+int MockServer::answerEvents(MockConnection *connection, const player_t& player, qint64 since){
+  if(player.events.isEmpty()){
+    return 0;
+  }
+  qint64 lastEventId = player.events.last().toMap()["id"].toLongLong();
+  QVariantMap eventsReply;
+  eventsReply["last_event_id"] = lastEventId;
+
+  //A poll that has never seen an event just learns where the stream is, so it doesn't
+  //miss anything that happens between this poll and the next one.
+  if(since == -1){
+    eventsReply["events"] = QVariantList();
+    connection->respond(200, toJSON(eventsReply));
+    return 200;
+  }
+
+  qint64 firstEventId = player.events.first().toMap()["id"].toLongLong();
+  if(since < firstEventId - 1){
+    connection->respond(410);
+    return 410;
+  }
+  QVariantList newEvents;
+  Q_FOREACH(const QVariant& event, player.events){
+    if(event.toMap()["id"].toLongLong() > since){
+      newEvents.append(event);
+    }
+  }
+  if(newEvents.isEmpty()){
+    return 0;
+  }
+  eventsReply["events"] = newEvents;
+  connection->respond(200, toJSON(eventsReply));
+  return 200;
+}
+
+void MockServer::expireEventWaiters(){
+  qint64 now = clock.elapsed();
+  QList<event_waiter_t>::iterator it = eventWaiters.begin();
+  while(it != eventWaiters.end()){
+    if(it->connection.isNull()){
+      it = eventWaiters.erase(it);
+    }
+    else if(it->deadline <= now){
+      it->connection->respond(204);
+      if(options.isVerbose){
+        QTextStream(stdout) << "GET " << it->connection->getRequest().url.path() <<
+          " -> 204 (" << it->connection->getElapsed() << "ms)" << endl;
+      }
+      it = eventWaiters.erase(it);
+    }
+    else{
+      ++it;
+    }
+  }
+}
+
+void MockServer::churn(){
+  if(players.isEmpty()){
+    return;
+  }
+  player_id_t playerId = players.keys().at(qrand() % players.size());
+  player_t& player = players[playerId];
+
+  if(qrand() % 2 == 0){
+    if(!player.participants.isEmpty() && qrand() % 2 == 0){
+      player.participants.removeAt(qrand() % player.participants.size());
+    }
+    else{
+      int id = 2000 + qrand() % 1000;
+      QVariantMap participant;
+      participant["id"] = id;
+      participant["username"] = "churner" + QString::number(id);
+      participant["first_name"] = "Churner";
+      participant["last_name"] = QString::number(id);
+      player.participants.append(participant);
+    }
+    publishEvent(playerId, "participants");
+    return;
+  }
+
+  QVariantMap voter;
+  voter["id"] = 3000 + qrand() % 1000;
+  voter["username"] = "voter" + voter["id"].toString();
+  if(!player.playlist.isEmpty()){
+    int entryIndex = qrand() % player.playlist.size();
+    QVariantMap entry = player.playlist[entryIndex].toMap();
+    QString votes = qrand() % 3 == 0 ? "downvoters" : "upvoters";
+    QVariantList voters = entry[votes].toList();
+    voters.append(voter);
+    entry[votes] = voters;
+    player.playlist[entryIndex] = entry;
+  }
+  else if(!player.library.isEmpty()){
+    QList<library_song_id_t> ids = player.library.keys();
+    library_song_id_t id = ids.at(qrand() % ids.size());
+    player.playlist.append(createPlaylistEntry(
+      player.library[id], voter["id"].value<user_id_t>(), voter["username"].toString()));
+  }
+  else{
+    return;
+  }
+  ++player.playlistVersion;
+  publishEvent(playerId, "active_playlist");
+}
+
+QVariantMap MockServer::getActivePlaylist(const player_t& player){
+  QVariantMap activePlaylist;
+  activePlaylist["active_playlist"] = player.playlist;
+  activePlaylist["current_song"] = player.currentSong;
+  activePlaylist["volume"] = player.volume;
+  activePlaylist["state"] = player.state;
+  return activePlaylist;
+}
+
+QVariantMap MockServer::createPlaylistEntry(
+  const QVariantMap& song, user_id_t adderId, const QString& adderUsername)
+{
+  QVariantMap adder;
+  adder["id"] = QString::number(adderId);
+  adder["username"] = adderUsername;
+  QVariantMap entry;
+  entry["song"] = song;
+  entry["upvoters"] = QVariantList();
+  entry["downvoters"] = QVariantList();
+  entry["time_added"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+  entry["adder"] = adder;
+  return entry;
+}
+
+int MockServer::findPlaylistEntry(const player_t& player, library_song_id_t libId){
+  for(int i=0; i<player.playlist.size(); ++i){
+    if(player.playlist[i].toMap()["song"].toMap()["id"].value<library_song_id_t>() == libId){
+      return i;
+    }
+  }
+  return -1;
+}
+
+QHash<QString, QString> MockServer::parseForm(const QByteArray& body){
+  QHash<QString, QString> form;
+  Q_FOREACH(const QByteArray& param, body.split('&')){
+    int equals = param.indexOf('=');
+    if(equals == -1){
+      continue;
+    }
+    form.insert(
+      QUrl::fromPercentEncoding(param.left(equals)),
+      QUrl::fromPercentEncoding(param.mid(equals + 1)));
+  }
+  return form;
+}
+
+QByteArray MockServer::toJSON(const QVariant& value){
+  bool success = true;
+  return QtJson::Json::serialize(value, success);
+}
+
+QVariant MockServer::fromJSON(const QString& json, bool& success){
+  return QtJson::Json::parse(json, success);
+}
+
+bool MockServer::chance(int percentage){
+  return percentage > 0 && qrand() % 100 < percentage;
+}
+
+
+} //end namespace UDJ
@@ -0,0 +1,385 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef MOCK_SERVER_HPP
+#define MOCK_SERVER_HPP
+#include "ConfigDefs.hpp"
+#include "LibraryFingerprint.hpp"
+#include "MockConnection.hpp"
+#include <QTcpServer>
+#include <QPointer>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QVariantMap>
+#include <QMap>
+
+class QTimer;
+
+namespace UDJ{
+
+
+/**
+ * \brief An in-memory stand-in for the UDJ server, for exercising the player without the
+ * real server and for benchmarking it on a single machine.
+ *
+ * It implements the endpoints the player uses: authentication, player creation,
+ * password, location, state and volume, library modification and fingerprints, the
+ * active playlist (with ETags), the current song, participants and pushed player events.
+ * Latency, errors, dropped connections and ticket challenges can be injected to see how
+ * the player copes.
+ */
+class MockServer : public QObject{
+Q_OBJECT
+public:
+
+  /** @name Public Types */
+  //@{
+
+  /**
+   * \brief How the mock server should behave.
+   */
+  typedef struct {
+    /** \brief Path all the endpoints live under, e.g. /udj/0_6/. */
+    QString basePath;
+    /** \brief Delay added to every answer in milliseconds. */
+    int latency;
+    /** \brief Random extra delay of up to this many milliseconds. */
+    int jitter;
+    /** \brief Percentage of requests answered with a 503. */
+    int errorRate;
+    /** \brief Percentage of requests whose connection is dropped without an answer. */
+    int dropRate;
+    /** \brief Percentage of authenticated requests whose ticket is suddenly revoked. */
+    int challengeRate;
+    /** \brief How long tickets last in seconds, 0 meaning forever. */
+    int ticketLifetime;
+    /** \brief The password every user must use, empty meaning any password will do. */
+    QString password;
+    /** \brief Number of made up participants each player starts with. */
+    int numParticipants;
+    /** \brief Interval between made up changes by participants, 0 meaning none. */
+    int churnInterval;
+    /** \brief Whether or not the player events endpoint is available. */
+    bool supportsEvents;
+    /** \brief Whether or not the active playlist is sent with an ETag. */
+    bool supportsETags;
+    /** \brief Whether or not every request is logged. */
+    bool isVerbose;
+  } options_t;
+
+  //@}
+
+  /** @name Constructors */
+  //@{
+
+  /**
+   * \brief Constructs a MockServer.
+   *
+   * \param options How the server should behave.
+   * \param parent The parent object.
+   */
+  MockServer(const options_t& options, QObject *parent=0);
+
+  //@}
+
+  /** @name Modifiers */
+  //@{
+
+  /**
+   * \brief Starts listening for players.
+   *
+   * \param port The port to listen on.
+   * \param listenAnywhere Whether to listen on every interface rather than only locally.
+   * \return True if the server is listening, false otherwise.
+   */
+  bool listen(quint16 port, bool listenAnywhere);
+
+  //@}
+
+private slots:
+
+  /** @name Private Slots */
+  //@{
+
+  /** \brief Sets up a connection for each new client. */
+  void onNewConnection();
+
+  /**
+   * \brief Delays a freshly read request by the configured latency.
+   *
+   * \param connection The connection the request came in on.
+   */
+  void onRequestReceived(MockConnection *connection);
+
+  /**
+   * \brief Handles a request once its delay has passed.
+   *
+   * \param connection The connection the request came in on.
+   */
+  void onRequestReady(MockConnection *connection);
+
+  /** \brief Answers any long polls that have waited long enough with a 204. */
+  void expireEventWaiters();
+
+  /** \brief Has a made up participant change something on a random player. */
+  void churn();
+
+  //@}
+
+private:
+
+  /** @name Private Types */
+  //@{
+
+  /**
+   * \brief A ticket handed out by authentication.
+   */
+  typedef struct {
+    user_id_t userId;
+    QString username;
+    QElapsedTimer issued;
+  } ticket_t;
+
+  /**
+   * \brief Everything the server knows about a player.
+   */
+  typedef struct {
+    QString name;
+    user_id_t owner;
+    QString state;
+    int volume;
+    QMap<library_song_id_t, QVariantMap> library;
+    LibraryFingerprint fingerprint;
+    /** \brief The active playlist entries in play order. */
+    QVariantList playlist;
+    /** \brief The entry being played, empty if none. */
+    QVariantMap currentSong;
+    QVariantList participants;
+    /** \brief Bumped on every change to the active playlist, state or volume. */
+    quint64 playlistVersion;
+    /** \brief The most recent events, oldest first. */
+    QVariantList events;
+  } player_t;
+
+  /**
+   * \brief A long poll waiting for events.
+   */
+  typedef struct {
+    QPointer<MockConnection> connection;
+    player_id_t playerId;
+    qint64 since;
+    qint64 deadline;
+  } event_waiter_t;
+
+  //@}
+
+  /** @name Private Members */
+  //@{
+
+  /** \brief How the server should behave. */
+  options_t options;
+
+  /** \brief Accepts connections from players. */
+  QTcpServer *tcpServer;
+
+  /** \brief Monotonic clock used for long poll deadlines. */
+  QElapsedTimer clock;
+
+  /** \brief Timer used to expire long polls. */
+  QTimer *waiterTimer;
+
+  /** \brief Timer used to trigger made up participant changes. */
+  QTimer *churnTimer;
+
+  /** \brief Ids given to users, by username. */
+  QHash<QString, user_id_t> users;
+
+  /** \brief Tickets that are currently valid, by ticket hash. */
+  QHash<QByteArray, ticket_t> tickets;
+
+  /** \brief Every player created so far, by id. */
+  QMap<player_id_t, player_t> players;
+
+  /** \brief Long polls waiting for events. */
+  QList<event_waiter_t> eventWaiters;
+
+  /** \brief The id that will be given to the next player. */
+  player_id_t nextPlayerId;
+
+  /** \brief The id that will be given to the next event. */
+  qint64 nextEventId;
+
+  //@}
+
+  /** @name Private Functions */
+  //@{
+
+  /**
+   * \brief Routes a request to the function handling its endpoint.
+   *
+   * \param connection The connection the request came in on.
+   * \param segments The path of the request below the base path, split on slashes.
+   * \return The status code of the answer, or 0 if it will be answered later.
+   */
+  int route(MockConnection *connection, const QStringList& segments);
+
+  /**
+   * \brief Checks the ticket a request carries, answering with a ticket challenge if it
+   * isn't valid.
+   *
+   * \param connection The connection the request came in on.
+   * \param ticket Set to the request's ticket if it is valid.
+   * \return True if the ticket is valid, false if the request has been answered.
+   */
+  bool checkTicket(MockConnection *connection, ticket_t& ticket);
+
+  //@}
+
+  /**
+   * @name Endpoint Handlers
+   * Each handler answers the request for its endpoint and returns the status code of the
+   * answer, or 0 if the request will be answered later.
+   */
+  //@{
+
+  int handleAuth(MockConnection *connection);
+  int handleCreatePlayer(MockConnection *connection, const ticket_t& ticket);
+  int handleLibMod(MockConnection *connection, player_id_t playerId, player_t& player);
+  int handleLibFingerprint(MockConnection *connection, player_t& player);
+  int handleLibBucketSongs(MockConnection *connection, player_t& player);
+  int handleGetActivePlaylist(MockConnection *connection, player_t& player);
+  int handleModActivePlaylist(
+    MockConnection *connection, player_id_t playerId, player_t& player, const ticket_t& ticket);
+  int handleCurrentSong(MockConnection *connection, player_id_t playerId, player_t& player);
+  int handleVolume(MockConnection *connection, player_id_t playerId, player_t& player);
+  int handleState(MockConnection *connection, player_id_t playerId, player_t& player);
+  int handleEvents(MockConnection *connection, player_id_t playerId, player_t& player);
+
+  //@}
+
+  /** @name Helper Functions */
+  //@{
+
+  /**
+   * \brief Records a change to a player as an event and answers any long polls waiting
+   * for one.
+   *
+   * \param playerId The id of the player that changed.
+   * \param type The kind of change, "active_playlist" or "participants".
+   */
+  void publishEvent(player_id_t playerId, const QString& type);
+
+  /**
+   * \brief Answers a long poll with the events it hasn't seen yet.
+   *
+   * \param connection The connection the long poll came in on.
+   * \param player The player the long poll is for.
+   * \param since The id of the last event the long poll has seen, -1 if none.
+   * \return The status code of the answer, or 0 if there was nothing to answer with.
+   */
+  int answerEvents(MockConnection *connection, const player_t& player, qint64 since);
+
+  /**
+   * \brief Builds the active playlist exactly as the player expects to receive it.
+   *
+   * \param player The player in question.
+   * \return The active playlist of the player.
+   */
+  static QVariantMap getActivePlaylist(const player_t& player);
+
+  /**
+   * \brief Builds an entry for the active playlist.
+   *
+   * \param song The library song the entry is for.
+   * \param adderId The id of the user who added the song.
+   * \param adderUsername The username of the user who added the song.
+   * \return The entry.
+   */
+  static QVariantMap createPlaylistEntry(
+    const QVariantMap& song, user_id_t adderId, const QString& adderUsername);
+
+  /**
+   * \brief Finds the position of a song in the active playlist.
+   *
+   * \param player The player in question.
+   * \param libId The library id of the song.
+   * \return The position of the song, or -1 if it isn't in the active playlist.
+   */
+  static int findPlaylistEntry(const player_t& player, library_song_id_t libId);
+
+  /**
+   * \brief Parses an application/x-www-form-urlencoded body.
+   *
+   * \param body The body to parse.
+   * \return The value of each parameter, by name.
+   */
+  static QHash<QString, QString> parseForm(const QByteArray& body);
+
+  /**
+   * \brief Serializes a value as JSON.
+   *
+   * \param value The value to serialize.
+   * \return The value as JSON.
+   */
+  static QByteArray toJSON(const QVariant& value);
+
+  /**
+   * \brief Parses JSON.
+   *
+   * \param json The JSON to parse.
+   * \param success Set to whether or not parsing succeeded.
+   * \return The parsed value.
+   */
+  static QVariant fromJSON(const QString& json, bool& success);
+
+  /**
+   * \brief Decides whether something that should happen a given percentage of the time
+   * happens this time.
+   *
+   * \param percentage How often it should happen, between 0 and 100.
+   * \return True if it happens this time, false otherwise.
+   */
+  static bool chance(int percentage);
+
+  /**
+   * \brief Gets how many events are kept around for long polls that fall behind.
+   *
+   * @return How many events are kept per player.
+   */
+  static const int& getMaxEvents(){
+    static const int maxEvents = 100;
+    return maxEvents;
+  }
+
+  /**
+   * \brief Gets the longest a long poll is held when it doesn't ask for less.
+   *
+   * @return The longest a long poll is held in seconds.
+   */
+  static const int& getMaxEventsWait(){
+    static const int maxEventsWait = 30;
+    return maxEventsWait;
+  }
+
+  //@}
+
+};
+
+
+} //end namespace UDJ
+#endif //MOCK_SERVER_HPP
@@ -0,0 +1,155 @@
+/**
+ * Copyright 2011 Kurtis L. Nusbaum
+ *
+ * This file is part of UDJ.
+ *
+ * UDJ is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * UDJ is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with UDJ.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "MockServer.hpp"
+#include <QCoreApplication>
+#include <QStringList>
+#include <QTextStream>
+#include <QDateTime>
+
+using namespace UDJ;
+
+static void printUsage(QTextStream& out){
+  out << "Usage: udj-mockserver [options]" << endl
+    << "  --port N             Port to listen on (default 8080)" << endl
+    << "  --any                Listen on every interface, not just localhost" << endl
+    << "  --base PATH          Path the endpoints live under (default /udj/0_6/)" << endl
+    << "  --latency MS         Delay added to every answer" << endl
+    << "  --jitter MS          Random extra delay of up to MS" << endl
+    << "  --error-rate PCT     Percentage of requests answered with a 503" << endl
+    << "  --drop-rate PCT      Percentage of connections dropped without an answer" << endl
+    << "  --challenge-rate PCT Percentage of requests whose ticket is revoked" << endl
+    << "  --ticket-lifetime S  How long tickets last, 0 meaning forever" << endl
+    << "  --password PASS      Password every user must log in with" << endl
+    << "  --participants N     Made up participants each player starts with (default 3)" << endl
+    << "  --churn MS           Interval between made up participant changes" << endl
+    << "  --no-events          Act like a server without the player events endpoint" << endl
+    << "  --no-etags           Act like a server that doesn't send ETags" << endl
+    << "  --verbose            Log every request" << endl;
+}
+
+int main(int argc, char* argv[]){
+  QCoreApplication app(argc, argv);
+  QTextStream out(stdout);
+  QTextStream err(stderr);
+  qsrand(QDateTime::currentDateTime().toTime_t());
+
+  MockServer::options_t options;
+  options.basePath = "/udj/0_6/";
+  options.latency = 0;
+  options.jitter = 0;
+  options.errorRate = 0;
+  options.dropRate = 0;
+  options.challengeRate = 0;
+  options.ticketLifetime = 0;
+  options.numParticipants = 3;
+  options.churnInterval = 0;
+  options.supportsEvents = true;
+  options.supportsETags = true;
+  options.isVerbose = false;
+  int port = 8080;
+  bool listenAnywhere = false;
+
+  QStringList args = app.arguments();
+  args.removeFirst();
+  while(!args.isEmpty()){
+    QString arg = args.takeFirst();
+    if(arg == "--help"){
+      printUsage(out);
+      return 0;
+    }
+    else if(arg == "--any"){
+      listenAnywhere = true;
+    }
+    else if(arg == "--no-events"){
+      options.supportsEvents = false;
+    }
+    else if(arg == "--no-etags"){
+      options.supportsETags = false;
+    }
+    else if(arg == "--verbose"){
+      options.isVerbose = true;
+    }
+    else if(args.isEmpty()){
+      err << "Unknown option or missing value: " << arg << endl;
+      printUsage(err);
+      return 1;
+    }
+    else{
+      QString value = args.takeFirst();
+      bool isNumber = true;
+      if(arg == "--base"){
+        options.basePath = value;
+        if(!options.basePath.startsWith("/")){
+          options.basePath.prepend("/");
+        }
+        if(!options.basePath.endsWith("/")){
+          options.basePath.append("/");
+        }
+      }
+      else if(arg == "--password"){
+        options.password = value;
+      }
+      else if(arg == "--port"){
+        port = value.toInt(&isNumber);
+      }
+      else if(arg == "--latency"){
+        options.latency = value.toInt(&isNumber);
+      }
+      else if(arg == "--jitter"){
+        options.jitter = value.toInt(&isNumber);
+      }
+      else if(arg == "--error-rate"){
+        options.errorRate = value.toInt(&isNumber);
+      }
+      else if(arg == "--drop-rate"){
+        options.dropRate = value.toInt(&isNumber);
+      }
+      else if(arg == "--challenge-rate"){
+        options.challengeRate = value.toInt(&isNumber);
+      }
+      else if(arg == "--ticket-lifetime"){
+        options.ticketLifetime = value.toInt(&isNumber);
+      }
+      else if(arg == "--participants"){
+        options.numParticipants = value.toInt(&isNumber);
+      }
+      else if(arg == "--churn"){
+        options.churnInterval = value.toInt(&isNumber);
+      }
+      else{
+        err << "Unknown option: " << arg << endl;
+        printUsage(err);
+        return 1;
+      }
+      if(!isNumber || value.toInt() < 0){
+        err << "Bad value for " << arg << ": " << value << endl;
+        return 1;
+      }
+    }
+  }
+
+  MockServer server(options);
+  if(!server.listen(port, listenAnywhere)){
+    err << "Couldn't listen on port " << port << endl;
+    return 1;
+  }
+  out << "Mock UDJ server listening on http://" <<
+    (listenAnywhere ? "0.0.0.0" : "localhost") << ":" << port << options.basePath << endl;
+  return app.exec();
+}